@@ -115,6 +115,9 @@ Args::Ctor()
   db_copySrcFiles   = true;
   out_db_config     = "";
   db_makeMetricDB   = true;
+  db_sharedMetricDB = false;
+  db_makeCCTDB      = false;
+  db_remapTraces    = false;
   db_addStructId    = false;
 
   out_txt           = Analysis_OUT_TXT;
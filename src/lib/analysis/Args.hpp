@@ -202,6 +202,9 @@ public:
   std::string out_db_config;     // disable: "", stdout: "-"
 
   bool db_makeMetricDB;
+  bool db_sharedMetricDB; // one shared metric db (hpcprof-mpi)
+  bool db_makeCCTDB;
+  bool db_remapTraces;    // cpId remap tables instead of rewritten traces
   bool db_addStructId;
 
   // -------------------------------------------------------
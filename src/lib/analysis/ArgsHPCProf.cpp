@@ -116,6 +116,9 @@ Options: General:\n\
   -V, --version        Print version information.\n\
   -h, --help           Print this help.\n\
   --debug [<n>]        Debug: use debug level <n>. {1}\n\
+  -j <num>, --jobs <num>\n\
+                       Use <num> threads to read and merge profiles. {1}\n\
+                       hpcprof-mpi ignores this option.\n\
 \n\
 Options: Source Code and Static Structure:\n\
   --name <name>, --title <name>\n\
@@ -152,9 +155,22 @@ Options: Output:\n\
                        Specify Experiment database name <db-path>.\n\
                        {./" Analysis_DB_DIR "}\n\
                        Experiment format {" Analysis_OUT_DB_EXPERIMENT "}\n\
-  --metric-db <yes|no>\n\
+  --metric-db <yes|no|shared>\n\
                        Control whether to generate a thread-level metric\n\
                        value database for hpcviewer scatter plots. {yes}\n\
+                       With 'shared', hpcprof-mpi writes the metrics of all\n\
+                       threads into one indexed file (experiment.thread-db)\n\
+                       instead of one file per thread.\n\
+  --cct-db <yes|no>    Control whether to also write the CCT and its metric\n\
+                       values in binary form (experiment.cctdb) for\n\
+                       tools that map the database directly. {no}\n\
+  --xml-db <yes|no>    Control whether to write " Analysis_OUT_DB_EXPERIMENT ".\n\
+                       hpcviewer and hpcserver require it. {yes}\n\
+  --trace-remap <yes|no>\n\
+                       Control whether to link trace files into the database\n\
+                       unchanged, with a call path id remap table (.cpmap)\n\
+                       for each, instead of rewriting them.  Only hpcserver\n\
+                       reads the remap tables. {no}\n\
   --remove-redundancy \n\
                        Eliminate procedure name redundancy in experiment.xml\n\
   --struct-id          Add 'str=nnn' field to profile data with the hpcstruct\n\
@@ -204,6 +220,12 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   {  0 , "metric-db",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "cct-db",          CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "xml-db",          CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "trace-remap",     CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   {  0 , "struct-id",       CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
 
@@ -216,6 +238,8 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   { 0, "remove-redundancy", CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+  { 'j', "jobs",            CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   {  0 , "debug",           CLP::ARG_OPT,  CLP::DUPOPT_CLOB, NULL,  // hidden
      CLP::isOptArg_long },
   CmdLineParser_OptArgDesc_NULL_MACRO // SGI's compiler requires this version
@@ -393,7 +417,8 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
 	parseArg_metric(metricVec[i], "--metric/-M option");
       }
     }
-    // N.B.: hpcprof checks for "force-metric": src/tool/hpcprof/Args.cpp
+    // N.B.: hpcprof checks for "force-metric" and "jobs":
+    // src/tool/hpcprof/Args.cpp
     
     // Check for other options: Output options
     bool isDbDirSet = false;
@@ -407,7 +432,27 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
     }
     if (parser.isOpt("metric-db")) {
       const string& arg = parser.getOptArg("metric-db");
-      db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+      if (arg == "shared") {
+	db_makeMetricDB = true;
+	db_sharedMetricDB = true;
+      }
+      else {
+	db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+	db_sharedMetricDB = false;
+      }
+    }
+    if (parser.isOpt("cct-db")) {
+      const string& arg = parser.getOptArg("cct-db");
+      db_makeCCTDB = CmdLineParser::parseArg_bool(arg, "--cct-db option");
+    }
+    if (parser.isOpt("xml-db")) {
+      const string& arg = parser.getOptArg("xml-db");
+      bool makeXMLDB = CmdLineParser::parseArg_bool(arg, "--xml-db option");
+      out_db_experiment = (makeXMLDB) ? Analysis_OUT_DB_EXPERIMENT : "";
+    }
+    if (parser.isOpt("trace-remap")) {
+      const string& arg = parser.getOptArg("trace-remap");
+      db_remapTraces = CmdLineParser::parseArg_bool(arg, "--trace-remap option");
     }
     if (parser.isOpt("struct-id")) {
       db_addStructId = true;
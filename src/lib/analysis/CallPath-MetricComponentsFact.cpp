@@ -165,8 +165,8 @@ MetricComponentsFact::make(Prof::CCT::ANode* node,
 
       if (stmt->hasMetric(mId_src)) {
 	double mval = stmt->metric(mId_src);
-	stmt->demandMetric(mId_dst) += mval;
-	stmt->metric(mId_src) = 0.0;
+	stmt->addMetric(mId_dst, mval);
+	stmt->setMetric(mId_src, 0.0);
       }
     }
   }
@@ -68,11 +68,25 @@ using std::dec;
 #include <string>
 using std::string;
 
+#include <vector>
+using std::vector;
+
+#include <set>
+
+#include <algorithm>
+#include <exception>
+
 #include <climits>
 #include <cstring>
 
 #include <typeinfo>
 
+#include <include/hpctoolkit-config.h>
+
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
+
 #include <sys/stat.h>
 
 //*************************** User Include Files ****************************
@@ -91,6 +105,9 @@ using std::string;
 #include <lib/profxml/XercesUtil.hpp>
 #include <lib/profxml/PGMReader.hpp>
 
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcrun-metric.h>
 
 #include <lib/binutils/LM.hpp>
@@ -138,15 +155,315 @@ namespace Analysis {
 namespace CallPath {
 
 
+//***************************************************************************
+// Parallel reading of profiles (hpcprof -j)
+//***************************************************************************
+
+typedef vector<Prof::Metric::Mgr::PerfEventStatistics> PerfEventStatisticsVec;
+
+
+// A partially merged profile together with the name suffix each of
+// its metrics had when it was read.  Metric::Mgr::insert() makes
+// metric names unique with a suffix that depends on the metrics
+// already in the target; to obtain the names the sequential reader
+// would obtain, the original suffixes are restored before merging a
+// partial profile into another one.
+struct PartialProfile {
+  PartialProfile()
+    : prof(NULL)
+  { }
+
+  Prof::CallPath::Profile* prof;
+  vector<string> metricSfx;
+};
+
+
+static void
+readPartial(PartialProfile& x, const Util::StringVec& profileFiles,
+	    const Util::UIntVec* groupMap, uint i, uint rFlags,
+	    PerfEventStatisticsVec& stats)
+{
+  uint groupId = (groupMap) ? (*groupMap)[i] : 0;
+  x.prof = read(profileFiles[i], groupId, rFlags);
+
+  Prof::Metric::Mgr* mMgr = x.prof->metricMgr();
+  mMgr->perfEventStatistics(stats[i]);
+
+  x.metricSfx.resize(mMgr->size());
+  for (uint j = 0; j < mMgr->size(); ++j) {
+    x.metricSfx[j] = mMgr->metric(j)->nameSfx();
+  }
+}
+
+
+// mergePartial: merge 'y' into 'x' (and delete 'y') as if the
+// profiles within 'y' had been merged into 'x' one at a time.
+static void
+mergePartial(PartialProfile& x, PartialProfile& y, int mergeTy,
+	     uint mrgFlags)
+{
+  Prof::Metric::Mgr* y_mMgr = y.prof->metricMgr();
+  for (uint j = 0; j < y_mMgr->size(); ++j) {
+    y_mMgr->metric(j)->nameSfx(y.metricSfx[j]);
+  }
+
+  x.prof->merge(*y.prof, mergeTy, mrgFlags);
+  x.metricSfx.insert(x.metricSfx.end(),
+		     y.metricSfx.begin(), y.metricSfx.end());
+
+  delete y.prof;
+  y.prof = NULL;
+  y.metricSfx.clear();
+}
+
+
+// readTree: Each thread reads and left-folds a contiguous range of
+// 'profileFiles'; the partial profiles are then merged pairwise in a
+// tree reduction (cf. hpcprof-mpi's ParallelAnalysis::reduce()).
+// Because a partial profile only ever absorbs the partial profile to
+// its right, CCT children, load modules and metrics appear in the
+// same order as in the sequential reader.
+//
+// N.B.: Merging partial profiles renumbers call path ids differently
+// than the sequential reader would.  This is harmless unless the
+// profiles have traces, which is why readParallel() uses readOrdered()
+// in that case.
+static Prof::CallPath::Profile*
+readTree(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	 int mergeTy, uint rFlags, uint mrgFlags, uint numThreads,
+	 PartialProfile& prof0, PerfEventStatisticsVec& stats)
+{
+  int numFiles = profileFiles.size();
+  int numParts = std::min(numThreads, (uint)numFiles);
+
+  vector<PartialProfile> parts(numParts);
+  parts[0] = prof0;
+  prof0.prof = NULL;
+
+  std::exception_ptr error;
+
+  // 1. Each thread left-folds its range of profiles [beg, end)
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (int k = 0; k < numParts; ++k) {
+    int beg = (int)(((uint64_t)numFiles * k) / numParts);
+    int end = (int)(((uint64_t)numFiles * (k + 1)) / numParts);
+    if (k == 0) {
+      beg = 1; // profileFiles[0] has already been read
+    }
+    try {
+      for (int i = beg; i < end; ++i) {
+	PartialProfile p;
+	readPartial(p, profileFiles, groupMap, i, rFlags, stats);
+	if (parts[k].prof) {
+	  mergePartial(parts[k], p, mergeTy, mrgFlags);
+	}
+	else {
+	  parts[k] = p;
+	}
+      }
+    }
+    catch (...) {
+#ifdef ENABLE_OPENMP
+#pragma omp critical (readTree_error)
+#endif
+      {
+	if (!error) {
+	  error = std::current_exception();
+	}
+      }
+    }
+  }
+
+  // 2. Merge partial profiles pairwise: at each level, parts[k]
+  //    absorbs parts[k + stride]
+  for (int stride = 1; stride < numParts && !error; stride *= 2) {
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int k = 0; k < numParts - stride; k += 2 * stride) {
+      try {
+	mergePartial(parts[k], parts[k + stride], mergeTy, mrgFlags);
+      }
+      catch (...) {
+#ifdef ENABLE_OPENMP
+#pragma omp critical (readTree_error)
+#endif
+	{
+	  if (!error) {
+	    error = std::current_exception();
+	  }
+	}
+      }
+    }
+  }
+
+  if (error) {
+    for (int k = 0; k < numParts; ++k) {
+      delete parts[k].prof;
+    }
+    std::rethrow_exception(error);
+  }
+
+  return parts[0].prof;
+}
+
+
+// readOrdered: Threads read a window of profiles in parallel; the
+// calling thread merges them in order.  Merging with
+// Prof::CCT::MrgFlg_NormalizeTraceFileY rewrites the trace file of
+// the profile being merged; this is only correct when profiles are
+// merged one at a time into the accumulated profile.  The rewrites
+// themselves are independent and run in parallel.
+static Prof::CallPath::Profile*
+readOrdered(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	    int mergeTy, uint rFlags, uint mrgFlags, uint numThreads,
+	    PartialProfile& prof0, PerfEventStatisticsVec& stats)
+{
+  int numFiles = profileFiles.size();
+
+  Prof::CallPath::Profile* prof = prof0.prof;
+  prof0.prof = NULL;
+
+  vector<PartialProfile> window(numThreads);
+
+  for (int beg = 1; beg < numFiles; beg += numThreads) {
+    int end = std::min(beg + (int)numThreads, numFiles);
+
+    std::exception_ptr error;
+
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int i = beg; i < end; ++i) {
+      try {
+	readPartial(window[i - beg], profileFiles, groupMap, i, rFlags, stats);
+      }
+      catch (...) {
+#ifdef ENABLE_OPENMP
+#pragma omp critical (readOrdered_error)
+#endif
+	{
+	  if (!error) {
+	    error = std::current_exception();
+	  }
+	}
+      }
+    }
+
+    if (error) {
+      for (int i = beg; i < end; ++i) {
+	delete window[i - beg].prof;
+      }
+      delete prof;
+      std::rethrow_exception(error);
+    }
+
+    // Merging only computes the new call path ids of each trace; the
+    // traces of the window are then rewritten concurrently.
+    for (int i = beg; i < end; ++i) {
+      Prof::CallPath::Profile* p = window[i - beg].prof;
+      prof->merge(*p, mergeTy, mrgFlags | Prof::CCT::MrgFlg_DeferTraceFixY);
+    }
+
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int i = beg; i < end; ++i) {
+      try {
+	window[i - beg].prof->fixDeferredTrace();
+      }
+      catch (...) {
+#ifdef ENABLE_OPENMP
+#pragma omp critical (readOrdered_error)
+#endif
+	{
+	  if (!error) {
+	    error = std::current_exception();
+	  }
+	}
+      }
+    }
+
+    for (int i = beg; i < end; ++i) {
+      delete window[i - beg].prof;
+      window[i - beg].prof = NULL;
+    }
+
+    if (error) {
+      delete prof;
+      std::rethrow_exception(error);
+    }
+  }
+
+  return prof;
+}
+
+
+// readParallel: Read and merge 'profileFiles' using 'numThreads'
+// threads.  The resulting profile has the same CCT, load modules and
+// metrics as the one produced by the sequential reader.  (Metric
+// values are summed in a different order, which only matters for
+// non-integral values.)
+static Prof::CallPath::Profile*
+readParallel(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	     int mergeTy, uint rFlags, uint mrgFlags, uint numThreads)
+{
+#ifdef ENABLE_OPENMP
+  omp_set_num_threads(numThreads);
+#endif
+
+  PerfEventStatisticsVec stats(profileFiles.size());
+
+  PartialProfile prof0;
+  readPartial(prof0, profileFiles, groupMap, 0, rFlags, stats);
+
+  // hpcrun either traces all threads or none
+  bool hasTraces = !prof0.prof->traceFileNameSet().empty();
+
+  Prof::CallPath::Profile* prof = NULL;
+  if (mergeTy == Prof::CallPath::Profile::Merge_CreateMetric
+      && !(hasTraces && (mrgFlags & Prof::CCT::MrgFlg_NormalizeTraceFileY))) {
+    prof = readTree(profileFiles, groupMap, mergeTy, rFlags, mrgFlags,
+		    numThreads, prof0, stats);
+  }
+  else {
+    prof = readOrdered(profileFiles, groupMap, mergeTy, rFlags, mrgFlags,
+		       numThreads, prof0, stats);
+  }
+
+  // replay the perf event statistics in the sequential reader's order
+  for (uint i = 1; i < profileFiles.size(); ++i) {
+    prof->metricMgr()->mergePerfEventStatistics(stats[i]);
+  }
+  prof->metricMgr()->mergePerfEventStatistics_finalize(profileFiles.size());
+
+  // add the directories into the set of directories
+  for (uint i = 0; i < profileFiles.size(); ++i) {
+    prof->addDirectory(profileFiles[i]);
+  }
+
+  return prof;
+}
+
+
+//***************************************************************************
+
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags, uint mrgFlags)
+     int mergeTy, uint rFlags, uint mrgFlags, uint numThreads)
 {
   // Special case
   if (profileFiles.empty()) {
     Prof::CallPath::Profile* prof = Prof::CallPath::Profile::make(rFlags);
     return prof;
   }
+
+  if (numThreads > 1 && profileFiles.size() > 1) {
+    return readParallel(profileFiles, groupMap, mergeTy, rFlags, mrgFlags,
+			numThreads);
+  }
   
   // General case
   uint groupId = (groupMap) ? (*groupMap)[0] : 0;
@@ -317,9 +634,27 @@ coalesceStmts(Prof::Struct::ANode* node)
 
 typedef std::map<Prof::Struct::ANode*, Prof::CCT::ANode*> StructToCCTMap;
 
+typedef std::vector<Prof::CCT::ADynNode*> ADynNodeVec;
+typedef std::vector<Prof::Struct::ACodeNode*> ACodeNodeVec;
+
 static void
-overlayStaticStructure(Prof::CCT::ANode* node,
-		       Prof::LoadMap::LM* loadmap_lm,
+bucketByLM(Prof::CCT::ANode* node, vector<ADynNodeVec>& lmNodes);
+
+static void
+findStructure(const ADynNodeVec& nodes, const Prof::Struct::LM* lmStrct,
+	      ACodeNodeVec& nodeStrcts);
+
+static void
+overlayStaticStructureLM(Prof::CallPath::Profile& prof,
+			 Prof::LoadMap::LM* loadmap_lm,
+			 Prof::Struct::LM* lmStrct,
+			 const ADynNodeVec& nodes,
+			 const ACodeNodeVec& nodeStrcts,
+			 bool printProgress);
+
+static void
+overlayStaticStructure(const ADynNodeVec& nodes,
+		       const ACodeNodeVec& nodeStrcts,
 		       Prof::Struct::LM* lmStrct, BinUtil::LM* lm);
 
 static Prof::CCT::ANode*
@@ -342,6 +677,14 @@ coalesceStmts(Prof::CallPath::Profile& prof);
 //****************************************************************************
 
 
+// overlayStaticStructureMain: Rather than walking the CCT once per
+// load module, bucket the CCT's ADynNodes by load module in one walk
+// and then overlay each load module's bucket.  Looking up existing
+// structure only reads the load module's Struct::LM and runs in
+// parallel; creating structure and frames modifies shared trees and
+// runs in load module order.  Reading a BinUtil::LM for a load module
+// without structure also stays serial: BFD keeps global state
+// (bfd_init(), bfd_get_error()) and is not thread safe.
 void
 Analysis::CallPath::
 overlayStaticStructureMain(Prof::CallPath::Profile& prof,
@@ -357,21 +700,62 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
   // Overlay static structure. N.B. To process spurious samples,
   // iteration includes LoadMap::LMId_NULL
   // -------------------------------------------------------
-  for (Prof::LoadMap::LMId_t i = Prof::LoadMap::LMId_NULL;
-      i <= loadmap->size(); ++i) {
+  int numLMs = loadmap->size() + 1;
+
+  vector<Prof::Struct::LM*> lmStrcts(numLMs, NULL);
+  vector<char> doFind(numLMs, false);
+  std::set<Prof::Struct::LM*> lmStrctSet;
+
+  for (int i = Prof::LoadMap::LMId_NULL; i < numLMs; ++i) {
     Prof::LoadMap::LM* lm = loadmap->lm(i);
     if (lm->isUsed()) {
       try {
-        const string& lm_nm = lm->name();
+        lmStrcts[i] = Prof::Struct::LM::demand(rootStrct, lm->name());
+      }
+      catch (const Diagnostics::Exception& x) {
+        errors += "  " + x.what() + "\n";
+        continue;
+      }
+      // search a Struct::LM shared by load modules for only one of them
+      doFind[i] = (lmStrcts[i]->childCount() > 0
+		   && lmStrctSet.insert(lmStrcts[i]).second);
+    }
+  }
+
+  vector<ADynNodeVec> lmNodes(numLMs);
+  bucketByLM(prof.cct()->root(), lmNodes);
+
+  // N.B.: A load module without structure finds none; its structure
+  // is made while overlaying (cf. Analysis::Util::demandStructure()).
+  vector<ACodeNodeVec> lmNodeStrcts(numLMs);
 
-        Prof::Struct::LM* lmStrct = Prof::Struct::LM::demand(rootStrct, lm_nm);
-        Analysis::CallPath::overlayStaticStructureMain(prof, lm, lmStrct,
-                                                       printProgress);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (int i = Prof::LoadMap::LMId_NULL; i < numLMs; ++i) {
+    if (doFind[i] && !lmNodes[i].empty()) {
+      try {
+	findStructure(lmNodes[i], lmStrcts[i], lmNodeStrcts[i]);
+      }
+      catch (...) {
+	lmNodeStrcts[i].clear(); // overlaying will report any error
+      }
+    }
+  }
+
+  for (int i = Prof::LoadMap::LMId_NULL; i < numLMs; ++i) {
+    if (lmStrcts[i]) {
+      try {
+        overlayStaticStructureLM(prof, loadmap->lm(i), lmStrcts[i],
+				 lmNodes[i], lmNodeStrcts[i], printProgress);
       }
       catch (const Diagnostics::Exception& x) {
         errors += "  " + x.what() + "\n";
       }
     }
+
+    ADynNodeVec().swap(lmNodes[i]);
+    ACodeNodeVec().swap(lmNodeStrcts[i]);
   }
 
   if (!errors.empty()) {
@@ -390,61 +774,19 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
 }
 
 
-void
-Analysis::CallPath::
-overlayStaticStructureMain(Prof::CallPath::Profile& prof,
-			   Prof::LoadMap::LM* loadmap_lm,
-			   Prof::Struct::LM* lmStrct,
-                           bool printProgress)
-{
-  const string& lm_nm = loadmap_lm->name();
-  BinUtil::LM* lm = NULL;
-
-  bool useStruct = (lmStrct->childCount() > 0);
-
-  if (useStruct) {
-    DIAG_MsgIf(printProgress, "STRUCTURE: " << lm_nm);
-  } else if (loadmap_lm->id() == Prof::LoadMap::LMId_NULL) {
-    // no-op for this case
-  } else if (vdso_loadmodule(lm_nm.c_str()))  {
-    DIAG_WMsgIf(printProgress, "Cannot fully process samples for virtual load module " << lm_nm);
-  } else {
-
-    try {
-      lm = new BinUtil::LM();
-      lm->open(lm_nm.c_str());
-      lm->read(prof.directorySet(), BinUtil::LM::ReadFlg_Proc);
-    }
-    catch (const Diagnostics::Exception& x) {
-      delete lm;
-      lm = NULL;
-      DIAG_WMsgIf(printProgress, "Cannot fully process samples for load module " << 
-                  lm_nm << ": " << x.what());
-    }
-    if (lm) DIAG_MsgIf(printProgress, "Line map : " << lm_nm);
-  }
-
-  if (lm) {
-    lmStrct->pretty_name(lm->name().c_str());
-  }
-  Analysis::CallPath::overlayStaticStructure(prof, loadmap_lm, lmStrct, lm);
-  
-  // account for new structure inserted by BAnal::Struct::makeStructureSimple()
-  lmStrct->computeVMAMaps();
-
-  delete lm;
-}
-
-
 // overlayStaticStructure: Create frames for CCT::Call and CCT::Stmt
-// nodes using a preorder walk over the CCT.
+// nodes of one load module.
 void
 Analysis::CallPath::
 overlayStaticStructure(Prof::CallPath::Profile& prof,
 		       Prof::LoadMap::LM* loadmap_lm,
 		       Prof::Struct::LM* lmStrct, BinUtil::LM* lm)
 {
-  overlayStaticStructure(prof.cct()->root(), loadmap_lm, lmStrct, lm);
+  vector<ADynNodeVec> lmNodes(prof.loadmap()->size() + 1);
+  bucketByLM(prof.cct()->root(), lmNodes);
+
+  ::overlayStaticStructure(lmNodes[loadmap_lm->id()], ACodeNodeVec(),
+			   lmStrct, lm);
 }
 
 
@@ -486,95 +828,152 @@ noteStaticStructureOnLeaves(Prof::CallPath::Profile& prof)
 
 //****************************************************************************
 
+// bucketByLM: Append each ADynNode below 'node' to the bucket of its
+// load module.  The nodes of a bucket with the same parent are
+// adjacent.  Use cmpByDynInfo()-ordering so that results are
+// deterministic (cf. hpcprof-mpi)
 static void
-overlayStaticStructure(Prof::CCT::ANode* node,
-		       Prof::LoadMap::LM* loadmap_lm,
-		       Prof::Struct::LM* lmStrct, BinUtil::LM* lm)
+bucketByLM(Prof::CCT::ANode* node, vector<ADynNodeVec>& lmNodes)
 {
-  // INVARIANT: The parent of 'node' has been fully processed
-  // w.r.t. the given load module and lives within a correctly located
-  // procedure frame.
-  
-  if (!node) { return; }
+  Prof::CCT::ANodeSortedChildIterator it(node, Prof::CCT::ANodeSortedIterator::cmpByDynInfo);
 
-  bool useStruct = (!lm);
-
-  // N.B.: dynamically allocate to better handle the deep recursion
-  // required for very deep CCTs.
-  StructToCCTMap* strctToCCTMap = new StructToCCTMap;
-
-  if (0 && Analysis::CallPath::dbgOs) {
-    (*Analysis::CallPath::dbgOs) << "overlayStaticStructure: node (";
-    Prof::CCT::ADynNode* node_dyn = dynamic_cast<Prof::CCT::ADynNode*>(node);
-    if (node_dyn) {
-      (*Analysis::CallPath::dbgOs) << node_dyn->lmId() << ", " << hex << node_dyn->lmIP() << dec;
+  for ( ; it.current(); it++) {
+    Prof::CCT::ADynNode* n_dyn = dynamic_cast<Prof::CCT::ADynNode*>(it.current());
+    if (n_dyn && n_dyn->lmId() < lmNodes.size()) {
+      lmNodes[n_dyn->lmId()].push_back(n_dyn);
     }
-    (*Analysis::CallPath::dbgOs) << "): " << node->toStringMe() << std::endl;
   }
 
-  // ---------------------------------------------------
-  // For each immediate child of this node...
-  //
-  // Use cmpByDynInfo()-ordering so that results are deterministic
-  // (cf. hpcprof-mpi)
-  // ---------------------------------------------------
-  for (Prof::CCT::ANodeSortedChildIterator it(node, Prof::CCT::ANodeSortedIterator::cmpByDynInfo);
-       it.current(); /* */) {
+  // N.B.: recur only after all children are bucketed
+  for (it.reset(); it.current(); it++) {
     Prof::CCT::ANode* n = it.current();
-    it++; // advance iterator -- it is pointing at 'n'
-    
-    // ---------------------------------------------------
-    // process Prof::CCT::ADynNode nodes
-    // 
-    // N.B.: Since we process w.r.t. one load module at a time, we may
-    //   see non-ADynNode nodes!
-    // ---------------------------------------------------
-    Prof::CCT::ADynNode* n_dyn = dynamic_cast<Prof::CCT::ADynNode*>(n);
-    if (n_dyn && (n_dyn->lmId() == loadmap_lm->id())) {
-      using namespace Prof;
+    if (!n->isLeaf()) {
+      bucketByLM(n, lmNodes);
+    }
+  }
+}
 
-      const string* unkProcNm = NULL;
-      if (n_dyn->isSecondarySynthRoot()) {
-	unkProcNm = &Struct::Tree::PartialUnwindProcNm;
-      }
 
-      // 1. Add symbolic information to 'n_dyn'
-      VMA lm_ip = n_dyn->lmIP();
-      Struct::ACodeNode* strct =
-	Analysis::Util::demandStructure(lm_ip, lmStrct, lm, useStruct,
-					unkProcNm);
-      
-      n->structure(strct);
-      //strct->demandMetric(CallPath::Profile::StructMetricIdFlg) += 1.0;
+// findStructure: Find the existing structure (if any) of each of
+// 'nodes'.  Only reads 'lmStrct'.
+static void
+findStructure(const ADynNodeVec& nodes, const Prof::Struct::LM* lmStrct,
+	      ACodeNodeVec& nodeStrcts)
+{
+  nodeStrcts.resize(nodes.size());
+  for (uint i = 0; i < nodes.size(); ++i) {
+    nodeStrcts[i] = lmStrct->findByVMA(nodes[i]->lmIP());
+  }
+}
 
-      DIAG_MsgIf(0, "overlayStaticStructure: dyn (" << n_dyn->lmId() << ", " << hex << lm_ip << ") --> struct " << strct << dec << " " << strct->toStringMe());
-      if (0 && Analysis::CallPath::dbgOs) {
-	(*Analysis::CallPath::dbgOs) << "dyn (" << n_dyn->lmId() << ", " << hex << lm_ip << dec << ") --> struct " << strct->toStringMe() << std::endl;
-      }
 
-      // 2. Demand a procedure frame for 'n_dyn' and its scope within it
-      Struct::ANode* scope_strct = strct->ancestor(Struct::ANode::TyLoop,
-						   Struct::ANode::TyAlien,
-						   Struct::ANode::TyProc);
-      //scope_strct->demandMetric(CallPath::Profile::StructMetricIdFlg) += 1.0;
+static void
+overlayStaticStructureLM(Prof::CallPath::Profile& prof,
+			 Prof::LoadMap::LM* loadmap_lm,
+			 Prof::Struct::LM* lmStrct,
+			 const ADynNodeVec& nodes,
+			 const ACodeNodeVec& nodeStrcts,
+			 bool printProgress)
+{
+  const string& lm_nm = loadmap_lm->name();
+  BinUtil::LM* lm = NULL;
 
-      Prof::CCT::ANode* scope_frame =
-	demandScopeInFrame(n_dyn, scope_strct, *strctToCCTMap);
+  bool useStruct = (lmStrct->childCount() > 0);
 
-      // 3. Link 'n' to its parent
-      n->unlink();
-      n->link(scope_frame);
+  if (useStruct) {
+    DIAG_MsgIf(printProgress, "STRUCTURE: " << lm_nm);
+  } else if (loadmap_lm->id() == Prof::LoadMap::LMId_NULL) {
+    // no-op for this case
+  } else if (vdso_loadmodule(lm_nm.c_str()))  {
+    DIAG_WMsgIf(printProgress, "Cannot fully process samples for virtual load module " << lm_nm);
+  } else {
+
+    try {
+      lm = new BinUtil::LM();
+      lm->open(lm_nm.c_str());
+      lm->read(prof.directorySet(), BinUtil::LM::ReadFlg_Proc);
     }
-    
-    // ---------------------------------------------------
-    // recur
-    // ---------------------------------------------------
-    if (!n->isLeaf()) {
-      overlayStaticStructure(n, loadmap_lm, lmStrct, lm);
+    catch (const Diagnostics::Exception& x) {
+      delete lm;
+      lm = NULL;
+      DIAG_WMsgIf(printProgress, "Cannot fully process samples for load module " << 
+                  lm_nm << ": " << x.what());
     }
+    if (lm) DIAG_MsgIf(printProgress, "Line map : " << lm_nm);
   }
 
-  delete strctToCCTMap;
+  if (lm) {
+    lmStrct->pretty_name(lm->name().c_str());
+  }
+  overlayStaticStructure(nodes, nodeStrcts, lmStrct, lm);
+  
+  // account for new structure inserted by BAnal::Struct::makeStructureSimple()
+  lmStrct->computeVMAMaps();
+
+  delete lm;
+}
+
+
+// overlayStaticStructure: Create frames for 'nodes', the ADynNodes of
+// one load module (cf. bucketByLM()).  If non-empty, 'nodeStrcts'
+// holds the existing structure of each node (cf. findStructure()).
+static void
+overlayStaticStructure(const ADynNodeVec& nodes,
+		       const ACodeNodeVec& nodeStrcts,
+		       Prof::Struct::LM* lmStrct, BinUtil::LM* lm)
+{
+  bool useStruct = (!lm);
+
+  // Frames are made per parent.  INVARIANT: A node's parent has not
+  // changed since bucketByLM(), though the parent itself may have
+  // been moved into a frame.
+  Prof::CCT::ANode* parent = NULL;
+  StructToCCTMap strctToCCTMap;
+
+  for (uint i = 0; i < nodes.size(); ++i) {
+    using namespace Prof;
+
+    CCT::ADynNode* n_dyn = nodes[i];
+
+    if (n_dyn->parent() != parent) {
+      parent = n_dyn->parent();
+      strctToCCTMap.clear();
+    }
+
+    const string* unkProcNm = NULL;
+    if (n_dyn->isSecondarySynthRoot()) {
+      unkProcNm = &Struct::Tree::PartialUnwindProcNm;
+    }
+
+    // 1. Add symbolic information to 'n_dyn'
+    VMA lm_ip = n_dyn->lmIP();
+    Struct::ACodeNode* strct = (i < nodeStrcts.size()) ? nodeStrcts[i] : NULL;
+    if (!strct) {
+      strct = Analysis::Util::demandStructure(lm_ip, lmStrct, lm, useStruct,
+					      unkProcNm);
+    }
+
+    n_dyn->structure(strct);
+    //strct->demandMetric(CallPath::Profile::StructMetricIdFlg) += 1.0;
+
+    DIAG_MsgIf(0, "overlayStaticStructure: dyn (" << n_dyn->lmId() << ", " << hex << lm_ip << ") --> struct " << strct << dec << " " << strct->toStringMe());
+    if (0 && Analysis::CallPath::dbgOs) {
+      (*Analysis::CallPath::dbgOs) << "dyn (" << n_dyn->lmId() << ", " << hex << lm_ip << dec << ") --> struct " << strct->toStringMe() << std::endl;
+    }
+
+    // 2. Demand a procedure frame for 'n_dyn' and its scope within it
+    Struct::ANode* scope_strct = strct->ancestor(Struct::ANode::TyLoop,
+						 Struct::ANode::TyAlien,
+						 Struct::ANode::TyProc);
+    //scope_strct->demandMetric(CallPath::Profile::StructMetricIdFlg) += 1.0;
+
+    CCT::ANode* scope_frame =
+      demandScopeInFrame(n_dyn, scope_strct, strctToCCTMap);
+
+    // 3. Link 'n_dyn' to its parent
+    n_dyn->unlink();
+    n_dyn->link(scope_frame);
+  }
 }
 
 
@@ -1056,8 +1455,9 @@ makeReturnCountMetric(Prof::CallPath::Profile& prof)
       Prof::CCT::ANode* n_parent = n->parent();
       for (uint i = 0; i < retCntId.size(); ++i) {
 	uint mId = retCntId[i];
-	n_parent->demandMetric(mId) += n->demandMetric(mId);
-	n->metric(mId) = 0.0;
+	double mVal = (n->hasMetricSlow(mId)) ? n->metric(mId) : 0.0;
+	n_parent->addMetric(mId, mVal);
+	n->setMetric(mId, 0.0);
       }
     }
   }
@@ -1076,6 +1476,13 @@ static void
 write(Prof::CallPath::Profile& prof, std::ostream& os,
       const Analysis::Args& args);
 
+static void
+writeCCTDB(Prof::CallPath::Profile& prof, const string& fnm);
+
+static void
+visibleMetricRange(Prof::CallPath::Profile& prof,
+		   uint& metricBegId, uint& metricEndId);
+
 
 // makeDatabase: assumes Analysis::Args::makeDatabaseDir() has been called
 void
@@ -1093,20 +1500,27 @@ makeDatabase(Prof::CallPath::Profile& prof, const Analysis::Args& args)
   // 2. Copy trace files (if necessary)
   Analysis::Util::copyTraceFiles(db_dir, prof.traceFileNameSet());
 
-  // 3. Create 'experiment.xml' file
-  string experiment_fnm = db_dir + "/" + args.out_db_experiment;
-  std::ostream* os = IOUtil::OpenOStream(experiment_fnm.c_str());
+  // 3. Create 'experiment.xml' file (unless disabled)
+  if (!args.out_db_experiment.empty()) {
+    string experiment_fnm = db_dir + "/" + args.out_db_experiment;
+    std::ostream* os = IOUtil::OpenOStream(experiment_fnm.c_str());
 
-  char* outBuf = new char[HPCIO_RWBufferSz];
+    char* outBuf = new char[HPCIO_RWBufferSz];
 
-  std::streambuf* os_buf = os->rdbuf();
-  os_buf->pubsetbuf(outBuf, HPCIO_RWBufferSz);
+    std::streambuf* os_buf = os->rdbuf();
+    os_buf->pubsetbuf(outBuf, HPCIO_RWBufferSz);
 
-  // 4. Write data for 'experiment.xml'
-  Analysis::CallPath::write(prof, *os, args);
-  IOUtil::CloseStream(os);
+    // 4. Write data for 'experiment.xml'
+    Analysis::CallPath::write(prof, *os, args);
+    IOUtil::CloseStream(os);
 
-  delete[] outBuf;
+    delete[] outBuf;
+  }
+
+  // 5. Create binary CCT database (if requested)
+  if (args.db_makeCCTDB) {
+    writeCCTDB(prof, db_dir + "/" + HPCPROF_CCTDBFnm);
+  }
 }
 
 
@@ -1133,13 +1547,7 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
 
   uint metricBegId = 0;
   uint metricEndId = prof.metricMgr()->size();
-
- {
-    Metric::ADesc* mBeg = prof.metricMgr()->findFirstVisible();
-    Metric::ADesc* mEnd = prof.metricMgr()->findLastVisible();
-    metricBegId = (mBeg) ? mBeg->id()     : Metric::Mgr::npos;
-    metricEndId = (mEnd) ? mEnd->id() + 1 : Metric::Mgr::npos;
-  }
+  visibleMetricRange(prof, metricBegId, metricEndId);
 
   string name = (args.title.empty()) ? prof.name() : args.title;
 
@@ -1174,6 +1582,42 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
   os.flush();
 }
 
+
+// writeCCTDB: write the CCT and the same metrics as experiment.xml in
+// hpcprof-cctdb format.  Assumes dense preorder CCT ids.
+static void
+writeCCTDB(Prof::CallPath::Profile& prof, const string& fnm)
+{
+  uint metricBegId = 0;
+  uint metricEndId = prof.metricMgr()->size();
+  visibleMetricRange(prof, metricBegId, metricEndId);
+
+  FILE* fs = hpcio_fopen_w(fnm.c_str(), 1/*overwrite*/);
+  if (!fs) {
+    DIAG_Throw("error opening cct-db file '" << fnm << "'");
+  }
+
+  int ret = Prof::CallPath::Profile::fmt_cctdb_fwrite(prof, fs, metricBegId,
+						       metricEndId);
+  hpcio_fclose(fs);
+  if (ret != HPCFMT_OK) {
+    DIAG_Throw("error writing cct-db file '" << fnm << "'");
+  }
+}
+
+
+static void
+visibleMetricRange(Prof::CallPath::Profile& prof,
+		   uint& metricBegId, uint& metricEndId)
+{
+  using namespace Prof;
+
+  Metric::ADesc* mBeg = prof.metricMgr()->findFirstVisible();
+  Metric::ADesc* mEnd = prof.metricMgr()->findLastVisible();
+  metricBegId = (mBeg) ? mBeg->id()     : Metric::Mgr::npos;
+  metricEndId = (mEnd) ? mEnd->id() + 1 : Metric::Mgr::npos;
+}
+
 } // namespace CallPath
 
 } // namespace Analysis
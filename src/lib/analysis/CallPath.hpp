@@ -94,9 +94,12 @@ extern std::ostream* dbgOs; // for parallel debugging
 //
 // ---------------------------------------------------------
 
+// read: Read and merge 'profileFiles'.  If 'numThreads' > 1, profiles
+// are read and merged concurrently; the result is the same as with
+// one thread.
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags = 0, uint mrgFlags = 0);
+     int mergeTy, uint rFlags = 0, uint mrgFlags = 0, uint numThreads = 1);
 
 Prof::CallPath::Profile*
 read(const char* prof_fnm, uint groupId, uint rFlags = 0);
@@ -138,13 +141,6 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
 			   string agent, bool doNormalizeTy,
                            bool printProgress);
 
-void
-overlayStaticStructureMain(Prof::CallPath::Profile& prof,
-			   Prof::LoadMap::LM* loadmap_lm,
-			   Prof::Struct::LM* lmStrct,
-                           bool printProgress);
-
-
 // lm is optional and may be NULL
 void 
 overlayStaticStructure(Prof::CallPath::Profile& prof,
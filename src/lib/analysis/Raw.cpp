@@ -63,6 +63,8 @@
 #include <string>
 using std::string;
 
+#include <vector>
+
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
@@ -75,6 +77,7 @@ using std::string;
 #include <lib/prof/Flat-ProfileData.hpp>
 
 #include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcio-buffer.h>
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 
@@ -96,6 +99,12 @@ Analysis::Raw::writeAsText(/*destination,*/ const char* filenm)
   else if (ty == ProfType_CallpathMetricDB) {
     writeAsText_callpathMetricDB(filenm);
   }
+  else if (ty == ProfType_CallpathCCTDB) {
+    writeAsText_callpathCCTDB(filenm);
+  }
+  else if (ty == ProfType_CallpathThreadDB) {
+    writeAsText_callpathThreadDB(filenm);
+  }
   else if (ty == ProfType_CallpathTrace) {
     writeAsText_callpathTrace(filenm);
   }
@@ -166,6 +175,111 @@ Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 }
 
 
+void
+Analysis::Raw::writeAsText_callpathCCTDB(const char* filenm)
+{
+  if (!filenm) { return; }
+
+  hpccctDB_t db;
+  if (hpccctDB_open(&db, filenm) != HPCFMT_OK) {
+    DIAG_EMsg("While reading '" << filenm << "'...");
+    DIAG_Throw("error mapping cct-db file '" << filenm << "'");
+  }
+
+  try {
+    hpccctDB_fmt_hdr_fprint(&db.hdr, stdout);
+
+    for (uint32_t nodeId = 1; nodeId < db.hdr.numNodes; ++nodeId) {
+      hpccctDB_fmt_node_t node;
+      uint64_t beg, end;
+      if (hpccctDB_node(&db, nodeId, &node) != HPCFMT_OK
+	  || hpccctDB_metricRow(&db, nodeId, &beg, &end) != HPCFMT_OK) {
+	DIAG_Throw("error reading cct-db node " << nodeId);
+      }
+
+      hpccctDB_fmt_node_fprint(&node, nodeId, stdout);
+
+      const uint32_t strIds[] = { node.lmStr, node.fileStr, node.procStr };
+      for (uint i = 0; i < sizeof(strIds) / sizeof(strIds[0]); ++i) {
+	const char* str = hpccctDB_str(&db, strIds[i]);
+	if (!str) {
+	  DIAG_Throw("error reading cct-db string " << strIds[i]);
+	}
+	if (str[0] != '\0') {
+	  fprintf(stdout, "  [str %u: %s]\n", strIds[i], str);
+	}
+      }
+
+      for (uint64_t k = beg; k < end; ++k) {
+	uint32_t mId;
+	double mVal;
+	hpccctDB_metric(&db, k, &mId, &mVal);
+	fprintf(stdout, "  (%u: %g)\n", mId, mVal);
+      }
+    }
+  }
+  catch (...) {
+    hpccctDB_close(&db);
+    DIAG_EMsg("While reading '" << filenm << "'...");
+    throw;
+  }
+
+  hpccctDB_close(&db);
+}
+
+
+void
+Analysis::Raw::writeAsText_callpathThreadDB(const char* filenm)
+{
+  if (!filenm) { return; }
+
+  hpcthreadDB_t db;
+  if (hpcthreadDB_open(&db, filenm) != HPCFMT_OK) {
+    DIAG_EMsg("While reading '" << filenm << "'...");
+    DIAG_Throw("error mapping thread-db file '" << filenm << "'");
+  }
+
+  try {
+    hpcthreadDB_fmt_hdr_fprint(&db.hdr, stdout);
+
+    for (uint32_t t = 0; t < db.hdr.numThreads; ++t) {
+      hpcthreadDB_fmt_idx_t idx;
+      if (hpcthreadDB_thread(&db, t, &idx) != HPCFMT_OK) {
+	DIAG_Throw("error reading thread-db thread " << t);
+      }
+      hpcthreadDB_fmt_idx_fprint(&idx, t, stdout);
+      fprintf(stdout, "  [%s]\n", hpcthreadDB_threadName(&db, &idx));
+
+      for (uint32_t r = 0; r < idx.numRows; ++r) {
+	uint32_t nodeId;
+	uint64_t entry, beg, end;
+	hpcthreadDB_row(&db, &idx, r, &nodeId, &entry);
+	if (hpcthreadDB_nodeMetrics(&db, &idx, nodeId, &beg, &end)
+	    != HPCFMT_OK) {
+	  DIAG_Throw("error reading thread-db node " << nodeId);
+	}
+
+	fprintf(stdout, "  (%6u: ", nodeId);
+	for (uint64_t k = beg; k < end; ++k) {
+	  uint32_t mId;
+	  double mVal;
+	  hpcthreadDB_entry(&db, &idx, k, &mId, &mVal);
+	  fprintf(stdout, "[%u: %g] ", mId, mVal);
+	}
+	fprintf(stdout, ")\n");
+      }
+    }
+  }
+  catch (...) {
+    hpcthreadDB_close(&db);
+    DIAG_EMsg("While reading '" << filenm << "'...");
+    throw;
+  }
+
+  hpcthreadDB_close(&db);
+}
+
+
 void
 Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
 {
@@ -186,18 +300,51 @@ Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
 
     hpctrace_fmt_hdr_fprint(&hdr, stdout);
 
-    // Read trace records and exit on EOF
-    while ( !feof(fs) ) {
-      hpctrace_fmt_datum_t datum;
-      ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, fs);
-      if (ret == HPCFMT_EOF) {
-	break;
-      }
-      else if (ret == HPCFMT_ERR) {
-	DIAG_Throw("error reading trace file '" << filenm << "'");
+    // Read trace records in batches (from a mapping of the file, or
+    // else through 'buf') and exit on EOF
+    std::vector<char> buf(HPCIO_RWBufferSz);
+    hpcio_inbuf_t inbuf;
+    ret = hpcio_inbuf_attach(&inbuf, fileno(fs), ftello(fs),
+			     &buf[0], buf.size(), HPCIO_INBUF_MMAP);
+    if (ret != HPCFMT_OK) {
+      DIAG_Throw("error reading trace file '" << filenm << "'");
+    }
+
+    const size_t maxRecs = 1024;
+    hpctrace_fmt_datum_t datum[maxRecs];
+    hpctrace_fmt_blk_t blk;
+    hpctrace_fmt_blk_init(&blk);
+    do {
+      size_t numRecs = maxRecs;
+      ret = hpctrace_fmt_datums_inbuf_read(datum, &numRecs, hdr.flags,
+					   &blk, &inbuf);
+      for (size_t i = 0; i < numRecs; ++i) {
+	hpctrace_fmt_datum_fprint(&datum[i], hdr.flags, stdout);
       }
+    } while (ret == HPCFMT_OK);
+
+    // hand the stream back positioned after the last record
+    off_t pos = hpcio_inbuf_tell(&inbuf);
+    hpcio_inbuf_detach(&inbuf);
+    if (ret == HPCFMT_ERR || fseeko(fs, pos, SEEK_SET) != 0) {
+      DIAG_Throw("error reading trace file '" << filenm << "'");
+    }
 
-      hpctrace_fmt_datum_fprint(&datum, hdr.flags, stdout);
+    // Block-encoded traces: print the block index
+    if (hdr.flags.fields.isBlocked) {
+      hpctrace_fmt_footer_t footer;
+      ret = hpctrace_fmt_footer_fread(&footer, fs);
+      if (ret != HPCFMT_OK || fseek(fs, footer.idxOff, SEEK_SET) != 0) {
+	DIAG_Throw("error reading block index of trace file '" << filenm << "'");
+      }
+      for (uint64_t i = 0; i < footer.numBlocks; ++i) {
+	hpctrace_fmt_blkidx_t blkIdx;
+	ret = hpctrace_fmt_blkidx_fread(&blkIdx, fs);
+	if (ret != HPCFMT_OK) {
+	  DIAG_Throw("error reading block index of trace file '" << filenm << "'");
+	}
+	hpctrace_fmt_blkidx_fprint(&blkIdx, stdout);
+      }
     }
 
     hpcio_fclose(fs);
@@ -89,6 +89,12 @@ writeAsText_callpath(/*destination,*/ const char* filenm);
 void
 writeAsText_callpathMetricDB(/*destination,*/ const char* filenm);
 
+void
+writeAsText_callpathCCTDB(/*destination,*/ const char* filenm);
+
+void
+writeAsText_callpathThreadDB(/*destination,*/ const char* filenm);
+
 void
 writeAsText_callpathTrace(/*destination,*/ const char* filenm);
 
@@ -154,6 +154,12 @@ getProfileType(const std::string& filenm)
   else if (strncmp(buf, HPCMETRICDB_FMT_Magic, HPCMETRICDB_FMT_MagicLen) == 0) {
     ty = ProfType_CallpathMetricDB;
   }
+  else if (strncmp(buf, HPCCCTDB_FMT_Magic, HPCCCTDB_FMT_MagicLen) == 0) {
+    ty = ProfType_CallpathCCTDB;
+  }
+  else if (strncmp(buf, HPCTHREADDB_FMT_Magic, HPCTHREADDB_FMT_MagicLen) == 0) {
+    ty = ProfType_CallpathThreadDB;
+  }
   else if (strncmp(buf, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen) == 0) {
     ty = ProfType_CallpathTrace;
   }
@@ -596,12 +602,50 @@ copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
     const string& srcFnm2 = x;
     const string  dstFnm = dstDir + "/" + FileUtil::basename(x);
 
+    const string  remapFnm = Prof::CallPath::Profile::traceRemapFileName(x);
+    const string  srcRemapFnm = remapFnm + "." + HPCPROF_TmpFnmSfx;
+
     // Note: the source and destination directories may be on
     // different mount points.  For the trace.tmp files, we try move
     // first (faster), if that fails, try copy and delete.  If any
     // move fails, then always copy (so only one failed move).
 
-    if (FileUtil::isReadable(srcFnm1)) {
+    if (FileUtil::isReadable(srcRemapFnm)) {
+      // cpId remap table: move it and hard link the unchanged trace
+      // (copy if the database is on another file system)
+      const string dstRemapFnm = dstDir + "/" + FileUtil::basename(remapFnm);
+      try {
+	DIAG_Msg(2, "trace remap (mv): '" << srcRemapFnm << "' -> '"
+		 << dstRemapFnm << "'");
+	FileUtil::move(dstRemapFnm, srcRemapFnm);
+      }
+      catch (const Diagnostics::Exception& ex) {
+	try {
+	  FileUtil::copy(dstRemapFnm, srcRemapFnm);
+	  FileUtil::remove(srcRemapFnm.c_str());
+	}
+	catch (const Diagnostics::Exception& ex) {
+	  DIAG_EMsg("While copying trace remap files ['"
+		    << srcRemapFnm << "' -> '" << dstRemapFnm << "']:"
+		    << ex.message());
+	}
+      }
+      try {
+	DIAG_Msg(2, "trace (ln): '" << srcFnm2 << "' -> '" << dstFnm << "'");
+	FileUtil::link(dstFnm, srcFnm2);
+      }
+      catch (const Diagnostics::Exception& ex) {
+	try {
+	  DIAG_Msg(2, "trace (cp): '" << srcFnm2 << "' -> '" << dstFnm << "'");
+	  FileUtil::copy(dstFnm, srcFnm2);
+	}
+	catch (const Diagnostics::Exception& ex) {
+	  DIAG_EMsg("While copying trace files ['"
+		    << srcFnm2 << "' -> '" << dstFnm << "']:" << ex.message());
+	}
+      }
+    }
+    else if (FileUtil::isReadable(srcFnm1)) {
       // trace.tmp exists: try move, then copy and delete
       bool copyDone = false;
       if (tryMove) {
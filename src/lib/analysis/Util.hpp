@@ -93,6 +93,8 @@ enum ProfType_t {
   ProfType_NULL,
   ProfType_Callpath,
   ProfType_CallpathMetricDB,
+  ProfType_CallpathCCTDB,
+  ProfType_CallpathThreadDB,
   ProfType_CallpathTrace,
   ProfType_Flat
 };
@@ -0,0 +1,308 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Round-trip tests for the block-encoded hpctrace records (1.02).
+//
+// Description:
+//   Encodes records with hpctrace_fmt_blk_append, writes the blocks and
+//   the terminating empty block, and decodes them again both through
+//   stdio (hpctrace_fmt_datum_blk_fread) and through an input buffer
+//   (hpctrace_fmt_datums_inbuf_read).
+//
+//***************************************************************************
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcio-buffer.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include "UnitTests.h"
+
+#define MAX_RECS 4096
+
+
+// a record sequence with small and large, forward and backward time
+// deltas, repeated and changing call paths
+static void
+makeRecords(hpctrace_fmt_datum_t* x, int n, bool isDataCentric)
+{
+  uint64_t t = 1000000;
+  for (int i = 0; i < n; ++i) {
+    t += (i % 7 == 3) ? 123456789 : (i % 11 == 5) ? (uint64_t)-40 : 250;
+    x[i].time = t;
+    x[i].cpId = (i % 3 == 0) ? (uint32_t)(i / 3) : (uint32_t)(i / 3 + 1);
+    x[i].metricId = (isDataCentric ? (uint32_t)(i % 5)
+		     : HPCRUN_FMT_MetricId_NULL);
+  }
+  x[n - 1].cpId = HPCRUN_FMT_CCTNodeId_NULL - 1; // a large varint
+}
+
+
+// encodes 'n' records into as many blocks as needed, followed by the
+// terminating empty block; returns the number of blocks
+static int
+writeRecords(FILE* fs, hpctrace_fmt_datum_t* x, int n,
+	     hpctrace_hdr_flags_t flags)
+{
+  static hpctrace_fmt_blk_t blk;
+  int numBlks = 0;
+
+  hpctrace_fmt_blk_init(&blk);
+  for (int i = 0; i < n; ++i) {
+    if (hpctrace_fmt_blk_isFull(&blk)) {
+      UT_CHECK(hpctrace_fmt_blk_fwrite(&blk, fs) == HPCFMT_OK);
+      numBlks++;
+      hpctrace_fmt_blk_init(&blk);
+    }
+    hpctrace_fmt_blk_append(&blk, &x[i], flags);
+  }
+  if (blk.numRecs > 0) {
+    UT_CHECK(hpctrace_fmt_blk_fwrite(&blk, fs) == HPCFMT_OK);
+    numBlks++;
+  }
+  hpctrace_fmt_blk_init(&blk);
+  UT_CHECK(hpctrace_fmt_blk_fwrite(&blk, fs) == HPCFMT_OK);
+  return numBlks;
+}
+
+
+static bool
+isSameDatum(const hpctrace_fmt_datum_t* x, const hpctrace_fmt_datum_t* y)
+{
+  return (x->time == y->time && x->cpId == y->cpId
+	  && x->metricId == y->metricId);
+}
+
+
+static void
+roundTrip(int n, hpctrace_hdr_flags_t flags, int numBlksExpected)
+{
+  static hpctrace_fmt_datum_t x[MAX_RECS], y[MAX_RECS + 8];
+  static hpctrace_fmt_blk_t blk;
+  static char inbufMem[1024];
+
+  flags.fields.isBlocked = true;
+  makeRecords(x, n, flags.fields.isDataCentric);
+
+  FILE* fs = tmpfile();
+  UT_CHECK(fs != NULL);
+  if (!fs) {
+    return;
+  }
+  int numBlks = writeRecords(fs, x, n, flags);
+  if (numBlksExpected > 0) {
+    UT_CHECK(numBlks == numBlksExpected);
+  }
+  fflush(fs);
+
+  // 1. stdio
+  rewind(fs);
+  hpctrace_fmt_blk_init(&blk);
+  int i = 0, ret;
+  hpctrace_fmt_datum_t d;
+  while ((ret = hpctrace_fmt_datum_blk_fread(&d, flags, &blk, fs))
+	 == HPCFMT_OK) {
+    UT_CHECK(i < n && isSameDatum(&x[i], &d));
+    i++;
+  }
+  UT_CHECK(ret == HPCFMT_EOF);
+  UT_CHECK(i == n);
+
+  // 2. input buffer, a few records at a time
+  hpcio_inbuf_t inbuf;
+  UT_CHECK(hpcio_inbuf_attach(&inbuf, fileno(fs), 0, inbufMem,
+			      sizeof(inbufMem), 0) == HPCFMT_OK);
+  hpctrace_fmt_blk_init(&blk);
+  i = 0;
+  while (true) {
+    size_t m = (i < n) ? 7 : 1;
+    ret = hpctrace_fmt_datums_inbuf_read(&y[i], &m, flags, &blk, &inbuf);
+    if (ret != HPCFMT_OK) {
+      break;
+    }
+    for (size_t k = 0; k < m; ++k, ++i) {
+      UT_CHECK(i < n && isSameDatum(&x[i], &y[i]));
+    }
+    if (i > n) {
+      break;
+    }
+  }
+  UT_CHECK(ret == HPCFMT_EOF);
+  UT_CHECK(i == n);
+  hpcio_inbuf_detach(&inbuf);
+
+  fclose(fs);
+}
+
+
+// the number of records that exactly fill one block
+static int
+recordsPerBlock(hpctrace_hdr_flags_t flags)
+{
+  static hpctrace_fmt_datum_t x[MAX_RECS];
+  static hpctrace_fmt_blk_t blk;
+
+  makeRecords(x, MAX_RECS, flags.fields.isDataCentric);
+  hpctrace_fmt_blk_init(&blk);
+  int n = 0;
+  while (!hpctrace_fmt_blk_isFull(&blk)) {
+    hpctrace_fmt_blk_append(&blk, &x[n++], flags);
+  }
+  UT_CHECK(blk.numRecs == (uint32_t)n);
+  UT_CHECK(blk.len <= HPCTRACE_FMT_BlkPayloadSz);
+  return n;
+}
+
+
+// write a remap table, optionally corrupt it, and read it back
+static int
+remapRead(int corrupt, uint32_t* numIds)
+{
+  static const uint32_t newId[] = { 0, 7, 3, 42, 5 };
+  uint32_t n = sizeof(newId) / sizeof(newId[0]);
+  uint32_t* map = NULL;
+
+  FILE* fs = tmpfile();
+  UT_CHECK(hpctrace_fmt_remap_fwrite(newId, n, fs) == HPCFMT_OK);
+  fflush(fs);
+  long cntOff = HPCTRACE_RMAP_MagicLen + HPCTRACE_RMAP_VersionLen
+    + HPCTRACE_RMAP_EndianLen;
+  if (corrupt == 1) {
+    // unknown version
+    fseek(fs, HPCTRACE_RMAP_MagicLen, SEEK_SET);
+    fputc('9', fs);
+  }
+  else if (corrupt == 2) {
+    // other endianness
+    fseek(fs, cntOff - 1, SEEK_SET);
+    fputc('l', fs);
+  }
+  else if (corrupt == 3) {
+    // a count larger than the file
+    fseek(fs, cntOff, SEEK_SET);
+    hpcfmt_int4_fwrite(0x40000000, fs);
+  }
+  fflush(fs);
+  rewind(fs);
+
+  int ret = hpctrace_fmt_remap_fread(&map, numIds, fs, malloc, free);
+  if (ret == HPCFMT_OK) {
+    UT_CHECK(*numIds == n);
+    for (uint32_t i = 0; i < n && i < *numIds; ++i) {
+      UT_CHECK(map[i] == newId[i]);
+    }
+    UT_CHECK(hpctrace_fmt_remap_cpId(map, *numIds, 3) == 42);
+  }
+  free(map);
+  fclose(fs);
+  return ret;
+}
+
+
+void
+traceBlkTest(void)
+{
+  hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
+  hpctrace_hdr_flags_t flagsDC = hpctrace_hdr_flags_NULL;
+  flagsDC.fields.isDataCentric = true;
+
+  // one record
+  roundTrip(1, flags, 1);
+  roundTrip(1, flagsDC, 1);
+
+  // exactly one full block, and one record more
+  int n = recordsPerBlock(flags);
+  roundTrip(n, flags, 1);
+  roundTrip(n + 1, flags, 2);
+
+  // data-centric records keep their metric ids across blocks
+  int nDC = recordsPerBlock(flagsDC);
+  UT_CHECK(nDC < n);
+  roundTrip(nDC, flagsDC, 1);
+  roundTrip(MAX_RECS, flagsDC, 0);
+
+  // a truncated block is an error, not the end of the trace
+  {
+    static hpctrace_fmt_datum_t x[16], y;
+    static hpctrace_fmt_blk_t blk;
+    hpctrace_hdr_flags_t f = flagsDC;
+    f.fields.isBlocked = true;
+    makeRecords(x, 16, true);
+
+    FILE* fs = tmpfile();
+    writeRecords(fs, x, 16, f);
+    fflush(fs);
+    UT_CHECK(ftruncate(fileno(fs), HPCTRACE_FMT_BlkHdrLen + 5) == 0);
+    rewind(fs);
+
+    hpctrace_fmt_blk_init(&blk);
+    int ret;
+    while ((ret = hpctrace_fmt_datum_blk_fread(&y, f, &blk, fs)) == HPCFMT_OK)
+      ;
+    UT_CHECK(ret == HPCFMT_ERR);
+    fclose(fs);
+  }
+
+  // remap tables round trip; a bad header or count is rejected
+  {
+    uint32_t numIds = 0;
+    UT_CHECK(remapRead(0, &numIds) == HPCFMT_OK);
+    UT_CHECK(remapRead(1, &numIds) == HPCFMT_ERR);
+    UT_CHECK(remapRead(2, &numIds) == HPCFMT_ERR);
+    UT_CHECK(remapRead(3, &numIds) == HPCFMT_ERR);
+  }
+}
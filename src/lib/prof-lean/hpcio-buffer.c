@@ -58,7 +58,13 @@
 // We don't need to reimplement all of stdio, just enough to meet the
 // special needs of writing hpcrun and hpctrace files from hpcrun.
 // Programs like hpcstruct and hpcprof should continue to use the
-// stdio library.
+// stdio library for writing.
+//
+// The input buffer (hpcio_inbuf_t) is the reading counterpart, for
+// the tools that read hpcrun and hpctrace files.  It fills the client
+// buffer with large pread()s, or maps the whole file, so that readers
+// can decode fixed-size records in place (hpcio_beX_get) instead of
+// going through stdio a byte at a time.
 //
 // Note: this file should be careful only to use functions that are
 // safe inside signal handlers.  In particular, don't use malloc or
@@ -71,14 +77,29 @@
 //
 // Deserves further study: the best way to handle errors from write().
 //
+// Async mode (HPCIO_OUTBUF_ASYNC): the client buffer is used as two
+// halves.  When one half fills, it is pushed onto a lock-free list of
+// pending buffers and filling continues in the other half, so the
+// caller (usually a signal handler) only copies into memory.  A helper
+// thread calls hpcio_outbuf_async_drain() to write() pending halves.
+// If the other half is still pending when the current one fills, the
+// caller waits, helping to drain the list so that progress does not
+// depend on the helper thread.  The helper sleeps on a futex between
+// handoffs; a handoff only makes the wake syscall when it is asleep.
+//
 //***************************************************************************
 
 //************************* System Include Files ****************************
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -91,6 +112,21 @@
 #include <include/min-max.h>
 
 #define HPCIO_OUTBUF_MAGIC  0x494F4246
+#define HPCIO_INBUF_MAGIC   0x49494246
+
+
+//*************************** Private Data **********************************
+
+// async mode: pending outbufs, linked through 'pend_next'
+static atomic_uintptr_t async_pending = ATOMIC_VAR_INIT(0);
+
+// async mode: called each time a writer waits for its pending half
+static void (*async_wait_fn)(void) = NULL;
+
+// async mode: futex word, bumped on every handoff and wake, and the
+// number of helper threads sleeping on it
+static atomic_int async_seq = ATOMIC_VAR_INIT(0);
+static atomic_int async_sleepers = ATOMIC_VAR_INIT(0);
 
 
 //*************************** Private Functions *****************************
@@ -137,6 +173,121 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
 }
 
 
+// Async mode: write() the pending half of the outbuf and release it.
+//
+static void
+outbuf_async_write(hpcio_outbuf_t *outbuf)
+{
+  ssize_t amt_done, ret;
+
+  amt_done = 0;
+  while (amt_done < outbuf->pend_size) {
+    errno = 0;
+    ret = write(outbuf->fd, outbuf->pend_start + amt_done,
+		outbuf->pend_size - amt_done);
+
+    if (ret > 0 || (ret == 0 && errno == EINTR)) {
+      amt_done += ret;
+    }
+    else {
+      // hard failure: drop the data and report it at close
+      outbuf->pend_err = 1;
+      break;
+    }
+  }
+
+  outbuf->pend_size = 0;
+  atomic_store_explicit(&outbuf->pend_state, 0, memory_order_release);
+}
+
+
+// Async mode: bump the futex word and wake the helper if it sleeps.
+//
+static void
+outbuf_async_signal(void)
+{
+  atomic_fetch_add(&async_seq, 1);
+  if (atomic_load(&async_sleepers) > 0) {
+    syscall(SYS_futex, &async_seq, FUTEX_WAKE_PRIVATE, INT_MAX,
+	    NULL, NULL, 0);
+  }
+}
+
+
+// Async mode: wait until the pending half of the outbuf is written.
+//
+// A drain takes the whole pending list at once, so a signal handler
+// that interrupts it and then waits for a half on that (now private)
+// list would spin forever.  Block all signals while helping drain.
+// Use the raw syscall: the sigprocmask() wrappers may refuse to block
+// the sampling signals.
+//
+static void
+outbuf_async_wait(hpcio_outbuf_t *outbuf)
+{
+  if (atomic_load_explicit(&outbuf->pend_state, memory_order_acquire) == 0) {
+    return;
+  }
+
+  if (async_wait_fn) {
+    async_wait_fn();
+  }
+
+  sigset_t all, old;
+  sigfillset(&all);
+  syscall(SYS_rt_sigprocmask, SIG_BLOCK, &all, &old, _NSIG / 8);
+
+  while (atomic_load_explicit(&outbuf->pend_state, memory_order_acquire) != 0) {
+    hpcio_outbuf_async_drain();
+  }
+
+  syscall(SYS_rt_sigprocmask, SIG_SETMASK, &old, NULL, _NSIG / 8);
+}
+
+
+// Async mode: swap halves and hand the full one to the writer.
+//
+// Returns: HPCFMT_OK, or HPCFMT_ERR if an earlier write failed.
+//
+static int
+outbuf_async_handoff(hpcio_outbuf_t *outbuf)
+{
+  outbuf_async_wait(outbuf);
+
+  if (outbuf->in_use > 0) {
+    void *full = outbuf->buf_start;
+    outbuf->buf_start = outbuf->pend_start;
+    outbuf->pend_start = full;
+    outbuf->pend_size = outbuf->in_use;
+    outbuf->in_use = 0;
+    atomic_store_explicit(&outbuf->pend_state, 1, memory_order_relaxed);
+
+    uintptr_t head = atomic_load_explicit(&async_pending, memory_order_relaxed);
+    do {
+      outbuf->pend_next = (hpcio_outbuf_t *) head;
+    } while (!atomic_compare_exchange_weak_explicit(&async_pending, &head,
+						    (uintptr_t) outbuf,
+						    memory_order_release,
+						    memory_order_relaxed));
+    outbuf_async_signal();
+  }
+
+  return (outbuf->pend_err) ? HPCFMT_ERR : HPCFMT_OK;
+}
+
+
+// Write or hand off the outbuf, depending on its mode.
+//
+static int
+outbuf_flush(hpcio_outbuf_t *outbuf)
+{
+  if (outbuf->flags & HPCIO_OUTBUF_ASYNC) {
+    return outbuf_async_handoff(outbuf);
+  }
+  return outbuf_flush_buffer(outbuf);
+}
+
+
 //*************************** Interface Functions ***************************
 
 // Attach the file descriptor to the buffer, initialize and fill in
@@ -163,6 +314,16 @@ hpcio_outbuf_attach(hpcio_outbuf_t *outbuf /* out */, int fd,
   outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
   spinlock_unlock(&outbuf->lock);
 
+  outbuf->pend_start = NULL;
+  outbuf->pend_size = 0;
+  atomic_store_explicit(&outbuf->pend_state, 0, memory_order_relaxed);
+  outbuf->pend_err = 0;
+  outbuf->pend_next = NULL;
+  if (flags & HPCIO_OUTBUF_ASYNC) {
+    outbuf->buf_size = buf_size / 2;
+    outbuf->pend_start = buf_start + outbuf->buf_size;
+  }
+
   return HPCFMT_OK;
 }
 
@@ -187,7 +348,7 @@ hpcio_outbuf_write(hpcio_outbuf_t *outbuf, const void *data, size_t size)
   while (amt_done < size) {
     // flush if needed
     if (size > outbuf->buf_size - outbuf->in_use) {
-      outbuf_flush_buffer(outbuf);
+      outbuf_flush(outbuf);
       if (outbuf->in_use == outbuf->buf_size) {
 	// flush failed, no space
 	break;
@@ -222,7 +383,10 @@ hpcio_outbuf_flush(hpcio_outbuf_t *outbuf)
     spinlock_lock(&outbuf->lock);
   }
 
-  int ret = outbuf_flush_buffer(outbuf);
+  int ret = outbuf_flush(outbuf);
+  if (outbuf->flags & HPCIO_OUTBUF_ASYNC) {
+    outbuf_async_wait(outbuf);
+  }
 
   if (outbuf->use_lock) {
     spinlock_unlock(&outbuf->lock);
@@ -249,7 +413,15 @@ hpcio_outbuf_close(hpcio_outbuf_t *outbuf)
     spinlock_lock(&outbuf->lock);
   }
 
-  if (outbuf_flush_buffer(outbuf) == HPCFMT_OK
+  int flush_ret = outbuf_flush(outbuf);
+  if (outbuf->flags & HPCIO_OUTBUF_ASYNC) {
+    outbuf_async_wait(outbuf);
+    if (outbuf->pend_err) {
+      flush_ret = HPCFMT_ERR;
+    }
+  }
+
+  if (flush_ret == HPCFMT_OK
       && close(outbuf->fd) == 0) {
     // flush and close both succeed
     outbuf->magic = 0;
@@ -264,3 +436,259 @@ hpcio_outbuf_close(hpcio_outbuf_t *outbuf)
   }
   return ret;
 }
+
+
+// Initialize async mode at process start (and in a fork()ed child,
+// which must not write its parent's pending buffers).  'wait_fn' is
+// called each time an async outbuf has to wait for its pending half.
+//
+void
+hpcio_outbuf_async_init(void (*wait_fn)(void))
+{
+  atomic_store_explicit(&async_pending, 0, memory_order_relaxed);
+  atomic_store_explicit(&async_seq, 0, memory_order_relaxed);
+  atomic_store_explicit(&async_sleepers, 0, memory_order_relaxed);
+  async_wait_fn = wait_fn;
+}
+
+
+// Helper thread: read the handoff sequence number.  Read it before
+// hpcio_outbuf_async_drain() and pass it to hpcio_outbuf_async_sleep()
+// so that a handoff between the two is not missed.
+//
+int
+hpcio_outbuf_async_seq(void)
+{
+  return atomic_load(&async_seq);
+}
+
+
+// Helper thread: sleep until the next handoff or
+// hpcio_outbuf_async_wake(), unless one happened since 'seq' was read.
+//
+void
+hpcio_outbuf_async_sleep(int seq)
+{
+  atomic_fetch_add(&async_sleepers, 1);
+  if (atomic_load(&async_seq) == seq
+      && atomic_load(&async_pending) == 0) {
+    syscall(SYS_futex, &async_seq, FUTEX_WAIT_PRIVATE, seq,
+	    NULL, NULL, 0);
+  }
+  atomic_fetch_sub(&async_sleepers, 1);
+}
+
+
+// Wake the helper thread, eg, to tell it to exit.
+//
+void
+hpcio_outbuf_async_wake(void)
+{
+  outbuf_async_signal();
+}
+
+
+// Write all pending halves of async outbufs.  Safe to call from
+// several threads: each pending half is written exactly once.
+//
+// Returns: the number of halves written.
+//
+int
+hpcio_outbuf_async_drain(void)
+{
+  hpcio_outbuf_t *outbuf = (hpcio_outbuf_t *)
+    atomic_exchange_explicit(&async_pending, 0, memory_order_acquire);
+
+  int num = 0;
+  while (outbuf != NULL) {
+    // read the link first: the owner may requeue the outbuf as soon
+    // as its pending half is released
+    hpcio_outbuf_t *next = outbuf->pend_next;
+    outbuf_async_write(outbuf);
+    outbuf = next;
+    num++;
+  }
+  return num;
+}
+
+
+//***************************************************************************
+// Input buffer
+//***************************************************************************
+
+// Attach the inbuf to file descriptor 'fd' for reading from 'offset'.
+// The inbuf does not own 'fd', and the file position of 'fd' is not
+// used or changed.  With HPCIO_INBUF_MMAP, a regular file is mapped
+// and 'buf_start' is not used; if the file can't be mapped, the inbuf
+// falls back to reading into 'buf_start', which may then not be NULL.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_inbuf_attach(hpcio_inbuf_t *inbuf /* out */, int fd, off_t offset,
+		   void *buf_start, size_t buf_size, int flags)
+{
+  if (inbuf == NULL || fd < 0 || offset < 0) {
+    return HPCFMT_ERR;
+  }
+
+  inbuf->magic = HPCIO_INBUF_MAGIC;
+  inbuf->fd = fd;
+  inbuf->flags = flags;
+  inbuf->eof = 0;
+  inbuf->err = 0;
+  inbuf->buf_start = buf_start;
+  inbuf->buf_size = buf_size;
+  inbuf->map_start = NULL;
+  inbuf->map_size = 0;
+
+  struct stat st;
+  if ((flags & HPCIO_INBUF_MMAP) && fstat(fd, &st) == 0
+      && S_ISREG(st.st_mode) && st.st_size > 0 && offset <= st.st_size) {
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+      inbuf->map_start = map;
+      inbuf->map_size = st.st_size;
+      inbuf->data = map;
+      inbuf->data_off = 0;
+      inbuf->pos = offset;
+      inbuf->len = st.st_size;
+      inbuf->eof = 1;
+      return HPCFMT_OK;
+    }
+  }
+
+  if (buf_start == NULL || buf_size == 0) {
+    inbuf->magic = 0;
+    return HPCFMT_ERR;
+  }
+  inbuf->data = buf_start;
+  inbuf->data_off = offset;
+  inbuf->pos = 0;
+  inbuf->len = 0;
+
+  return HPCFMT_OK;
+}
+
+
+// Make at least 'size' unread bytes available, if the file has them,
+// by moving the unread bytes to the front of the buffer and refilling
+// the rest of it.
+//
+// Returns: the number of unread bytes available, which is less than
+// 'size' only at end of file, on a read error, or if 'size' exceeds
+// the buffer size.
+//
+size_t
+hpcio_inbuf_fill(hpcio_inbuf_t *inbuf, size_t size)
+{
+  size_t avail = inbuf->len - inbuf->pos;
+  if (avail >= size || inbuf->eof || inbuf->err
+      || inbuf->magic != HPCIO_INBUF_MAGIC) {
+    return avail;
+  }
+
+  if (inbuf->pos > 0) {
+    memmove(inbuf->buf_start, inbuf->buf_start + inbuf->pos, avail);
+    inbuf->data_off += inbuf->pos;
+    inbuf->pos = 0;
+    inbuf->len = avail;
+  }
+
+  while (inbuf->len < inbuf->buf_size) {
+    ssize_t ret = pread(inbuf->fd, inbuf->buf_start + inbuf->len,
+			inbuf->buf_size - inbuf->len,
+			inbuf->data_off + inbuf->len);
+    if (ret > 0) {
+      inbuf->len += ret;
+    }
+    else if (ret == 0) {
+      inbuf->eof = 1;
+      break;
+    }
+    else if (errno != EINTR) {
+      inbuf->err = 1;
+      break;
+    }
+  }
+
+  return inbuf->len - inbuf->pos;
+}
+
+
+// Copy the next 'size' bytes of the inbuf to 'data'.  Unlike
+// hpcio_inbuf_get(), 'size' may exceed the buffer size.
+//
+// Returns: number of bytes copied, less than 'size' only at end of
+// file or on a read error.
+//
+size_t
+hpcio_inbuf_read(hpcio_inbuf_t *inbuf, void *data, size_t size)
+{
+  size_t amt, amt_done;
+
+  amt_done = 0;
+  while (amt_done < size) {
+    if (inbuf->pos == inbuf->len
+	&& hpcio_inbuf_fill(inbuf, size - amt_done) == 0) {
+      break;
+    }
+    amt = MIN(size - amt_done, inbuf->len - inbuf->pos);
+    memcpy(data + amt_done, inbuf->data + inbuf->pos, amt);
+    inbuf->pos += amt;
+    amt_done += amt;
+  }
+  return amt_done;
+}
+
+
+// Continue reading at file offset 'offset'.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_inbuf_seek(hpcio_inbuf_t *inbuf, off_t offset)
+{
+  if (inbuf == NULL || inbuf->magic != HPCIO_INBUF_MAGIC || offset < 0) {
+    return HPCFMT_ERR;
+  }
+
+  if (offset >= inbuf->data_off && offset <= inbuf->data_off + inbuf->len) {
+    inbuf->pos = offset - inbuf->data_off;
+  }
+  else if (inbuf->map_start != NULL) {
+    return HPCFMT_ERR; // past the end of the file
+  }
+  else {
+    inbuf->data_off = offset;
+    inbuf->pos = 0;
+    inbuf->len = 0;
+    inbuf->eof = 0;
+  }
+  return HPCFMT_OK;
+}
+
+
+// Release the inbuf's mapping, if any.  The file descriptor is left
+// open; use hpcio_inbuf_tell() first to resume reading it elsewhere.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_inbuf_detach(hpcio_inbuf_t *inbuf)
+{
+  if (inbuf == NULL || inbuf->magic != HPCIO_INBUF_MAGIC) {
+    return HPCFMT_ERR;
+  }
+
+  int ret = inbuf->err ? HPCFMT_ERR : HPCFMT_OK;
+  if (inbuf->map_start != NULL && munmap(inbuf->map_start, inbuf->map_size) != 0) {
+    ret = HPCFMT_ERR;
+  }
+  inbuf->magic = 0;
+  inbuf->map_start = NULL;
+  inbuf->fd = -1;
+
+  return ret;
+}
@@ -64,6 +64,15 @@ typedef struct hpcio_outbuf_s {
   int  flags;
   char use_lock;
   spinlock_t lock;
+
+  // HPCIO_OUTBUF_ASYNC: the client buffer is split into two halves.
+  // While one is filled, the other ('pend_start') is either idle or
+  // waiting for hpcio_outbuf_async_drain() to write it.
+  void  *pend_start;
+  size_t pend_size;
+  atomic_long pend_state;
+  int    pend_err;
+  struct hpcio_outbuf_s *pend_next;
 } hpcio_outbuf_t;
 
 
@@ -73,6 +82,7 @@ typedef struct hpcio_outbuf_s {
 
 #define HPCIO_OUTBUF_LOCKED    0x1
 #define HPCIO_OUTBUF_UNLOCKED  0x2
+#define HPCIO_OUTBUF_ASYNC     0x4  // write() from hpcio_outbuf_async_drain()
 
 #if defined(__cplusplus)
 extern "C" {
@@ -91,8 +101,112 @@ hpcio_outbuf_flush(hpcio_outbuf_t *outbuf);
 int
 hpcio_outbuf_close(hpcio_outbuf_t *outbuf);
 
+void
+hpcio_outbuf_async_init(void (*wait_fn)(void));
+
+int
+hpcio_outbuf_async_drain(void);
+
+int
+hpcio_outbuf_async_seq(void);
+
+void
+hpcio_outbuf_async_sleep(int seq);
+
+void
+hpcio_outbuf_async_wake(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+
+//***************************************************************************
+
+// Clients should treat the inbuf struct as opaque.
+
+typedef struct hpcio_inbuf_s {
+  uint32_t magic;
+  int   fd;
+  int   flags;
+  int   eof;
+  int   err;
+
+  // the bytes [data + pos, data + len) are the unread part of the
+  // window that starts at file offset 'data_off'
+  const unsigned char *data;
+  size_t pos;
+  size_t len;
+  off_t  data_off;
+
+  unsigned char *buf_start;
+  size_t buf_size;
+
+  // HPCIO_INBUF_MMAP: mapping of the whole file, if any
+  void  *map_start;
+  size_t map_size;
+} hpcio_inbuf_t;
+
+
+// Flags for hpcio_inbuf_attach().
+
+#define HPCIO_INBUF_MMAP  0x1  // map the file rather than pread() into the buffer
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+int
+hpcio_inbuf_attach(hpcio_inbuf_t *inbuf /* out */, int fd, off_t offset,
+		   void *buf_start, size_t buf_size, int flags);
+
+size_t
+hpcio_inbuf_fill(hpcio_inbuf_t *inbuf, size_t size);
+
+size_t
+hpcio_inbuf_read(hpcio_inbuf_t *inbuf, void *data, size_t size);
+
+int
+hpcio_inbuf_seek(hpcio_inbuf_t *inbuf, off_t offset);
+
+int
+hpcio_inbuf_detach(hpcio_inbuf_t *inbuf);
+
 #if defined(__cplusplus)
 }
 #endif
 
+
+// Return a pointer to the next 'size' bytes of the inbuf and consume
+// them, or NULL if fewer than 'size' bytes remain.  The bytes stay
+// valid until the next call on the inbuf.
+static inline const void *
+hpcio_inbuf_get(hpcio_inbuf_t *inbuf, size_t size)
+{
+  if (inbuf->len - inbuf->pos < size
+      && hpcio_inbuf_fill(inbuf, size) < size) {
+    return NULL;
+  }
+  const unsigned char *p = inbuf->data + inbuf->pos;
+  inbuf->pos += size;
+  return p;
+}
+
+
+// True if every byte of the file has been consumed (and there was no
+// read error), i.e., a failed read ended cleanly between records.
+static inline int
+hpcio_inbuf_eof(hpcio_inbuf_t *inbuf)
+{
+  return inbuf->eof && !inbuf->err && inbuf->pos == inbuf->len;
+}
+
+
+// The file offset of the next unread byte.
+static inline off_t
+hpcio_inbuf_tell(hpcio_inbuf_t *inbuf)
+{
+  return inbuf->data_off + (off_t)inbuf->pos;
+}
+
 #endif  // prof_lean_hpcio_buffer
@@ -273,19 +273,17 @@ hpcio_le8_fwrite(uint64_t* val, FILE* fs)
 // Big endian
 //***************************************************************************
 
+// The big-endian readers fetch each value with a single fread()
+// rather than one fgetc() per byte, taking the stream lock once.  A
+// short read leaves the missing low-order bytes zero.
+
 size_t
 hpcio_be2_fread(uint16_t* val, FILE* fs)
 {
-  uint16_t v = 0; // local copy of val
-  int shift = 0, num_read = 0, c;
-  
-  for (shift = 8; shift >= 0; shift -= 8) {
-    if ( (c = fgetc(fs)) == EOF ) { break; }
-    num_read++;
-    v = (uint16_t)(v | ((c & 0xff) << shift)); // 8, 0
-  }
+  unsigned char buf[sizeof(uint16_t)] = { 0 };
+  size_t num_read = fread(buf, 1, sizeof(buf), fs);
 
-  *val = v;
+  *val = hpcio_be2_get(buf);
   return num_read;
 }
 
@@ -293,16 +291,10 @@ hpcio_be2_fread(uint16_t* val, FILE* fs)
 size_t
 hpcio_be4_fread(uint32_t* val, FILE* fs)
 {
-  uint32_t v = 0; // local copy of val
-  int shift = 0, num_read = 0, c;
-  
-  for (shift = 24; shift >= 0; shift -= 8) {
-    if ( (c = fgetc(fs)) == EOF ) { break; }
-    num_read++;
-    v |= ((uint32_t)(c & 0xff) << shift); // 24, 16, 8, 0
-  }
+  unsigned char buf[sizeof(uint32_t)] = { 0 };
+  size_t num_read = fread(buf, 1, sizeof(buf), fs);
 
-  *val = v;
+  *val = hpcio_be4_get(buf);
   return num_read;
 }
 
@@ -310,16 +302,10 @@ hpcio_be4_fread(uint32_t* val, FILE* fs)
 size_t
 hpcio_be8_fread(uint64_t* val, FILE* fs)
 {
-  uint64_t v = 0; // local copy of val
-  int shift = 0, num_read = 0, c;
-  
-  for (shift = 56; shift >= 0; shift -= 8) {
-    if ( (c = fgetc(fs)) == EOF ) { break; }
-    num_read++;
-    v |= ((uint64_t)(c & 0xff) << shift); // 56, 48, 40, ... 0
-  }
+  unsigned char buf[sizeof(uint64_t)] = { 0 };
+  size_t num_read = fread(buf, 1, sizeof(buf), fs);
 
-  *val = v;
+  *val = hpcio_be8_get(buf);
   return num_read;
 }
 
@@ -327,18 +313,7 @@ hpcio_be8_fread(uint64_t* val, FILE* fs)
 size_t
 hpcio_beX_fread(uint8_t* val, size_t size, FILE* fs)
 {
-  size_t num_read = 0;
-
-  for (uint i = 0; i < size; ++i) {
-    int c = fgetc(fs);
-    if (c == EOF) {
-      break;
-    }
-    val[i] = (uint8_t) c;
-    num_read++;
-  }
-
-  return num_read;
+  return fread(val, 1, size, fs);
 }
 
 
@@ -67,6 +67,7 @@
 //************************* System Include Files ****************************
 
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 
 //*************************** User Include Files ****************************
@@ -171,6 +172,79 @@ size_t
 hpcio_beX_fwrite(uint8_t* val, size_t size, FILE* fs);
 
 
+//***************************************************************************
+
+// hpcio_beX_get: Decode the 'X'-byte big-endian value at 'p', which
+// need not be aligned.
+//
+// hpcio_be8_swap_n: Convert 'n' 8-byte big-endian values, already
+// copied into 'val', to host order in place.  The loop is simple
+// enough for compilers to vectorize.
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__)
+#  if (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#    define HPCIO_BE2_TO_HOST(x) __builtin_bswap16(x)
+#    define HPCIO_BE4_TO_HOST(x) __builtin_bswap32(x)
+#    define HPCIO_BE8_TO_HOST(x) __builtin_bswap64(x)
+#  elif (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#    define HPCIO_BE2_TO_HOST(x) (x)
+#    define HPCIO_BE4_TO_HOST(x) (x)
+#    define HPCIO_BE8_TO_HOST(x) (x)
+#  endif
+#endif
+
+static inline uint16_t
+hpcio_be2_get(const void* p)
+{
+#ifdef HPCIO_BE2_TO_HOST
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return HPCIO_BE2_TO_HOST(v);
+#else
+  const unsigned char* b = (const unsigned char*)p;
+  return (uint16_t)((b[0] << 8) | b[1]);
+#endif
+}
+
+
+static inline uint32_t
+hpcio_be4_get(const void* p)
+{
+#ifdef HPCIO_BE4_TO_HOST
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return HPCIO_BE4_TO_HOST(v);
+#else
+  const unsigned char* b = (const unsigned char*)p;
+  return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16)
+    | ((uint32_t)b[2] << 8) | (uint32_t)b[3];
+#endif
+}
+
+
+static inline uint64_t
+hpcio_be8_get(const void* p)
+{
+#ifdef HPCIO_BE8_TO_HOST
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return HPCIO_BE8_TO_HOST(v);
+#else
+  const unsigned char* b = (const unsigned char*)p;
+  return ((uint64_t)hpcio_be4_get(b) << 32) | hpcio_be4_get(b + 4);
+#endif
+}
+
+
+static inline void
+hpcio_be8_swap_n(uint64_t* val, size_t n)
+{
+  for (size_t i = 0; i < n; ++i) {
+    val[i] = hpcio_be8_get(&val[i]);
+  }
+}
+
+
 //***************************************************************************
 
 #if defined(__cplusplus)
@@ -73,6 +73,7 @@
 #include <string.h>
 
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 //*************************** User Include Files ****************************
 
@@ -639,6 +640,54 @@ hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
 }
 
 
+int
+hpcrun_fmt_cct_node_inbuf_read(hpcrun_fmt_cct_node_t* x,
+			       epoch_flags_t flags, hpcio_inbuf_t* inbuf)
+{
+  bool isLogicalUnwind = flags.fields.isLogicalUnwind;
+  size_t len = 4 + 4 + 2 + 8;
+  if (isLogicalUnwind) {
+    len += 4 + LUSH_LIP_DATA8_SZ * 8;
+  }
+
+  const unsigned char* p = hpcio_inbuf_get(inbuf, len);
+  if (!p) {
+    return hpcio_inbuf_eof(inbuf) ? HPCFMT_EOF : HPCFMT_ERR;
+  }
+
+  x->id = hpcio_be4_get(p);
+  x->id_parent = hpcio_be4_get(p + 4);
+  p += 8;
+
+  x->as_info = lush_assoc_info_NULL;
+  if (isLogicalUnwind) {
+    x->as_info.bits = hpcio_be4_get(p);
+    p += 4;
+  }
+
+  x->lm_id = hpcio_be2_get(p);
+  x->lm_ip = hpcio_be8_get(p + 2);
+  p += 10;
+
+  lush_lip_init(&x->lip);
+  if (isLogicalUnwind) {
+    memcpy(x->lip.data8, p, LUSH_LIP_DATA8_SZ * 8);
+    hpcio_be8_swap_n(x->lip.data8, LUSH_LIP_DATA8_SZ);
+  }
+
+  // metric values are decoded in bulk
+  if (x->num_metrics > 0) {
+    size_t sz = x->num_metrics * sizeof(uint64_t);
+    if (hpcio_inbuf_read(inbuf, x->metrics, sz) != sz) {
+      return HPCFMT_ERR;
+    }
+    hpcio_be8_swap_n(&x->metrics[0].bits, x->num_metrics);
+  }
+
+  return HPCFMT_OK;
+}
+
+
 int
 hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
 			   epoch_flags_t flags, FILE* fs)
@@ -800,6 +849,9 @@ hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs)
   if (hdr->version > 1.0) {
     HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->flags.bits), infs));
   }
+  if (hdr->version < 1.015) {
+    hdr->flags.fields.isBlocked = false; // only defined for 1.02+
+  }
 
   return HPCFMT_OK;
 }
@@ -822,8 +874,11 @@ hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
     k++;
   }
 
+  const char* versionStr = (flags.fields.isBlocked) ?
+    HPCTRACE_FMT_VersionBlk : HPCTRACE_FMT_Version;
+
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen);
-  hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Version, HPCTRACE_FMT_VersionLen);
+  hpcio_outbuf_write(outbuf, versionStr, HPCTRACE_FMT_VersionLen);
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Endian, HPCTRACE_FMT_EndianLen);
   ret = hpcio_outbuf_write(outbuf, buf, bufSZ);
 
@@ -844,7 +899,10 @@ hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
   nw = fwrite(HPCTRACE_FMT_Magic,   1, HPCTRACE_FMT_MagicLen, fs);
   if (nw != HPCTRACE_FMT_MagicLen) return HPCFMT_ERR;
 
-  nw = fwrite(HPCTRACE_FMT_Version, 1, HPCTRACE_FMT_VersionLen, fs);
+  const char* versionStr = (flags.fields.isBlocked) ?
+    HPCTRACE_FMT_VersionBlk : HPCTRACE_FMT_Version;
+
+  nw = fwrite(versionStr, 1, HPCTRACE_FMT_VersionLen, fs);
   if (nw != HPCTRACE_FMT_VersionLen) return HPCFMT_ERR;
 
   nw = fwrite(HPCTRACE_FMT_Endian,  1, HPCTRACE_FMT_EndianLen, fs);
@@ -967,79 +1025,1245 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 
 
 //***************************************************************************
-// hpcprof-metricdb (located here for now)
+// [hpctrace] block-encoded trace records (version 1.02)
 //***************************************************************************
 
-//***************************************************************************
-// [hpcprof-metricdb] hdr
-//***************************************************************************
+static inline int
+hpctrace_varint_put(unsigned char* buf, uint64_t val)
+{
+  int k = 0;
+  while (val >= 0x80) {
+    buf[k++] = (unsigned char)(val | 0x80);
+    val >>= 7;
+  }
+  buf[k++] = (unsigned char)val;
+  return k;
+}
+
+
+static inline int
+hpctrace_varint_get(const unsigned char* buf, uint32_t len, uint32_t* pos,
+		    uint64_t* val)
+{
+  uint64_t x = 0;
+  for (int shift = 0; shift < 64 && *pos < len; shift += 7) {
+    unsigned char b = buf[(*pos)++];
+    x |= ((uint64_t)(b & 0x7f)) << shift;
+    if (!(b & 0x80)) {
+      *val = x;
+      return HPCFMT_OK;
+    }
+  }
+  return HPCFMT_ERR;
+}
+
+
+static inline void
+hpctrace_blk_hdr_pack(hpctrace_fmt_blk_t* blk,
+		      unsigned char buf[HPCTRACE_FMT_BlkHdrLen])
+{
+  int k = 0;
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    buf[k++] = (blk->time0 >> shift) & 0xff;
+  }
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    buf[k++] = (blk->numRecs >> shift) & 0xff;
+  }
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    buf[k++] = (blk->len >> shift) & 0xff;
+  }
+}
+
+
+void
+hpctrace_fmt_blk_init(hpctrace_fmt_blk_t* blk)
+{
+  blk->time0    = 0;
+  blk->numRecs  = 0;
+  blk->len      = 0;
+  blk->pos      = 0;
+  blk->recIdx   = 0;
+  blk->prevTime = 0;
+  blk->prevCpId = HPCRUN_FMT_CCTNodeId_NULL;
+  blk->isEnd    = false;
+}
+
+
+// N.B.: async safe; no allocation or I/O
+void
+hpctrace_fmt_blk_append(hpctrace_fmt_blk_t* blk, hpctrace_fmt_datum_t* x,
+			hpctrace_hdr_flags_t flags)
+{
+  if (blk->numRecs == 0) {
+    blk->time0 = x->time;
+    blk->prevTime = x->time;
+  }
+
+  int64_t dt = (int64_t)(x->time - blk->prevTime);
+  uint64_t dtZZ = ((uint64_t)dt << 1) ^ (uint64_t)(dt >> 63);
+  bool isSameCpId = (x->cpId == blk->prevCpId);
+
+  unsigned char* buf = blk->payload + blk->pos;
+  int k = hpctrace_varint_put(buf, (dtZZ << 1) | isSameCpId);
+  if (!isSameCpId) {
+    k += hpctrace_varint_put(buf + k, x->cpId);
+  }
+  if (flags.fields.isDataCentric) {
+    k += hpctrace_varint_put(buf + k, x->metricId);
+  }
+
+  blk->pos += k;
+  blk->len = blk->pos;
+  blk->numRecs++;
+  blk->prevTime = x->time;
+  blk->prevCpId = x->cpId;
+}
+
 
 int
-hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
+hpctrace_fmt_blk_next(hpctrace_fmt_blk_t* blk, hpctrace_fmt_datum_t* x,
+		      hpctrace_hdr_flags_t flags)
 {
-  char tag[HPCMETRICDB_FMT_MagicLen + 1];
-  char version[HPCMETRICDB_FMT_VersionLen + 1];
-  char endian[HPCMETRICDB_FMT_EndianLen + 1];
+  if (blk->recIdx >= blk->numRecs) {
+    return HPCFMT_EOF;
+  }
 
-  int nr = fread(tag, 1, HPCMETRICDB_FMT_MagicLen, infs);
-  tag[HPCMETRICDB_FMT_MagicLen] = '\0';
+  uint64_t val;
+  HPCFMT_ThrowIfError(hpctrace_varint_get(blk->payload, blk->len, &blk->pos,
+					  &val));
+  uint64_t dtZZ = val >> 1;
+  int64_t dt = (int64_t)(dtZZ >> 1) ^ -(int64_t)(dtZZ & 1);
+  x->time = blk->prevTime + dt;
 
-  if (nr != HPCMETRICDB_FMT_MagicLen) {
+  if (val & 1) {
+    x->cpId = blk->prevCpId;
+  }
+  else {
+    HPCFMT_ThrowIfError(hpctrace_varint_get(blk->payload, blk->len,
+					    &blk->pos, &val));
+    x->cpId = (uint32_t)val;
+  }
+
+  if (flags.fields.isDataCentric) {
+    HPCFMT_ThrowIfError(hpctrace_varint_get(blk->payload, blk->len,
+					    &blk->pos, &val));
+    x->metricId = (uint32_t)val;
+  }
+  else {
+    x->metricId = HPCRUN_FMT_MetricId_NULL;
+  }
+
+  blk->recIdx++;
+  blk->prevTime = x->time;
+  blk->prevCpId = x->cpId;
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_blk_fread(hpctrace_fmt_blk_t* blk, FILE* fs)
+{
+  hpctrace_fmt_blk_init(blk);
+
+  int ret = hpcfmt_int8_fread(&(blk->time0), fs);
+  if (ret != HPCFMT_OK) {
+    return ret; // can be HPCFMT_EOF
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(blk->numRecs), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(blk->len), fs));
+
+  if (blk->numRecs == 0) {
+    blk->isEnd = true;
+    return HPCFMT_EOF;
+  }
+  if (blk->len > HPCTRACE_FMT_BlkPayloadSz) {
     return HPCFMT_ERR;
   }
-  if (strcmp(tag, HPCMETRICDB_FMT_Magic) != 0) {
+  if (fread(blk->payload, 1, blk->len, fs) != blk->len) {
     return HPCFMT_ERR;
   }
+  blk->prevTime = blk->time0;
 
-  nr = fread(&version, 1, HPCMETRICDB_FMT_VersionLen, infs);
-  version[HPCMETRICDB_FMT_VersionLen] = '\0';
-  if (nr != HPCMETRICDB_FMT_VersionLen) {
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_blk_outbuf(hpctrace_fmt_blk_t* blk, hpcio_outbuf_t* outbuf)
+{
+  unsigned char buf[HPCTRACE_FMT_BlkHdrLen];
+  hpctrace_blk_hdr_pack(blk, buf);
+
+  if (hpcio_outbuf_write(outbuf, buf, HPCTRACE_FMT_BlkHdrLen)
+      != HPCTRACE_FMT_BlkHdrLen) {
+    return HPCFMT_ERR;
+  }
+  if (blk->len > 0
+      && hpcio_outbuf_write(outbuf, blk->payload, blk->len) != blk->len) {
     return HPCFMT_ERR;
   }
-  hdr->version = atof(hdr->versionStr);
 
-  nr = fread(&endian, 1, HPCMETRICDB_FMT_EndianLen, infs);
-  if (nr != HPCMETRICDB_FMT_EndianLen) {
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_blk_fwrite(hpctrace_fmt_blk_t* blk, FILE* fs)
+{
+  unsigned char buf[HPCTRACE_FMT_BlkHdrLen];
+  hpctrace_blk_hdr_pack(blk, buf);
+
+  if (fwrite(buf, 1, HPCTRACE_FMT_BlkHdrLen, fs) != HPCTRACE_FMT_BlkHdrLen) {
+    return HPCFMT_ERR;
+  }
+  if (fwrite(blk->payload, 1, blk->len, fs) != blk->len) {
     return HPCFMT_ERR;
   }
 
-  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNodes), infs));
-  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numMetrics), infs));
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_datum_blk_fread(hpctrace_fmt_datum_t* x,
+			     hpctrace_hdr_flags_t flags,
+			     hpctrace_fmt_blk_t* blk, FILE* fs)
+{
+  if (!flags.fields.isBlocked) {
+    return hpctrace_fmt_datum_fread(x, flags, fs);
+  }
+
+  while (true) {
+    if (blk->isEnd) {
+      return HPCFMT_EOF;
+    }
+
+    int ret = hpctrace_fmt_blk_next(blk, x, flags);
+    if (ret != HPCFMT_EOF) {
+      return ret;
+    }
+
+    ret = hpctrace_fmt_blk_fread(blk, fs);
+    if (ret == HPCFMT_EOF) {
+      blk->isEnd = true;
+    }
+    else if (ret != HPCFMT_OK) {
+      return ret;
+    }
+  }
+}
+
+
+int
+hpctrace_fmt_blk_inbuf_read(hpctrace_fmt_blk_t* blk, hpcio_inbuf_t* inbuf)
+{
+  hpctrace_fmt_blk_init(blk);
+
+  const unsigned char* p = hpcio_inbuf_get(inbuf, HPCTRACE_FMT_BlkHdrLen);
+  if (!p) {
+    return hpcio_inbuf_eof(inbuf) ? HPCFMT_EOF : HPCFMT_ERR;
+  }
+  blk->time0 = hpcio_be8_get(p);
+  blk->numRecs = hpcio_be4_get(p + 8);
+  blk->len = hpcio_be4_get(p + 12);
+
+  if (blk->numRecs == 0) {
+    blk->isEnd = true;
+    return HPCFMT_EOF;
+  }
+  if (blk->len > HPCTRACE_FMT_BlkPayloadSz) {
+    return HPCFMT_ERR;
+  }
+  if (hpcio_inbuf_read(inbuf, blk->payload, blk->len) != blk->len) {
+    return HPCFMT_ERR;
+  }
+  blk->prevTime = blk->time0;
 
   return HPCFMT_OK;
 }
 
 
+// Flat records: decode as many as are buffered at a time
+static int
+hpctrace_datums_inbuf_read_flat(hpctrace_fmt_datum_t* x, size_t* n,
+				hpctrace_hdr_flags_t flags,
+				hpcio_inbuf_t* inbuf)
+{
+  bool isDataCentric = flags.fields.isDataCentric;
+  size_t recSz = 8 + 4 + (isDataCentric ? 4 : 0);
+  size_t numRead = 0;
+
+  while (numRead < *n) {
+    size_t m = hpcio_inbuf_fill(inbuf, recSz) / recSz;
+    if (m == 0) {
+      break;
+    }
+    if (m > *n - numRead) {
+      m = *n - numRead;
+    }
+
+    const unsigned char* p = hpcio_inbuf_get(inbuf, m * recSz);
+    for (size_t i = 0; i < m; ++i, p += recSz) {
+      hpctrace_fmt_datum_t* d = &x[numRead + i];
+      d->time = hpcio_be8_get(p);
+      d->cpId = hpcio_be4_get(p + 8);
+      d->metricId = isDataCentric ? hpcio_be4_get(p + 12)
+	: HPCRUN_FMT_MetricId_NULL;
+    }
+    numRead += m;
+  }
+
+  int ret = HPCFMT_OK;
+  if (numRead < *n && !hpcio_inbuf_eof(inbuf)) {
+    ret = HPCFMT_ERR; // truncated record or read error
+  }
+  else if (numRead == 0) {
+    ret = HPCFMT_EOF;
+  }
+  *n = numRead;
+  return ret;
+}
+
+
 int
-hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
+hpctrace_fmt_datums_inbuf_read(hpctrace_fmt_datum_t* x, size_t* n,
+			       hpctrace_hdr_flags_t flags,
+			       hpctrace_fmt_blk_t* blk, hpcio_inbuf_t* inbuf)
 {
-  int nw;
+  if (!flags.fields.isBlocked) {
+    return hpctrace_datums_inbuf_read_flat(x, n, flags, inbuf);
+  }
 
-  nw = fwrite(HPCMETRICDB_FMT_Magic,   1, HPCMETRICDB_FMT_MagicLen, outfs);
-  if (nw != HPCTRACE_FMT_MagicLen) return HPCFMT_ERR;
+  size_t numRead = 0;
+  int ret = HPCFMT_OK;
+  while (numRead < *n && !blk->isEnd) {
+    ret = hpctrace_fmt_blk_next(blk, &x[numRead], flags);
+    if (ret == HPCFMT_OK) {
+      numRead++;
+      continue;
+    }
+    else if (ret != HPCFMT_EOF) {
+      break;
+    }
 
-  nw = fwrite(HPCMETRICDB_FMT_Version, 1, HPCMETRICDB_FMT_VersionLen, outfs);
-  if (nw != HPCMETRICDB_FMT_VersionLen) return HPCFMT_ERR;
+    ret = hpctrace_fmt_blk_inbuf_read(blk, inbuf);
+    if (ret == HPCFMT_EOF) {
+      blk->isEnd = true;
+    }
+    else if (ret != HPCFMT_OK) {
+      break;
+    }
+  }
 
-  nw = fwrite(HPCMETRICDB_FMT_Endian,  1, HPCMETRICDB_FMT_EndianLen, outfs);
-  if (nw != HPCMETRICDB_FMT_EndianLen) return HPCFMT_ERR;
+  *n = numRead;
+  if (ret == HPCFMT_ERR) {
+    return HPCFMT_ERR;
+  }
+  return (numRead > 0) ? HPCFMT_OK : HPCFMT_EOF;
+}
 
-  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numNodes, outfs));
-  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numMetrics, outfs));
 
+//***************************************************************************
+// [hpctrace] block index and footer (version 1.02)
+//***************************************************************************
+
+int
+hpctrace_fmt_blkidx_fread(hpctrace_fmt_blkidx_t* x, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->time), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->off), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->numRecs), fs));
   return HPCFMT_OK;
 }
 
 
 int
-hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
+hpctrace_fmt_blkidx_outbuf(hpctrace_fmt_blkidx_t* x, hpcio_outbuf_t* outbuf)
 {
-  fprintf(outfs, "%s\n", HPCMETRICDB_FMT_Magic);
-  fprintf(outfs, "[hdr:...]\n");
+  unsigned char buf[HPCTRACE_FMT_BlkIdxLen];
+  int k = 0;
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    buf[k++] = (x->time >> shift) & 0xff;
+  }
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    buf[k++] = (x->off >> shift) & 0xff;
+  }
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    buf[k++] = (x->numRecs >> shift) & 0xff;
+  }
 
-  fprintf(outfs, "(num-nodes:   %u)\n", hdr->numNodes);
-  fprintf(outfs, "(num-metrics: %u)\n", hdr->numMetrics);
+  if (hpcio_outbuf_write(outbuf, buf, k) != k) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_blkidx_fwrite(hpctrace_fmt_blkidx_t* x, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->time, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->off, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->numRecs, fs));
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_blkidx_fprint(hpctrace_fmt_blkidx_t* x, FILE* fs)
+{
+  fprintf(fs, "(block: %"PRIu64", off: %"PRIu64", records: %u)\n",
+	  x->time, x->off, x->numRecs);
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_footer_fread(hpctrace_fmt_footer_t* x, FILE* fs)
+{
+  if (fseek(fs, -HPCTRACE_FMT_FooterLen, SEEK_END) != 0) {
+    return HPCFMT_ERR;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->idxOff), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->numBlocks), fs));
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_footer_outbuf(hpctrace_fmt_footer_t* x, hpcio_outbuf_t* outbuf)
+{
+  unsigned char buf[HPCTRACE_FMT_FooterLen];
+  int k = 0;
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    buf[k++] = (x->idxOff >> shift) & 0xff;
+  }
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    buf[k++] = (x->numBlocks >> shift) & 0xff;
+  }
+
+  if (hpcio_outbuf_write(outbuf, buf, k) != k) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
 
+
+int
+hpctrace_fmt_footer_fwrite(hpctrace_fmt_footer_t* x, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->idxOff, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->numBlocks, fs));
   return HPCFMT_OK;
 }
 
+
+//***************************************************************************
+// [hpctrace] call path id remap table
+//***************************************************************************
+
+int
+hpctrace_fmt_remap_fread(uint32_t** newId, uint32_t* numIds, FILE* fs,
+			 hpcfmt_alloc_fn alloc, hpcfmt_free_fn dealloc)
+{
+  char tag[HPCTRACE_RMAP_MagicLen + 1];
+  char version[HPCTRACE_RMAP_VersionLen + 1];
+  char endian[HPCTRACE_RMAP_EndianLen + 1];
+
+  int nr = fread(tag, 1, HPCTRACE_RMAP_MagicLen, fs);
+  tag[HPCTRACE_RMAP_MagicLen] = '\0';
+  if (nr != HPCTRACE_RMAP_MagicLen || strcmp(tag, HPCTRACE_RMAP_Magic) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(version, 1, HPCTRACE_RMAP_VersionLen, fs);
+  version[HPCTRACE_RMAP_VersionLen] = '\0';
+  if (nr != HPCTRACE_RMAP_VersionLen
+      || strcmp(version, HPCTRACE_RMAP_Version) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(endian, 1, HPCTRACE_RMAP_EndianLen, fs);
+  endian[HPCTRACE_RMAP_EndianLen] = '\0';
+  if (nr != HPCTRACE_RMAP_EndianLen
+      || strcmp(endian, HPCTRACE_RMAP_Endian) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  uint32_t n;
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&n, fs));
+
+  // a corrupt count must not size the allocation: the ids that
+  // follow must fit in the rest of the file
+  struct stat st;
+  off_t pos = ftello(fs);
+  if (pos < 0 || fstat(fileno(fs), &st) != 0 || pos > st.st_size
+      || (uint64_t) n * sizeof(uint32_t) > (uint64_t) (st.st_size - pos)) {
+    return HPCFMT_ERR;
+  }
+
+  size_t sz = ((n > 0) ? n : 1) * sizeof(uint32_t);
+  uint32_t* map = (alloc) ? (uint32_t*) alloc(sz) : NULL;
+  if (!map) {
+    return HPCFMT_ERR;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    if (hpcfmt_int4_fread(&map[i], fs) != HPCFMT_OK) {
+      if (dealloc) {
+	dealloc(map);
+      }
+      return HPCFMT_ERR;
+    }
+  }
+
+  *newId = map;
+  *numIds = n;
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_remap_fwrite(const uint32_t* newId, uint32_t numIds, FILE* fs)
+{
+  int nw;
+
+  nw = fwrite(HPCTRACE_RMAP_Magic,   1, HPCTRACE_RMAP_MagicLen, fs);
+  if (nw != HPCTRACE_RMAP_MagicLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCTRACE_RMAP_Version, 1, HPCTRACE_RMAP_VersionLen, fs);
+  if (nw != HPCTRACE_RMAP_VersionLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCTRACE_RMAP_Endian,  1, HPCTRACE_RMAP_EndianLen, fs);
+  if (nw != HPCTRACE_RMAP_EndianLen) return HPCFMT_ERR;
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(numIds, fs));
+  for (uint32_t i = 0; i < numIds; i++) {
+    HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(newId[i], fs));
+  }
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// hpcprof-metricdb (located here for now)
+//***************************************************************************
+
+//***************************************************************************
+// [hpcprof-metricdb] hdr
+//***************************************************************************
+
+int
+hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
+{
+  char tag[HPCMETRICDB_FMT_MagicLen + 1];
+  char version[HPCMETRICDB_FMT_VersionLen + 1];
+  char endian[HPCMETRICDB_FMT_EndianLen + 1];
+
+  int nr = fread(tag, 1, HPCMETRICDB_FMT_MagicLen, infs);
+  tag[HPCMETRICDB_FMT_MagicLen] = '\0';
+
+  if (nr != HPCMETRICDB_FMT_MagicLen) {
+    return HPCFMT_ERR;
+  }
+  if (strcmp(tag, HPCMETRICDB_FMT_Magic) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(&version, 1, HPCMETRICDB_FMT_VersionLen, infs);
+  version[HPCMETRICDB_FMT_VersionLen] = '\0';
+  if (nr != HPCMETRICDB_FMT_VersionLen) {
+    return HPCFMT_ERR;
+  }
+  hdr->version = atof(hdr->versionStr);
+
+  nr = fread(&endian, 1, HPCMETRICDB_FMT_EndianLen, infs);
+  if (nr != HPCMETRICDB_FMT_EndianLen) {
+    return HPCFMT_ERR;
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNodes), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numMetrics), infs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
+{
+  int nw;
+
+  nw = fwrite(HPCMETRICDB_FMT_Magic,   1, HPCMETRICDB_FMT_MagicLen, outfs);
+  if (nw != HPCTRACE_FMT_MagicLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCMETRICDB_FMT_Version, 1, HPCMETRICDB_FMT_VersionLen, outfs);
+  if (nw != HPCMETRICDB_FMT_VersionLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCMETRICDB_FMT_Endian,  1, HPCMETRICDB_FMT_EndianLen, outfs);
+  if (nw != HPCMETRICDB_FMT_EndianLen) return HPCFMT_ERR;
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numNodes, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numMetrics, outfs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
+{
+  fprintf(outfs, "%s\n", HPCMETRICDB_FMT_Magic);
+  fprintf(outfs, "[hdr:...]\n");
+
+  fprintf(outfs, "(num-nodes:   %u)\n", hdr->numNodes);
+  fprintf(outfs, "(num-metrics: %u)\n", hdr->numMetrics);
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// hpcprof-cctdb (located here for now)
+//***************************************************************************
+
+//***************************************************************************
+// [hpcprof-cctdb] hdr
+//***************************************************************************
+
+int
+hpccctDB_fmt_hdr_fread(hpccctDB_fmt_hdr_t* hdr, FILE* infs)
+{
+  char tag[HPCCCTDB_FMT_MagicLen + 1];
+
+  int nr = fread(tag, 1, HPCCCTDB_FMT_MagicLen, infs);
+  tag[HPCCCTDB_FMT_MagicLen] = '\0';
+
+  if (nr != HPCCCTDB_FMT_MagicLen) {
+    return HPCFMT_ERR;
+  }
+  if (strcmp(tag, HPCCCTDB_FMT_Magic) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(hdr->versionStr, 1, HPCCCTDB_FMT_VersionLen, infs);
+  hdr->versionStr[HPCCCTDB_FMT_VersionLen] = '\0';
+  if (nr != HPCCCTDB_FMT_VersionLen) {
+    return HPCFMT_ERR;
+  }
+  hdr->version = atof(hdr->versionStr);
+
+  nr = fread(&hdr->endian, 1, HPCCCTDB_FMT_EndianLen, infs);
+  if (nr != HPCCCTDB_FMT_EndianLen) {
+    return HPCFMT_ERR;
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNodes), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numStrings), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->metricBegId), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->metricEndId), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->numNonZeros), infs));
+
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->nodeTblOff), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->strIdxOff), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->strDataOff), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->metricRowOff), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->metricValOff), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->metricColOff), infs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpccctDB_fmt_hdr_fwrite(hpccctDB_fmt_hdr_t* hdr, FILE* outfs)
+{
+  int nw;
+
+  nw = fwrite(HPCCCTDB_FMT_Magic,   1, HPCCCTDB_FMT_MagicLen, outfs);
+  if (nw != HPCCCTDB_FMT_MagicLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCCCTDB_FMT_Version, 1, HPCCCTDB_FMT_VersionLen, outfs);
+  if (nw != HPCCCTDB_FMT_VersionLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCCCTDB_FMT_Endian,  1, HPCCCTDB_FMT_EndianLen, outfs);
+  if (nw != HPCCCTDB_FMT_EndianLen) return HPCFMT_ERR;
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numNodes, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numStrings, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->metricBegId, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->metricEndId, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->numNonZeros, outfs));
+
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->nodeTblOff, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->strIdxOff, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->strDataOff, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->metricRowOff, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->metricValOff, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->metricColOff, outfs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpccctDB_fmt_hdr_fprint(hpccctDB_fmt_hdr_t* hdr, FILE* outfs)
+{
+  fprintf(outfs, "%s\n", HPCCCTDB_FMT_Magic);
+  fprintf(outfs, "[hdr:...]\n");
+
+  fprintf(outfs, "(num-nodes:     %u)\n", hdr->numNodes);
+  fprintf(outfs, "(num-strings:   %u)\n", hdr->numStrings);
+  fprintf(outfs, "(metrics:       [%u, %u))\n",
+	  hdr->metricBegId, hdr->metricEndId);
+  fprintf(outfs, "(num-non-zeros: %"PRIu64")\n", hdr->numNonZeros);
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// [hpcprof-cctdb] node
+//***************************************************************************
+
+int
+hpccctDB_fmt_node_fwrite(hpccctDB_fmt_node_t* x, FILE* outfs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->parent, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->subtreeEnd, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->type, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->flags, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->structId, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->line, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->cpId, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->lmStr, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->fileStr, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->procStr, outfs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpccctDB_fmt_node_fprint(hpccctDB_fmt_node_t* x, uint32_t id, FILE* outfs)
+{
+  fprintf(outfs, "(%u: parent %u, end %u, type %u, flags %u, s %u, l %u, "
+	  "cpId %u, str [%u %u %u])\n", id, x->parent, x->subtreeEnd,
+	  x->type, x->flags, x->structId, x->line, x->cpId,
+	  x->lmStr, x->fileStr, x->procStr);
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// [hpcprof-cctdb] mapped reader
+//***************************************************************************
+
+// fmt_inFile: true if [off, off + len) lies within a file of size 'sz'
+static bool
+fmt_inFile(uint64_t off, uint64_t len, uint64_t sz)
+{
+  return (off <= sz && len <= sz - off);
+}
+
+
+static int
+cctdb_hdr_decode(hpccctDB_fmt_hdr_t* hdr, const char* p)
+{
+  if (memcmp(p, HPCCCTDB_FMT_Magic, HPCCCTDB_FMT_MagicLen) != 0) {
+    return HPCFMT_ERR;
+  }
+  p += HPCCCTDB_FMT_MagicLen;
+
+  memcpy(hdr->versionStr, p, HPCCCTDB_FMT_VersionLen);
+  hdr->versionStr[HPCCCTDB_FMT_VersionLen] = '\0';
+  hdr->version = atof(hdr->versionStr);
+  p += HPCCCTDB_FMT_VersionLen;
+
+  hdr->endian = *p;
+  p += HPCCCTDB_FMT_EndianLen;
+
+  hdr->numNodes     = hpcio_be4_get(p);  p += 4;
+  hdr->numStrings   = hpcio_be4_get(p);  p += 4;
+  hdr->metricBegId  = hpcio_be4_get(p);  p += 4;
+  hdr->metricEndId  = hpcio_be4_get(p);  p += 4;
+  hdr->numNonZeros  = hpcio_be8_get(p);  p += 8;
+
+  hdr->nodeTblOff   = hpcio_be8_get(p);  p += 8;
+  hdr->strIdxOff    = hpcio_be8_get(p);  p += 8;
+  hdr->strDataOff   = hpcio_be8_get(p);  p += 8;
+  hdr->metricRowOff = hpcio_be8_get(p);  p += 8;
+  hdr->metricValOff = hpcio_be8_get(p);  p += 8;
+  hdr->metricColOff = hpcio_be8_get(p);
+
+  return HPCFMT_OK;
+}
+
+
+static int
+cctdb_validate(const hpccctDB_t* db)
+{
+  const hpccctDB_fmt_hdr_t* hdr = &db->hdr;
+  uint64_t sz = db->size;
+
+  if (hdr->numNodes < 2 || hdr->metricBegId > hdr->metricEndId
+      || hdr->strDataOff > hdr->metricRowOff
+      || hdr->numNonZeros > sz / 8) {
+    return HPCFMT_ERR;
+  }
+
+  uint64_t strDataLen = hdr->metricRowOff - hdr->strDataOff;
+  if (!fmt_inFile(hdr->nodeTblOff,
+		    (uint64_t)hdr->numNodes * HPCCCTDB_FMT_NodeLen, sz)
+      || !fmt_inFile(hdr->strIdxOff,
+		       ((uint64_t)hdr->numStrings + 1) * 8, sz)
+      || !fmt_inFile(hdr->strDataOff, strDataLen, sz)
+      || !fmt_inFile(hdr->metricRowOff,
+		       ((uint64_t)hdr->numNodes + 1) * 8, sz)
+      || !fmt_inFile(hdr->metricValOff, hdr->numNonZeros * 8, sz)
+      || !fmt_inFile(hdr->metricColOff, hdr->numNonZeros * 4, sz)) {
+    return HPCFMT_ERR;
+  }
+
+  // the last string ends within the string data; the last row ends at
+  // the last non-zero value
+  const char* strIdx = db->base + hdr->strIdxOff;
+  const char* rows = db->base + hdr->metricRowOff;
+  if (hpcio_be8_get(strIdx + (uint64_t)hdr->numStrings * 8) > strDataLen
+      || hpcio_be8_get(rows + (uint64_t)hdr->numNodes * 8)
+         != hdr->numNonZeros) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+// fmt_mapFile: maps all of 'fnm' read-only if it has at least 'minSz'
+// bytes
+static int
+fmt_mapFile(const char* fnm, size_t minSz, const char** base, size_t* size)
+{
+  *base = NULL;
+  *size = 0;
+
+  int fd = open(fnm, O_RDONLY);
+  if (fd < 0) {
+    return HPCFMT_ERR;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < minSz) {
+    close(fd);
+    return HPCFMT_ERR;
+  }
+
+  void* x = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (x == MAP_FAILED) {
+    return HPCFMT_ERR;
+  }
+  *base = (const char*)x;
+  *size = st.st_size;
+  return HPCFMT_OK;
+}
+
+
+int
+hpccctDB_open(hpccctDB_t* db, const char* fnm)
+{
+  if (fmt_mapFile(fnm, HPCCCTDB_FMT_HeaderLen, &db->base, &db->size)
+      != HPCFMT_OK) {
+    return HPCFMT_ERR;
+  }
+
+  if (cctdb_hdr_decode(&db->hdr, db->base) != HPCFMT_OK
+      || cctdb_validate(db) != HPCFMT_OK) {
+    hpccctDB_close(db);
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+void
+hpccctDB_close(hpccctDB_t* db)
+{
+  if (db->base) {
+    munmap((void*)db->base, db->size);
+  }
+  db->base = NULL;
+  db->size = 0;
+}
+
+
+int
+hpccctDB_node(const hpccctDB_t* db, uint32_t id, hpccctDB_fmt_node_t* x)
+{
+  if (id == 0 || id >= db->hdr.numNodes) {
+    return HPCFMT_ERR;
+  }
+
+  const char* p = (db->base + db->hdr.nodeTblOff
+		   + (uint64_t)id * HPCCCTDB_FMT_NodeLen);
+  x->parent     = hpcio_be4_get(p +  0);
+  x->subtreeEnd = hpcio_be4_get(p +  4);
+  x->type       = hpcio_be4_get(p +  8);
+  x->flags      = hpcio_be4_get(p + 12);
+  x->structId   = hpcio_be4_get(p + 16);
+  x->line       = hpcio_be4_get(p + 20);
+  x->cpId       = hpcio_be4_get(p + 24);
+  x->lmStr      = hpcio_be4_get(p + 28);
+  x->fileStr    = hpcio_be4_get(p + 32);
+  x->procStr    = hpcio_be4_get(p + 36);
+
+  if (x->parent >= id || x->subtreeEnd <= id
+      || x->subtreeEnd > db->hdr.numNodes) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+const char*
+hpccctDB_str(const hpccctDB_t* db, uint32_t strId)
+{
+  if (strId >= db->hdr.numStrings) {
+    return NULL;
+  }
+
+  const char* strIdx = db->base + db->hdr.strIdxOff;
+  uint64_t beg = hpcio_be8_get(strIdx + (uint64_t)strId * 8);
+  uint64_t end = hpcio_be8_get(strIdx + ((uint64_t)strId + 1) * 8);
+
+  // N.B.: cctdb_validate() checked that the last offset is in bounds
+  const char* strData = db->base + db->hdr.strDataOff;
+  uint64_t strDataLen = db->hdr.metricRowOff - db->hdr.strDataOff;
+  if (beg >= end || end > strDataLen || strData[end - 1] != '\0') {
+    return NULL;
+  }
+  return strData + beg;
+}
+
+
+int
+hpccctDB_metricRow(const hpccctDB_t* db, uint32_t id,
+		   uint64_t* beg, uint64_t* end)
+{
+  if (id >= db->hdr.numNodes) {
+    return HPCFMT_ERR;
+  }
+
+  const char* rows = db->base + db->hdr.metricRowOff;
+  *beg = hpcio_be8_get(rows + (uint64_t)id * 8);
+  *end = hpcio_be8_get(rows + ((uint64_t)id + 1) * 8);
+
+  if (*beg > *end || *end > db->hdr.numNonZeros) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+void
+hpccctDB_metric(const hpccctDB_t* db, uint64_t k,
+		uint32_t* mId, double* mVal)
+{
+  uint64_t bits = hpcio_be8_get(db->base + db->hdr.metricValOff + k * 8);
+  memcpy(mVal, &bits, sizeof(bits));
+  *mId = hpcio_be4_get(db->base + db->hdr.metricColOff + k * 4);
+}
+
+
+//***************************************************************************
+// hpcprof-threaddb (located here for now)
+//***************************************************************************
+
+//***************************************************************************
+// [hpcprof-threaddb] hdr
+//***************************************************************************
+
+int
+hpcthreadDB_fmt_hdr_fread(hpcthreadDB_fmt_hdr_t* hdr, FILE* infs)
+{
+  char tag[HPCTHREADDB_FMT_MagicLen + 1];
+
+  int nr = fread(tag, 1, HPCTHREADDB_FMT_MagicLen, infs);
+  tag[HPCTHREADDB_FMT_MagicLen] = '\0';
+
+  if (nr != HPCTHREADDB_FMT_MagicLen) {
+    return HPCFMT_ERR;
+  }
+  if (strcmp(tag, HPCTHREADDB_FMT_Magic) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(hdr->versionStr, 1, HPCTHREADDB_FMT_VersionLen, infs);
+  hdr->versionStr[HPCTHREADDB_FMT_VersionLen] = '\0';
+  if (nr != HPCTHREADDB_FMT_VersionLen) {
+    return HPCFMT_ERR;
+  }
+  hdr->version = atof(hdr->versionStr);
+
+  nr = fread(&hdr->endian, 1, HPCTHREADDB_FMT_EndianLen, infs);
+  if (nr != HPCTHREADDB_FMT_EndianLen) {
+    return HPCFMT_ERR;
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numThreads), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNodes), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->threadIdxOff), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->dataOff), infs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcthreadDB_fmt_hdr_fwrite(hpcthreadDB_fmt_hdr_t* hdr, FILE* outfs)
+{
+  int nw;
+
+  nw = fwrite(HPCTHREADDB_FMT_Magic,   1, HPCTHREADDB_FMT_MagicLen, outfs);
+  if (nw != HPCTHREADDB_FMT_MagicLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCTHREADDB_FMT_Version, 1, HPCTHREADDB_FMT_VersionLen, outfs);
+  if (nw != HPCTHREADDB_FMT_VersionLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCTHREADDB_FMT_Endian,  1, HPCTHREADDB_FMT_EndianLen, outfs);
+  if (nw != HPCTHREADDB_FMT_EndianLen) return HPCFMT_ERR;
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numThreads, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numNodes, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->threadIdxOff, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->dataOff, outfs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcthreadDB_fmt_hdr_fprint(hpcthreadDB_fmt_hdr_t* hdr, FILE* outfs)
+{
+  fprintf(outfs, "%s\n", HPCTHREADDB_FMT_Magic);
+  fprintf(outfs, "[hdr:...]\n");
+
+  fprintf(outfs, "(num-threads: %u)\n", hdr->numThreads);
+  fprintf(outfs, "(num-nodes:   %u)\n", hdr->numNodes);
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// [hpcprof-threaddb] thread index
+//***************************************************************************
+
+int
+hpcthreadDB_fmt_idx_fread(hpcthreadDB_fmt_idx_t* x, FILE* infs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->off), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->nnz), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->numRows), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->numMetrics), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->groupId), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->nameLen), infs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcthreadDB_fmt_idx_fwrite(hpcthreadDB_fmt_idx_t* x, FILE* outfs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->off, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->nnz, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->numRows, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->numMetrics, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->groupId, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->nameLen, outfs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcthreadDB_fmt_idx_fprint(hpcthreadDB_fmt_idx_t* x, uint32_t threadIdx,
+			   FILE* outfs)
+{
+  fprintf(outfs, "(%u: off %"PRIu64", nnz %"PRIu64", rows %u, metrics %u, "
+	  "group %u)\n", threadIdx, x->off, x->nnz, x->numRows,
+	  x->numMetrics, x->groupId);
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// [hpcprof-threaddb] mapped reader
+//***************************************************************************
+
+static int
+threaddb_hdr_decode(hpcthreadDB_fmt_hdr_t* hdr, const char* p)
+{
+  if (memcmp(p, HPCTHREADDB_FMT_Magic, HPCTHREADDB_FMT_MagicLen) != 0) {
+    return HPCFMT_ERR;
+  }
+  p += HPCTHREADDB_FMT_MagicLen;
+
+  memcpy(hdr->versionStr, p, HPCTHREADDB_FMT_VersionLen);
+  hdr->versionStr[HPCTHREADDB_FMT_VersionLen] = '\0';
+  hdr->version = atof(hdr->versionStr);
+  p += HPCTHREADDB_FMT_VersionLen;
+
+  hdr->endian = *p;
+  p += HPCTHREADDB_FMT_EndianLen;
+
+  hdr->numThreads   = hpcio_be4_get(p);  p += 4;
+  hdr->numNodes     = hpcio_be4_get(p);  p += 4;
+  hdr->threadIdxOff = hpcio_be8_get(p);  p += 8;
+  hdr->dataOff      = hpcio_be8_get(p);
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcthreadDB_open(hpcthreadDB_t* db, const char* fnm)
+{
+  if (fmt_mapFile(fnm, HPCTHREADDB_FMT_HeaderLen, &db->base, &db->size)
+      != HPCFMT_OK) {
+    return HPCFMT_ERR;
+  }
+
+  if (threaddb_hdr_decode(&db->hdr, db->base) != HPCFMT_OK
+      || !fmt_inFile(db->hdr.threadIdxOff,
+		       (uint64_t)db->hdr.numThreads * HPCTHREADDB_FMT_IdxLen,
+		       db->size)) {
+    hpcthreadDB_close(db);
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+void
+hpcthreadDB_close(hpcthreadDB_t* db)
+{
+  if (db->base) {
+    munmap((void*)db->base, db->size);
+  }
+  db->base = NULL;
+  db->size = 0;
+}
+
+
+int
+hpcthreadDB_thread(const hpcthreadDB_t* db, uint32_t threadIdx,
+		   hpcthreadDB_fmt_idx_t* x)
+{
+  if (threadIdx >= db->hdr.numThreads) {
+    return HPCFMT_ERR;
+  }
+
+  const char* p = (db->base + db->hdr.threadIdxOff
+		   + (uint64_t)threadIdx * HPCTHREADDB_FMT_IdxLen);
+  x->off        = hpcio_be8_get(p +  0);
+  x->nnz        = hpcio_be8_get(p +  8);
+  x->numRows    = hpcio_be4_get(p + 16);
+  x->numMetrics = hpcio_be4_get(p + 20);
+  x->groupId    = hpcio_be4_get(p + 24);
+  x->nameLen    = hpcio_be4_get(p + 28);
+
+  // the block (name, rows, entries) lies within the file
+  uint64_t sz = db->size;
+  uint64_t rowsOff = x->off + x->nameLen;
+  uint64_t entriesOff =
+    rowsOff + ((uint64_t)x->numRows + 1) * HPCTHREADDB_FMT_RowLen;
+  if (x->nameLen == 0 || x->nnz > sz / HPCTHREADDB_FMT_EntryLen
+      || !fmt_inFile(x->off, x->nameLen, sz)
+      || !fmt_inFile(rowsOff, entriesOff - rowsOff, sz)
+      || !fmt_inFile(entriesOff, x->nnz * HPCTHREADDB_FMT_EntryLen, sz)
+      || db->base[rowsOff - 1] != '\0') {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+const char*
+hpcthreadDB_threadName(const hpcthreadDB_t* db,
+		       const hpcthreadDB_fmt_idx_t* x)
+{
+  return db->base + x->off;
+}
+
+
+void
+hpcthreadDB_row(const hpcthreadDB_t* db, const hpcthreadDB_fmt_idx_t* x,
+		uint32_t r, uint32_t* nodeId, uint64_t* entry)
+{
+  const char* p = (db->base + x->off + x->nameLen
+		   + (uint64_t)r * HPCTHREADDB_FMT_RowLen);
+  *nodeId = hpcio_be4_get(p);
+  *entry  = hpcio_be8_get(p + 4);
+}
+
+
+int
+hpcthreadDB_nodeMetrics(const hpcthreadDB_t* db,
+			const hpcthreadDB_fmt_idx_t* x, uint32_t nodeId,
+			uint64_t* beg, uint64_t* end)
+{
+  *beg = *end = 0;
+
+  // rows [0, numRows) are sorted by node id
+  uint32_t lo = 0, hi = x->numRows;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    uint32_t midId;
+    uint64_t midEntry;
+    hpcthreadDB_row(db, x, mid, &midId, &midEntry);
+    if (midId < nodeId) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  uint32_t rowId;
+  uint64_t nextEntry;
+  if (lo < x->numRows) {
+    hpcthreadDB_row(db, x, lo, &rowId, beg);
+    if (rowId == nodeId) {
+      hpcthreadDB_row(db, x, lo + 1, &rowId, &nextEntry);
+      if (*beg > nextEntry || nextEntry > x->nnz) {
+	*beg = 0;
+	return HPCFMT_ERR;
+      }
+      *end = nextEntry;
+      return HPCFMT_OK;
+    }
+  }
+
+  *beg = 0;
+  return HPCFMT_OK;
+}
+
+
+void
+hpcthreadDB_entry(const hpcthreadDB_t* db, const hpcthreadDB_fmt_idx_t* x,
+		  uint64_t k, uint32_t* mId, double* mVal)
+{
+  const char* p = (db->base + x->off + x->nameLen
+		   + ((uint64_t)x->numRows + 1) * HPCTHREADDB_FMT_RowLen
+		   + k * HPCTHREADDB_FMT_EntryLen);
+  *mId = hpcio_be4_get(p);
+  uint64_t bits = hpcio_be8_get(p + 4);
+  memcpy(mVal, &bits, sizeof(bits));
+}
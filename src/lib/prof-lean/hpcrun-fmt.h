@@ -101,6 +101,12 @@ static const char HPCRUN_LogFnmSfx[] = "log";
 // hpcprof metric db filename suffix
 static const char HPCPROF_MetricDBSfx[] = "metric-db";
 
+// hpcprof binary cct db filename
+static const char HPCPROF_CCTDBFnm[] = "experiment.cctdb";
+
+// hpcprof-mpi shared thread-level metric db filename
+static const char HPCPROF_ThreadDBFnm[] = "experiment.thread-db";
+
 static const char HPCPROF_TmpFnmSfx[] = "tmp";
 
 
@@ -555,6 +561,12 @@ extern int
 hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
 			  epoch_flags_t flags, FILE* fs);
 
+// Same as hpcrun_fmt_cct_node_fread(), but decodes the node in place
+// from 'inbuf'.  N.B.: assumes space for metrics has been allocated
+extern int
+hpcrun_fmt_cct_node_inbuf_read(hpcrun_fmt_cct_node_t* x,
+			       epoch_flags_t flags, hpcio_inbuf_t* inbuf);
+
 extern int
 hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
 			   epoch_flags_t flags, FILE* fs);
@@ -590,15 +602,18 @@ hpcrun_fmt_lip_fprint(lush_lip_t* x, FILE* fs, const char* pre);
 // Header sizes:
 // - version 1.00: 24 bytes
 // - version 1.01: 32 bytes: 24 + sizeof(hpctrace_hdr_flags_t)
+// - version 1.02: 32 bytes (same as 1.01; records are block-encoded)
 
-static const char HPCTRACE_FMT_Magic[]   = "HPCRUN-trace______"; // 18 bytes
-static const char HPCTRACE_FMT_Version[] = "01.01";              // 5 bytes
-static const char HPCTRACE_FMT_Endian[]  = "b";                  // 1 byte
+static const char HPCTRACE_FMT_Magic[]      = "HPCRUN-trace______"; // 18 bytes
+static const char HPCTRACE_FMT_Version[]    = "01.01";              // 5 bytes
+static const char HPCTRACE_FMT_VersionBlk[] = "01.02";              // 5 bytes
+static const char HPCTRACE_FMT_Endian[]     = "b";                  // 1 byte
 
 
 typedef struct hpctrace_hdr_flags_bitfield {
   bool isDataCentric : 1;
-  uint64_t unused    : 63;
+  bool isBlocked     : 1; // version 1.02: block-encoded records
+  uint64_t unused    : 62;
 } hpctrace_hdr_flags_bitfield;
 
 
@@ -684,6 +699,190 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 			  FILE* fs);
 
 
+//***************************************************************************
+// [hpctrace] block-encoded trace records (version 1.02)
+//***************************************************************************
+
+// A version 1.02 trace (hdr flag 'isBlocked') stores its records in
+// independently decodable blocks:
+//
+//   block:  [time0: uint64][numRecs: uint32][len: uint32][payload: len]
+//   record: varint((zigzag(time - prevTime) << 1) | (cpId == prevCpId))
+//           [varint(cpId)]      if cpId != prevCpId
+//           [varint(metricId)]  if isDataCentric
+//
+// where 'time0' is the time of the first record and, at the start of
+// each block, prevTime = time0 and prevCpId = HPCRUN_FMT_CCTNodeId_NULL.
+// Consecutive samples usually differ by a small time delta and often
+// share a call path, so a record typically takes 2-4 bytes instead of
+// 12.  The block list is terminated by an empty block (numRecs == 0),
+// followed by a block index (one hpctrace_fmt_blkidx_t per block, in
+// time order) and a fixed-size footer locating the index.
+
+#define HPCTRACE_FMT_BlkHdrLen      (16)
+#define HPCTRACE_FMT_BlkPayloadSz   (4096)
+#define HPCTRACE_FMT_BlkDatumMaxLen (10 + 5 + 5) // max varint lengths
+
+typedef struct hpctrace_fmt_blk_t {
+  uint64_t time0;
+  uint32_t numRecs;
+  uint32_t len;
+
+  // encoder/decoder state
+  uint32_t pos;
+  uint32_t recIdx;
+  uint64_t prevTime;
+  uint32_t prevCpId;
+  bool     isEnd;
+
+  unsigned char payload[HPCTRACE_FMT_BlkPayloadSz];
+} hpctrace_fmt_blk_t;
+
+
+void
+hpctrace_fmt_blk_init(hpctrace_fmt_blk_t* blk);
+
+static inline bool
+hpctrace_fmt_blk_isFull(hpctrace_fmt_blk_t* blk)
+{
+  return (blk->pos + HPCTRACE_FMT_BlkDatumMaxLen > HPCTRACE_FMT_BlkPayloadSz);
+}
+
+// Encode 'x' at the end of 'blk'. Precondition: !hpctrace_fmt_blk_isFull()
+void
+hpctrace_fmt_blk_append(hpctrace_fmt_blk_t* blk, hpctrace_fmt_datum_t* x,
+			hpctrace_hdr_flags_t flags);
+
+// Decode the next record of 'blk'; returns HPCFMT_EOF when exhausted.
+int
+hpctrace_fmt_blk_next(hpctrace_fmt_blk_t* blk, hpctrace_fmt_datum_t* x,
+		      hpctrace_hdr_flags_t flags);
+
+// Read the next block; returns HPCFMT_EOF at the terminating empty block.
+int
+hpctrace_fmt_blk_fread(hpctrace_fmt_blk_t* blk, FILE* fs);
+
+// Write 'blk' (an empty block terminates the block list)
+int
+hpctrace_fmt_blk_outbuf(hpctrace_fmt_blk_t* blk, hpcio_outbuf_t* outbuf);
+
+// N.B.: not async safe
+int
+hpctrace_fmt_blk_fwrite(hpctrace_fmt_blk_t* blk, FILE* fs);
+
+
+// Read the next trace record of either a flat or a block-encoded
+// trace.  'blk' holds the decoder state between calls and must be
+// initialized with hpctrace_fmt_blk_init() before the first call.
+int
+hpctrace_fmt_datum_blk_fread(hpctrace_fmt_datum_t* x,
+			     hpctrace_hdr_flags_t flags,
+			     hpctrace_fmt_blk_t* blk, FILE* fs);
+
+// Read the next block from 'inbuf'; as hpctrace_fmt_blk_fread().
+int
+hpctrace_fmt_blk_inbuf_read(hpctrace_fmt_blk_t* blk, hpcio_inbuf_t* inbuf);
+
+// Read up to '*n' trace records of either a flat or a block-encoded
+// trace from 'inbuf' into 'x', and set '*n' to the number read.  Flat
+// records are decoded straight from the inbuf.  Returns HPCFMT_OK if
+// any records were read, HPCFMT_EOF at the end of the records, else
+// HPCFMT_ERR (the records read before the error are still in 'x').
+// 'blk' is as for hpctrace_fmt_datum_blk_fread().
+int
+hpctrace_fmt_datums_inbuf_read(hpctrace_fmt_datum_t* x, size_t* n,
+			       hpctrace_hdr_flags_t flags,
+			       hpctrace_fmt_blk_t* blk, hpcio_inbuf_t* inbuf);
+
+
+//***************************************************************************
+// [hpctrace] block index and footer (version 1.02)
+//***************************************************************************
+
+typedef struct hpctrace_fmt_blkidx_t {
+  uint64_t time;    // time of the block's first record
+  uint64_t off;     // file offset of the block
+  uint32_t numRecs;
+} hpctrace_fmt_blkidx_t;
+
+#define HPCTRACE_FMT_BlkIdxLen (8 + 8 + 4)
+
+typedef struct hpctrace_fmt_footer_t {
+  uint64_t idxOff;    // file offset of the first hpctrace_fmt_blkidx_t
+  uint64_t numBlocks;
+} hpctrace_fmt_footer_t;
+
+#define HPCTRACE_FMT_FooterLen (8 + 8)
+
+
+int
+hpctrace_fmt_blkidx_fread(hpctrace_fmt_blkidx_t* x, FILE* fs);
+
+int
+hpctrace_fmt_blkidx_outbuf(hpctrace_fmt_blkidx_t* x, hpcio_outbuf_t* outbuf);
+
+// N.B.: not async safe
+int
+hpctrace_fmt_blkidx_fwrite(hpctrace_fmt_blkidx_t* x, FILE* fs);
+
+int
+hpctrace_fmt_blkidx_fprint(hpctrace_fmt_blkidx_t* x, FILE* fs);
+
+
+// N.B.: repositions 'fs' to the start of the footer
+int
+hpctrace_fmt_footer_fread(hpctrace_fmt_footer_t* x, FILE* fs);
+
+int
+hpctrace_fmt_footer_outbuf(hpctrace_fmt_footer_t* x, hpcio_outbuf_t* outbuf);
+
+// N.B.: not async safe
+int
+hpctrace_fmt_footer_fwrite(hpctrace_fmt_footer_t* x, FILE* fs);
+
+
+//***************************************************************************
+// [hpctrace] call path id remap table
+//***************************************************************************
+
+// When hpcprof renumbers the call path ids of a trace, it may write a
+// remap table beside the trace instead of rewriting it.  For
+// 'name.hpctrace', the table is 'name.cpmap':
+//
+//   magic, version, endian (24 bytes)
+//   uint32_t numIds
+//   uint32_t newId[numIds]   (indexed by old cpId)
+//
+// cpIds that are not below numIds are not renumbered.
+
+static const char HPCTRACE_RemapFnmSfx[] = "cpmap";
+
+static const char HPCTRACE_RMAP_Magic[]   = "HPCPROF-cpmap_____"; // 18 bytes
+static const char HPCTRACE_RMAP_Version[] = "01.00";              // 5 bytes
+static const char HPCTRACE_RMAP_Endian[]  = "b";                  // 1 byte
+
+#define HPCTRACE_RMAP_MagicLen   (sizeof(HPCTRACE_RMAP_Magic) - 1)
+#define HPCTRACE_RMAP_VersionLen (sizeof(HPCTRACE_RMAP_Version) - 1)
+#define HPCTRACE_RMAP_EndianLen  (sizeof(HPCTRACE_RMAP_Endian) - 1)
+
+
+// Reads the table into a buffer from 'alloc'; on error, the buffer
+// is released with 'dealloc'
+int
+hpctrace_fmt_remap_fread(uint32_t** newId, uint32_t* numIds, FILE* fs,
+			 hpcfmt_alloc_fn alloc, hpcfmt_free_fn dealloc);
+
+// N.B.: not async safe
+int
+hpctrace_fmt_remap_fwrite(const uint32_t* newId, uint32_t numIds, FILE* fs);
+
+static inline uint32_t
+hpctrace_fmt_remap_cpId(const uint32_t* newId, uint32_t numIds, uint32_t cpId)
+{
+  return (cpId < numIds) ? newId[cpId] : cpId;
+}
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -731,6 +930,327 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
+
+//***************************************************************************
+// hpcprof-cctdb (located here for now)
+//***************************************************************************
+
+// A binary, mmap-able form of the canonical CCT that hpcprof writes
+// to experiment.xml.  As with the other formats, all values are
+// big-endian.  Every section begins at an 8-byte aligned offset that
+// is recorded in the header, so a reader can map the file and index
+// it directly:
+//
+//   hdr
+//   node table:  numNodes x hpccctDB_fmt_node_t, indexed by the node's
+//                dense preorder id (cf. Prof::CCT::Tree::
+//                makeDensePreorderIds()); entry 0 is unused and the
+//                root is entry 1.  Node n's subtree is the id range
+//                [n, n.subtreeEnd); its children are n+1,
+//                (n+1).subtreeEnd, ... while less than n.subtreeEnd.
+//   string index: (numStrings + 1) x uint64_t offsets into the string
+//                data; string i is [idx[i], idx[i+1]) (NUL included).
+//                String 0 is the empty string.
+//   string data
+//   metric rows: (numNodes + 1) x uint64_t; the non-zero metric values
+//                of node n are entries [row[n], row[n+1]) of the metric
+//                columns/values (compressed sparse rows)
+//   metric vals: numNonZeros x double
+//   metric cols: numNonZeros x uint32_t metric ids (as in
+//                experiment.xml)
+
+//***************************************************************************
+// [hpcprof-cctdb] hdr
+//***************************************************************************
+
+static const char HPCCCTDB_FMT_Magic[]   = "HPCPROF-cctdb_____"; // 18 bytes
+static const char HPCCCTDB_FMT_Version[] = "01.00";              // 5 bytes
+static const char HPCCCTDB_FMT_Endian[]  = "b";                  // 1 byte
+
+#define HPCCCTDB_FMT_MagicLenX   (sizeof(HPCCCTDB_FMT_Magic) - 1)
+#define HPCCCTDB_FMT_VersionLenX (sizeof(HPCCCTDB_FMT_Version) - 1)
+#define HPCCCTDB_FMT_EndianLenX  (sizeof(HPCCCTDB_FMT_Endian) - 1)
+
+static const int HPCCCTDB_FMT_MagicLen   = HPCCCTDB_FMT_MagicLenX;
+static const int HPCCCTDB_FMT_VersionLen = HPCCCTDB_FMT_VersionLenX;
+static const int HPCCCTDB_FMT_EndianLen  = HPCCCTDB_FMT_EndianLenX;
+
+// N.B.: the header is padded to a multiple of 8 bytes
+static const int HPCCCTDB_FMT_HeaderLen =
+  (HPCCCTDB_FMT_MagicLenX + HPCCCTDB_FMT_VersionLenX
+   + HPCCCTDB_FMT_EndianLenX
+   + (4 * 4)   // numNodes, numStrings, metricBegId, metricEndId
+   + (1 * 8)   // numNonZeros
+   + (6 * 8)); // section offsets
+
+
+typedef struct hpccctDB_fmt_hdr_t {
+
+  char versionStr[sizeof(HPCCCTDB_FMT_Version)];
+  double version;
+  char endian;
+
+  uint32_t numNodes;    // including the unused entry 0
+  uint32_t numStrings;
+  uint32_t metricBegId; // metric ids in [metricBegId, metricEndId)
+  uint32_t metricEndId;
+  uint64_t numNonZeros;
+
+  uint64_t nodeTblOff;
+  uint64_t strIdxOff;
+  uint64_t strDataOff;
+  uint64_t metricRowOff;
+  uint64_t metricValOff;
+  uint64_t metricColOff;
+
+} hpccctDB_fmt_hdr_t;
+
+
+int
+hpccctDB_fmt_hdr_fread(hpccctDB_fmt_hdr_t* hdr, FILE* infs);
+
+int
+hpccctDB_fmt_hdr_fwrite(hpccctDB_fmt_hdr_t* hdr, FILE* outfs);
+
+int
+hpccctDB_fmt_hdr_fprint(hpccctDB_fmt_hdr_t* hdr, FILE* outfs);
+
+
+//***************************************************************************
+// [hpcprof-cctdb] node
+//***************************************************************************
+
+typedef struct hpccctDB_fmt_node_t {
+
+  uint32_t parent;     // 0 for the root
+  uint32_t subtreeEnd; // one past the last id in the subtree
+  uint32_t type;       // Prof::CCT::ANode::ANodeTy
+  uint32_t flags;      // hpccctDB_fmt_node_flags
+  uint32_t structId;   // static structure id; 0 if none
+  uint32_t line;
+  uint32_t cpId;       // call path (trace) id; 0 if none
+  uint32_t lmStr;      // string ids; 0 if none
+  uint32_t fileStr;
+  uint32_t procStr;
+
+} hpccctDB_fmt_node_t;
+
+static const int HPCCCTDB_FMT_NodeLen = (10 * 4);
+
+enum hpccctDB_fmt_node_flags {
+  HPCCCTDB_FMT_NodeFlg_Alien = (1 << 0)
+};
+
+
+int
+hpccctDB_fmt_node_fwrite(hpccctDB_fmt_node_t* x, FILE* outfs);
+
+int
+hpccctDB_fmt_node_fprint(hpccctDB_fmt_node_t* x, uint32_t id, FILE* outfs);
+
+
+//***************************************************************************
+// [hpcprof-cctdb] mapped reader
+//***************************************************************************
+
+// hpccctDB_t: a read-only mapping of an hpcprof-cctdb file.
+// hpccctDB_open() validates the header and that every section lies
+// within the file; the accessors decode values in place.
+typedef struct hpccctDB_t {
+
+  const char* base; // the mapping
+  size_t size;
+  hpccctDB_fmt_hdr_t hdr;
+
+} hpccctDB_t;
+
+
+// hpccctDB_open: maps 'fnm'; returns HPCFMT_OK or HPCFMT_ERR (if the
+// file cannot be mapped or is not a well-formed hpcprof-cctdb file)
+int
+hpccctDB_open(hpccctDB_t* db, const char* fnm);
+
+void
+hpccctDB_close(hpccctDB_t* db);
+
+// hpccctDB_node: decodes node 'id' (1 <= id < hdr.numNodes)
+int
+hpccctDB_node(const hpccctDB_t* db, uint32_t id, hpccctDB_fmt_node_t* x);
+
+// hpccctDB_str: returns string 'strId' or NULL if it is malformed
+const char*
+hpccctDB_str(const hpccctDB_t* db, uint32_t strId);
+
+// hpccctDB_metricRow: sets [*beg, *end) to node 'id''s range of
+// non-zero metric values (cf. hpccctDB_metric)
+int
+hpccctDB_metricRow(const hpccctDB_t* db, uint32_t id,
+		   uint64_t* beg, uint64_t* end);
+
+// hpccctDB_metric: decodes non-zero value 'k' (k < hdr.numNonZeros)
+void
+hpccctDB_metric(const hpccctDB_t* db, uint64_t k,
+		uint32_t* mId, double* mVal);
+
+
+//***************************************************************************
+// hpcprof-threaddb (located here for now)
+//***************************************************************************
+
+// The thread-level metrics of all profiles in one file (cf. the
+// per-profile hpcprof-metricdb).  All values are big-endian:
+//
+//   hdr
+//   thread index: numThreads x hpcthreadDB_fmt_idx_t, in the order of
+//                 hpcprof-mpi's canonical list of profile files
+//   thread data:  one block per thread, at idx.off:
+//     name:    idx.nameLen bytes (NUL included), the profile's name
+//     rows:    (idx.numRows + 1) x { uint32_t nodeId; uint64_t entry },
+//              one row per CCT node with a non-zero metric value in
+//              increasing node id order, plus a terminating row with
+//              nodeId 0 and entry idx.nnz.  The values of row r are
+//              entries [rows[r].entry, rows[r+1].entry).
+//     entries: idx.nnz x { uint32_t metricId; double value }, where
+//              metricId is in [0, idx.numMetrics), as the columns of
+//              an hpcprof-metricdb
+//
+// Node ids are as in experiment.xml and range over [1, numNodes].
+
+//***************************************************************************
+// [hpcprof-threaddb] hdr
+//***************************************************************************
+
+static const char HPCTHREADDB_FMT_Magic[]   = "HPCPROF-threaddb__"; // 18 bytes
+static const char HPCTHREADDB_FMT_Version[] = "01.00";              // 5 bytes
+static const char HPCTHREADDB_FMT_Endian[]  = "b";                  // 1 byte
+
+#define HPCTHREADDB_FMT_MagicLenX   (sizeof(HPCTHREADDB_FMT_Magic) - 1)
+#define HPCTHREADDB_FMT_VersionLenX (sizeof(HPCTHREADDB_FMT_Version) - 1)
+#define HPCTHREADDB_FMT_EndianLenX  (sizeof(HPCTHREADDB_FMT_Endian) - 1)
+
+static const int HPCTHREADDB_FMT_MagicLen   = HPCTHREADDB_FMT_MagicLenX;
+static const int HPCTHREADDB_FMT_VersionLen = HPCTHREADDB_FMT_VersionLenX;
+static const int HPCTHREADDB_FMT_EndianLen  = HPCTHREADDB_FMT_EndianLenX;
+
+static const int HPCTHREADDB_FMT_HeaderLen =
+  (HPCTHREADDB_FMT_MagicLenX + HPCTHREADDB_FMT_VersionLenX
+   + HPCTHREADDB_FMT_EndianLenX
+   + (2 * 4)   // numThreads, numNodes
+   + (2 * 8)); // threadIdxOff, dataOff
+
+
+typedef struct hpcthreadDB_fmt_hdr_t {
+
+  char versionStr[sizeof(HPCTHREADDB_FMT_Version)];
+  double version;
+  char endian;
+
+  uint32_t numThreads;
+  uint32_t numNodes;
+
+  uint64_t threadIdxOff;
+  uint64_t dataOff;
+
+} hpcthreadDB_fmt_hdr_t;
+
+
+int
+hpcthreadDB_fmt_hdr_fread(hpcthreadDB_fmt_hdr_t* hdr, FILE* infs);
+
+int
+hpcthreadDB_fmt_hdr_fwrite(hpcthreadDB_fmt_hdr_t* hdr, FILE* outfs);
+
+int
+hpcthreadDB_fmt_hdr_fprint(hpcthreadDB_fmt_hdr_t* hdr, FILE* outfs);
+
+
+//***************************************************************************
+// [hpcprof-threaddb] thread index
+//***************************************************************************
+
+typedef struct hpcthreadDB_fmt_idx_t {
+
+  uint64_t off;        // file offset of the thread's block
+  uint64_t nnz;        // number of entries
+  uint32_t numRows;    // number of rows (excluding the terminator)
+  uint32_t numMetrics;
+  uint32_t groupId;
+  uint32_t nameLen;
+
+} hpcthreadDB_fmt_idx_t;
+
+static const int HPCTHREADDB_FMT_IdxLen = (2 * 8) + (4 * 4);
+
+static const int HPCTHREADDB_FMT_RowLen = 4 + 8;
+static const int HPCTHREADDB_FMT_EntryLen = 4 + 8;
+
+
+int
+hpcthreadDB_fmt_idx_fread(hpcthreadDB_fmt_idx_t* x, FILE* infs);
+
+int
+hpcthreadDB_fmt_idx_fwrite(hpcthreadDB_fmt_idx_t* x, FILE* outfs);
+
+int
+hpcthreadDB_fmt_idx_fprint(hpcthreadDB_fmt_idx_t* x, uint32_t threadIdx,
+			   FILE* outfs);
+
+
+//***************************************************************************
+// [hpcprof-threaddb] mapped reader
+//***************************************************************************
+
+// hpcthreadDB_t: a read-only mapping of an hpcprof-threaddb file (cf.
+// hpccctDB_t).  A thread's block is located through the thread index;
+// a node's values within it through a binary search of the block's
+// rows, after which they are contiguous.
+typedef struct hpcthreadDB_t {
+
+  const char* base; // the mapping
+  size_t size;
+  hpcthreadDB_fmt_hdr_t hdr;
+
+} hpcthreadDB_t;
+
+
+// hpcthreadDB_open: maps 'fnm'; returns HPCFMT_OK or HPCFMT_ERR (if
+// the file cannot be mapped or its header or index is malformed)
+int
+hpcthreadDB_open(hpcthreadDB_t* db, const char* fnm);
+
+void
+hpcthreadDB_close(hpcthreadDB_t* db);
+
+// hpcthreadDB_thread: decodes the index entry of thread 'threadIdx'
+// and validates its block
+int
+hpcthreadDB_thread(const hpcthreadDB_t* db, uint32_t threadIdx,
+		   hpcthreadDB_fmt_idx_t* x);
+
+// hpcthreadDB_threadName: the name of a thread validated by
+// hpcthreadDB_thread()
+const char*
+hpcthreadDB_threadName(const hpcthreadDB_t* db,
+		       const hpcthreadDB_fmt_idx_t* x);
+
+// hpcthreadDB_nodeMetrics: sets [*beg, *end) to the entries of node
+// 'nodeId' in thread 'x' (an empty range if it has no non-zero values)
+int
+hpcthreadDB_nodeMetrics(const hpcthreadDB_t* db,
+			const hpcthreadDB_fmt_idx_t* x, uint32_t nodeId,
+			uint64_t* beg, uint64_t* end);
+
+// hpcthreadDB_row: decodes row 'r' (r <= x->numRows) of thread 'x'
+void
+hpcthreadDB_row(const hpcthreadDB_t* db, const hpcthreadDB_fmt_idx_t* x,
+		uint32_t r, uint32_t* nodeId, uint64_t* entry);
+
+// hpcthreadDB_entry: decodes entry 'k' (k < x->nnz) of thread 'x'
+void
+hpcthreadDB_entry(const hpcthreadDB_t* db, const hpcthreadDB_fmt_idx_t* x,
+		  uint64_t k, uint32_t* mId, double* mVal);
+
+
 // --------------------------------------------------------------------------
 // additional sampling info
 // --------------------------------------------------------------------------
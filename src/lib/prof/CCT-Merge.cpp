@@ -91,7 +91,8 @@ namespace CCT {
 //***************************************************************************
 
 MergeContext::MergeContext(Tree* cct, bool doTrackCPIds)
-  : m_cct(cct), m_mrgFlag(0), m_isTrackingCPIds(doTrackCPIds)
+  : m_cct(cct), m_mrgFlag(0), m_mrgNodes(NULL),
+    m_isTrackingCPIds(doTrackCPIds)
 {
   if (isTrackingCPIds()) {
     fillCPIdSet(cct);
@@ -113,6 +114,18 @@ MergeContext::fillCPIdSet(Tree* cct)
 }
 
 
+//***************************************************************************
+// MergedNodeSet
+//***************************************************************************
+
+void
+MergedNodeSet::insert(ANode* x)
+{
+  // stop at the first ancestor already present: its own ancestors are
+  for ( ; x && m_nodes.insert(x).second; x = x->parent()) { }
+}
+
+
 //***************************************************************************
 // MergeEffect
 //***************************************************************************
@@ -68,6 +68,7 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <unordered_set>
 
 //*************************** User Include Files ****************************
 
@@ -126,6 +127,58 @@ struct MergeEffect {
 typedef std::list<MergeEffect> MergeEffectList;
 
 
+//***************************************************************************
+// MergedNodeSet
+//***************************************************************************
+
+class ANode;
+
+// MergedNodeSet: the nodes of a CCT whose metrics were changed by one
+// or more merges, together with all their ancestors.  Since metric
+// values only flow from a node to its ancestors, a pass interested
+// only in the merged values may visit only these nodes (cf. the
+// sparse forms of ANode::aggregateMetricsIncl()).  Iteration order is
+// unspecified.
+class MergedNodeSet {
+public:
+  typedef std::unordered_set<ANode*>::const_iterator const_iterator;
+
+  MergedNodeSet()
+  { }
+
+  // insert: inserts 'x' and its ancestors
+  void
+  insert(ANode* x);
+
+  bool
+  contains(const ANode* x) const
+  { return (m_nodes.find(const_cast<ANode*>(x)) != m_nodes.end()); }
+
+  bool
+  empty() const
+  { return m_nodes.empty(); }
+
+  uint
+  size() const
+  { return m_nodes.size(); }
+
+  void
+  clear()
+  { m_nodes.clear(); }
+
+  const_iterator
+  begin() const
+  { return m_nodes.begin(); }
+
+  const_iterator
+  end() const
+  { return m_nodes.end(); }
+
+private:
+  std::unordered_set<ANode*> m_nodes;
+};
+
+
 } // namespace CCT
 
 } // namespace Prof
@@ -154,6 +207,15 @@ enum {
   // Instruct a merge function to only perform tree merges; tree
   // inserts are considered errors and throw an exception.
   MrgFlg_AssertCCTMergeOnly  = (1 << 2),
+
+  // With MrgFlg_NormalizeTraceFileY, write a call path id remap table
+  // beside y's trace file instead of rewriting the trace.
+  MrgFlg_RemapTraceFileY     = (1 << 4),
+
+  // With MrgFlg_NormalizeTraceFileY, only compute the new call path
+  // ids of y's trace; the caller rewrites it later with
+  // CallPath::Profile::fixDeferredTrace().
+  MrgFlg_DeferTraceFixY      = (1 << 5),
   
   // -------------------------------------------------------
   // *Private* CCT Merge flags
@@ -185,6 +247,26 @@ public:
   { return (m_mrgFlag & MrgFlg_PropagateEffects); }
 
 
+  // -------------------------------------------------------
+  // mergedNodes: if non-NULL, collects the nodes changed by the merge
+  // -------------------------------------------------------
+  void
+  mergedNodes(MergedNodeSet* x)
+  { m_mrgNodes = x; }
+
+  MergedNodeSet*
+  mergedNodes() const
+  { return m_mrgNodes; }
+
+  void
+  noteMergedNode(ANode* x)
+  {
+    if (m_mrgNodes) {
+      m_mrgNodes->insert(x);
+    }
+  }
+
+
   // -------------------------------------------------------
   //
   // -------------------------------------------------------
@@ -262,6 +344,7 @@ private:
   const Tree* m_cct;
 
   uint m_mrgFlag;
+  MergedNodeSet* m_mrgNodes;
 
   bool m_isTrackingCPIds;
   CPIdSet m_cpIdSet;
@@ -71,9 +71,15 @@ using std::string;
 #include <vector>
 using std::vector;
 
+#include <unordered_map>
+
 #include <set>
 using std::set;
 
+#include <mutex>
+
+#include <algorithm>
+
 #include <typeinfo>
 
 //*************************** User Include Files ****************************
@@ -161,7 +167,8 @@ Tree::~Tree()
 
 
 MergeEffectList*
-Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag)
+Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag,
+	    MergedNodeSet* mrgNodes)
 {
   Tree* x = this;
   ANode* x_root = root();
@@ -203,10 +210,13 @@ Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag)
     m_mergeCtxt = new MergeContext(x, doTrackCPIds);
   }
   m_mergeCtxt->flags(mrgFlag);
+  m_mergeCtxt->mergedNodes(mrgNodes);
   
   MergeEffectList* mrgEffects =
     x_root->mergeDeep(y_root, x_newMetricBegIdx, *m_mergeCtxt, oFlag);
 
+  m_mergeCtxt->mergedNodes(NULL);
+
   DIAG_If(0 /*public diag level*/) {
     verifyUniqueCPIds();
   }
@@ -215,6 +225,37 @@ Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag)
 }
 
 
+ANode*
+Tree::mergeNode(ANode* x_parent, ADynNode* y, uint x_newMetricBegIdx,
+		bool isInsertOnly, bool& isInserted)
+{
+  if (!m_mergeCtxt) {
+    bool doTrackCPIds = !metadata()->traceFileNameSet().empty();
+    m_mergeCtxt = new MergeContext(this, doTrackCPIds);
+  }
+  m_mergeCtxt->flags(0);
+
+  // cf. ANode::mergeDeep()
+  ADynNode* x_dyn = (isInsertOnly) ? NULL : x_parent->findDynChild(*y);
+
+  if (!x_dyn) {
+    MergeEffectList* effctLst =
+      y->mergeDeep_fixInsert(x_newMetricBegIdx, *m_mergeCtxt,
+			     x_parent->isSparseMetrics());
+    delete effctLst;
+    y->link(x_parent);
+    isInserted = true;
+    return y;
+  }
+  else {
+    x_dyn->mergeMe(*y, m_mergeCtxt, x_newMetricBegIdx);
+    delete y;
+    isInserted = false;
+    return x_dyn;
+  }
+}
+
+
 void
 Tree::pruneCCTByNodeId(const uint8_t* prunedNodes)
 {
@@ -336,14 +377,316 @@ ANode::IntToANodeType(long i)
 
 uint ANode::s_nextUniqueId = 2;
 
+static std::mutex s_nextUniqueIdLock;
+
+
+uint
+ANode::makeUniqueId()
+{
+  std::lock_guard<std::mutex> guard(s_nextUniqueIdLock);
+  uint id = s_nextUniqueId;
+  s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
+  return id;
+}
+
+
+//***************************************************************************
+// ADynNodeIndex
+//***************************************************************************
+
+// ADynNodeIndex: Indexes the direct ADynNode descendents of a node
+// (cf. ANode::findDynChild) by the hashable parts of the
+// ADynNode::isMergable() identity:
+//   1. the standard merge condition: (lm id, lm ip, logical ip)
+//   2. the structured-leaf condition: (lm id, enclosing scope, line)
+// A bucket only holds candidates; each must still satisfy
+// ADynNode::isMergable().  Because relinking does not keep buckets in
+// child order, find() only answers when exactly one candidate is
+// mergable; otherwise the caller must resolve child order itself.
+class ADynNodeIndex
+{
+public:
+  ADynNodeIndex()
+  { }
+
+  ~ADynNodeIndex()
+  { }
+
+  void
+  insert(ADynNode* x)
+  {
+    m_ipMap[IPKey(*x)].push_back(x);
+    if (x->structure()) {
+      m_strctMap[StrctKey(*x)].push_back(x);
+    }
+  }
+
+  void
+  erase(ADynNode* x)
+  {
+    eraseFrom(m_ipMap, IPKey(*x), x);
+    if (x->structure()) {
+      eraseFrom(m_strctMap, StrctKey(*x), x);
+    }
+  }
+
+  // find: returns the unique mergable candidate for 'y' (or NULL if
+  //   there is none).  If several candidates are mergable, returns
+  //   NULL and sets 'isUnique' to false.
+  ADynNode*
+  find(const ADynNode& y, bool& isUnique) const
+  {
+    ADynNode* x = NULL;
+    isUnique = findIn(m_ipMap, IPKey(y), y, x);
+    if (isUnique && y.isLeaf() && y.structure()) {
+      isUnique = findIn(m_strctMap, StrctKey(y), y, x);
+    }
+    return (isUnique) ? x : NULL;
+  }
+
+private:
+  typedef std::vector<ADynNode*> NodeVec;
+
+  struct IPKey
+  {
+    IPKey(const ADynNode& x)
+      : lmId(x.lmId_real()), lmIP(x.lmIP_real()), hasLip(x.lip() != NULL)
+    {
+      lip[0] = (hasLip) ? x.lip()->data8[0] : 0;
+      lip[1] = (hasLip) ? x.lip()->data8[1] : 0;
+    }
+
+    bool
+    operator==(const IPKey& y) const
+    {
+      return (lmId == y.lmId && lmIP == y.lmIP && hasLip == y.hasLip
+	      && lip[0] == y.lip[0] && lip[1] == y.lip[1]);
+    }
+
+    LoadMap::LMId_t lmId;
+    VMA lmIP;
+    bool hasLip;
+    uint64_t lip[LUSH_LIP_DATA8_SZ];
+  };
+
+  struct IPKeyHash
+  {
+    size_t
+    operator()(const IPKey& x) const
+    {
+      size_t h = std::hash<VMA>()(x.lmIP);
+      h = hashCombine(h, x.lmId);
+      h = hashCombine(h, x.lip[0]);
+      h = hashCombine(h, x.lip[1]);
+      return h;
+    }
+  };
+
+  struct StrctKey
+  {
+    StrctKey(const ADynNode& x)
+      : lmId(x.lmId_real()),
+	scope(ADynNode::ancestorIfNotProc(x.structure())),
+	line(x.structure()->begLine())
+    { }
+
+    bool
+    operator==(const StrctKey& y) const
+    { return (lmId == y.lmId && scope == y.scope && line == y.line); }
+
+    LoadMap::LMId_t lmId;
+    const Struct::ACodeNode* scope;
+    SrcFile::ln line;
+  };
+
+  struct StrctKeyHash
+  {
+    size_t
+    operator()(const StrctKey& x) const
+    {
+      size_t h = std::hash<const void*>()(x.scope);
+      h = hashCombine(h, x.lmId);
+      h = hashCombine(h, x.line);
+      return h;
+    }
+  };
+
+  typedef std::unordered_map<IPKey, NodeVec, IPKeyHash> IPMap;
+  typedef std::unordered_map<StrctKey, NodeVec, StrctKeyHash> StrctMap;
+
+  static size_t
+  hashCombine(size_t h, uint64_t v)
+  { return h ^ (std::hash<uint64_t>()(v) + 0x9e3779b9 + (h << 6) + (h >> 2)); }
+
+  template<typename Map>
+  static void
+  eraseFrom(Map& map, const typename Map::key_type& key, ADynNode* x)
+  {
+    typename Map::iterator it = map.find(key);
+    if (it != map.end()) {
+      NodeVec& vec = it->second;
+      for (NodeVec::iterator v_it = vec.begin(); v_it != vec.end(); ++v_it) {
+	if (*v_it == x) {
+	  vec.erase(v_it);
+	  break;
+	}
+      }
+      if (vec.empty()) {
+	map.erase(it);
+      }
+    }
+  }
+
+  // findIn: accumulates into 'x' the mergable candidates for 'y' in
+  //   'key's bucket; returns false once a second distinct candidate
+  //   is found.
+  template<typename Map>
+  static bool
+  findIn(const Map& map, const typename Map::key_type& key, const ADynNode& y,
+	 ADynNode*& x)
+  {
+    typename Map::const_iterator it = map.find(key);
+    if (it != map.end()) {
+      const NodeVec& vec = it->second;
+      for (NodeVec::const_iterator v_it = vec.begin(); v_it != vec.end();
+	   ++v_it) {
+	if (*v_it != x && ADynNode::isMergable(**v_it, y)) {
+	  if (x) {
+	    return false;
+	  }
+	  x = *v_it;
+	}
+      }
+    }
+    return true;
+  }
+
+private:
+  IPMap m_ipMap;
+  StrctMap m_strctMap;
+};
+
 
 //***************************************************************************
 // ANode, etc: constructors/destructors
 //***************************************************************************
 
+ANode::~ANode()
+{
+  delete m_dynChildIdx;
+}
+
+
 string AProcNode::BOGUS;
 
 
+//***************************************************************************
+// ANode, etc: Tree modification
+//***************************************************************************
+
+void
+ANode::link(ANode* parent)
+{
+  NonUniformDegreeTreeNode::link(parent);
+  linkIntoDynChildIndex();
+}
+
+
+void
+ANode::linkBefore(ANode* sibling)
+{
+  NonUniformDegreeTreeNode::linkBefore(sibling);
+  linkIntoDynChildIndex();
+}
+
+
+void
+ANode::linkAfter(ANode* sibling)
+{
+  NonUniformDegreeTreeNode::linkAfter(sibling);
+  linkIntoDynChildIndex();
+}
+
+
+void
+ANode::unlink()
+{
+  unlinkFromDynChildIndex();
+  NonUniformDegreeTreeNode::unlink();
+}
+
+
+void
+ANode::invalidateDynChildIndex(ANode* x)
+{
+  for ( ; x; x = x->parent()) {
+    delete x->m_dynChildIdx;
+    x->m_dynChildIdx = NULL;
+    if (dynamic_cast<ADynNode*>(x)) {
+      break; // ADynNode ancestors of 'x' do not index beyond 'x'
+    }
+  }
+}
+
+
+void
+ANode::buildDynChildIndex(ADynNodeIndex& idx) const
+{
+  // N.B.: visit in the same order as the linear search
+  for (ANodeChildIterator it(this); it.Current(); ++it) {
+    ANode* x = it.current();
+    ADynNode* x_dyn = dynamic_cast<ADynNode*>(x);
+    if (x_dyn) {
+      idx.insert(x_dyn);
+    }
+    else {
+      x->buildDynChildIndex(idx);
+    }
+  }
+}
+
+
+void
+ANode::linkIntoDynChildIndex()
+{
+  ADynNode* x_dyn = dynamic_cast<ADynNode*>(this);
+  if (!x_dyn) {
+    // a subtree of unknown ADynNode descendents: rebuild lazily
+    invalidateDynChildIndex(parent());
+    return;
+  }
+
+  for (ANode* z = parent(); z; z = z->parent()) {
+    if (z->m_dynChildIdx) {
+      z->m_dynChildIdx->insert(x_dyn);
+    }
+    if (dynamic_cast<ADynNode*>(z)) {
+      break;
+    }
+  }
+}
+
+
+void
+ANode::unlinkFromDynChildIndex()
+{
+  ADynNode* x_dyn = dynamic_cast<ADynNode*>(this);
+  if (!x_dyn) {
+    invalidateDynChildIndex(parent());
+    return;
+  }
+
+  for (ANode* z = parent(); z; z = z->parent()) {
+    if (z->m_dynChildIdx) {
+      z->m_dynChildIdx->erase(x_dyn);
+    }
+    if (dynamic_cast<ADynNode*>(z)) {
+      break;
+    }
+  }
+}
+
+
 //***************************************************************************
 // ANode, etc: Tree Navigation 
 //***************************************************************************
@@ -451,6 +794,22 @@ ANode::zeroMetricsDeep(uint mBegId, uint mEndId)
 }
 
 
+void
+ANode::zeroMetricsDeep(uint mBegId, uint mEndId, const MergedNodeSet& nodes)
+{
+  if ( !(mBegId < mEndId) ) {
+    return; // short circuit
+  }
+
+  for (MergedNodeSet::const_iterator it = nodes.begin();
+       it != nodes.end(); ++it) {
+    ANode* n = *it;
+    // N.B.: unlike the dense form, aggregation need not have sized n
+    n->zeroMetrics(mBegId, std::min(mEndId, n->numMetrics()));
+  }
+}
+
+
 void
 ANode::aggregateMetricsIncl(uint mBegId, uint mEndId)
 {
@@ -481,9 +840,11 @@ ANode::aggregateMetricsIncl(const VMAIntervalSet& ivalset)
 	const VMAInterval& ival = *it1;
 	uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
 
-	for (uint mId = mBegId; mId < mEndId; ++mId) {
-	  double mVal = n->demandMetric(mId, mEndId/*size*/);
-	  n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
+	n->ensureMetricsSize(mEndId);
+	n_parent->ensureMetricsSize(mEndId);
+	for (uint mId = n->nextMetric(mBegId, mEndId); mId != Metric::IData::npos;
+	     mId = n->nextMetric(mId + 1, mEndId)) {
+	  n_parent->addMetric(mId, n->metric(mId));
 	}
       }
     }
@@ -491,6 +852,51 @@ ANode::aggregateMetricsIncl(const VMAIntervalSet& ivalset)
 }
 
 
+void
+ANode::aggregateMetricsIncl(const VMAIntervalSet& ivalset,
+			    const MergedNodeSet& nodes)
+{
+  if (ivalset.empty() || !nodes.contains(this)) {
+    return; // short circuit
+  }
+
+  aggregateMetricsIncl_sparse(ivalset, nodes);
+}
+
+
+void
+ANode::aggregateMetricsIncl_sparse(const VMAIntervalSet& ivalset,
+				   const MergedNodeSet& nodes)
+{
+  ANode* n = this;
+
+  // N.B.: To give results identical to the dense form, visit children
+  // in the order of its post-order ANodeIterator, i.e., forward.
+  for (NonUniformDegreeTreeNodeChildIterator it(n, true/*forward*/);
+       it.Current(); ++it) {
+    ANode* x = static_cast<ANode*>(it.Current());
+    if (!nodes.contains(x)) {
+      continue; // all values in subtree 'x' are zero
+    }
+
+    x->aggregateMetricsIncl_sparse(ivalset, nodes);
+
+    for (VMAIntervalSet::const_iterator it1 = ivalset.begin();
+	 it1 != ivalset.end(); ++it1) {
+      const VMAInterval& ival = *it1;
+      uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
+
+      x->ensureMetricsSize(mEndId);
+      n->ensureMetricsSize(mEndId);
+      for (uint mId = x->nextMetric(mBegId, mEndId); mId != Metric::IData::npos;
+	   mId = x->nextMetric(mId + 1, mEndId)) {
+	n->addMetric(mId, x->metric(mId));
+      }
+    }
+  }
+}
+
+
 void
 ANode::aggregateMetricsExcl(uint mBegId, uint mEndId)
 {
@@ -515,7 +921,21 @@ ANode::aggregateMetricsExcl(const VMAIntervalSet& ivalset)
 
 
 void
-ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
+ANode::aggregateMetricsExcl(const VMAIntervalSet& ivalset,
+			    const MergedNodeSet& nodes)
+{
+  if (ivalset.empty() || !nodes.contains(this)) {
+    return; // short circuit
+  }
+
+  AProcNode* frame = NULL; // will be set during tree traversal
+  aggregateMetricsExcl(frame, ivalset, &nodes);
+}
+
+
+void
+ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset,
+			    const MergedNodeSet* nodes)
 {
   ANode* n = this;
 
@@ -565,7 +985,9 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
   // -------------------------------------------------------
   for (ANodeChildIterator it(n); it.Current(); ++it) {
     ANode* x = it.current();
-    x->aggregateMetricsExcl(frameNxt, ivalset);
+    if (!nodes || nodes->contains(x)) {
+      x->aggregateMetricsExcl(frameNxt, ivalset, nodes);
+    }
   }
 
   // -------------------------------------------------------
@@ -579,11 +1001,17 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
       const VMAInterval& ival = *it;
       uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
 
-      for (uint mId = mBegId; mId < mEndId; ++mId) {
-        double mVal = n->demandMetric(mId, mEndId/*size*/);
-        n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
+      n->ensureMetricsSize(mEndId);
+      n_parent->ensureMetricsSize(mEndId);
+      if (frame && frame != n_parent) {
+        frame->ensureMetricsSize(mEndId);
+      }
+      for (uint mId = n->nextMetric(mBegId, mEndId); mId != Metric::IData::npos;
+           mId = n->nextMetric(mId + 1, mEndId)) {
+        double mVal = n->metric(mId);
+        n_parent->addMetric(mId, mVal);
         if (frame && frame != n_parent) {
-          frame->demandMetric(mId, mEndId/*size*/) += mVal;
+          frame->addMetric(mId, mVal);
         }
       }
     }
@@ -623,7 +1051,7 @@ ANode::computeMetricsMe(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
       expr->evalNF(*this);
       if (doFinal) {
 	double val = expr->eval(*this);
-	demandMetric(mId, numMetrics/*size*/) = val;
+	setMetric(mId, val, numMetrics/*size*/);
       }
     }
   }
@@ -860,9 +1288,16 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 		   << y_child->toStringMe(Tree::OFlg_Debug));
 	y_child->unlink();
   
-	effctLst1 = y_child->mergeDeep_fixInsert(x_newMetricBegIdx, mrgCtxt);
+	effctLst1 = y_child->mergeDeep_fixInsert(x_newMetricBegIdx, mrgCtxt,
+						 x->isSparseMetrics());
 
 	y_child->link(x);
+
+	if (mrgCtxt.mergedNodes()) {
+	  for (ANodeIterator it1(y_child); it1.Current(); ++it1) {
+	    mrgCtxt.noteMergedNode(it1.current());
+	  }
+	}
       }
     }
     else {
@@ -873,6 +1308,7 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 		 << "\n  y: " << y_child_dyn->toStringMe(Tree::OFlg_Debug));
       MergeEffect effct =
 	x_child_dyn->mergeMe(*y_child_dyn, &mrgCtxt, x_newMetricBegIdx);
+      mrgCtxt.noteMergedNode(x_child_dyn);
       if (mrgCtxt.doPropagateEffects() && !effct.isNoop()) {
 	effctLst->push_back(effct);
       }
@@ -926,8 +1362,9 @@ ANode::mergeMe(const ANode& y, MergeContext* GCC_ATTR_UNUSED mrgCtxt,
     ensureMetricsSize(x_end);
   }
 
-  for (uint x_i = metricBegIdx, y_i = 0; x_i < x_end; ++x_i, ++y_i) {
-    x->metric(x_i) += y.metric(y_i);
+  for (uint y_i = y.nextMetric(0); y_i != Metric::IData::npos;
+       y_i = y.nextMetric(y_i + 1)) {
+    x->addMetric(metricBegIdx + y_i, y.metric(y_i));
   }
   
   MergeEffect noopEffect;
@@ -981,9 +1418,27 @@ ADynNode::mergeMe(const ANode& y, MergeContext* mrgCtxt, uint metricBegIdx, bool
 }
 
 
+// findDynChild: nodes with at least this many children use an index
+static const uint DynChildIndex_MinChildren = 16;
+
 ADynNode*
 ANode::findDynChild(const ADynNode& y_dyn)
 {
+  if (!m_dynChildIdx && childCount() >= DynChildIndex_MinChildren) {
+    m_dynChildIdx = new ADynNodeIndex;
+    buildDynChildIndex(*m_dynChildIdx);
+  }
+
+  if (m_dynChildIdx) {
+    bool isUnique = true;
+    ADynNode* x_dyn = m_dynChildIdx->find(y_dyn, isUnique);
+    if (isUnique) {
+      return x_dyn;
+    }
+    // Several candidates: the linear search below determines which
+    // comes first in child order.
+  }
+
   for (ANodeChildIterator it(this); it.Current(); ++it) {
     ANode* x = it.current();
 
@@ -1007,7 +1462,8 @@ ANode::findDynChild(const ADynNode& y_dyn)
 
 
 MergeEffectList*
-ANode::mergeDeep_fixInsert(int newMetrics, MergeContext& mrgCtxt)
+ANode::mergeDeep_fixInsert(int newMetrics, MergeContext& mrgCtxt,
+			   bool isSparseMetrics)
 {
   // Assumes: While merging CCT::Tree y into CCT::Tree x, subtree
   // 'this', which used to live in 'y', has just been inserted into
@@ -1037,6 +1493,9 @@ ANode::mergeDeep_fixInsert(int newMetrics, MergeContext& mrgCtxt)
     // -----------------------------------------------------
     // 2. Make space for the metrics of CCT::Tree x
     // -----------------------------------------------------
+    if (isSparseMetrics) {
+      n->makeSparseMetrics();
+    }
     n->insertMetricsBefore(newMetrics);
   }
   
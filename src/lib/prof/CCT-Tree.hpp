@@ -126,6 +126,7 @@ namespace CallPath {
 namespace CCT {
 
 class ANode;
+class ADynNode;
 
 
 class Tree
@@ -172,11 +173,23 @@ public:
   { return m_metadata; }
   
   // -------------------------------------------------------
-  // Given a Tree, merge into 'this'
+  // Given a Tree, merge into 'this'.  If 'mrgNodes' is non-NULL, the
+  // nodes of 'this' changed by the merge are added to it.
   // -------------------------------------------------------
   MergeEffectList*
   merge(const Tree* y, uint x_newMetricBegIdx,
-	uint mrgFlag = 0, uint oFlag = 0);
+	uint mrgFlag = 0, uint oFlag = 0, MergedNodeSet* mrgNodes = NULL);
+
+  // mergeNode: Merge the childless node 'y', which belongs to no tree,
+  // as a child of 'x_parent' in 'this', as merge() would merge it as
+  // a child of the node corresponding to 'x_parent'.  If
+  // 'isInsertOnly', 'y' is inserted without looking for a
+  // corresponding child (i.e., 'x_parent' itself was inserted).
+  // Returns the node of 'this' corresponding to 'y', which is 'y'
+  // itself iff 'isInserted' is set; otherwise 'y' is deleted.
+  ANode*
+  mergeNode(ANode* x_parent, ADynNode* y, uint x_newMetricBegIdx,
+	    bool isInsertOnly, bool& isInserted);
 
   // -------------------------------------------------------
   // dense ids (only used when explicitly requested)
@@ -272,6 +285,8 @@ class ANode;     // Everyone's base class
 class ADynNode;
 class AProcNode;
 
+class ADynNodeIndex;
+
 class Root;
 
 class ProcFrm;
@@ -315,34 +330,40 @@ private:
 
 
 public:
+  // N.B.: a node uses the metric storage form of its parent
   ANode(ANodeTy type, ANode* parent, Struct::ACodeNode* strct = NULL)
     : NonUniformDegreeTreeNode(parent),
-      Metric::IData(),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
+      Metric::IData(0, (parent && parent->isSparseMetrics())),
+      m_type(type), m_id(makeUniqueId()), m_strct(strct),
+      m_dynChildIdx(NULL)
   {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
+    invalidateDynChildIndex(parent);
   }
 
   ANode(ANodeTy type,
 	ANode* parent, Struct::ACodeNode* strct, const Metric::IData& metrics)
     : NonUniformDegreeTreeNode(parent),
       Metric::IData(metrics),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
+      m_type(type), m_id(makeUniqueId()), m_strct(strct),
+      m_dynChildIdx(NULL)
   {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
+    if (parent && parent->isSparseMetrics()) {
+      makeSparseMetrics();
+    }
+    invalidateDynChildIndex(parent);
   }
 
-  virtual ~ANode()
-  { }
+  virtual ~ANode();
   
   // deep copy of internals (but without children)
   ANode(const ANode& x)
     : NonUniformDegreeTreeNode(NULL),
       Metric::IData(x),
-      m_type(x.m_type), /*m_id: skip*/ m_strct(x.m_strct)
+      m_type(x.m_type), /*m_id: skip*/ m_strct(x.m_strct),
+      m_dynChildIdx(NULL)
   {
     zeroLinks();
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
+    makeUniqueId();
   }
 
   // deep copy of internals (but without children)
@@ -396,7 +417,10 @@ public:
 
   void
   structure(const Struct::ACodeNode* strct)
-  { m_strct = const_cast<Struct::ACodeNode*>(strct); }
+  {
+    m_strct = const_cast<Struct::ACodeNode*>(strct);
+    noteMergeKeyChange();
+  }
 
   uint
   structureId() const
@@ -447,6 +471,24 @@ public:
   }
 
 
+  // --------------------------------------------------------
+  // Tree modification
+  //   N.B.: These hide the NonUniformDegreeTreeNode versions so that
+  //   an ancestor's child index (cf. findDynChild) remains consistent.
+  // --------------------------------------------------------
+  void
+  link(ANode* parent);
+
+  void
+  linkBefore(ANode* sibling);
+
+  void
+  linkAfter(ANode* sibling);
+
+  void
+  unlink();
+
+
   // --------------------------------------------------------
   // ancestor: find first ANode in path from this to root with given type
   // (Note: We assume that a node *can* be an ancestor of itself.)
@@ -481,6 +523,11 @@ public:
   void
   zeroMetricsDeep(uint mBegId, uint mEndId);
 
+  // zeroMetricsDeep: sparse form: zeros only the nodes in 'nodes'
+  // (cf. aggregateMetricsIncl())
+  void
+  zeroMetricsDeep(uint mBegId, uint mEndId, const MergedNodeSet& nodes);
+
 
   // aggregateMetricsIncl: aggregates metrics for inclusive CCT
   // metrics. [mBegId, mEndId) forms an interval for batch processing.
@@ -494,6 +541,14 @@ public:
   aggregateMetricsIncl(uint mBegId)
   { aggregateMetricsIncl(mBegId, mBegId + 1); }
 
+  // aggregateMetricsIncl: sparse form: assumes that only the nodes in
+  // 'nodes' (e.g., the nodes changed by merging a profile into a
+  // zeroed tree) may have non-zero values.  Visits only these nodes
+  // and gives results identical to the dense form.
+  void
+  aggregateMetricsIncl(const VMAIntervalSet& ivalset,
+		       const MergedNodeSet& nodes);
+
 
   // aggregateMetricsExcl: aggregates metrics for exclusive CCT
   // metrics. [mBegId, mEndId) forms an interval for batch processing.
@@ -507,14 +562,26 @@ public:
   aggregateMetricsExcl(uint mBegId)
   { aggregateMetricsExcl(mBegId, mBegId + 1); }
 
+  // aggregateMetricsExcl: sparse form (cf. aggregateMetricsIncl())
+  void
+  aggregateMetricsExcl(const VMAIntervalSet& ivalset,
+		       const MergedNodeSet& nodes);
+
 private:
+  void
+  aggregateMetricsIncl_sparse(const VMAIntervalSet& ivalset,
+			      const MergedNodeSet& nodes);
+
   //
   // laks 2015.10.21: we don't want accumulate the exclusive cost of 
   // an inlined statement to the caller. Instead, we assume an inline
   // function (Proc) as the same as a normal procedure (ProcFrm).
   // And the lowest common ancestor for Proc and ProcFrm is AProcNode.
+  //
+  // If 'nodes' is non-NULL, only visits descendents within 'nodes'.
   void
-  aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset);
+  aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset,
+		       const MergedNodeSet* nodes = NULL);
 
 public:
   // computeMetrics: compute this subtree's Metric::DerivedDesc metric
@@ -596,6 +663,10 @@ public:
   // If the CCT does not have structure information, we only need to
   //   inspect the children of z.  Otherwise, it is necessary to find
   //   the collection of z's direct ADynNode descendents.
+  //
+  // Nodes with many children lazily build an index (ADynNodeIndex)
+  //   of their direct ADynNode descendents so that merging is not
+  //   quadratic in a node's fan-out.
   CCT::ADynNode*
   findDynChild(const ADynNode& y_dyn);
 
@@ -649,6 +720,7 @@ public:
   codeName() const;
 
 protected:
+  friend class Tree; // Tree::mergeNode()
 
   bool
   writeXML_pre(std::ostream& os,
@@ -661,20 +733,54 @@ protected:
 
   // --------------------------------------------------------
   // Makes room for new metrics. Also checks and resolves
-  // any cpId conflicts between 2 trees.
+  // any cpId conflicts between 2 trees and adopts the metric
+  // storage form of the destination tree.
   // --------------------------------------------------------
 
   MergeEffectList*
-  mergeDeep_fixInsert(int newMetrics, MergeContext& mrgCtxt);
+  mergeDeep_fixInsert(int newMetrics, MergeContext& mrgCtxt,
+		      bool isSparseMetrics = false);
+
+  // --------------------------------------------------------
+  // Child index maintenance (cf. findDynChild)
+  // --------------------------------------------------------
+
+  // noteMergeKeyChange: must be called whenever a field used by
+  //   ADynNode::isMergable() changes
+  void
+  noteMergeKeyChange()
+  { invalidateDynChildIndex(parent()); }
+
+private:
+  // invalidateDynChildIndex: discard every index that may contain a
+  //   direct ADynNode descendent of 'x' (i.e., the indices of 'x' and
+  //   of its ancestors up to and including the first ADynNode)
+  static void
+  invalidateDynChildIndex(ANode* x);
+
+  void
+  buildDynChildIndex(ADynNodeIndex& idx) const;
+
+  void
+  linkIntoDynChildIndex();
 
+  void
+  unlinkFromDynChildIndex();
 
 private:
+  // makeUniqueId: N.B.: profiles may be read concurrently (hpcprof -j)
+  static uint
+  makeUniqueId();
+
   static uint s_nextUniqueId;
   
 protected:
   ANodeTy m_type; // obsolete with typeid(), but hard to replace
   uint m_id;
   Struct::ACodeNode* m_strct;
+
+private:
+  ADynNodeIndex* m_dynChildIdx; // owned; built on demand
 };
 
 
@@ -750,6 +856,7 @@ public:
       m_opIdx = x.m_opIdx;
       delete m_lip;
       m_lip = clone_lip(x.m_lip);
+      noteMergeKeyChange();
     }
     return *this;
   }
@@ -809,13 +916,17 @@ public:
   void
   lmId(LoadMap::LMId_t x)
   {
-    if (isValid_lip()) { lush_lip_setLMId(m_lip, (uint16_t)x); return; }
-    m_lmId = x;
+    if (isValid_lip()) { lush_lip_setLMId(m_lip, (uint16_t)x); }
+    else { m_lmId = x; }
+    noteMergeKeyChange();
   }
 
   void
   lmId_real(LoadMap::LMId_t x)
-  { m_lmId = x; }
+  {
+    m_lmId = x;
+    noteMergeKeyChange();
+  }
 
   virtual VMA
   lmIP() const
@@ -836,10 +947,12 @@ public:
     if (isValid_lip()) {
       lush_lip_setLMIP(m_lip, lmIP);
       m_opIdx = 0;
-      return;
     }
-    m_lmIP  = lmIP;
-    m_opIdx = opIdx;
+    else {
+      m_lmIP  = lmIP;
+      m_opIdx = opIdx;
+    }
+    noteMergeKeyChange();
   }
 
   ushort
@@ -857,7 +970,10 @@ public:
   
   void
   lip(const lush_lip_t* lip)
-  { m_lip = const_cast<lush_lip_t*>(lip); }
+  {
+    m_lip = const_cast<lush_lip_t*>(lip);
+    noteMergeKeyChange();
+  }
 
   static lush_lip_t*
   clone_lip(const lush_lip_t* x)
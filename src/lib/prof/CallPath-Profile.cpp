@@ -71,9 +71,13 @@ using std::dec;
 using std::string;
 
 #include <map>
+#include <set>
+#include <vector>
 #include <algorithm>
 #include <sstream>
 
+#include <cerrno>
+#include <cstdlib> // posix_memalign
 #include <cstdio>
 #include <cstring> // strcmp
 #include <cmath> // abs
@@ -159,7 +163,7 @@ std::map<uint, uint> m_pairFakeLoadModule;
 namespace CallPath {
 
 
-Profile::Profile(const std::string name)
+Profile::Profile(const std::string name, bool isSparseMetrics)
 {
   m_name = name;
   m_fmtVersion = 0.0;
@@ -171,6 +175,7 @@ Profile::Profile(const std::string name)
 
   m_mMgr = new Metric::Mgr;
   m_isMetricMgrVirtual = false;
+  m_isSparseMetrics = isSparseMetrics;
 
   m_loadmap = new LoadMap;
 
@@ -192,7 +197,8 @@ Profile::~Profile()
 
 
 uint
-Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
+Profile::merge(Profile& y, int mergeTy, uint mrgFlag,
+	       CCT::MergedNodeSet* mrgNodes)
 {
   Profile& x = (*this);
 
@@ -201,6 +207,56 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
   // -------------------------------------------------------
   // merge name, flags, etc
   // -------------------------------------------------------
+  merge_info(y);
+
+  // -------------------------------------------------------
+  // merge metrics
+  // -------------------------------------------------------
+  uint x_newMetricBegIdx = 0;
+  uint firstMergedMetric = mergeMetrics(y, mergeTy, x_newMetricBegIdx);
+  
+  // -------------------------------------------------------
+  // merge LoadMaps
+  //
+  // Post-INVARIANT: y's cct refers to x's LoadMap
+  // -------------------------------------------------------
+  std::vector<LoadMap::MergeEffect>* mrgEffects1 =
+    x.m_loadmap->merge(*y.loadmap());
+  y.merge_fixCCT(mrgEffects1);
+  delete mrgEffects1;
+
+  // -------------------------------------------------------
+  // merge CCTs
+  // -------------------------------------------------------
+
+  if (mrgFlag & CCT::MrgFlg_NormalizeTraceFileY) {
+    mrgFlag |= CCT::MrgFlg_PropagateEffects;
+  }
+
+  CCT::MergeEffectList* mrgEffects2 =
+    x.cct()->merge(y.cct(), x_newMetricBegIdx, mrgFlag, 0/*oFlag*/,
+		   mrgNodes);
+
+  DIAG_Assert(Logic::implies(mrgEffects2 && !mrgEffects2->empty(),
+			     mrgFlag & CCT::MrgFlg_NormalizeTraceFileY),
+	      "CallPath::Profile::merge: there should only be CCT::MergeEffects when MrgFlg_NormalizeTraceFileY is passed");
+
+  if (mrgFlag & CCT::MrgFlg_RemapTraceFileY) {
+    y.merge_writeTraceRemap(mrgEffects2);
+  }
+  else {
+    y.merge_fixTrace(mrgEffects2, (mrgFlag & CCT::MrgFlg_DeferTraceFixY));
+  }
+  delete mrgEffects2;
+
+  return firstMergedMetric;
+}
+
+
+void
+Profile::merge_info(Profile& y)
+{
+  Profile& x = (*this);
 
   // Note: these values can be 'null' if the hpcrun-fmt data had no epochs
   if (x.m_fmtVersion == 0.0) {
@@ -240,43 +296,6 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
 			      y.m_traceFileNameSet.end());
   x.m_traceMinTime = std::min(x.m_traceMinTime, y.m_traceMinTime);
   x.m_traceMaxTime = std::max(x.m_traceMaxTime, y.m_traceMaxTime);
-
-
-  // -------------------------------------------------------
-  // merge metrics
-  // -------------------------------------------------------
-  uint x_newMetricBegIdx = 0;
-  uint firstMergedMetric = mergeMetrics(y, mergeTy, x_newMetricBegIdx);
-  
-  // -------------------------------------------------------
-  // merge LoadMaps
-  //
-  // Post-INVARIANT: y's cct refers to x's LoadMap
-  // -------------------------------------------------------
-  std::vector<LoadMap::MergeEffect>* mrgEffects1 =
-    x.m_loadmap->merge(*y.loadmap());
-  y.merge_fixCCT(mrgEffects1);
-  delete mrgEffects1;
-
-  // -------------------------------------------------------
-  // merge CCTs
-  // -------------------------------------------------------
-
-  if (mrgFlag & CCT::MrgFlg_NormalizeTraceFileY) {
-    mrgFlag |= CCT::MrgFlg_PropagateEffects;
-  }
-
-  CCT::MergeEffectList* mrgEffects2 =
-    x.cct()->merge(y.cct(), x_newMetricBegIdx, mrgFlag);
-
-  DIAG_Assert(Logic::implies(mrgEffects2 && !mrgEffects2->empty(),
-			     mrgFlag & CCT::MrgFlg_NormalizeTraceFileY),
-	      "CallPath::Profile::merge: there should only be CCT::MergeEffects when MrgFlg_NormalizeTraceFileY is passed");
-
-  y.merge_fixTrace(mrgEffects2);
-  delete mrgEffects2;
-
-  return firstMergedMetric;
 }
 
 
@@ -343,6 +362,31 @@ Profile::mergeMetrics(Profile& y, int mergeTy, uint& x_newMetricBegIdx)
 }
 
 
+static void
+cct_fixLMIds(CCT::ADynNode* n_dyn,
+	     const std::vector<LoadMap::MergeEffect>& mrgEffects)
+{
+  lush_lip_t* lip = n_dyn->lip();
+
+  LoadMap::LMId_t lmId1, lmId2;
+  lmId1 = n_dyn->lmId_real();
+  lmId2 = (lip) ? lush_lip_getLMId(lip) : LoadMap::LMId_NULL;
+
+  for (uint i = 0; i < mrgEffects.size(); ++i) {
+    const LoadMap::MergeEffect& chg = mrgEffects[i];
+    if (chg.old_id == lmId1) {
+      n_dyn->lmId_real(chg.new_id);
+      if (lmId2 == LoadMap::LMId_NULL) {
+	break; // quick exit in the common case
+      }
+    }
+    if (chg.old_id == lmId2) {
+      lush_lip_setLMId(lip, (uint16_t) chg.new_id);
+    }
+  }
+}
+
+
 void
 Profile::merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects)
 {
@@ -358,34 +402,233 @@ Profile::merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects)
     
     CCT::ADynNode* n_dyn = dynamic_cast<CCT::ADynNode*>(n);
     if (n_dyn) {
-      lush_lip_t* lip = n_dyn->lip();
+      cct_fixLMIds(n_dyn, *mrgEffects);
+    }
+  }
+}
 
-      LoadMap::LMId_t lmId1, lmId2;
-      lmId1 = n_dyn->lmId_real();
-      lmId2 = (lip) ? lush_lip_getLMId(lip) : LoadMap::LMId_NULL;
-      
-      for (uint i = 0; i < mrgEffects->size(); ++i) {
-	const LoadMap::MergeEffect& chg = (*mrgEffects)[i];
-	if (chg.old_id == lmId1) {
-	  n_dyn->lmId_real(chg.new_id);
-	  if (lmId2 == LoadMap::LMId_NULL) {
-	    break; // quick exit in the common case
-	  }
-	}
-	if (chg.old_id == lmId2) {
-	  lush_lip_setLMId(lip, (uint16_t) chg.new_id);
-	}
+
+// Reads the rest of an input stream through an hpcio_inbuf_t, which
+// maps the file or, failing that, reads it in large chunks.  When
+// done, the stream is repositioned after the bytes consumed.
+class StreamInbuf {
+public:
+  StreamInbuf(FILE* fs)
+    : m_fs(fs), m_buf(NULL), m_isAttached(false)
+  {
+    off_t off = ftello(fs);
+    if (off < 0) {
+      return; // not seekable: read through 'fs'
+    }
+    m_isAttached = (hpcio_inbuf_attach(&m_inbuf, fileno(fs), off, NULL, 0,
+				       HPCIO_INBUF_MMAP) == HPCFMT_OK);
+    if (!m_isAttached) {
+      m_buf = new char[HPCIO_RWBufferSz];
+      m_isAttached = (hpcio_inbuf_attach(&m_inbuf, fileno(fs), off, m_buf,
+					 HPCIO_RWBufferSz, 0) == HPCFMT_OK);
+    }
+  }
+
+  ~StreamInbuf()
+  {
+    if (m_isAttached) {
+      off_t off = hpcio_inbuf_tell(&m_inbuf);
+      hpcio_inbuf_detach(&m_inbuf);
+      fseeko(m_fs, off, SEEK_SET);
+    }
+    delete[] m_buf;
+  }
+
+  // NULL if the stream must be read directly
+  hpcio_inbuf_t*
+  inbuf()
+  { return m_isAttached ? &m_inbuf : NULL; }
+
+private:
+  StreamInbuf(const StreamInbuf&);
+  StreamInbuf& operator=(const StreamInbuf&);
+
+  FILE* m_fs;
+  char* m_buf;
+  bool m_isAttached;
+  hpcio_inbuf_t m_inbuf;
+};
+
+
+// Write the non-empty block 'blk' at offset 'off' and record it in 'blkIdx'
+static int
+trace_blk_fwrite(hpctrace_fmt_blk_t* blk,
+		 std::vector<hpctrace_fmt_blkidx_t>& blkIdx, uint64_t& off,
+		 FILE* fs)
+{
+  if (blk->numRecs == 0) {
+    return HPCFMT_OK;
+  }
+
+  hpctrace_fmt_blkidx_t x;
+  x.time = blk->time0;
+  x.off = off;
+  x.numRecs = blk->numRecs;
+  blkIdx.push_back(x);
+
+  HPCFMT_ThrowIfError(hpctrace_fmt_blk_fwrite(blk, fs));
+  off += HPCTRACE_FMT_BlkHdrLen + blk->len;
+  hpctrace_fmt_blk_init(blk);
+  return HPCFMT_OK;
+}
+
+
+// Terminate the block list at offset 'off' and write the block index
+// and footer
+static int
+trace_blkidx_fwrite(std::vector<hpctrace_fmt_blkidx_t>& blkIdx, uint64_t off,
+		    FILE* fs)
+{
+  hpctrace_fmt_blk_t endBlk;
+  hpctrace_fmt_blk_init(&endBlk);
+  HPCFMT_ThrowIfError(hpctrace_fmt_blk_fwrite(&endBlk, fs));
+
+  for (uint i = 0; i < blkIdx.size(); ++i) {
+    HPCFMT_ThrowIfError(hpctrace_fmt_blkidx_fwrite(&blkIdx[i], fs));
+  }
+
+  hpctrace_fmt_footer_t footer;
+  footer.idxOff = off + HPCTRACE_FMT_BlkHdrLen;
+  footer.numBlocks = blkIdx.size();
+  HPCFMT_ThrowIfError(hpctrace_fmt_footer_fwrite(&footer, fs));
+  return HPCFMT_OK;
+}
+
+
+// Dense old -> new cpId table for 'mrgEffects'; ids beyond the table
+// are unchanged (cf. hpctrace_fmt_remap_cpId)
+static void
+trace_remapTable(const CCT::MergeEffectList* mrgEffects,
+		 std::vector<uint32_t>& newId)
+{
+  uint32_t numIds = 0;
+  for (CCT::MergeEffectList::const_iterator it = mrgEffects->begin();
+       it != mrgEffects->end(); ++it) {
+    numIds = std::max(numIds, (uint32_t) it->old_cpId + 1);
+  }
+
+  newId.resize(numIds);
+  for (uint32_t i = 0; i < numIds; ++i) {
+    newId[i] = i;
+  }
+  for (CCT::MergeEffectList::const_iterator it = mrgEffects->begin();
+       it != mrgEffects->end(); ++it) {
+    newId[it->old_cpId] = it->new_cpId;
+  }
+}
+
+
+// Remap the cpIds of the fixed-size records in 'buf', in place.
+// Records are big-endian (time, cpId[, metricId]).
+static void
+trace_remapRecords(unsigned char* buf, size_t numRecs, size_t recSz,
+		   const uint32_t* newId, uint32_t numIds)
+{
+  unsigned char* p = buf + sizeof(uint64_t);
+  for (size_t i = 0; i < numRecs; ++i, p += recSz) {
+    uint32_t id = ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+      | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+    uint32_t nid = hpctrace_fmt_remap_cpId(newId, numIds, id);
+    p[0] = (unsigned char) (nid >> 24);
+    p[1] = (unsigned char) (nid >> 16);
+    p[2] = (unsigned char) (nid >> 8);
+    p[3] = (unsigned char) nid;
+  }
+}
+
+
+enum TraceFixErr {
+  TraceFixErr_None,
+  TraceFixErr_Read,
+  TraceFixErr_Write,
+  TraceFixErr_Alloc
+};
+
+
+// Bulk path for unblocked traces: the records have a fixed size, so
+// read large chunks past the header, remap them in place and write
+// them out whole.  'outfs' must be flushed and positioned after its
+// header.  Returns: HPCFMT_OK, or HPCFMT_ERR with 'err' telling
+// whether reading, writing or allocating the chunk buffer failed.
+static int
+trace_fixRecords(FILE* infs, long inOff, FILE* outfs,
+		 hpctrace_hdr_flags_t flags,
+		 const std::vector<uint32_t>& newId, TraceFixErr& err)
+{
+  static const size_t chunkSz = 4 * 1024 * 1024;
+
+  const size_t recSz = sizeof(uint64_t) + sizeof(uint32_t)
+    + (flags.fields.isDataCentric ? sizeof(uint32_t) : 0);
+  const size_t chunkRecs = chunkSz / recSz;
+
+  int infd = fileno(infs);
+  int outfd = fileno(outfs);
+
+  void* bufp = NULL;
+  if (posix_memalign(&bufp, 4096, chunkRecs * recSz) != 0) {
+    err = TraceFixErr_Alloc;
+    return HPCFMT_ERR;
+  }
+  unsigned char* buf = (unsigned char*) bufp;
+
+  const uint32_t* map = newId.empty() ? NULL : &newId[0];
+  uint32_t numIds = newId.size();
+
+  int ret = HPCFMT_OK;
+  off_t off = inOff;
+  size_t have = 0; // bytes of a partial record carried over
+  while (true) {
+    ssize_t nr = pread(infd, buf + have, chunkRecs * recSz - have, off);
+    if (nr < 0) {
+      if (errno == EINTR) continue;
+      err = TraceFixErr_Read;
+      ret = HPCFMT_ERR;
+      break;
+    }
+    off += nr;
+    have += nr;
+
+    size_t numRecs = have / recSz;
+    if (numRecs == 0) {
+      break; // EOF; a trailing partial record is dropped
+    }
+    trace_remapRecords(buf, numRecs, recSz, map, numIds);
+
+    size_t len = numRecs * recSz;
+    for (size_t done = 0; done < len; ) {
+      ssize_t nw = write(outfd, buf + done, len - done);
+      if (nw < 0) {
+	if (errno == EINTR) continue;
+	err = TraceFixErr_Write;
+	ret = HPCFMT_ERR;
+	break;
       }
+      done += nw;
+    }
+    if (ret != HPCFMT_OK) {
+      break;
+    }
+
+    memmove(buf, buf + len, have - len);
+    have -= len;
+    if (nr == 0) {
+      break;
     }
   }
+
+  free(buf);
+  return ret;
 }
 
 
 void
-Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
+Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects, bool defer)
 {
-  typedef std::map<uint, uint> UIntToUIntMap;
-
   // early exit for trivial case
   if (m_traceFileName.empty()) {
     return;
@@ -394,30 +637,50 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
     return; // rely on Analysis::Util::copyTraceFiles() to copy orig file
   }
 
-  // N.B.: We could build a map of old->new cpIds within
-  // Profile::merge(), but the list of effects is more general and
-  // extensible.  There are no asymptotic problems with building the
-  // following map for local use.
-  UIntToUIntMap cpIdMap;
-  for (CCT::MergeEffectList::const_iterator it = mrgEffects->begin();
-       it != mrgEffects->end(); ++it) {
-    const CCT::MergeEffect& effct = *it;
-    cpIdMap.insert(std::make_pair(effct.old_cpId, effct.new_cpId));
+  std::vector<uint32_t> newId;
+  trace_remapTable(mrgEffects, newId);
+
+  if (defer) {
+    m_traceFixId.swap(newId);
   }
+  else {
+    fixTrace(m_traceFileName, newId);
+  }
+}
+
+
+void
+Profile::fixDeferredTrace()
+{
+  if (!m_traceFixId.empty()) {
+    fixTrace(m_traceFileName, m_traceFixId);
+    std::vector<uint32_t>().swap(m_traceFixId);
+  }
+}
+
+
+// Rewrite trace file 'inFnm' into 'inFnm.tmp' with the cpIds in
+// 'newId'.  Only touches the two files, so distinct traces may be
+// fixed concurrently.
+void
+Profile::fixTrace(const std::string& inFnm, const std::vector<uint32_t>& newId)
+{
+  const uint32_t* map = newId.empty() ? NULL : &newId[0];
+  uint32_t numIds = newId.size();
 
   // ------------------------------------------------------------
   // Rewrite trace file
   // ------------------------------------------------------------
   int ret;
+  bool isBlkReadErr = false;
 
-  DIAG_MsgIf(0, "Profile::merge_fixTrace: " << m_traceFileName);
+  DIAG_MsgIf(0, "Profile::fixTrace: " << inFnm);
 
-  string traceFileNameTmp = m_traceFileName + "." + HPCPROF_TmpFnmSfx;
+  string traceFileNameTmp = inFnm + "." + HPCPROF_TmpFnmSfx;
 
   char* infsBuf = new char[HPCIO_RWBufferSz];
   char* outfsBuf = new char[HPCIO_RWBufferSz];
 
-  const string& inFnm = m_traceFileName;
   FILE* infs = hpcio_fopen_r(inFnm.c_str());
   if (!infs) {
     std::string errorString;
@@ -427,7 +690,7 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
   }
 
   ret = setvbuf(infs, infsBuf, _IOFBF, HPCIO_RWBufferSz);
-  DIAG_AssertWarn(ret == 0, inFnm << ": Profile::merge_fixTrace: setvbuf!");
+  DIAG_AssertWarn(ret == 0, inFnm << ": Profile::fixTrace: setvbuf!");
 
   hpctrace_fmt_hdr_t hdr;
   ret = hpctrace_fmt_hdr_fread(&hdr, infs);
@@ -458,40 +721,95 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
   }
 
   ret = setvbuf(outfs, outfsBuf, _IOFBF, HPCIO_RWBufferSz);
-  DIAG_AssertWarn(ret == 0, outFnm << ": Profile::merge_fixTrace: setvbuf!");
+  DIAG_AssertWarn(ret == 0, outFnm << ": Profile::fixTrace: setvbuf!");
+
+  // Fixed-size records are remapped in bulk.  Block-encoded traces
+  // (version 1.02) are re-encoded since the varint size of a cpId may
+  // change; their block index is rebuilt.
+  hpctrace_fmt_blk_t inBlk, outBlk;
+  hpctrace_fmt_blk_init(&inBlk);
+  hpctrace_fmt_blk_init(&outBlk);
+  std::vector<hpctrace_fmt_blkidx_t> outBlkIdx;
+  uint64_t outOff = HPCTRACE_FMT_HeaderLen;
 
   ret = hpctrace_fmt_hdr_fwrite(hdr.flags, outfs);
   if (ret == HPCFMT_ERR) goto badwrite;
 
-  while ( !feof(infs) ) {
-    // 1. Read trace record (exit on EOF)
-    hpctrace_fmt_datum_t datum;
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
-    if (ret == HPCFMT_EOF) {
-      break;
-    } else if (ret == HPCFMT_ERR) {
-      DIAG_EMsg("failed reading a record from trace measurement file " << inFnm << "; skip this one.");
+  if (!hdr.flags.fields.isBlocked) {
+    TraceFixErr err = TraceFixErr_None;
+    long inOff = ftell(infs);
+    if (inOff < 0 || fflush(outfs) != 0) goto badwrite;
+    ret = trace_fixRecords(infs, inOff, outfs, hdr.flags, newId, err);
+    if (ret == HPCFMT_ERR && err != TraceFixErr_Write) {
+      if (err == TraceFixErr_Alloc) {
+	DIAG_EMsg("failed allocating a buffer to fix trace measurement file " << inFnm << "; skip this one.");
+      }
+      else {
+	DIAG_EMsg("failed reading a record from trace measurement file " << inFnm << "; skip this one.");
+      }
       hpcio_fclose(infs);
       hpcio_fclose(outfs);
       unlink(outFnm.c_str()); // delete incomplete output file
       return;
     }
-    
-    // 2. Translate cct id
-    uint cctId_old = datum.cpId;
-    uint cctId_new = datum.cpId;
-    UIntToUIntMap::iterator it = cpIdMap.find(cctId_old);
-    if (it != cpIdMap.end()) {
-      cctId_new = it->second;
-      DIAG_MsgIf(0, "  " << cctId_old << " -> " << cctId_new);
+    else if (ret == HPCFMT_ERR) {
+      goto badwrite;
     }
-    datum.cpId = cctId_new;
+    goto done;
+  }
+
+  {
+    StreamInbuf in(infs);
+    const size_t maxRecs = 1024;
+    hpctrace_fmt_datum_t datum[maxRecs];
+
+    while (true) {
+      // 1. Read a batch of trace records (exit on EOF)
+      size_t numRecs = maxRecs;
+      if (in.inbuf()) {
+	ret = hpctrace_fmt_datums_inbuf_read(datum, &numRecs, hdr.flags,
+					     &inBlk, in.inbuf());
+      }
+      else {
+	numRecs = 1;
+	ret = hpctrace_fmt_datum_blk_fread(&datum[0], hdr.flags, &inBlk, infs);
+      }
+      if (ret == HPCFMT_EOF) {
+	break;
+      } else if (ret == HPCFMT_ERR) {
+	isBlkReadErr = true;
+	break;
+      }
 
-    // 3. Write new trace record
-    ret = hpctrace_fmt_datum_fwrite(&datum, hdr.flags, outfs);
-    if (ret == HPCFMT_ERR) goto badwrite;
+      for (size_t i = 0; i < numRecs; ++i) {
+	// 2. Translate cct id
+	datum[i].cpId = hpctrace_fmt_remap_cpId(map, numIds, datum[i].cpId);
+
+	// 3. Write new trace record
+	if (hpctrace_fmt_blk_isFull(&outBlk)) {
+	  ret = trace_blk_fwrite(&outBlk, outBlkIdx, outOff, outfs);
+	  if (ret == HPCFMT_ERR) break;
+	}
+	hpctrace_fmt_blk_append(&outBlk, &datum[i], hdr.flags);
+      }
+      if (ret == HPCFMT_ERR) break;
+    }
   }
+  if (isBlkReadErr) {
+    DIAG_EMsg("failed reading a record from trace measurement file " << inFnm << "; skip this one.");
+    hpcio_fclose(infs);
+    hpcio_fclose(outfs);
+    unlink(outFnm.c_str()); // delete incomplete output file
+    return;
+  }
+  if (ret == HPCFMT_ERR) goto badwrite;
 
+  ret = trace_blk_fwrite(&outBlk, outBlkIdx, outOff, outfs);
+  if (ret == HPCFMT_ERR) goto badwrite;
+  ret = trace_blkidx_fwrite(outBlkIdx, outOff, outfs);
+  if (ret == HPCFMT_ERR) goto badwrite;
+
+done:
   hpcio_fclose(infs);
   hpcio_fclose(outfs);
 
@@ -513,6 +831,67 @@ badwrite:
 
 
 
+// Write the old -> new cpId map of the trace file as a dense table
+// (hpctrace_fmt_remap_fwrite) so that the trace itself can be linked
+// into the database unchanged.  Readers apply the table.
+void
+Profile::merge_writeTraceRemap(const CCT::MergeEffectList* mrgEffects)
+{
+  if (m_traceFileName.empty()) {
+    return;
+  }
+  else if (!mrgEffects || mrgEffects->empty()) {
+    return; // rely on Analysis::Util::copyTraceFiles() to copy orig file
+  }
+
+  std::vector<uint32_t> newId;
+  trace_remapTable(mrgEffects, newId);
+  uint32_t numIds = newId.size();
+
+  const string outFnm =
+    traceRemapFileName(m_traceFileName) + "." + HPCPROF_TmpFnmSfx;
+
+  DIAG_MsgIf(0, "Profile::merge_writeTraceRemap: " << outFnm);
+
+  FILE* outfs = hpcio_fopen_w(outFnm.c_str(), 1/*overwrite*/);
+  if (!outfs) {
+    if (errno == EDQUOT) {
+      DIAG_EMsg("disk quota exceeded; unable to open trace remap file  " <<
+		outFnm << "; aborting.");
+      prof_abort(-1);
+    }
+    // fall back to rewriting the trace
+    DIAG_Msg(1, "unable to open trace remap file " << outFnm
+	     << "; rewriting trace " << m_traceFileName);
+    fixTrace(m_traceFileName, newId);
+    return;
+  }
+
+  int ret = hpctrace_fmt_remap_fwrite(newId.data(), numIds, outfs);
+  if (ret == HPCFMT_ERR || hpcio_fclose(outfs) != 0) {
+    std::string errorString;
+    hpcrun_getFileErrorString(outFnm, errorString);
+    DIAG_EMsg("failed writing trace remap file " << errorString << "; aborting.");
+    unlink(outFnm.c_str()); // delete incomplete output file
+    prof_abort(-1);
+  }
+}
+
+
+std::string
+Profile::traceRemapFileName(const std::string& traceFnm)
+{
+  const string traceSfx = string(".") + HPCRUN_TraceFnmSfx;
+  string stem = traceFnm;
+  if (stem.length() > traceSfx.length()
+      && stem.compare(stem.length() - traceSfx.length(), traceSfx.length(),
+		      traceSfx) == 0) {
+    stem.erase(stem.length() - traceSfx.length());
+  }
+  return stem + "." + HPCTRACE_RemapFnmSfx;
+}
+
+
 // ---------------------------------------------------
 // String comparison used for hash map
 // ---------------------------------------------------
@@ -939,7 +1318,8 @@ const char* Profile::FmtEpoch_NV_virtualMetrics = "is-virtual-metrics";
 Profile*
 Profile::make(uint rFlags)
 {
-  Profile* prof = new Profile("[program-name]");
+  Profile* prof = new Profile("[program-name]",
+			      (rFlags & RFlg_SparseMetrics));
 
   if (rFlags & RFlg_VirtualMetrics) {
     prof->isMetricMgrVirtual(true);
@@ -1068,11 +1448,65 @@ Profile::fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
 }
 
 
+int
+Profile::fmt_freadMerge(Profile& x, FILE* infs, uint rFlags, int mergeTy,
+			std::string ctxtStr)
+{
+  int ret;
+
+  // ------------------------------------------------------------
+  // hdr
+  // ------------------------------------------------------------
+  hpcrun_fmt_hdr_t hdr;
+  ret = hpcrun_fmt_hdr_fread(&hdr, infs, malloc);
+  if (ret != HPCFMT_OK) {
+    DIAG_Throw("error reading 'fmt-hdr' in " << ctxtStr);
+  }
+  if ( !(hdr.version >= HPCRUN_FMT_Version_20) ) {
+    hpcrun_fmt_hdr_free(&hdr, free);
+    DIAG_Throw("unsupported file version '" << hdr.versionStr << "'");
+  }
+
+  // ------------------------------------------------------------
+  // epoch: Merge each epoch into 'x' while reading it
+  // ------------------------------------------------------------
+  uint num_epochs = 0;
+  while ( !feof(infs) ) {
+
+    Profile* myprof = NULL;
+
+    string myCtxtStr = "epoch " + StrUtil::toStr(num_epochs + 1);
+    ctxtStr += ": " + myCtxtStr;
+
+    try {
+      ret = fmt_epoch_fread(myprof, infs, rFlags, hdr,
+			    ctxtStr, NULL, NULL, &x, mergeTy);
+    }
+    catch (const Diagnostics::Exception& e) {
+      delete myprof;
+      hpcrun_fmt_hdr_free(&hdr, free);
+      DIAG_Throw("error reading " << ctxtStr << ": " << e.what());
+    }
+    delete myprof;
+
+    if (ret == HPCFMT_EOF) {
+      break;
+    }
+
+    num_epochs++;
+  }
+
+  hpcrun_fmt_hdr_free(&hdr, free);
+
+  return HPCFMT_OK;
+}
+
+
 int
 Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
 			 const hpcrun_fmt_hdr_t& hdr,
 			 std::string ctxtStr, const char* filename,
-			 FILE* outfs)
+			 FILE* outfs, Profile* mrgDst, int mergeTy)
 {
   using namespace Prof;
 
@@ -1233,7 +1667,7 @@ Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
   // make CallPath::Profile
   // ----------------------------------------
   
-  prof = new Profile(progNm);
+  prof = new Profile(progNm, (rFlags & RFlg_SparseMetrics));
 
   prof->m_fmtVersion = hdr.version;
   prof->m_flags = ehdr.flags;
@@ -1411,7 +1845,8 @@ Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
   // ------------------------------------------------------------
   // cct
   // ------------------------------------------------------------
-  fmt_cct_fread(*prof, infs, rFlags, metricTbl, ctxtStr, outfs);
+  fmt_cct_fread(*prof, infs, rFlags, metricTbl, ctxtStr, outfs,
+		mrgDst, mergeTy);
 
 
   hpcrun_fmt_epochHdr_free(&ehdr, free);
@@ -1424,7 +1859,8 @@ Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
 int
 Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 		       const metric_tbl_t& metricTbl,
-		       std::string ctxtStr, FILE* outfs)
+		       std::string ctxtStr, FILE* outfs,
+		       Profile* mrgDst, int mergeTy)
 {
   typedef std::map<int, CCT::ANode*> CCTIdToCCTNodeMap;
 
@@ -1450,11 +1886,35 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 
   CCT::Tree* cct = prof.cct();
   
-  if (numNodes > 0) {
+  if (numNodes > 0 && !mrgDst) {
     delete cct->root();
     cct->root(NULL);
   }
 
+  // ------------------------------------------------------------
+  // When merging, 'cctNodeMap' maps to nodes of mrgDst's CCT, and
+  // 'mrgInsertedIds' holds the nodes that were inserted there rather
+  // than merged with an existing node (cf. CCT::ANode::mergeDeep()).
+  // N.B.: merge 'prof' info (e.g., flags) only after the nodes have
+  // been decoded with its own flags.
+  // ------------------------------------------------------------
+  uint x_newMetricBegIdx = 0;
+  std::vector<LoadMap::MergeEffect> lmMrgEffects;
+  std::set<int> mrgInsertedIds;
+
+  if (mrgDst) {
+    DIAG_Assert(typeid(*mrgDst->cct()->root()) == typeid(CCT::Root),
+		"Profile::fmt_cct_fread: cannot merge into a non-canonical CCT");
+    prof.metricMgr()->computePartners(); // cf. fmt_fread()
+    mrgDst->mergeMetrics(prof, mergeTy, x_newMetricBegIdx);
+    mrgDst->metricMgr()->mergePerfEventStatistics(prof.metricMgr());
+
+    std::vector<LoadMap::MergeEffect>* mrgEffects =
+      mrgDst->m_loadmap->merge(*prof.loadmap());
+    lmMrgEffects.swap(*mrgEffects);
+    delete mrgEffects;
+  }
+
   // N.B.: numMetricsSrc <= [numMetricsDst = prof.metricMgr()->size()]
   uint numMetricsSrc = metricTbl.len;
 
@@ -1468,13 +1928,47 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     (hpcrun_metricVal_t*)alloca(numMetricsSrc * sizeof(hpcrun_metricVal_t))
     : NULL;
 
+  // ------------------------------------------
+  // check if the metric contains a formula
+  //  if this is the case, we'll compute the metric based on the formula
+  //  given by hpcrun.  Each formula is compiled once here and then
+  //  evaluated for every node.
+  // FIXME: we don't check the validity of the formula (yet).
+  //        If hpcrun has incorrect formula, the result can be anything
+  // ------------------------------------------
+  metric_desc_t* m_lst = metricTbl.lst;
+
   ExprEval eval;
+  std::vector<ExprCode> formulaCode(numMetricsSrc);
+  std::vector<uint> formulaIds; // metrics with a valid formula
+
+  {
+    VarMap var_map(nodeFmt.metrics, m_lst, numMetricsSrc);
+    for (uint i = 0; i < numMetricsSrc; i++) {
+      char *expr = (char*) m_lst[i].formula;
+      if (expr == NULL || strlen(expr)==0) continue;
+
+      // a formula whose syntax is wrong never yields a value
+      if (eval.Compile(expr, &var_map, formulaCode[i])) {
+	formulaIds.push_back(i);
+      }
+    }
+  }
+
+  // Nodes are decoded straight from the file's bytes rather than
+  // through 'infs'
+  StreamInbuf in(infs);
 
   for (uint i = 0; i < numNodes; ++i) {
     // ----------------------------------------------------------
     // Read the node
     // ----------------------------------------------------------
-    ret = hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
+    if (in.inbuf()) {
+      ret = hpcrun_fmt_cct_node_inbuf_read(&nodeFmt, prof.m_flags, in.inbuf());
+    }
+    else {
+      ret = hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
+    }
     if (ret != HPCFMT_OK) {
       DIAG_Throw("Error reading CCT node " << nodeFmt.id);
     }
@@ -1482,24 +1976,16 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
       hpcrun_fmt_cct_node_fprint(&nodeFmt, outfs, prof.m_flags,
 				 &metricTbl, "  ");
     }
-    // ------------------------------------------
-    // check if the metric contains a formula
-    //  if this is the case, we'll compute the metric based on the formula
-    //  given by hpcrun.
-    // FIXME: we don't check the validity of the formula (yet).
-    //        If hpcrun has incorrect formula, the result can be anything
-    // ------------------------------------------
-    metric_desc_t* m_lst = metricTbl.lst;
-    VarMap var_map(nodeFmt.metrics, m_lst, numMetricsSrc);
-
-    for (uint i = 0; i < numMetricsSrc; i++) {
-      char *expr = (char*) m_lst[i].formula;
-      if (expr == NULL || strlen(expr)==0) continue;
-
-      double res = eval.Eval(expr, &var_map);
-      if (eval.GetErr() == EEE_NO_ERROR) {
-        // the formula syntax looks "correct". Update the the metric value
-      	hpcrun_fmt_metric_set_value(m_lst[i], &nodeFmt.metrics[i], res);
+    if (!formulaIds.empty()) {
+      VarMap var_map(nodeFmt.metrics, m_lst, numMetricsSrc);
+
+      for (uint k = 0; k < formulaIds.size(); k++) {
+	uint i = formulaIds[k];
+	double res = eval.Eval(formulaCode[i], &var_map);
+	if (eval.GetErr() == EEE_NO_ERROR) {
+	  // the formula syntax looks "correct". Update the the metric value
+	  hpcrun_fmt_metric_set_value(m_lst[i], &nodeFmt.metrics[i], res);
+	}
       }
     }
 
@@ -1546,7 +2032,48 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 	  DIAG_WMsg(2, ctxtStr << ": CCT (non-root) node " << nodeId << " has invalid normalized IP: " << node->nameDyn());
 	}
       }
+    }
 
+    if (mrgDst) {
+      // ----------------------------------------------------------
+      // Merge node into mrgDst's CCT
+      // ----------------------------------------------------------
+      CCT::Tree* x_cct = mrgDst->cct();
+      CCT::ANode* x_node = NULL;
+
+      bool isInsertOnly =
+	(node_parent && mrgInsertedIds.count(parentId) > 0);
+
+      if (!node_parent && node->isPrimarySynthRoot()) {
+	// cf. canonicalize(): a primary root corresponds to x's root
+	DIAG_AssertWarn(!node_sib, ctxtStr << ": CCT root cannot be split into interior and leaf!");
+	x_node = x_cct->root();
+	delete node;
+	delete node_sib;
+      }
+      else {
+	CCT::ANode* x_parent = (node_parent) ? node_parent : x_cct->root();
+	bool isInserted = false;
+
+	cct_fixLMIds(node, lmMrgEffects);
+	x_node = x_cct->mergeNode(x_parent, node, x_newMetricBegIdx,
+				  isInsertOnly, isInserted);
+	if (isInserted) {
+	  mrgInsertedIds.insert(nodeFmt.id);
+	}
+
+	if (node_sib) {
+	  cct_fixLMIds(node_sib, lmMrgEffects);
+	  x_cct->mergeNode(x_parent, node_sib, x_newMetricBegIdx,
+			   isInsertOnly, isInserted);
+	}
+      }
+
+      cctNodeMap.insert(std::make_pair(nodeFmt.id, x_node));
+      continue;
+    }
+
+    if (node_parent) {
       node->link(node_parent);
       if (node_sib) {
 	node_sib->link(node_parent);
@@ -1561,6 +2088,15 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     cctNodeMap.insert(std::make_pair(nodeFmt.id, node));
   }
 
+  if (mrgDst) {
+    mrgDst->merge_info(prof);
+
+    // carry over the load modules marked as used while making nodes
+    std::vector<LoadMap::MergeEffect>* mrgEffects =
+      mrgDst->m_loadmap->merge(*prof.loadmap());
+    delete mrgEffects;
+  }
+
   if (outfs) {
     fprintf(outfs, "]\n");
   }
@@ -1749,6 +2285,270 @@ Profile::fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags)
 }
 
 
+//***************************************************************************
+// hpcprof-cctdb
+//***************************************************************************
+
+typedef std::map<std::string, uint32_t> CCTDBStrMap;
+
+static uint32_t
+cctdb_internStr(CCTDBStrMap& strMap, std::vector<const std::string*>& strTbl,
+		const std::string& str)
+{
+  std::pair<CCTDBStrMap::iterator, bool> ret =
+    strMap.insert(std::make_pair(str, (uint32_t)strTbl.size()));
+  if (ret.second) {
+    strTbl.push_back(&(ret.first->first));
+  }
+  return ret.first->second;
+}
+
+
+// cctdb_makeNames: record the load module, file and procedure names of
+// 'n'.  Procedure frames always have names (the 'unknown' names if they
+// have no structure); other nodes have the names their structure or
+// load module provides.
+static void
+cctdb_makeNames(const Prof::CCT::ANode* n, const Prof::LoadMap& loadmap,
+		hpccctDB_fmt_node_t& x,
+		CCTDBStrMap& strMap, std::vector<const std::string*>& strTbl)
+{
+  using namespace Prof;
+
+  const CCT::AProcNode* n_proc = dynamic_cast<const CCT::AProcNode*>(n);
+  const CCT::ADynNode* n_dyn = dynamic_cast<const CCT::ADynNode*>(n);
+  const Struct::ACodeNode* strct = n->structure();
+
+  if (n_proc) {
+    if (strct) {
+      if (n_proc->isAlien()) {
+	x.flags |= HPCCCTDB_FMT_NodeFlg_Alien;
+      }
+      x.lmStr   = cctdb_internStr(strMap, strTbl, n_proc->lmName());
+      x.fileStr = cctdb_internStr(strMap, strTbl, n_proc->fileName());
+      x.procStr = cctdb_internStr(strMap, strTbl, n_proc->procName());
+    }
+    else {
+      x.lmStr   = cctdb_internStr(strMap, strTbl, Struct::Tree::UnknownLMNm);
+      x.fileStr = cctdb_internStr(strMap, strTbl,
+				  Struct::Tree::UnknownFileNm);
+      x.procStr = cctdb_internStr(strMap, strTbl,
+				  Struct::Tree::UnknownProcNm);
+    }
+  }
+  else if (strct) {
+    const Struct::LM* lm = strct->ancestorLM();
+    if (lm) {
+      x.lmStr = cctdb_internStr(strMap, strTbl, lm->name());
+    }
+    const Struct::Alien* alien = strct->ancestorAlien();
+    const Struct::File* file = strct->ancestorFile();
+    if (alien) {
+      x.fileStr = cctdb_internStr(strMap, strTbl, alien->fileName());
+    }
+    else if (file) {
+      x.fileStr = cctdb_internStr(strMap, strTbl, file->name());
+    }
+  }
+  else if (n_dyn) {
+    LoadMap::LMId_t lmId = n_dyn->lmId();
+    if (lmId != LoadMap::LMId_NULL && lmId <= loadmap.size()) {
+      x.lmStr = cctdb_internStr(strMap, strTbl, loadmap.lm(lmId)->name());
+    }
+  }
+}
+
+
+// cctdb_makeNodes: fill the node table (indexed by dense preorder id)
+// for the subtree rooted at 'n' and return one past its largest id.
+static uint32_t
+cctdb_makeNodes(const Prof::CCT::ANode* n, const Prof::LoadMap& loadmap,
+		std::vector<hpccctDB_fmt_node_t>& nodeTbl,
+		std::vector<const Prof::CCT::ANode*>& nodeVec,
+		CCTDBStrMap& strMap, std::vector<const std::string*>& strTbl)
+{
+  using namespace Prof;
+
+  uint32_t id = n->id();
+  DIAG_Assert(id > 0 && id < nodeTbl.size(), "cctdb_makeNodes: node id "
+	      << id << " is not a dense preorder id");
+
+  hpccctDB_fmt_node_t& x = nodeTbl[id];
+  memset(&x, 0, sizeof(x));
+  nodeVec[id] = n;
+
+  x.parent = (n->parent()) ? n->parent()->id() : 0;
+  x.type = n->type();
+  x.structId = (n->structure()) ? n->structure()->id() : 0;
+  x.line = n->begLine();
+
+  const CCT::ADynNode* n_dyn = dynamic_cast<const CCT::ADynNode*>(n);
+  if (n_dyn && hpcrun_fmt_doRetainId(n_dyn->cpId())) {
+    x.cpId = n_dyn->cpId();
+  }
+
+  if (n->type() == CCT::ANode::TyRoot) {
+    const CCT::Root* n_root = static_cast<const CCT::Root*>(n);
+    x.procStr = cctdb_internStr(strMap, strTbl, n_root->name());
+  }
+  else {
+    cctdb_makeNames(n, loadmap, x, strMap, strTbl);
+  }
+
+  uint32_t subtreeEnd = id + 1;
+  for (CCT::ANodeChildIterator it(n); it.Current(); ++it) {
+    uint32_t end = cctdb_makeNodes(it.current(), loadmap, nodeTbl, nodeVec,
+				   strMap, strTbl);
+    subtreeEnd = std::max(subtreeEnd, end);
+  }
+  x.subtreeEnd = subtreeEnd;
+  return subtreeEnd;
+}
+
+
+static int
+cctdb_pad(uint64_t len, FILE* fs)
+{
+  static const char zeros[8] = { 0 };
+  uint64_t padLen = (8 - (len % 8)) % 8;
+  if (padLen > 0 && fwrite(zeros, 1, padLen, fs) != padLen) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+Profile::fmt_cctdb_fwrite(const Profile& prof, FILE* fs,
+			  uint metricBeg, uint metricEnd)
+{
+  int ret;
+
+  // ------------------------------------------------------------
+  // Gather nodes (by dense preorder id) and the string table
+  // ------------------------------------------------------------
+
+  // N.B.: assumes CCT::Tree::makeDensePreorderIds() has been called
+  uint32_t numNodes = prof.cct()->maxDenseId() + 1;
+
+  std::vector<hpccctDB_fmt_node_t> nodeTbl(numNodes);
+  std::vector<const CCT::ANode*> nodeVec(numNodes, NULL);
+  memset(&nodeTbl[0], 0, sizeof(hpccctDB_fmt_node_t));
+
+  CCTDBStrMap strMap;
+  std::vector<const std::string*> strTbl;
+  cctdb_internStr(strMap, strTbl, ""); // string 0
+
+  cctdb_makeNodes(prof.cct()->root(), *prof.loadmap(), nodeTbl, nodeVec,
+		  strMap, strTbl);
+
+  uint32_t numStrings = strTbl.size();
+  uint64_t strDataLen = 0;
+  for (uint i = 0; i < numStrings; ++i) {
+    strDataLen += strTbl[i]->length() + 1;
+  }
+
+  // ------------------------------------------------------------
+  // Count non-zero metric values (compressed sparse rows)
+  // ------------------------------------------------------------
+
+  metricEnd = std::min(metricEnd, (uint)prof.metricMgr()->size());
+  metricBeg = std::min(metricBeg, metricEnd);
+
+  std::vector<uint64_t> rows(numNodes + 1, 0);
+  for (uint32_t id = 0; id < numNodes; ++id) {
+    uint64_t nnz = 0;
+    const CCT::ANode* n = nodeVec[id];
+    if (n && n->hasMetrics(metricBeg, metricEnd)) {
+      for (uint mId = metricBeg; mId < metricEnd; ++mId) {
+	if (n->hasMetric(mId)) {
+	  nnz++;
+	}
+      }
+    }
+    rows[id + 1] = rows[id] + nnz;
+  }
+  uint64_t numNonZeros = rows[numNodes];
+
+  // ------------------------------------------------------------
+  // Write header
+  // ------------------------------------------------------------
+
+  hpccctDB_fmt_hdr_t hdr;
+  hdr.numNodes    = numNodes;
+  hdr.numStrings  = numStrings;
+  hdr.metricBegId = metricBeg;
+  hdr.metricEndId = metricEnd;
+  hdr.numNonZeros = numNonZeros;
+
+  hdr.nodeTblOff   = HPCCCTDB_FMT_HeaderLen;
+  hdr.strIdxOff    = hdr.nodeTblOff + (uint64_t)numNodes * HPCCCTDB_FMT_NodeLen;
+  hdr.strDataOff   = hdr.strIdxOff + (uint64_t)(numStrings + 1) * 8;
+  hdr.metricRowOff = hdr.strDataOff + strDataLen + ((8 - (strDataLen % 8)) % 8);
+  hdr.metricValOff = hdr.metricRowOff + (uint64_t)(numNodes + 1) * 8;
+  hdr.metricColOff = hdr.metricValOff + numNonZeros * 8;
+
+  ret = hpccctDB_fmt_hdr_fwrite(&hdr, fs);
+  if (ret != HPCFMT_OK) return HPCFMT_ERR;
+
+  // ------------------------------------------------------------
+  // Write node table and strings
+  // ------------------------------------------------------------
+
+  for (uint32_t id = 0; id < numNodes; ++id) {
+    ret = hpccctDB_fmt_node_fwrite(&nodeTbl[id], fs);
+    if (ret != HPCFMT_OK) return HPCFMT_ERR;
+  }
+
+  uint64_t strOff = 0;
+  for (uint i = 0; i < numStrings; ++i) {
+    ret = hpcfmt_int8_fwrite(strOff, fs);
+    if (ret != HPCFMT_OK) return HPCFMT_ERR;
+    strOff += strTbl[i]->length() + 1;
+  }
+  ret = hpcfmt_int8_fwrite(strOff, fs);
+  if (ret != HPCFMT_OK) return HPCFMT_ERR;
+
+  for (uint i = 0; i < numStrings; ++i) {
+    const std::string& str = *strTbl[i];
+    if (fwrite(str.c_str(), 1, str.length() + 1, fs) != str.length() + 1) {
+      return HPCFMT_ERR;
+    }
+  }
+  ret = cctdb_pad(strDataLen, fs);
+  if (ret != HPCFMT_OK) return HPCFMT_ERR;
+
+  // ------------------------------------------------------------
+  // Write metric rows, values and columns
+  // ------------------------------------------------------------
+
+  for (uint32_t id = 0; id <= numNodes; ++id) {
+    ret = hpcfmt_int8_fwrite(rows[id], fs);
+    if (ret != HPCFMT_OK) return HPCFMT_ERR;
+  }
+
+  for (uint pass = 0; pass < 2; ++pass) {
+    for (uint32_t id = 0; id < numNodes; ++id) {
+      if (rows[id] == rows[id + 1]) {
+	continue;
+      }
+      const CCT::ANode* n = nodeVec[id];
+      for (uint mId = metricBeg; mId < metricEnd; ++mId) {
+	if (!n->hasMetric(mId)) {
+	  continue;
+	}
+	ret = (pass == 0) ?
+	  hpcfmt_real8_fwrite(n->metric(mId), fs) :
+	  hpcfmt_int4_fwrite(mId, fs);
+	if (ret != HPCFMT_OK) return HPCFMT_ERR;
+      }
+    }
+  }
+
+  return HPCFMT_OK;
+}
+
+
 //***************************************************************************
 
 // 1. Create a CCT::Root node for the CCT
@@ -1829,6 +2629,9 @@ Profile::canonicalize(uint rFlags)
   // ------------------------------------------------------------
 
   CCT::ANode* rootNew = new CCT::Root(m_name);
+  if (m_isSparseMetrics) {
+    rootNew->makeSparseMetrics();
+  }
   
   if (splicePoint) {
     for (CCT::ANodeChildIterator it(splicePoint); it.Current(); /* */) {
@@ -1943,7 +2746,7 @@ cct_makeNode(Prof::CallPath::Profile& prof,
     numMetricsDst = 0;
   }
 
-  Metric::IData metricData(numMetricsDst);
+  Metric::IData metricData(numMetricsDst, prof.isSparseMetrics());
   for (uint i_dst = 0, i_src = 0; i_dst < numMetricsDst; i_dst++) {
     Metric::ADesc* adesc = prof.metricMgr()->metric(i_dst);
     Metric::SampledDesc* mdesc = dynamic_cast<Metric::SampledDesc*>(adesc);
@@ -1961,7 +2764,7 @@ cct_makeNode(Prof::CallPath::Profile& prof,
 	DIAG_Die(DIAG_UnexpectedInput);
     }
 
-    metricData.metric(i_dst) = mval * (double)mdesc->period();
+    metricData.setMetric(i_dst, mval * (double)mdesc->period());
 
     if (!hpcrun_metricVal_isZero(m)) {
       hasMetrics = true;
@@ -98,7 +98,9 @@ class Profile
   : public Unique // non copyable
 {
 public:
-  Profile(const std::string name);
+  // N.B.: if 'isSparseMetrics', CCT nodes store their metrics in
+  // sparse form (cf. Metric::IData)
+  Profile(const std::string name, bool isSparseMetrics = false);
   virtual ~Profile();
   
   // -------------------------------------------------------
@@ -131,6 +133,22 @@ public:
   traceFileNameSet()
   { return m_traceFileNameSet; }
 
+  // rewrite the trace file of a profile merged with
+  // CCT::MrgFlg_DeferTraceFixY.  Distinct profiles may do this
+  // concurrently.
+  void
+  fixDeferredTrace();
+
+  // rewrite trace file 'traceFnm' into 'traceFnm.tmp', mapping each
+  // cpId through the dense table 'newId'
+  static void
+  fixTrace(const std::string& traceFnm, const std::vector<uint32_t>& newId);
+
+  // name of the call path id remap table for trace file 'traceFnm'
+  // (cf. CCT::MrgFlg_RemapTraceFileY)
+  static std::string
+  traceRemapFileName(const std::string& traceFnm);
+
   // enable/disable redundancy of procedure names
   // @param flag: true  -- redundancy is eliminated
   // 		  false -- redundancy is allowed
@@ -190,6 +208,13 @@ public:
   isMetricMgrVirtual(bool x)
   { m_isMetricMgrVirtual = x; }
 
+
+  // isSparseMetrics: whether CCT nodes store metrics in sparse form.
+  //   Fixed at construction (cf. RFlg_SparseMetrics).
+  bool
+  isSparseMetrics() const
+  { return m_isSparseMetrics; }
+
   // -------------------------------------------------------
   // LoadMap
   // -------------------------------------------------------
@@ -241,11 +266,14 @@ public:
 
   // merge: Given a Profile y, merge y into x = 'this'.  The 'mergeTy'
   //   parameter indicates how to merge y's metrics into x.  Returns
-  //   the index of the first merged metric in x.
+  //   the index of the first merged metric in x.  If 'mrgNodes' is
+  //   non-NULL, the CCT nodes of x changed by the merge are added to
+  //   it (cf. CCT::Tree::merge()).
   // ASSUMES: both x and y are in canonical form (canonicalize())
   // WARNING: the merge may change/destroy y
   uint
-  merge(Profile& y, int mergeTy, uint mrgFlag = 0);
+  merge(Profile& y, int mergeTy, uint mrgFlag = 0,
+	CCT::MergedNodeSet* mrgNodes = NULL);
 
   // -------------------------------------------------------
   //
@@ -271,6 +299,9 @@ public:
     // affects the normalizations applied to obtain a canonical CCT.
     RFlg_HpcrunData = (1 << 4),
 
+    // store CCT node metrics in sparse form (cf. Metric::IData)
+    RFlg_SparseMetrics = (1 << 5),
+
     // only write metric descriptors, even if CCT nodes have metrics
     WFlg_VirtualMetrics = (1 << 15)
   };
@@ -298,15 +329,29 @@ public:
   fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
 	    std::string ctxtStr, const char* filename, FILE* outfs);
 
+  // If 'mrgDst' is non-NULL, the profile is merged into 'mrgDst' (as
+  // with mrgDst->merge(prof, mergeTy)) while it is read: 'prof' only
+  // receives the metric table and load map, and each CCT node is
+  // merged into mrgDst's CCT as soon as it is decoded.  Perf event
+  // statistics are merged as well.
   static int
   fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
 		  const hpcrun_fmt_hdr_t& hdr,
-		  std::string ctxtStr, const char* filename, FILE* outfs);
+		  std::string ctxtStr, const char* filename, FILE* outfs,
+		  Profile* mrgDst = NULL, int mergeTy = Merge_MergeMetricByName);
 
   static int
   fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 		const metric_tbl_t& metricTbl,
-		std::string ctxtStr, FILE* outfs);
+		std::string ctxtStr, FILE* outfs,
+		Profile* mrgDst = NULL, int mergeTy = Merge_MergeMetricByName);
+
+  // fmt_freadMerge: Reads a profile from 'infs' and merges it into
+  // 'x' node by node, without building it (cf. fmt_epoch_fread()).
+  // ASSUMES: x is in canonical form
+  static int
+  fmt_freadMerge(Profile& x, FILE* infs, uint rFlags, int mergeTy,
+		 std::string ctxtStr);
 
 
   // fmt_*_fwrite(): Write the appropriate object as hpcrun_fmt to the
@@ -324,6 +369,13 @@ public:
   static int
   fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags);
 
+  // fmt_cctdb_fwrite: writes the CCT and the non-zero values of
+  // metrics [metricBeg, metricEnd) in hpcprof-cctdb format (cf.
+  // hpcrun-fmt.h).  Assumes the CCT has dense preorder ids.
+  static int
+  fmt_cctdb_fwrite(const Profile& prof, FILE* fs,
+		   uint metricBeg, uint metricEnd);
+
   // -------------------------------------------------------
   // Output
   // -------------------------------------------------------
@@ -352,6 +404,10 @@ private:
   void
   canonicalize(uint rFlags = 0);
 
+  // merge y's name, flags, etc.
+  void
+  merge_info(Profile& y);
+
   uint
   mergeMetrics(Profile& y, int mergeTy, uint& x_newMetricBegIdx);
 
@@ -359,8 +415,12 @@ private:
   void
   merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects);
 
+  // if 'defer', only compute the new cpIds (cf. fixDeferredTrace())
+  void
+  merge_fixTrace(const CCT::MergeEffectList* mrgEffects, bool defer = false);
+
   void
-  merge_fixTrace(const CCT::MergeEffectList* mrgEffects);
+  merge_writeTraceRemap(const CCT::MergeEffectList* mrgEffects);
 
 
 private:
@@ -373,6 +433,7 @@ private:
   StringSet m_directorySet; // set of directories containing profiles
 
   std::string m_traceFileName;   // non-empty, if relevant
+  std::vector<uint32_t> m_traceFixId; // deferred trace fix (cpId table)
   StringSet m_traceFileNameSet;
   uint64_t m_traceMinTime, m_traceMaxTime;
 
@@ -381,6 +442,7 @@ private:
 
   Metric::Mgr* m_mMgr;
   bool m_isMetricMgrVirtual;
+  bool m_isSparseMetrics;
 
   LoadMap* m_loadmap;
 
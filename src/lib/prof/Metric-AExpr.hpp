@@ -143,7 +143,7 @@ public:
   evalNF(Metric::IData& mdata) const
   {
     double z = eval(mdata);
-    accumVar(0, mdata) = z;
+    accumVar(0, mdata, z);
     return z;
   }
 
@@ -219,13 +219,17 @@ public:
   //
   // ------------------------------------------------------------
 
-  static double&
-  var(Metric::IData& mdata, uint mId)
-  { return mdata.demandMetric(mId); }
+  // var: assignment (cf. AExprIncr::var)
+  static double
+  var(Metric::IData& mdata, uint mId, double x)
+  {
+    mdata.setMetric(mId, x);
+    return x;
+  }
 
-  double&
-  accumVar(int i, Metric::IData& mdata) const
-  { return var(mdata, m_accumId[i]); }
+  double
+  accumVar(int i, Metric::IData& mdata, double x) const
+  { return var(mdata, m_accumId[i], x); }
 
 
   // ------------------------------------------------------------
@@ -313,8 +317,8 @@ protected:
     std::pair<double, double> z = evalSumSquares(mdata, opands, sz);
     double z1 = z.first;  // sum
     double z2 = z.second; // sum of squares
-    accumVar(0, mdata) = z1;
-    accumVar(1, mdata) = z2;
+    accumVar(0, mdata, z1);
+    accumVar(1, mdata, z2);
     return z1;
   }
 
@@ -829,7 +833,7 @@ public:
   evalNF(Metric::IData& mdata) const
   {
     double z = evalSum(mdata, m_opands, m_sz);
-    accumVar(0, mdata) = z;
+    accumVar(0, mdata, z);
     return z;
   }
 
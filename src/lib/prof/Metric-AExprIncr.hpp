@@ -202,9 +202,9 @@ public:
   accumVar(int i, const Metric::IData& mdata) const
   { return var(mdata, m_accumId[i]); }
 
-  double&
-  accumVar(int i, Metric::IData& mdata) const
-  { return var(mdata, m_accumId[i]); }
+  double
+  accumVar(int i, Metric::IData& mdata, double x) const
+  { return var(mdata, m_accumId[i], x); }
 
 
   // Metric::IDBExpr
@@ -225,9 +225,9 @@ public:
   srcVar(int i, const Metric::IData& mdata) const
   { return var(mdata, m_srcId[i]); }
 
-  double&
-  srcVar(int i, Metric::IData& mdata) const
-  { return var(mdata, m_srcId[i]); }
+  double
+  srcVar(int i, Metric::IData& mdata, double x) const
+  { return var(mdata, m_srcId[i], x); }
 
   std::string
   srcStr(int i) const
@@ -282,17 +282,22 @@ public:
 
 
   // ------------------------------------------------------------
-  // R- or L-Value of variable reference (cf. AExpr::Var)
+  // R-Value of variable reference (cf. AExpr::Var) and assignment.
+  //   N.B.: reads must not materialize absent sparse metrics, and
+  //   assignments of 0 leave a sparse metric absent (cf. IData).
   // ------------------------------------------------------------
 
-  static double&
-  var(Metric::IData& mdata, uint mId)
-  { return mdata.demandMetric(mId); }
-
   static double
   var(const Metric::IData& mdata, uint mId)
   { return mdata.demandMetric(mId); }
 
+  static double
+  var(Metric::IData& mdata, uint mId, double x)
+  {
+    mdata.setMetric(mId, x);
+    return x;
+  }
+
 
   // ------------------------------------------------------------
   //
@@ -311,8 +316,8 @@ public:
   double
   initializeStdDev(Metric::IData& mdata) const
   {
-    accumVar(0, mdata) = 0.0;
-    accumVar(1, mdata) = 0.0;
+    accumVar(0, mdata, 0.0);
+    accumVar(1, mdata, 0.0);
     return 0.0;
   }
 
@@ -320,9 +325,9 @@ public:
   double
   initializeSrcStdDev(Metric::IData& mdata) const
   {
-    srcVar(0, mdata) = 0.0;
+    srcVar(0, mdata, 0.0);
     if (isSetSrc(1)) {
-      srcVar(1, mdata) = 0.0;
+      srcVar(1, mdata, 0.0);
     }
     return 0.0;
   }
@@ -334,8 +339,8 @@ public:
     double a1 = accumVar(0, mdata), a2 = accumVar(1, mdata), s = srcVar(0, mdata);
     double z1 = a1 + s;       // running sum
     double z2 = a2 + (s * s); // running sum of squares
-    accumVar(0, mdata)  = z1;
-    accumVar(1, mdata) = z2;
+    accumVar(0, mdata, z1);
+    accumVar(1, mdata, z2);
     return z1;
   }
 
@@ -347,8 +352,8 @@ public:
     double s1 = srcVar(0, mdata), s2 = srcVar(1, mdata);
     double z1 = a1 + s1; // running sum
     double z2 = a2 + s2; // running sum of squares
-    accumVar(0, mdata)  = z1;
-    accumVar(1, mdata) = z2;
+    accumVar(0, mdata, z1);
+    accumVar(1, mdata, z2);
     return z1;
   }
 
@@ -366,8 +371,8 @@ public:
       double z2 = a2 / n;        // (sum of squares)/n
       sdev = sqrt(z2 - z1);      // stddev
 
-      accumVar(0, mdata) = sdev;
-      accumVar(1, mdata) = mean;
+      accumVar(0, mdata, sdev);
+      accumVar(1, mdata, mean);
     }
     return sdev;
   }
@@ -441,11 +446,11 @@ public:
 
   virtual double
   initialize(Metric::IData& mdata) const
-  { return (accumVar(0, mdata) = DBL_MIN /* sic; see above */); }
+  { return accumVar(0, mdata, DBL_MIN /* sic; see above */); }
 
   virtual double
   initializeSrc(Metric::IData& mdata) const
-  { return (srcVar(0, mdata) = DBL_MIN /* sic; see above */); }
+  { return srcVar(0, mdata, DBL_MIN /* sic; see above */); }
 
   virtual double
   accumulate(Metric::IData& mdata) const
@@ -456,7 +461,7 @@ public:
     // See comments above
     if (s != DBL_MIN && s != 0.0) {
       z = (a == DBL_MIN) ? s : std::min(a, s);
-      accumVar(0, mdata) = z;
+      accumVar(0, mdata, z);
     }
     DIAG_MsgIf(0, "MinIncr: min("<< a << ", " << s << ") = " << z);
 
@@ -518,11 +523,11 @@ public:
 
   virtual double
   initialize(Metric::IData& mdata) const
-  { return (accumVar(0, mdata) = 0.0); }
+  { return accumVar(0, mdata, 0.0); }
 
   virtual double
   initializeSrc(Metric::IData& mdata) const
-  { return (srcVar(0, mdata) = 0.0); }
+  { return srcVar(0, mdata, 0.0); }
 
   virtual double
   accumulate(Metric::IData& mdata) const
@@ -530,7 +535,7 @@ public:
     double a = accumVar(0, mdata), s = srcVar(0, mdata);
     double z = std::max(a, s);
     DIAG_MsgIf(0, "MaxIncr: max("<< a << ", " << s << ") = " << z);
-    accumVar(0, mdata) = z;
+    accumVar(0, mdata, z);
     return z;
   }
 
@@ -589,11 +594,11 @@ public:
 
   virtual double
   initialize(Metric::IData& mdata) const
-  { return (accumVar(0, mdata) = 0.0); }
+  { return accumVar(0, mdata, 0.0); }
 
   virtual double
   initializeSrc(Metric::IData& mdata) const
-  { return (srcVar(0, mdata) = 0.0); }
+  { return srcVar(0, mdata, 0.0); }
 
   virtual double
   accumulate(Metric::IData& mdata) const
@@ -601,7 +606,7 @@ public:
     double a = accumVar(0, mdata), s = srcVar(0, mdata);
     double z = a + s;
     DIAG_MsgIf(0, "SumIncr: +("<< a << ", " << s << ") = " << z);
-    accumVar(0, mdata) = z;
+    accumVar(0, mdata, z);
     return z;
   }
 
@@ -660,11 +665,11 @@ public:
 
   virtual double
   initialize(Metric::IData& mdata) const
-  { return (accumVar(0, mdata) = 0.0); }
+  { return accumVar(0, mdata, 0.0); }
 
   virtual double
   initializeSrc(Metric::IData& mdata) const
-  { return (srcVar(0, mdata) = 0.0); }
+  { return srcVar(0, mdata, 0.0); }
 
   virtual double
   accumulate(Metric::IData& mdata) const
@@ -672,7 +677,7 @@ public:
     double a = accumVar(0, mdata), s = srcVar(0, mdata);
     double z = a + s;
     DIAG_MsgIf(0, "MeanIncr: +("<< a << ", " << s << ") = " << z);
-    accumVar(0, mdata) = z;
+    accumVar(0, mdata, z);
     return z;
   }
 
@@ -688,7 +693,7 @@ public:
     if (numSrc(mdata) > 0) {
       double n = numSrc(mdata);
       z = a / n;
-      accumVar(0, mdata) = z;
+      accumVar(0, mdata, z);
     }
     return z;
   }
@@ -844,7 +849,7 @@ public:
     if (mean > epsilon) {
       z = sdev / mean;
     }
-    accumVar(0, mdata) = z;
+    accumVar(0, mdata, z);
     return z;
   }
 
@@ -930,7 +935,7 @@ public:
     if (mean > epsilon) {
       z = (sdev / mean) * 100;
     }
-    accumVar(0, mdata) = z;
+    accumVar(0, mdata, z);
     return z;
   }
 
@@ -995,7 +1000,7 @@ public:
   virtual double
   initialize(Metric::IData& mdata) const
   {
-    double z = accumVar(0, mdata) = numSrcFxd();
+    double z = accumVar(0, mdata, numSrcFxd());
     return z;
   }
 
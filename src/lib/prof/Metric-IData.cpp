@@ -90,6 +90,39 @@ namespace Metric {
 // IData
 //***************************************************************************
 
+void
+IData::makeSparseMetrics()
+{
+  if (m_sparse) {
+    return;
+  }
+
+  m_sparse = new SparseMetrics;
+  m_sparse->size = m_metrics.size();
+  for (uint i = 0; i < m_metrics.size(); ++i) {
+    if (m_metrics[i] != 0.0) {
+      m_sparse->vals.push_back(SparseMetric(i, m_metrics[i]));
+    }
+  }
+  MetricVec().swap(m_metrics);
+}
+
+
+void
+IData::makeDenseMetrics()
+{
+  DIAG_Assert(isSparseForm(), "IData::makeDenseMetrics: not sparse");
+
+  m_metrics.assign(m_sparse->size, 0.0);
+  for (SparseMetricVec::const_iterator it = m_sparse->vals.begin();
+       it != m_sparse->vals.end(); ++it) {
+    m_metrics[it->first] = it->second;
+  }
+  SparseMetricVec().swap(m_sparse->vals);
+  m_sparse->isDense = true;
+}
+
+
 std::string
 IData::toStringMetrics(int oFlags, const char* pfx) const
 {
@@ -110,14 +143,13 @@ IData::writeMetricsXML(std::ostream& os, uint mBegId, uint mEndId,
   }
   mEndId = std::min(numMetrics(), mEndId);
 
-  for (uint i = mBegId; i < mEndId; i++) {
-    if (hasMetric(i)) {
-      double m = metric(i);
-      os << ((!wasMetricWritten) ? pfx : "");
-      os << "<M " << "n" << xml::MakeAttrNum(i) 
-	 << " v" << xml::MakeAttrNum(m) << "/>";
-      wasMetricWritten = true;
-    }
+  for (uint i = nextMetric(mBegId, mEndId); i != IData::npos;
+       i = nextMetric(i + 1, mEndId)) {
+    double m = metric(i);
+    os << ((!wasMetricWritten) ? pfx : "");
+    os << "<M " << "n" << xml::MakeAttrNum(i) 
+       << " v" << xml::MakeAttrNum(m) << "/>";
+    wasMetricWritten = true;
   }
 
   return os;
@@ -66,6 +66,7 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 
 #include <typeinfo>
 #include <algorithm>
@@ -95,6 +96,24 @@ namespace Metric {
 // Optimized for the two expected common cases:
 //   1. no metrics (hpcstruct's using Prof::Struct::Tree)
 //   2. a known number of metrics (which may then be expanded)
+//
+// Metrics are stored either densely (a vector indexed by metric id)
+// or sparsely (a vector of (metric id, value) pairs sorted by id).
+// The sparse form is meant for CCTs with many metric columns that are
+// mostly zero (e.g., hpcprof-mpi's thread-level and summary metrics)
+// and is selected when the IData is created (cf. CallPath::Profile).
+// Both forms present the same interface: an absent value reads as 0.
+//
+// Values are usually inserted in increasing id order, which appends
+// in constant time.  To bound the cost of the remaining (sorted)
+// insertions, a sparse IData that fills up past the point where it
+// uses more memory than a dense vector switches to dense storage.  It
+// keeps its sparse policy: isSparseMetrics() still holds and
+// clearMetrics() returns it to the sparse form.
+//
+// N.B.: In the sparse form, a reference returned by the non-const
+// metric() or demandMetric() may be invalidated by the next insertion
+// into the same IData; prefer setMetric() for plain assignments.
 //***************************************************************************
 
 class IData {
@@ -102,28 +121,41 @@ public:
   
   typedef std::vector<double> MetricVec;
 
+  typedef std::pair<uint, double> SparseMetric;
+  typedef std::vector<SparseMetric> SparseMetricVec;
+
 public:
   // --------------------------------------------------------
   // Create/Destroy
   // --------------------------------------------------------
-  IData(size_t size = 0)
+  IData(size_t size = 0, bool isSparse = false)
+    : m_sparse(NULL)
   {
+    if (isSparse) {
+      m_sparse = new SparseMetrics;
+    }
     ensureMetricsSize(size);
   }
 
   virtual ~IData()
   {
+    delete m_sparse;
   }
   
   IData(const IData& x)
-    : m_metrics(x.m_metrics)
+    : m_metrics(x.m_metrics),
+      m_sparse((x.m_sparse) ? new SparseMetrics(*x.m_sparse) : NULL)
   {
   }
   
   IData&
   operator=(const IData& x)
   {
-    m_metrics = x.m_metrics;
+    if (this != &x) {
+      m_metrics = x.m_metrics;
+      delete m_sparse;
+      m_sparse = (x.m_sparse) ? new SparseMetrics(*x.m_sparse) : NULL;
+    }
     return *this;
   }
 
@@ -140,32 +172,68 @@ public:
     if (mBegId == IData::npos) {
       mBegId = 0;
     }
-    mEndId = std::min(numMetrics(), mEndId);
-
-    for (uint i = mBegId; i < mEndId; ++i) {
-      if (hasMetric(i)) {
-	return true;
-      }
-    }
-    return false;
+    return (nextMetric(mBegId, mEndId) != IData::npos);
   }
 
   bool
   hasMetric(size_t mId) const
-  { return (m_metrics[mId] != 0.0); }
+  {
+    if (isSparseForm()) {
+      const double* x = findSparseMetric(mId);
+      return (x && *x != 0.0);
+    }
+    return (m_metrics[mId] != 0.0);
+  }
 
   bool
   hasMetricSlow(size_t mId) const
-  { return (mId < m_metrics.size() && hasMetric(mId)); }
+  { return (mId < numMetrics() && hasMetric(mId)); }
+
+
+  // nextMetric: returns the smallest id in [mId, mEndId) with a
+  // non-zero value or npos if there is none.  Use to visit the
+  // non-zero metrics of a range; the sparse form skips absent values.
+  uint
+  nextMetric(uint mId, uint mEndId = Metric::IData::npos) const
+  {
+    mEndId = std::min(numMetrics(), mEndId);
+    if (isSparseForm()) {
+      SparseMetricVec::const_iterator it = sparseLowerBound(mId);
+      for ( ; it != m_sparse->vals.end() && it->first < mEndId; ++it) {
+	if (it->second != 0.0) {
+	  return it->first;
+	}
+      }
+      return IData::npos;
+    }
+
+    for (uint i = mId; i < mEndId; ++i) {
+      if (m_metrics[i] != 0.0) {
+	return i;
+      }
+    }
+    return IData::npos;
+  }
 
 
   double
   metric(size_t mId) const
-  { return m_metrics[mId]; }
+  {
+    if (isSparseForm()) {
+      const double* x = findSparseMetric(mId);
+      return (x) ? *x : 0.0;
+    }
+    return m_metrics[mId];
+  }
 
   double&
   metric(size_t mId)
-  { return m_metrics[mId]; }
+  {
+    if (isSparseForm()) {
+      return demandSparseMetric(mId);
+    }
+    return m_metrics[mId];
+  }
 
 
   double
@@ -185,13 +253,61 @@ public:
   }
 
 
+  // setMetric: demandMetric(mId, size) = x, except that the sparse
+  // form does not store zeros
+  void
+  setMetric(size_t mId, double x, size_t size = 0)
+  {
+    size_t sz = std::max(size, mId+1);
+    ensureMetricsSize(sz);
+    if (isSparseForm() && x == 0.0) {
+      SparseMetricVec::iterator it = sparseLowerBound(mId);
+      if (it != m_sparse->vals.end() && it->first == mId) {
+	m_sparse->vals.erase(it);
+      }
+      return;
+    }
+    metric(mId) = x;
+  }
+
+
+  // addMetric: demandMetric(mId, size) += x, except that the sparse
+  // form neither materializes an absent value for x == 0 nor keeps a
+  // sum that cancels to 0
+  void
+  addMetric(size_t mId, double x, size_t size = 0)
+  {
+    if (isSparseForm()) {
+      if (x != 0.0) {
+	double& z = demandSparseMetric(mId);
+	z += x;
+	if (z == 0.0 && isSparseForm()) {
+	  m_sparse->vals.erase(sparseLowerBound(mId));
+	}
+      }
+      ensureMetricsSize(std::max(size, mId+1));
+      return;
+    }
+    demandMetric(mId, size) += x;
+  }
+
+
   // zeroMetrics: takes bounds of the form [mBegId, mEndId)
   // N.B.: does not have demandZeroMetrics() semantics
   void
   zeroMetrics(uint mBegId, uint mEndId)
   {
+    if (isSparseForm()) {
+      if (mBegId < mEndId) {
+	m_sparse->vals.erase(sparseLowerBound(mBegId),
+			     sparseLowerBound(mEndId));
+      }
+      return;
+    }
+
+    mEndId = std::min(mEndId, (uint)m_metrics.size());
     for (uint i = mBegId; i < mEndId; ++i) {
-      metric(i) = 0.0;
+      m_metrics[i] = 0.0;
     }
   }
 
@@ -199,26 +315,61 @@ public:
   void
   clearMetrics()
   {
-    m_metrics.clear();;
+    if (m_sparse) {
+      MetricVec().swap(m_metrics);
+      m_sparse->vals.clear();
+      m_sparse->size = 0;
+      m_sparse->isDense = false;
+    }
+    else {
+      m_metrics.clear();
+    }
   }
 
   // ensureMetricsSize: ensures a vector of the requested size exists
   void
   ensureMetricsSize(size_t size) const
   {
-    if (size > m_metrics.size())
+    if (isSparseForm()) {
+      m_sparse->size = std::max(m_sparse->size, (uint)size);
+    }
+    else if (size > m_metrics.size()) {
       m_metrics.resize(size, 0.0 /*value*/); // inserts at end
+    }
   }
 
   void
   insertMetricsBefore(size_t numMetrics) 
   {
+    if (isSparseForm()) {
+      for (SparseMetricVec::iterator it = m_sparse->vals.begin();
+	   it != m_sparse->vals.end(); ++it) {
+	it->first += numMetrics;
+      }
+      m_sparse->size += numMetrics;
+      return;
+    }
     m_metrics.insert(m_metrics.begin(), numMetrics, 0.0);
   }
   
   uint
   numMetrics() const
-  { return m_metrics.size(); }
+  { return (isSparseForm()) ? m_sparse->size : m_metrics.size(); }
+
+
+  // --------------------------------------------------------
+  // Storage form
+  // --------------------------------------------------------
+
+  // isSparseMetrics: whether the IData uses the sparse policy (even if
+  // it has since switched to dense storage)
+  bool
+  isSparseMetrics() const
+  { return (m_sparse != NULL); }
+
+  // makeSparseMetrics: converts to the sparse form (if necessary)
+  void
+  makeSparseMetrics();
 
 
   // --------------------------------------------------------
@@ -245,8 +396,78 @@ public:
   ddumpMetrics() const;
 
   
+private:
+  struct SparseMetrics {
+    SparseMetrics()
+      : size(0), isDense(false)
+    { }
+
+    uint size;            // cf. numMetrics()
+    SparseMetricVec vals; // sorted by metric id
+    bool isDense;         // values have moved to m_metrics
+
+    static const uint MinDenseVals = 32;
+  };
+
+  bool
+  isSparseForm() const
+  { return (m_sparse && !m_sparse->isDense); }
+
+  // makeDenseMetrics: moves sparse values to m_metrics (keeps policy)
+  void
+  makeDenseMetrics();
+
+  static bool
+  lt_sparseId(const SparseMetric& x, uint mId)
+  { return (x.first < mId); }
+
+  SparseMetricVec::iterator
+  sparseLowerBound(uint mId) const
+  {
+    return std::lower_bound(m_sparse->vals.begin(), m_sparse->vals.end(),
+			    mId, lt_sparseId);
+  }
+
+  const double*
+  findSparseMetric(size_t mId) const
+  {
+    SparseMetricVec::iterator it = sparseLowerBound(mId);
+    if (it != m_sparse->vals.end() && it->first == mId) {
+      return &(it->second);
+    }
+    return NULL;
+  }
+
+  double&
+  demandSparseMetric(size_t mId)
+  {
+    ensureMetricsSize(mId + 1);
+    SparseMetricVec& vals = m_sparse->vals;
+    SparseMetricVec::iterator it;
+    if (vals.empty() || vals.back().first < mId) {
+      it = vals.insert(vals.end(), SparseMetric(mId, 0.0)); // common case
+    }
+    else {
+      it = sparseLowerBound(mId);
+      if (it->first == mId) {
+	return it->second;
+      }
+      it = vals.insert(it, SparseMetric(mId, 0.0));
+    }
+
+    // switch to dense storage once it is the smaller one (a pair is
+    // twice the size of a double); small sets are cheap to insert into
+    if (vals.size() > SparseMetrics::MinDenseVals
+	&& 2 * vals.size() > m_sparse->size) {
+      makeDenseMetrics();
+      return m_metrics[mId];
+    }
+    return it->second;
+  }
+
 private:
   mutable MetricVec m_metrics;
+  SparseMetrics* m_sparse; // non-NULL iff the sparse policy is used
 };
 
 //***************************************************************************
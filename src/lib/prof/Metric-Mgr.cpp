@@ -202,16 +202,32 @@ Mgr::makeSummaryMetrics(bool needAllStats, bool needMultiOccurance,
 void
 Mgr::mergePerfEventStatistics(Mgr *source)
 {
+  PerfEventStatistics stats;
+  source->perfEventStatistics(stats);
+  mergePerfEventStatistics(stats);
+}
+
+
+void
+Mgr::perfEventStatistics(PerfEventStatistics& stats) const
+{
+  stats.resize(m_metrics.size());
+  for (uint i = 0; i < m_metrics.size(); i++) {
+    const Prof::Metric::ADesc *m = m_metrics[i];
+    stats[i] = std::make_pair(m->num_samples(), m->periodMean());
+  }
+}
 
 
-  for (uint i=0; i<source->size(); i++) {
+void
+Mgr::mergePerfEventStatistics(const PerfEventStatistics& stats)
+{
+  for (uint i=0; i<stats.size(); i++) {
 
     Prof::Metric::ADesc *m = metric(i);
 
-    uint64_t samples = m->num_samples() +
-        source->metric(i)->num_samples();
-    uint64_t period  = m->periodMean() +
-        source->metric(i)->periodMean();
+    uint64_t samples = m->num_samples() + stats[i].first;
+    uint64_t period  = m->periodMean()  + stats[i].second;
 
     m->num_samples(samples);
     m->periodMean (period);
@@ -54,6 +54,7 @@
 #include <list>
 #include <vector>
 #include <map>
+#include <utility>
 
 #include <climits>
 
@@ -231,6 +232,19 @@ public:
   void
   mergePerfEventStatistics(Mgr *source);
 
+  // snapshot of the perf event statistics (num_samples, periodMean)
+  // of each metric; a snapshot may be taken right after a profile is
+  // read and replayed later, so that a reader that merges profiles
+  // out of order (hpcprof -j) sums the statistics exactly as the
+  // sequential reader does.
+  typedef std::vector<std::pair<uint64_t, float> > PerfEventStatistics;
+
+  void
+  perfEventStatistics(PerfEventStatistics& stats) const;
+
+  void
+  mergePerfEventStatistics(const PerfEventStatistics& stats);
+
   void
   mergePerfEventStatistics_finalize(int num_profiles);
 
@@ -0,0 +1,217 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Round-trip test for the hpcprof-cctdb format (experiment.cctdb).
+//
+// Description:
+//   Writes a small canonical CCT with Profile::fmt_cctdb_fwrite and
+//   checks what the hpccctDB_* mapped reader decodes from it.
+//
+//***************************************************************************
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <lib/prof/CallPath-Profile.hpp>
+#include <lib/prof/CCT-Tree.hpp>
+#include <lib/prof/LoadMap.hpp>
+#include <lib/prof/Metric-ADesc.hpp>
+#include <lib/prof/Metric-IData.hpp>
+#include <lib/prof/Metric-Mgr.hpp>
+
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include "UnitTests.hpp"
+
+using namespace Prof;
+
+
+static CCT::ADynNode*
+makeNode(CCT::ANode* parent, bool isCall, uint cpId, LoadMap::LMId_t lmId,
+	 VMA ip, double m0, double m1)
+{
+  Metric::IData metrics(2);
+  metrics.setMetric(0, m0);
+  metrics.setMetric(1, m1);
+  if (isCall) {
+    return new CCT::Call(parent, cpId, lush_assoc_info_NULL, lmId, ip, 0,
+			 NULL, metrics);
+  }
+  return new CCT::Stmt(parent, cpId, lush_assoc_info_NULL, lmId, ip, 0,
+		       NULL, metrics);
+}
+
+
+static void
+checkRow(const hpccctDB_t* db, uint32_t id, uint32_t mId, double mVal)
+{
+  uint64_t beg = 0, end = 0;
+  UT_CHECK(hpccctDB_metricRow(db, id, &beg, &end) == HPCFMT_OK);
+  UT_CHECK(end == beg + 1);
+  if (end == beg + 1) {
+    uint32_t x_mId = 0;
+    double x_mVal = 0.0;
+    hpccctDB_metric(db, beg, &x_mId, &x_mVal);
+    UT_CHECK(x_mId == mId);
+    UT_CHECK(x_mVal == mVal);
+  }
+}
+
+
+void
+cctDBTest()
+{
+  // ------------------------------------------------------------
+  // root -+- a (call, lm1) -+- b (stmt, lm1, cpId 7, m0 = 3)
+  //       |                 \- c (stmt, lm2, cpId 9, m1 = 5)
+  //       \- d (call, lm2)
+  // ------------------------------------------------------------
+  CallPath::Profile* prof = CallPath::Profile::make(0);
+
+  for (uint i = 0; i < 2; ++i) {
+    std::string nm = "m" + std::to_string(i);
+    Metric::SampledDesc* m =
+      new Metric::SampledDesc(nm, nm, 1, true, "", "", "HPCRUN");
+    prof->metricMgr()->insert(m);
+  }
+
+  LoadMap::LM* lm1 = new LoadMap::LM("/lib/a.so");
+  LoadMap::LM* lm2 = new LoadMap::LM("/lib/b.so");
+  prof->loadmap()->lm_insert(lm1);
+  prof->loadmap()->lm_insert(lm2);
+
+  CCT::ANode* root = prof->cct()->root();
+  CCT::ADynNode* a = makeNode(root, true, 0, lm1->id(), 0x100, 0.0, 0.0);
+  CCT::ADynNode* b = makeNode(a, false, 7, lm1->id(), 0x104, 3.0, 0.0);
+  CCT::ADynNode* c = makeNode(a, false, 9, lm2->id(), 0x200, 0.0, 5.0);
+  CCT::ADynNode* d = makeNode(root, true, 0, lm2->id(), 0x300, 0.0, 0.0);
+
+  uint maxId = prof->cct()->makeDensePreorderIds();
+  UT_CHECK(maxId == 5);
+
+  // ------------------------------------------------------------
+  // write
+  // ------------------------------------------------------------
+  char fnm[] = "/tmp/hpcprof-cctdb-testXXXXXX";
+  int fd = mkstemp(fnm);
+  UT_CHECK(fd >= 0);
+  if (fd < 0) {
+    delete prof;
+    return;
+  }
+  FILE* fs = fdopen(fd, "w");
+  UT_CHECK(CallPath::Profile::fmt_cctdb_fwrite(*prof, fs, 0, 2)
+	   == HPCFMT_OK);
+  fclose(fs);
+
+  // ------------------------------------------------------------
+  // read
+  // ------------------------------------------------------------
+  hpccctDB_t db;
+  UT_CHECK(hpccctDB_open(&db, fnm) == HPCFMT_OK);
+
+  UT_CHECK(db.hdr.numNodes == maxId + 1);
+  UT_CHECK(db.hdr.metricBegId == 0 && db.hdr.metricEndId == 2);
+  UT_CHECK(db.hdr.numNonZeros == 2);
+
+  CCT::ANode* nodes[] = { root, a, b, c, d };
+  CCT::ANode* subtreeLast[] = { d, c, b, c, d };
+  for (uint i = 0; i < 5 && db.hdr.numNodes == maxId + 1; ++i) {
+    CCT::ANode* n = nodes[i];
+    hpccctDB_fmt_node_t x;
+    UT_CHECK(hpccctDB_node(&db, n->id(), &x) == HPCFMT_OK);
+    UT_CHECK(x.parent == ((n->parent()) ? n->parent()->id() : 0));
+    UT_CHECK(x.subtreeEnd == subtreeLast[i]->id() + 1);
+    UT_CHECK(x.type == (uint32_t)n->type());
+  }
+
+  hpccctDB_fmt_node_t x;
+  UT_CHECK(hpccctDB_node(&db, root->id(), &x) == HPCFMT_OK);
+  UT_CHECK(strcmp(hpccctDB_str(&db, x.procStr), "[program-name]") == 0);
+
+  UT_CHECK(hpccctDB_node(&db, b->id(), &x) == HPCFMT_OK);
+  UT_CHECK(x.cpId == 7);
+  UT_CHECK(strcmp(hpccctDB_str(&db, x.lmStr), "/lib/a.so") == 0);
+
+  UT_CHECK(hpccctDB_node(&db, c->id(), &x) == HPCFMT_OK);
+  UT_CHECK(x.cpId == 9);
+  UT_CHECK(strcmp(hpccctDB_str(&db, x.lmStr), "/lib/b.so") == 0);
+
+  checkRow(&db, b->id(), 0, 3.0);
+  checkRow(&db, c->id(), 1, 5.0);
+
+  CCT::ANode* noMetrics[] = { root, a, d };
+  for (uint i = 0; i < 3; ++i) {
+    uint64_t beg = 0, end = 0;
+    UT_CHECK(hpccctDB_metricRow(&db, noMetrics[i]->id(), &beg, &end)
+	     == HPCFMT_OK);
+    UT_CHECK(beg == end);
+  }
+
+  size_t size = db.size;
+  hpccctDB_close(&db);
+
+  // ------------------------------------------------------------
+  // a truncated file is rejected
+  // ------------------------------------------------------------
+  UT_CHECK(truncate(fnm, size - 8) == 0);
+  UT_CHECK(hpccctDB_open(&db, fnm) == HPCFMT_ERR);
+
+  unlink(fnm);
+  delete prof;
+}
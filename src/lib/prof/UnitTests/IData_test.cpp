@@ -0,0 +1,218 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Equivalence test for the dense and sparse forms of Metric::IData.
+//
+// Description:
+//   Applies the same sequence of updates to a dense and a sparse IData
+//   and checks that both read the same through demandMetric(),
+//   nextMetric() and hasMetric(), including after a sparse IData has
+//   switched to dense storage.
+//
+//***************************************************************************
+
+#include <cstdlib>
+
+#include <lib/prof/Metric-IData.hpp>
+
+#include "UnitTests.hpp"
+
+using Prof::Metric::IData;
+
+
+// all observable state must agree
+static void
+checkSame(const IData& dense, const IData& sparse)
+{
+  UT_CHECK(dense.numMetrics() == sparse.numMetrics());
+  UT_CHECK(dense.hasMetrics() == sparse.hasMetrics());
+
+  for (uint i = 0; i < dense.numMetrics(); ++i) {
+    UT_CHECK(dense.metric(i) == sparse.metric(i));
+    UT_CHECK(dense.hasMetric(i) == sparse.hasMetric(i));
+  }
+
+  // iteration visits exactly the non-zero values, in order
+  uint i = dense.nextMetric(0), j = sparse.nextMetric(0);
+  for ( ; i != IData::npos && j != IData::npos;
+	i = dense.nextMetric(i + 1), j = sparse.nextMetric(j + 1)) {
+    UT_CHECK(i == j);
+    UT_CHECK(dense.metric(i) != 0.0);
+  }
+  UT_CHECK(i == IData::npos && j == IData::npos);
+}
+
+
+// a small deterministic generator (cf. rand_r) so that failures repeat
+static uint
+nextRand(uint& seed)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed / 65536) % 32768;
+}
+
+
+static void
+randomUpdates(uint numMetrics, uint numUpdates, uint seed)
+{
+  IData dense(numMetrics), sparse(numMetrics, true /*isSparse*/);
+
+  for (uint k = 0; k < numUpdates; ++k) {
+    uint mId = nextRand(seed) % numMetrics;
+    double x = (double)(nextRand(seed) % 5) - 2.0; // includes 0
+    switch (nextRand(seed) % 4) {
+      case 0:
+	dense.setMetric(mId, x);
+	sparse.setMetric(mId, x);
+	break;
+      case 1:
+	dense.addMetric(mId, x);
+	sparse.addMetric(mId, x);
+	break;
+      case 2:
+	dense.demandMetric(mId) += x;
+	sparse.demandMetric(mId) += x;
+	break;
+      case 3: {
+	uint mEnd = mId + nextRand(seed) % 8;
+	dense.zeroMetrics(mId, mEnd);
+	sparse.zeroMetrics(mId, mEnd);
+	break;
+      }
+    }
+  }
+  UT_CHECK(sparse.isSparseMetrics());
+  checkSame(dense, sparse);
+
+  // growing and shifting
+  dense.demandMetric(numMetrics + 3, numMetrics + 10) = 1.5;
+  sparse.demandMetric(numMetrics + 3, numMetrics + 10) = 1.5;
+  checkSame(dense, sparse);
+
+  dense.insertMetricsBefore(4);
+  sparse.insertMetricsBefore(4);
+  checkSame(dense, sparse);
+}
+
+
+void
+iDataTest()
+{
+  // ------------------------------------------------------------
+  // absent values read as zero and are not materialized by reads
+  // ------------------------------------------------------------
+  {
+    IData dense(10), sparse(10, true /*isSparse*/);
+    UT_CHECK(!sparse.hasMetrics());
+    const IData& c_sparse = sparse;
+    UT_CHECK(c_sparse.demandMetric(20, 30) == 0.0);
+    dense.demandMetric(20, 30);
+    checkSame(dense, sparse);
+    UT_CHECK(!sparse.hasMetrics());
+  }
+
+  // ------------------------------------------------------------
+  // zero-elision: explicit and cancelling zeros are invisible
+  // ------------------------------------------------------------
+  {
+    IData dense(8), sparse(8, true /*isSparse*/);
+    dense.setMetric(3, 2.0);
+    sparse.setMetric(3, 2.0);
+    dense.setMetric(5, 0.0);
+    sparse.setMetric(5, 0.0);
+    dense.addMetric(6, 0.0);
+    sparse.addMetric(6, 0.0);
+    dense.addMetric(3, -2.0);
+    sparse.addMetric(3, -2.0);
+    checkSame(dense, sparse);
+    UT_CHECK(!sparse.hasMetrics());
+    UT_CHECK(sparse.nextMetric(0) == IData::npos);
+
+    dense.setMetric(7, 1.0);
+    sparse.setMetric(7, 1.0);
+    UT_CHECK(sparse.hasMetrics(7, 8) && !sparse.hasMetrics(0, 7));
+    checkSame(dense, sparse);
+  }
+
+  // ------------------------------------------------------------
+  // out-of-order insertion, with and without the switch to dense
+  // storage (a large vector stays sparse; a small one fills up)
+  // ------------------------------------------------------------
+  randomUpdates(4096, 500, 1);
+  randomUpdates(100, 2000, 2);
+  randomUpdates(3, 50, 3);
+
+  // ------------------------------------------------------------
+  // a sparse IData that went dense keeps its policy
+  // ------------------------------------------------------------
+  {
+    IData dense(64), sparse(64, true /*isSparse*/);
+    for (uint i = 64; i > 0; --i) {
+      dense.setMetric(i - 1, i);
+      sparse.setMetric(i - 1, i);
+    }
+    checkSame(dense, sparse);
+    UT_CHECK(sparse.isSparseMetrics());
+
+    IData copy(sparse);
+    UT_CHECK(copy.isSparseMetrics());
+    checkSame(dense, copy);
+
+    sparse.clearMetrics();
+    dense.clearMetrics();
+    checkSame(dense, sparse);
+    sparse.setMetric(2, 4.0, 64);
+    dense.setMetric(2, 4.0, 64);
+    checkSame(dense, sparse);
+    UT_CHECK(sparse.isSparseMetrics());
+  }
+}
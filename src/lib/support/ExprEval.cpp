@@ -151,113 +151,226 @@ double ExprEval::Eval(EVAL_CHAR* expr, BaseVarMap *var_map)
   return res;
 }
 
-EXPR_EVAL_ERR ExprEval::GetErr() 
+// ================================
+//   Compiled expressions
+// ================================
+
+void ExprEval::Emit(ExprCode& code, ExprCode::OpCode op, unsigned int depth,
+		    double val, unsigned int var)
 {
-  return _err;
+  ExprCode::Op o;
+  o.code = op;
+  o.val  = val;
+  o.var  = var;
+  o.err  = EEE_NO_ERROR;
+  code.ops.push_back(o);
+  if (depth > code.max_depth) {
+    code.max_depth = depth;
+  }
 }
 
-EVAL_CHAR* ExprEval::GetErrPos() 
+// Compile a number, a variable or an expression in parenthesis,
+// leaving its value at 'depth' of the stack
+void ExprEval::CompileAtom(EVAL_CHAR*& expr, ExprCode& code, unsigned int depth)
 {
-  return _err_pos;
+    // Skip spaces
+    while(*expr == ' ')
+      expr++;
+
+    // Handle the sign before parenthesis (or before number)
+    bool negative = false;
+    if(*expr == '-') {
+      negative = true;
+      expr++;
+    }
+    if(*expr == '+') {
+      expr++;
+    }
+
+    // Check if there is parenthesis
+    if(*expr == '(') {
+      expr++;
+      _paren_count++;
+      CompileSummands(expr, code, depth);
+      if(*expr != ')') {
+        // Unmatched opening parenthesis
+        _err = EEE_PARENTHESIS;
+        _err_pos = expr;
+        return;
+      }
+      expr++;
+      _paren_count--;
+      if (negative) {
+        Emit(code, ExprCode::OP_NEG, depth);
+      }
+      return;
+    }
+
+    // check if this is variable
+    bool variable = _var_map->isVariable(expr);
+    if (variable) {
+      expr++;
+    }
+
+    char* end_ptr;
+    double res = strtod(expr, &end_ptr);
+    if(end_ptr == expr) {
+      // Report error
+      _err = EEE_WRONG_CHAR;
+      _err_pos = expr;
+      return;
+    }
+    expr = end_ptr;
+
+    if (variable) {
+      Emit(code, ExprCode::OP_VAR, depth, 0, (unsigned int) res);
+      // the parser stops at a variable without a value, so what it
+      // reports is the unparsed rest of the expression
+      code.ops.back().err = (_paren_count > 0) ? EEE_PARENTHESIS : EEE_WRONG_CHAR;
+      if (negative) {
+        Emit(code, ExprCode::OP_NEG, depth);
+      }
+    }
+    else {
+      Emit(code, ExprCode::OP_CONST, depth, negative ? -res : res);
+    }
+}
+
+void ExprEval::CompileFactors(EVAL_CHAR*& expr, ExprCode& code, unsigned int depth)
+{
+    CompileAtom(expr, code, depth);
+    for(;;) {
+      while(*expr == ' ')
+        expr++;
+      EVAL_CHAR op = *expr;
+      EVAL_CHAR* pos = expr;
+      if(op != '/' && op != '*')
+        return;
+      expr++;
+      EXPR_EVAL_ERR err = _err;
+      _err = EEE_NO_ERROR;
+      CompileAtom(expr, code, depth + 1);
+      if (_err != EEE_NO_ERROR && op == '/') {
+        // the parser divides by the 0 of a bad atom
+        _err = EEE_DIVIDE_BY_ZERO;
+        _err_pos = pos;
+        return;
+      }
+      if (_err == EEE_NO_ERROR) {
+        _err = err;
+      }
+      Emit(code, (op == '/') ? ExprCode::OP_DIV : ExprCode::OP_MUL, depth);
+    }
 }
 
+void ExprEval::CompileSummands(EVAL_CHAR*& expr, ExprCode& code, unsigned int depth)
+{
+    CompileFactors(expr, code, depth);
+    for(;;) {
+      while(*expr == ' ')
+        expr++;
+      EVAL_CHAR op = *expr;
+      if(op != '-' && op != '+')
+        return;
+      expr++;
+      CompileFactors(expr, code, depth + 1);
+      Emit(code, (op == '-') ? ExprCode::OP_SUB : ExprCode::OP_ADD, depth);
+    }
+}
 
-// =======
-//  Tests
-// =======
+bool ExprEval::Compile(EVAL_CHAR* expr, BaseVarMap *var_map, ExprCode& code)
+{
+  _paren_count  = 0;
+  _err          = EEE_NO_ERROR;
+  _var_map	= var_map;
 
-#ifdef _DEBUG
-void TestExprEval() {
-  ExprEval eval;
-  // Some simple expressions
-  assert(eval.Eval("1234") == 1234 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("1+2*3") == 7 && eval.GetErr() == EEE_NO_ERROR);
+  code.ops.clear();
+  code.max_depth = 0;
 
-  // Parenthesis
-  assert(eval.Eval("5*(4+4+1)") == 45 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("5*(2*(1+3)+1)") == 45 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("5*((1+3)*2+1)") == 45 && eval.GetErr() == EEE_NO_ERROR);
+  CompileSummands(expr, code, 0);
 
-  // Spaces
-  assert(eval.Eval("5 * ((1 + 3) * 2 + 1)") == 45 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("5 - 2 * ( 3 )") == -1 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("5 - 2 * ( ( 4 )  - 1 )") == -1 && eval.GetErr() == EEE_NO_ERROR);
+  if(_paren_count != 0 || *expr == ')') {
+    _err = EEE_PARENTHESIS;
+    _err_pos = expr;
+  }
+  else if(*expr != '\0') {
+    _err = EEE_WRONG_CHAR;
+    _err_pos = expr;
+  }
 
-  // Sign before parenthesis
-  assert(eval.Eval("-(2+1)*4") == -12 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("-4*(2+1)") == -12 && eval.GetErr() == EEE_NO_ERROR);
-  
-  // Fractional numbers
-  assert(eval.Eval("1.5/5") == 0.3 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("1/5e10") == 2e-11 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("(4-3)/(4*4)") == 0.0625 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("1/2/2") == 0.25 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("0.25 * .5 * 0.5") == 0.0625 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval(".25 / 2 * .5") == 0.0625 && eval.GetErr() == EEE_NO_ERROR);
-  
-  // Repeated operators
-  assert(eval.Eval("1+-2") == -1 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("--2") == 2 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("2---2") == 0 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("2-+-2") == 4 && eval.GetErr() == EEE_NO_ERROR);
-
-  // === Errors ===
-  // Parenthesis error
-  eval.Eval("5*((1+3)*2+1");
-  assert(eval.GetErr() == EEE_PARENTHESIS && strcmp(eval.GetErrPos(), "") == 0);
-  eval.Eval("5*((1+3)*2)+1)");
-  assert(eval.GetErr() == EEE_PARENTHESIS && strcmp(eval.GetErrPos(), ")") == 0);
-  
-  // Repeated operators (wrong)
-  eval.Eval("5*/2");
-  assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "/2") == 0);
-  
-  // Wrong position of an operator
-  eval.Eval("*2");
-  assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "*2") == 0);
-  eval.Eval("2+");
-  assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "") == 0);
-  eval.Eval("2*");
-  assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "") == 0);
-  
-  // Division by zero
-  eval.Eval("2/0");
-  assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/0") == 0);
-  eval.Eval("3+1/(5-5)+4");
-  assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/(5-5)+4") == 0);
-  eval.Eval("2/"); // Erroneously detected as division by zero, but that's ok for us
-  assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/") == 0);
-  
-  // Invalid characters
-  eval.Eval("~5");
-  assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "~5") == 0);
-  eval.Eval("5x");
-  assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "x") == 0);
-
-  // Multiply errors
-  eval.Eval("3+1/0+4$"); // Only one error will be detected (in this case, the last one)
-  assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "$") == 0);
-  eval.Eval("3+1/0+4");
-  assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/0+4") == 0);
-  eval.Eval("q+1/0)"); // ...or the first one
-  assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "q+1/0)") == 0);
-  eval.Eval("+1/0)");
-  assert(eval.GetErr() == EEE_PARENTHESIS && strcmp(eval.GetErrPos(), ")") == 0);
-  eval.Eval("+1/0");
-  assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/0") == 0);
-  
-  // An emtpy string
-  eval.Eval("");
-  assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "") == 0);
+  if (_err != EEE_NO_ERROR) {
+    code.ops.clear();
+    return false;
+  }
+  return true;
+}
+
+// Evaluate compiled code.  Operations are applied in the same order as
+// the parser applies them, so the result equals Eval() of the source.
+double ExprEval::Eval(const ExprCode& code, BaseVarMap *var_map)
+{
+  _err     = EEE_NO_ERROR;
+  _err_pos = NULL;
+
+  if (code.ops.empty()) {
+    _err = EEE_WRONG_CHAR;
+    return 0;
+  }
+  if (_stack.size() < code.max_depth + 1) {
+    _stack.resize(code.max_depth + 1);
+  }
+  double* stk = &_stack[0];
+
+  unsigned int top = 0; // number of values on the stack
+  for (size_t i = 0; i < code.ops.size(); i++) {
+    const ExprCode::Op& op = code.ops[i];
+    switch (op.code) {
+      case ExprCode::OP_CONST:
+        stk[top++] = op.val;
+        break;
+      case ExprCode::OP_VAR: {
+        double val = var_map->getValue(op.var);
+        if (var_map->getErrorCode() != 0) {
+          _err = op.err;
+          return 0;
+        }
+        stk[top++] = val;
+        break;
+      }
+      case ExprCode::OP_NEG:
+        stk[top - 1] = -stk[top - 1];
+        break;
+      case ExprCode::OP_ADD:
+        top--;
+        stk[top - 1] += stk[top];
+        break;
+      case ExprCode::OP_SUB:
+        top--;
+        stk[top - 1] -= stk[top];
+        break;
+      case ExprCode::OP_MUL:
+        top--;
+        stk[top - 1] *= stk[top];
+        break;
+      case ExprCode::OP_DIV:
+        top--;
+        if (stk[top] == 0) {
+          _err = EEE_DIVIDE_BY_ZERO;
+          return 0;
+        }
+        stk[top - 1] /= stk[top];
+        break;
+    }
+  }
+  return stk[0];
 }
-#endif
 
-// ============
-// Main program
-// ============
-#ifdef _DEBUG
+EXPR_EVAL_ERR ExprEval::GetErr() 
+{
+  return _err;
+}
 
-int main() {
-  TestExprEval();
+EVAL_CHAR* ExprEval::GetErrPos() 
+{
+  return _err_pos;
 }
-#endif
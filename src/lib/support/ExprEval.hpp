@@ -4,6 +4,8 @@
 #ifndef __ExprEval_H__
 #define  __ExprEval_H__
 
+#include <vector>
+
 #include <lib/support/BaseVarMap.hpp>   // basic var map class
 
 // Error codes enumeration
@@ -19,6 +21,27 @@ enum EXPR_EVAL_ERR {
 #define EVAL_CHAR char
 
 
+// A math expression compiled by ExprEval::Compile() into postfix
+// order, so that it can be evaluated many times (e.g., once per CCT
+// node) without being parsed again
+class ExprCode {
+public:
+  enum OpCode { OP_CONST, OP_VAR, OP_NEG, OP_ADD, OP_SUB, OP_MUL, OP_DIV };
+
+  struct Op {
+    OpCode code;
+    double val;        // OP_CONST
+    unsigned int var;  // OP_VAR
+    EXPR_EVAL_ERR err; // OP_VAR: error that Eval() reports if var has no value
+  };
+
+  std::vector<Op> ops;
+  unsigned int    max_depth; // of the evaluation stack
+
+  ExprCode() : max_depth(0) { }
+};
+
+
 // Parser class to evaluate math expression
 // The math expression has to be simple operators:
 // +,-,*, /, ( and ) 
@@ -41,10 +64,28 @@ private:
   // parse a sum or substraction
   double ParseSummands(EVAL_CHAR*& expr) ;
 
+  // the same grammar, emitting postfix code instead of values
+  void CompileAtom(EVAL_CHAR*& expr, ExprCode& code, unsigned int depth);
+  void CompileFactors(EVAL_CHAR*& expr, ExprCode& code, unsigned int depth);
+  void CompileSummands(EVAL_CHAR*& expr, ExprCode& code, unsigned int depth);
+  void Emit(ExprCode& code, ExprCode::OpCode op, unsigned int depth,
+	    double val = 0, unsigned int var = 0);
+
+  // evaluation stack for compiled code
+  std::vector<double> _stack;
+
 public:
   // main method to evaluate a math expression
   double  Eval(EVAL_CHAR* expr, BaseVarMap *var_map);
 
+  // compile a math expression; var_map is only used to recognize
+  // variables.  Returns false (cf. GetErr()) on a syntax error.
+  bool    Compile(EVAL_CHAR* expr, BaseVarMap *var_map, ExprCode& code);
+
+  // evaluate compiled code; as Eval(), the result is meaningful only
+  // if GetErr() returns EEE_NO_ERROR
+  double  Eval(const ExprCode& code, BaseVarMap *var_map);
+
   // get the error code
   EXPR_EVAL_ERR GetErr();
 
@@ -278,6 +278,17 @@ move(const char* dst, const char* src)
 }
 
 
+void
+link(const char* dst, const char* src)
+{
+  int ret = ::link(src, dst);
+  if (ret != 0) {
+    DIAG_Throw("[FileUtil::link] '" << src << "' -> '" << dst << "' ("
+	       << strerror(errno) << ")");
+  }
+}
+
+
 int
 remove(const char* file)
 { 
@@ -177,6 +177,17 @@ move(const std::string& dst, const std::string& src)
 }
 
 
+// hard link 'src' as 'dst' (both must be on the same file system)
+void
+link(const char* dst, const char* src);
+
+inline void
+link(const std::string& dst, const std::string& src)
+{
+  link(dst.c_str(), src.c_str());
+}
+
+
 
 // deletes fname (unlink) 
 extern int
@@ -102,7 +102,7 @@ public:
   // realpath: Given 'fnm', convert it to its 'realpath' (if possible)
   // and return true.  Return true if 'fnm' is as fully resolved as it
   // can be (which does not necessarily mean it exists); otherwise
-  // return false.
+  // return false.  Thread-safe.
   bool
   realpath(std::string& pathNm) const;
   
@@ -0,0 +1,204 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Tests the metric formula parser and compiler (ExprEval).
+//
+// Description:
+//   Checks the values and errors of ExprEval::Eval() on a set of
+//   expressions, and that code from ExprEval::Compile() evaluates to the
+//   same values and errors as the parser.
+//
+//***************************************************************************
+
+#include <cstring>
+
+#include <lib/support/BaseVarMap.hpp>
+#include <lib/support/ExprEval.hpp>
+
+#include "UnitTests.hpp"
+
+
+// variables are '@' followed by an index below 10; variable i is i + 0.5
+class TestVarMap : public BaseVarMap {
+  int _err;
+public:
+  TestVarMap() : _err(0) { }
+  bool isVariable(char *expr) { return *expr == '@'; }
+  double getValue(unsigned int var) {
+    _err = (var < 10) ? 0 : 1;
+    return var + 0.5;
+  }
+  int getErrorCode() { return _err; }
+};
+
+
+static TestVarMap vars;
+
+
+// 'expr' evaluates to 'val' without error
+static bool
+isValue(const char* expr, double val)
+{
+  ExprEval eval;
+  double res = eval.Eval((EVAL_CHAR*) expr, &vars);
+  return eval.GetErr() == EEE_NO_ERROR && res == val;
+}
+
+
+// 'expr' fails with 'err' at the suffix 'pos' of 'expr'
+static bool
+isError(const char* expr, EXPR_EVAL_ERR err, const char* pos)
+{
+  ExprEval eval;
+  eval.Eval((EVAL_CHAR*) expr, &vars);
+  return eval.GetErr() == err && strcmp(eval.GetErrPos(), pos) == 0;
+}
+
+
+void
+exprEvalTest()
+{
+  // Some simple expressions
+  UT_CHECK(isValue("1234", 1234));
+  UT_CHECK(isValue("1+2*3", 7));
+
+  // Parenthesis
+  UT_CHECK(isValue("5*(4+4+1)", 45));
+  UT_CHECK(isValue("5*(2*(1+3)+1)", 45));
+  UT_CHECK(isValue("5*((1+3)*2+1)", 45));
+
+  // Spaces
+  UT_CHECK(isValue("5 * ((1 + 3) * 2 + 1)", 45));
+  UT_CHECK(isValue("5 - 2 * ( 3 )", -1));
+  UT_CHECK(isValue("5 - 2 * ( ( 4 )  - 1 )", -1));
+
+  // Sign before parenthesis
+  UT_CHECK(isValue("-(2+1)*4", -12));
+  UT_CHECK(isValue("-4*(2+1)", -12));
+
+  // Fractional numbers
+  UT_CHECK(isValue("1.5/5", 0.3));
+  UT_CHECK(isValue("1/5e10", 2e-11));
+  UT_CHECK(isValue("(4-3)/(4*4)", 0.0625));
+  UT_CHECK(isValue("1/2/2", 0.25));
+  UT_CHECK(isValue("0.25 * .5 * 0.5", 0.0625));
+  UT_CHECK(isValue(".25 / 2 * .5", 0.0625));
+
+  // Repeated operators
+  UT_CHECK(isValue("1+-2", -1));
+  UT_CHECK(isValue("--2", 2));
+  UT_CHECK(isValue("2---2", 0));
+  UT_CHECK(isValue("2-+-2", 4));
+
+  // Variables
+  UT_CHECK(isValue("@1*2+@3", 6.5));
+  UT_CHECK(isValue("-@2/(@1-@0)", -2.5));
+
+  // === Errors ===
+  // Parenthesis error
+  UT_CHECK(isError("5*((1+3)*2+1", EEE_PARENTHESIS, ""));
+  UT_CHECK(isError("5*((1+3)*2)+1)", EEE_PARENTHESIS, ")"));
+
+  // Repeated operators (wrong)
+  UT_CHECK(isError("5*/2", EEE_WRONG_CHAR, "/2"));
+
+  // Wrong position of an operator
+  UT_CHECK(isError("*2", EEE_WRONG_CHAR, "*2"));
+  UT_CHECK(isError("2+", EEE_WRONG_CHAR, ""));
+  UT_CHECK(isError("2*", EEE_WRONG_CHAR, ""));
+
+  // Division by zero
+  UT_CHECK(isError("2/0", EEE_DIVIDE_BY_ZERO, "/0"));
+  UT_CHECK(isError("3+1/(5-5)+4", EEE_DIVIDE_BY_ZERO, "/(5-5)+4"));
+  // Erroneously detected as division by zero, but that's ok for us
+  UT_CHECK(isError("2/", EEE_DIVIDE_BY_ZERO, "/"));
+
+  // Invalid characters
+  UT_CHECK(isError("~5", EEE_WRONG_CHAR, "~5"));
+  UT_CHECK(isError("5x", EEE_WRONG_CHAR, "x"));
+
+  // Multiple errors: only one is detected, the last one...
+  UT_CHECK(isError("3+1/0+4$", EEE_WRONG_CHAR, "$"));
+  UT_CHECK(isError("3+1/0+4", EEE_DIVIDE_BY_ZERO, "/0+4"));
+  // ...or the first one
+  UT_CHECK(isError("q+1/0)", EEE_WRONG_CHAR, "q+1/0)"));
+  UT_CHECK(isError("+1/0)", EEE_PARENTHESIS, ")"));
+  UT_CHECK(isError("+1/0", EEE_DIVIDE_BY_ZERO, "/0"));
+
+  // An empty string
+  UT_CHECK(isError("", EEE_WRONG_CHAR, ""));
+
+  // Compiled code gives the same values and errors as the parser
+  const char* cases[] = {
+    "1234", "1+2*3", "5*(4+4+1)", "5*(2*(1+3)+1)", "5*((1+3)*2+1)",
+    "5 * ((1 + 3) * 2 + 1)", "5 - 2 * ( 3 )", "5 - 2 * ( ( 4 )  - 1 )",
+    "-(2+1)*4", "-4*(2+1)", "1.5/5", "1/5e10", "(4-3)/(4*4)", "1/2/2",
+    "0.25 * .5 * 0.5", ".25 / 2 * .5", "1+-2", "--2", "2---2", "2-+-2",
+    "@1*2+@3", "-@2/(@1-@0)", "@12+1",
+    "5*((1+3)*2+1", "5*((1+3)*2)+1)", "5*/2", "*2", "2+", "2*", "2/0",
+    "3+1/(5-5)+4", "2/", "~5", "5x", "3+1/0+4$", "3+1/0+4", "q+1/0)",
+    "+1/0)", "+1/0", "@1/(@2-@2)", ""
+  };
+  ExprEval eval;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    ExprEval ref;
+    double expected = ref.Eval((EVAL_CHAR*) cases[i], &vars);
+
+    ExprCode code;
+    double val = 0;
+    if (eval.Compile((EVAL_CHAR*) cases[i], &vars, code)) {
+      val = eval.Eval(code, &vars);
+    }
+    UT_CHECK(eval.GetErr() == ref.GetErr());
+    UT_CHECK(eval.GetErr() != EEE_NO_ERROR || val == expected);
+  }
+}
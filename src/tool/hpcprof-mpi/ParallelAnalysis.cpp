@@ -70,7 +70,13 @@ using std::string;
 
 #include <algorithm>
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+
 #include <stdint.h>
+#include <sys/types.h>
 
 //*************************** User Include Files ****************************
 
@@ -81,6 +87,9 @@ using std::string;
 #include <lib/analysis/CallPath.hpp>
 #include <lib/analysis/Util.hpp>
 
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
 #include <lib/support/diagnostics.h>
 #include <lib/support/StrUtil.hpp>
 
@@ -105,6 +114,18 @@ packStringSet(const StringSet& profile,
 static StringSet*
 unpackStringSet(uint8_t* buffer, size_t bufferSz);
 
+static void
+fwriteProfile(const Prof::CallPath::Profile& profile, FILE* fs);
+
+static Prof::CallPath::Profile*
+freadProfile(FILE* fs, const char* ctxtStr);
+
+static FILE*
+openSendStream(int dest, int tag, MPI_Comm comm);
+
+static FILE*
+openRecvStream(int src, int tag, MPI_Comm comm);
+
 //***************************************************************************
 // private functions
 //***************************************************************************
@@ -190,54 +211,60 @@ broadcast
 }
 
 
+// packSend/recvMerge: The profile is streamed in chunks (cf.
+// openSendStream) so that neither the sender nor the receiver holds a
+// packed copy of the whole profile, and so that packing overlaps with
+// communication.  The receiver merges each CCT node as it is decoded
+// (cf. Profile::fmt_freadMerge) rather than building the incoming
+// profile first.
+//
+// Both sides close their stream even if (un)packing fails: closing the
+// send stream posts the terminating chunk, so the receiver sees a
+// truncated profile rather than blocking; closing the receive stream
+// drains the remaining chunks, so the sender's sends complete.
 void
 packSend(Prof::CallPath::Profile* profile,
 	 int dest, int myRank, MPI_Comm comm)
 {
-  uint8_t* profileBuf = NULL;
-  size_t profileBufSz = 0;
-  packProfile(*profile, &profileBuf, &profileBufSz);
-  MPI_Send(profileBuf, (int)profileBufSz, MPI_BYTE, dest, myRank, comm);
-  free(profileBuf);
+  FILE* fs = openSendStream(dest, myRank, comm);
+  try {
+    fwriteProfile(*profile, fs);
+  }
+  catch (...) {
+    fclose(fs);
+    throw;
+  }
+  fclose(fs);
 }
 
 void
 recvMerge(Prof::CallPath::Profile* profile,
 	  int src, int myRank, MPI_Comm comm)
 {
-  // probe src
-  MPI_Status mpistat;
-  MPI_Probe(src, src, comm, &mpistat);
-  int profileBufSz;
-  MPI_Get_count(&mpistat, MPI_BYTE, &profileBufSz);
-
-  // receive profile from src
-  uint8_t *profileBuf = new uint8_t[profileBufSz];
-  MPI_Recv(profileBuf, profileBufSz, MPI_BYTE, src, src, comm, &mpistat);
-  Prof::CallPath::Profile* new_profile =
-    unpackProfile(profileBuf, (size_t)profileBufSz);
-  delete[] profileBuf;
-
   if (DBG_CCT_MERGE) {
     string pfx0 = "[" + StrUtil::toStr(myRank) + "]";
-    string pfx1 = "[" + StrUtil::toStr(src) + "]";
     DIAG_DevMsgIf(1, profile->metricMgr()->toString(pfx0.c_str()));
-    DIAG_DevMsgIf(1, new_profile->metricMgr()->toString(pfx1.c_str()));
   }
-    
-  int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
-  profile->merge(*new_profile, mergeTy);
 
-  // merging the perf event statistics
-  profile->metricMgr()->mergePerfEventStatistics(new_profile->metricMgr());
+  // receive profile from src, merging nodes as chunks are unpacked
+  FILE* fs = openRecvStream(src, src, comm);
+  try {
+    uint rFlags = Prof::CallPath::Profile::RFlg_VirtualMetrics;
+    int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
+    Prof::CallPath::Profile::fmt_freadMerge(*profile, fs, rFlags, mergeTy,
+					    "(ParallelAnalysis::recvMerge)");
+  }
+  catch (...) {
+    fclose(fs);
+    throw;
+  }
+  fclose(fs);
 
   if (DBG_CCT_MERGE) {
     string pfx = ("[" + StrUtil::toStr(src)
 		  + " => " + StrUtil::toStr(myRank) + "]");
     DIAG_DevMsgIf(1, profile->metricMgr()->toString(pfx.c_str()));
   }
-
-  delete new_profile;
 }
 
 void
@@ -311,8 +338,7 @@ packProfile(const Prof::CallPath::Profile& profile,
   // open_memstream: mallocs buffer and sets bufferSz
   FILE* fs = open_memstream((char**)buffer, bufferSz);
 
-  uint wFlags = Prof::CallPath::Profile::WFlg_VirtualMetrics;
-  Prof::CallPath::Profile::fmt_fwrite(profile, fs, wFlags);
+  fwriteProfile(profile, fs);
 
   fclose(fs);
 }
@@ -323,17 +349,233 @@ unpackProfile(uint8_t* buffer, size_t bufferSz)
 {
   FILE* fs = fmemopen(buffer, bufferSz, "r");
 
-  Prof::CallPath::Profile* prof = NULL;
-  uint rFlags = Prof::CallPath::Profile::RFlg_VirtualMetrics;
-  Prof::CallPath::Profile::fmt_fread(prof, fs, rFlags,
-				     "(ParallelAnalysis::unpackProfile)",
-				     NULL, NULL);
+  Prof::CallPath::Profile* prof =
+    freadProfile(fs, "(ParallelAnalysis::unpackProfile)");
 
   fclose(fs);
   return prof;
 }
 
 
+static void
+fwriteProfile(const Prof::CallPath::Profile& profile, FILE* fs)
+{
+  uint wFlags = Prof::CallPath::Profile::WFlg_VirtualMetrics;
+  Prof::CallPath::Profile::fmt_fwrite(profile, fs, wFlags);
+}
+
+
+static Prof::CallPath::Profile*
+freadProfile(FILE* fs, const char* ctxtStr)
+{
+  Prof::CallPath::Profile* prof = NULL;
+  uint rFlags = Prof::CallPath::Profile::RFlg_VirtualMetrics;
+  Prof::CallPath::Profile::fmt_fread(prof, fs, rFlags, ctxtStr, NULL, NULL);
+  return prof;
+}
+
+
+//***************************************************************************
+// chunked streams
+//
+// A stream is sent as a sequence of messages of at most StreamChunkSz
+// bytes; a message shorter than StreamChunkSz (possibly empty) ends the
+// sequence.  The sender posts a chunk with MPI_Isend as soon as it is
+// full and continues packing into the next of StreamSendBufs buffers;
+// the receiver posts the receive for the next chunk before unpacking
+// the current one.  Messages between a pair of ranks with the same tag
+// are non-overtaking, so chunks arrive in order.
+//***************************************************************************
+
+static const int StreamChunkSz  = (4 * 1024 * 1024);
+static const int StreamSendBufs = 2;
+
+
+struct SendStream {
+  int dest, tag;
+  MPI_Comm comm;
+
+  uint8_t* buf[StreamSendBufs];
+  MPI_Request req[StreamSendBufs];
+  int cur;   // buffer being filled
+  int curSz; // bytes in buffer 'cur'
+};
+
+
+static void
+sendStream_postChunk(SendStream* x)
+{
+  MPI_Isend(x->buf[x->cur], x->curSz, MPI_BYTE, x->dest, x->tag, x->comm,
+	    &x->req[x->cur]);
+
+  x->cur = (x->cur + 1) % StreamSendBufs;
+  x->curSz = 0;
+
+  // wait until the next buffer is no longer in flight
+  MPI_Wait(&x->req[x->cur], MPI_STATUS_IGNORE);
+}
+
+
+static ssize_t
+sendStream_write(void* cookie, const char* data, size_t size)
+{
+  SendStream* x = (SendStream*)cookie;
+
+  size_t nWritten = 0;
+  while (nWritten < size) {
+    size_t n = std::min(size - nWritten, (size_t)(StreamChunkSz - x->curSz));
+    memcpy(x->buf[x->cur] + x->curSz, data + nWritten, n);
+    x->curSz += n;
+    nWritten += n;
+
+    if (x->curSz == StreamChunkSz) {
+      sendStream_postChunk(x);
+    }
+  }
+  return nWritten;
+}
+
+
+static int
+sendStream_close(void* cookie)
+{
+  SendStream* x = (SendStream*)cookie;
+
+  // the final (short, possibly empty) chunk
+  sendStream_postChunk(x);
+  MPI_Waitall(StreamSendBufs, x->req, MPI_STATUSES_IGNORE);
+
+  for (int i = 0; i < StreamSendBufs; ++i) {
+    delete[] x->buf[i];
+  }
+  delete x;
+  return 0;
+}
+
+
+static FILE*
+openSendStream(int dest, int tag, MPI_Comm comm)
+{
+  SendStream* x = new SendStream;
+  x->dest = dest;
+  x->tag  = tag;
+  x->comm = comm;
+  for (int i = 0; i < StreamSendBufs; ++i) {
+    x->buf[i] = new uint8_t[StreamChunkSz];
+    x->req[i] = MPI_REQUEST_NULL;
+  }
+  x->cur = 0;
+  x->curSz = 0;
+
+  cookie_io_functions_t fns = { NULL, sendStream_write, NULL,
+				sendStream_close };
+  FILE* fs = fopencookie(x, "w", fns);
+  DIAG_Assert(fs, "ParallelAnalysis: cannot open send stream");
+  return fs;
+}
+
+
+struct RecvStream {
+  int src, tag;
+  MPI_Comm comm;
+
+  uint8_t* buf[2];
+  MPI_Request req; // receive posted into buf[1 - cur] (if any)
+  int cur;         // buffer being unpacked
+  int curSz, curPos;
+  bool isLast;     // buf[cur] holds the final chunk
+};
+
+
+static void
+recvStream_postChunk(RecvStream* x, int bufIdx)
+{
+  MPI_Irecv(x->buf[bufIdx], StreamChunkSz, MPI_BYTE, x->src, x->tag, x->comm,
+	    &x->req);
+}
+
+
+// recvStream_nextChunk: wait for the posted chunk, make it current, and
+// post the receive of the following chunk, if any
+static void
+recvStream_nextChunk(RecvStream* x)
+{
+  MPI_Status mpistat;
+  MPI_Wait(&x->req, &mpistat);
+
+  x->cur = 1 - x->cur;
+  MPI_Get_count(&mpistat, MPI_BYTE, &x->curSz);
+  x->curPos = 0;
+  x->isLast = (x->curSz < StreamChunkSz);
+
+  if (!x->isLast) {
+    recvStream_postChunk(x, 1 - x->cur);
+  }
+}
+
+
+static ssize_t
+recvStream_read(void* cookie, char* data, size_t size)
+{
+  RecvStream* x = (RecvStream*)cookie;
+
+  size_t nRead = 0;
+  while (nRead < size) {
+    if (x->curPos == x->curSz) {
+      if (x->isLast) {
+	break; // EOF
+      }
+      recvStream_nextChunk(x);
+      continue;
+    }
+    size_t n = std::min(size - nRead, (size_t)(x->curSz - x->curPos));
+    memcpy(data + nRead, x->buf[x->cur] + x->curPos, n);
+    x->curPos += n;
+    nRead += n;
+  }
+  return nRead;
+}
+
+
+static int
+recvStream_close(void* cookie)
+{
+  RecvStream* x = (RecvStream*)cookie;
+
+  // consume any remaining chunks (e.g., the empty final chunk)
+  while (!x->isLast) {
+    recvStream_nextChunk(x);
+  }
+
+  delete[] x->buf[0];
+  delete[] x->buf[1];
+  delete x;
+  return 0;
+}
+
+
+static FILE*
+openRecvStream(int src, int tag, MPI_Comm comm)
+{
+  RecvStream* x = new RecvStream;
+  x->src  = src;
+  x->tag  = tag;
+  x->comm = comm;
+  x->buf[0] = new uint8_t[StreamChunkSz];
+  x->buf[1] = new uint8_t[StreamChunkSz];
+  x->cur = 1;
+  x->curSz = x->curPos = 0;
+  x->isLast = false;
+
+  recvStream_postChunk(x, 0);
+
+  cookie_io_functions_t fns = { recvStream_read, NULL, NULL,
+				recvStream_close };
+  FILE* fs = fopencookie(x, "r", fns);
+  DIAG_Assert(fs, "ParallelAnalysis: cannot open receive stream");
+  return fs;
+}
+
 
 //***************************************************************************
 
@@ -381,10 +623,13 @@ packMetrics(const Prof::CallPath::Profile& profile,
   DIAG_Assert(packedMetrics.numNodes() == cct.maxDenseId() + 1, "");
   DIAG_Assert(packedMetrics.numMetrics() == mDrvdEnd - mDrvdBeg, "");
 
+  // N.B.: a sparse aggregation (cf. CCT::MergedNodeSet) does not size
+  // the metrics of nodes it does not visit
   for (Prof::CCT::ANodeIterator it(cct.root()); it.Current(); ++it) {
-    Prof::CCT::ANode* n = it.current();
+    const Prof::CCT::ANode* n = it.current();
     for (uint mId1 = 0, mId2 = mDrvdBeg; mId2 < mDrvdEnd; ++mId1, ++mId2) {
-      packedMetrics.idx(n->id(), mId1) = n->metric(mId2);
+      packedMetrics.idx(n->id(), mId1) =
+	(mId2 < n->numMetrics()) ? n->metric(mId2) : 0.0;
     }
   }
 }
@@ -406,7 +651,7 @@ unpackMetrics(Prof::CallPath::Profile& profile,
   for (uint nodeId = 1; nodeId < packedMetrics.numNodes(); ++nodeId) {
     for (uint mId1 = 0, mId2 = mBegId; mId2 < mEndId; ++mId1, ++mId2) {
       Prof::CCT::ANode* n = cct.findNode(nodeId);
-      n->demandMetric(mId2) = packedMetrics.idx(nodeId, mId1);
+      n->setMetric(mId2, packedMetrics.idx(nodeId, mId1));
     }
   }
 
@@ -420,6 +665,372 @@ unpackMetrics(Prof::CallPath::Profile& profile,
 
 
 
+//***************************************************************************
+// SharedMetricDB
+//***************************************************************************
+
+SharedMetricDB::SharedMetricDB(const std::string& fnm,
+			       const Prof::CallPath::Profile& profile,
+			       uint numThreads, MPI_Comm comm)
+  : m_comm(comm), m_myRank(0), m_fnm(fnm),
+    m_numNodes(profile.cct()->maxDenseId()),
+    m_numThreads(0), m_threadBeg(0), m_bufFs(NULL)
+{
+  MPI_Comm_rank(comm, &m_myRank);
+
+  // threads are indexed by rank, then by local order
+  MPI_Exscan(&numThreads, &m_threadBeg, 1, MPI_UNSIGNED, MPI_SUM, comm);
+  if (m_myRank == 0) {
+    m_threadBeg = 0; // undefined after MPI_Exscan
+  }
+  MPI_Allreduce(&numThreads, &m_numThreads, 1, MPI_UNSIGNED, MPI_SUM, comm);
+
+  m_idx.reserve(numThreads);
+
+  // N.B.: as with ProfileCache, an unlinked file in the node's
+  // temporary directory
+  m_bufFs = tmpfile();
+  if (!m_bufFs) {
+    DIAG_Throw("SharedMetricDB: cannot open temporary file");
+  }
+
+  int ret = MPI_File_open(comm, const_cast<char*>(fnm.c_str()),
+			  MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+			  &m_fh);
+  if (ret != MPI_SUCCESS) {
+    DIAG_Throw("error opening shared metric-db file '" << fnm << "'");
+  }
+  MPI_File_set_size(m_fh, 0);
+}
+
+
+SharedMetricDB::~SharedMetricDB()
+{
+  if (m_bufFs) {
+    fclose(m_bufFs);
+  }
+}
+
+
+static bool
+lt_nodeId(const Prof::CCT::ANode* x, const Prof::CCT::ANode* y)
+{
+  return (x->id() < y->id());
+}
+
+
+void
+SharedMetricDB::add(const Prof::CCT::MergedNodeSet& nodes, uint mBegId,
+		    uint mEndId, const std::string& name, uint groupId)
+{
+  FILE* fs = m_bufFs;
+
+  // only the nodes of the thread's CCT can have non-zero values; rows
+  // are written in node id order
+  std::vector<const Prof::CCT::ANode*> rowNodes;
+  rowNodes.reserve(nodes.size());
+  for (Prof::CCT::MergedNodeSet::const_iterator it = nodes.begin();
+       it != nodes.end(); ++it) {
+    const Prof::CCT::ANode* n = *it;
+    if (n->id() != 0 && n->hasMetrics(mBegId, mEndId)) {
+      rowNodes.push_back(n);
+    }
+  }
+  std::sort(rowNodes.begin(), rowNodes.end(), lt_nodeId);
+
+  hpcthreadDB_fmt_idx_t idx;
+  idx.off        = ftello(fs); // relative to the buffer; cf. close()
+  idx.nnz        = 0;
+  idx.numRows    = rowNodes.size();
+  idx.numMetrics = mEndId - mBegId;
+  idx.groupId    = groupId;
+  idx.nameLen    = name.length() + 1;
+
+  bool isOk = (fwrite(name.c_str(), 1, idx.nameLen, fs) == idx.nameLen);
+
+  // 1. rows
+  for (uint i = 0; isOk && i < rowNodes.size(); ++i) {
+    const Prof::CCT::ANode* n = rowNodes[i];
+
+    uint64_t nnz = 0;
+    for (uint mId = n->nextMetric(mBegId, mEndId);
+	 mId != Prof::Metric::IData::npos; mId = n->nextMetric(mId + 1, mEndId)) {
+      nnz++;
+    }
+
+    isOk = (hpcfmt_int4_fwrite(n->id(), fs) == HPCFMT_OK
+	    && hpcfmt_int8_fwrite(idx.nnz, fs) == HPCFMT_OK);
+    idx.nnz += nnz;
+  }
+  isOk = (isOk
+	  && hpcfmt_int4_fwrite(0, fs) == HPCFMT_OK
+	  && hpcfmt_int8_fwrite(idx.nnz, fs) == HPCFMT_OK);
+
+  // 2. entries
+  for (uint i = 0; isOk && i < rowNodes.size(); ++i) {
+    const Prof::CCT::ANode* n = rowNodes[i];
+
+    for (uint mId = n->nextMetric(mBegId, mEndId);
+	 isOk && mId != Prof::Metric::IData::npos;
+	 mId = n->nextMetric(mId + 1, mEndId)) {
+      isOk = (hpcfmt_int4_fwrite(mId - mBegId, fs) == HPCFMT_OK
+	      && hpcfmt_real8_fwrite(n->metric(mId), fs) == HPCFMT_OK);
+    }
+  }
+
+  if (!isOk) {
+    DIAG_Throw("error buffering shared metric-db data for '" << name << "'");
+  }
+
+  m_idx.push_back(idx);
+}
+
+
+void
+SharedMetricDB::close()
+{
+  // 1. place this rank's data after that of lower ranks
+  if (fflush(m_bufFs) != 0) {
+    DIAG_Throw("error buffering shared metric-db data");
+  }
+  unsigned long long bufSz = ftello(m_bufFs), bufOff = 0;
+
+  MPI_Exscan(&bufSz, &bufOff, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, m_comm);
+  if (m_myRank == 0) {
+    bufOff = 0; // undefined after MPI_Exscan
+  }
+
+  uint64_t dataOff = (HPCTHREADDB_FMT_HeaderLen
+		      + ((uint64_t)m_numThreads * HPCTHREADDB_FMT_IdxLen));
+  uint64_t off = dataOff + bufOff;
+  uint64_t idxOff = (HPCTHREADDB_FMT_HeaderLen
+		     + ((uint64_t)m_threadBeg * HPCTHREADDB_FMT_IdxLen));
+
+  // 2. header (rank 0) and thread index, buffered in file order
+  char* metaBuf = NULL;
+  size_t metaBufSz = 0, hdrSz = 0;
+  bool isOk = true;
+
+  FILE* fs = open_memstream(&metaBuf, &metaBufSz);
+  DIAG_Assert(fs, "SharedMetricDB: cannot open buffer");
+  if (m_myRank == 0) {
+    hpcthreadDB_fmt_hdr_t hdr;
+    hdr.numThreads   = m_numThreads;
+    hdr.numNodes     = m_numNodes;
+    hdr.threadIdxOff = HPCTHREADDB_FMT_HeaderLen;
+    hdr.dataOff      = dataOff;
+
+    isOk = (hpcthreadDB_fmt_hdr_fwrite(&hdr, fs) == HPCFMT_OK);
+    hdrSz = ftello(fs);
+  }
+  for (uint i = 0; isOk && i < m_idx.size(); ++i) {
+    m_idx[i].off += off;
+    isOk = (hpcthreadDB_fmt_idx_fwrite(&m_idx[i], fs) == HPCFMT_OK);
+  }
+  fclose(fs);
+
+  if (!isOk) {
+    free(metaBuf);
+    DIAG_Throw("error buffering shared metric-db index");
+  }
+
+  // 3. a file view of this rank's regions -- header, index slice,
+  //    data -- so that they can be written as one contiguous stream
+  std::vector<int> blkLens;
+  std::vector<MPI_Aint> blkOffs;
+  addViewBlk(blkLens, blkOffs, 0, hdrSz);
+  addViewBlk(blkLens, blkOffs, idxOff, metaBufSz - hdrSz);
+  addViewBlk(blkLens, blkOffs, off, bufSz);
+
+  MPI_Datatype view = MPI_BYTE;
+  if (!blkLens.empty()) {
+    MPI_Type_create_hindexed((int)blkLens.size(), &blkLens[0], &blkOffs[0],
+			     MPI_BYTE, &view);
+    MPI_Type_commit(&view);
+  }
+  MPI_File_set_view(m_fh, 0, MPI_BYTE, view, const_cast<char*>("native"),
+		    MPI_INFO_NULL);
+
+  // 4. collective writes; every rank makes the same number of calls
+  //    (ranks with less to write contribute empty writes)
+  unsigned long long mySz = metaBufSz + bufSz, maxSz = 0;
+  MPI_Allreduce(&mySz, &maxSz, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, m_comm);
+
+  std::vector<char> buf(StreamChunkSz);
+  rewind(m_bufFs);
+  for (unsigned long long pos = 0; pos < maxSz; pos += StreamChunkSz) {
+    size_t n = 0;
+    if (pos < mySz) {
+      n = (size_t)std::min((unsigned long long)StreamChunkSz, mySz - pos);
+
+      // the buffered index precedes the data
+      size_t nMeta = 0;
+      if (pos < metaBufSz) {
+	nMeta = std::min(n, (size_t)(metaBufSz - pos));
+	memcpy(&buf[0], metaBuf + pos, nMeta);
+      }
+      if (n > nMeta && fread(&buf[nMeta], 1, n - nMeta, m_bufFs) != n - nMeta) {
+	free(metaBuf);
+	DIAG_Throw("error reading shared metric-db data");
+      }
+    }
+    writeAll(pos, &buf[0], n);
+  }
+  free(metaBuf);
+
+  if (view != MPI_BYTE) {
+    MPI_Type_free(&view);
+  }
+
+  MPI_File_close(&m_fh);
+
+  fclose(m_bufFs);
+  m_bufFs = NULL;
+}
+
+
+// addViewBlk: adds [off, off + sz) to a file view, split into blocks
+// whose lengths fit an int
+void
+SharedMetricDB::addViewBlk(std::vector<int>& blkLens,
+			   std::vector<MPI_Aint>& blkOffs,
+			   uint64_t off, uint64_t sz)
+{
+  const uint64_t maxBlkSz = (1u << 30);
+  while (sz > 0) {
+    uint64_t n = std::min(sz, maxBlkSz);
+    blkLens.push_back((int)n);
+    blkOffs.push_back((MPI_Aint)off);
+    off += n;
+    sz -= n;
+  }
+}
+
+
+// writeAll: (collective) write 'bufSz' bytes of 'buf' at offset 'off'
+// of the file view
+void
+SharedMetricDB::writeAll(uint64_t off, const char* buf, size_t bufSz)
+{
+  DIAG_Assert(bufSz <= INT_MAX, "SharedMetricDB: write too large");
+
+  MPI_Status status;
+  int ret = MPI_File_write_at_all(m_fh, (MPI_Offset)off, (void*)buf,
+				  (int)bufSz, MPI_BYTE, &status);
+  if (ret != MPI_SUCCESS) {
+    DIAG_Throw("error writing shared metric-db file '" << m_fnm << "'");
+  }
+}
+
+
+
+//***************************************************************************
+// ProfileCache
+//***************************************************************************
+
+ProfileCache::ProfileCache()
+  : m_isReading(false)
+{
+  // N.B.: tmpfile() creates an unlinked file in the node's temporary
+  // directory, so the cache disappears with the process
+  m_fs = tmpfile();
+}
+
+
+ProfileCache::~ProfileCache()
+{
+  if (m_fs) {
+    fclose(m_fs);
+  }
+}
+
+
+void
+ProfileCache::put(const Prof::CCT::MergedNodeSet& nodes, uint mBegId,
+		  uint mEndId)
+{
+  DIAG_Assert(m_fs && !m_isReading, "ProfileCache::put");
+
+  m_vals.clear();
+
+  for (Prof::CCT::MergedNodeSet::const_iterator it = nodes.begin();
+       it != nodes.end(); ++it) {
+    const Prof::CCT::ANode* n = *it;
+    for (uint mId = n->nextMetric(mBegId, mEndId); mId != Prof::Metric::IData::npos;
+	 mId = n->nextMetric(mId + 1, mEndId)) {
+      Val x;
+      x.nodeId = n->id();
+      x.mId    = mId - mBegId;
+      x.val    = n->metric(mId);
+      m_vals.push_back(x);
+    }
+  }
+
+  Hdr hdr;
+  hdr.mBegId  = mBegId;
+  hdr.mEndId  = mEndId;
+  hdr.numVals = m_vals.size();
+
+  if (fwrite(&hdr, sizeof(hdr), 1, m_fs) != 1
+      || (!m_vals.empty()
+	  && fwrite(&m_vals[0], sizeof(Val), m_vals.size(), m_fs) != m_vals.size())) {
+    DIAG_Throw("error writing profile cache");
+  }
+}
+
+
+void
+ProfileCache::mapNodeIds(const Prof::CallPath::Profile& profile)
+{
+  const Prof::CCT::Tree& cct = *profile.cct();
+  m_nodes.assign(cct.maxDenseId() + 1, NULL);
+  for (Prof::CCT::ANodeIterator it(cct.root()); it.Current(); ++it) {
+    Prof::CCT::ANode* n = it.current();
+    if (n->id() < m_nodes.size()) {
+      m_nodes[n->id()] = n;
+    }
+  }
+}
+
+
+void
+ProfileCache::get(uint& mBegId, uint& mEndId, Prof::CCT::MergedNodeSet& nodes)
+{
+  DIAG_Assert(m_fs, "ProfileCache::get");
+
+  if (!m_isReading) {
+    if (fflush(m_fs) != 0 || fseek(m_fs, 0, SEEK_SET) != 0) {
+      DIAG_Throw("error reading profile cache");
+    }
+    m_isReading = true;
+  }
+
+  Hdr hdr;
+  if (fread(&hdr, sizeof(hdr), 1, m_fs) != 1) {
+    DIAG_Throw("error reading profile cache");
+  }
+
+  m_vals.resize(hdr.numVals);
+  if (hdr.numVals > 0
+      && fread(&m_vals[0], sizeof(Val), m_vals.size(), m_fs) != m_vals.size()) {
+    DIAG_Throw("error reading profile cache");
+  }
+
+  mBegId = hdr.mBegId;
+  mEndId = hdr.mEndId;
+
+  for (uint i = 0; i < m_vals.size(); ++i) {
+    const Val& x = m_vals[i];
+    Prof::CCT::ANode* n = (x.nodeId < m_nodes.size()) ? m_nodes[x.nodeId] : NULL;
+    if (n) {
+      n->setMetric(mBegId + x.mId, x.val, mEndId);
+      nodes.insert(n);
+    }
+  }
+}
+
+
+
 //***************************************************************************
 
 } // namespace ParallelAnalysis
@@ -80,6 +80,8 @@
 
 #include <lib/prof/CallPath-Profile.hpp>
 
+#include <lib/prof-lean/hpcrun-fmt.h>
+
 #include <lib/support/Unique.hpp>
 
 //*************************** Forward Declarations **************************
@@ -193,6 +195,133 @@ private:
 } // namespace ParallelAnalysis
 
 
+//***************************************************************************
+// SharedMetricDB: a metric database shared by all ranks
+//***************************************************************************
+
+namespace ParallelAnalysis {
+
+// SharedMetricDB: writes the thread-level metrics of all ranks into
+// one hpcprof-threaddb file (cf. hpcrun-fmt.h) with MPI-IO.  Each
+// rank add()s its threads in the order of its profile files, at its
+// own pace, into a node-local temporary file.  close() determines each
+// rank's regions with one MPI_Exscan, sets a file view over them and
+// copies the data there with collective writes.  All ranks must
+// construct and close() the database together.
+class SharedMetricDB
+  : public Unique // prevent copying
+{
+public:
+  // 'profile' is the canonical profile with dense CCT ids;
+  // 'numThreads' is the number of threads this rank will add
+  SharedMetricDB(const std::string& fnm,
+		 const Prof::CallPath::Profile& profile, uint numThreads,
+		 MPI_Comm comm = MPI_COMM_WORLD);
+
+  ~SharedMetricDB();
+
+  // add: buffers the non-zero values of metrics [mBegId, mEndId) of
+  // the nodes 'nodes' of the canonical profile (the nodes the thread's
+  // CCT was merged into) as this rank's next thread
+  void
+  add(const Prof::CCT::MergedNodeSet& nodes, uint mBegId, uint mEndId,
+      const std::string& name, uint groupId);
+
+  // close: (collective) writes the buffered threads, the thread index
+  // and the header
+  void
+  close();
+
+private:
+  static void
+  addViewBlk(std::vector<int>& blkLens, std::vector<MPI_Aint>& blkOffs,
+	     uint64_t off, uint64_t sz);
+
+  void
+  writeAll(uint64_t off, const char* buf, size_t bufSz);
+
+private:
+  MPI_Comm m_comm;
+  int m_myRank;
+  MPI_File m_fh;
+  std::string m_fnm;
+
+  uint m_numNodes;   // canonical CCT (max dense id)
+  uint m_numThreads; // all ranks
+  uint m_threadBeg;  // index of this rank's first thread
+
+  std::vector<hpcthreadDB_fmt_idx_t> m_idx; // this rank's threads
+
+  FILE* m_bufFs; // this rank's thread data (offsets relative to it)
+};
+
+} // namespace ParallelAnalysis
+
+
+//***************************************************************************
+// ProfileCache: the metric values of this rank's profiles
+//***************************************************************************
+
+namespace ParallelAnalysis {
+
+// ProfileCache: keeps, for each of this rank's profiles, the values it
+// contributes to the canonical CCT as (node id, metric, value) tuples,
+// so that a later pass can replay them instead of reading the profile
+// and merging it again.  Profiles are get() in the order they were
+// put(); the tuples are spilled to a node-local temporary file.
+class ProfileCache
+  : public Unique // prevent copying
+{
+public:
+  ProfileCache();
+
+  ~ProfileCache();
+
+  // isValid: false if the spill file could not be created
+  bool
+  isValid() const
+  { return (m_fs != NULL); }
+
+  // put: saves the non-zero values of metrics [mBegId, mEndId) of the
+  // nodes 'nodes' of the canonical profile (with dense CCT ids) as the
+  // next profile's
+  void
+  put(const Prof::CCT::MergedNodeSet& nodes, uint mBegId, uint mEndId);
+
+  // mapNodeIds: notes the node of each dense id used by put().  Call
+  // before the ids of the canonical profile are renumbered; values of
+  // nodes deleted by then are dropped by get().
+  void
+  mapNodeIds(const Prof::CallPath::Profile& profile);
+
+  // get: sets the next profile's values into the canonical profile
+  // and returns its metrics in [mBegId, mEndId) and the nodes it set
+  // in 'nodes'.  Assumes these metrics are zero.
+  void
+  get(uint& mBegId, uint& mEndId, Prof::CCT::MergedNodeSet& nodes);
+
+private:
+  struct Hdr {
+    uint32_t mBegId, mEndId;
+    uint64_t numVals;
+  };
+
+  struct Val {
+    uint32_t nodeId;
+    uint32_t mId; // relative to mBegId
+    double   val;
+  };
+
+  FILE* m_fs;
+  bool  m_isReading;
+
+  std::vector<Prof::CCT::ANode*> m_nodes; // by dense id (cf. put())
+  std::vector<Val> m_vals;
+};
+
+} // namespace ParallelAnalysis
+
+
 //***************************************************************************
 // reduce/broadcast
 //***************************************************************************
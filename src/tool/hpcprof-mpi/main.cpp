@@ -119,14 +119,16 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 		   const Analysis::Args& args,
 		   const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		   const vector<uint>& groupIdToGroupSizeMap,
-		   int myRank, int numRanks);
+		   int myRank, int numRanks,
+		   ParallelAnalysis::ProfileCache* cache);
 
 static void
 makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const Analysis::Args& args,
 		  const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		  const vector<uint>& groupIdToGroupSizeMap,
-		  int myRank, int numRanks);
+		  int myRank, int numRanks,
+		  ParallelAnalysis::ProfileCache* cache);
 
 static uint
 makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
@@ -142,13 +144,14 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		       const string& profileFile,
 		       const Analysis::Args& args, uint groupId, uint groupMax,
 		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
-		       int myRank);
+		       int myRank, ParallelAnalysis::ProfileCache* cache);
 
 static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		      const string& profileFile,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
-		      int myRank);
+		      int myRank, ParallelAnalysis::SharedMetricDB* sharedDB,
+		      ParallelAnalysis::ProfileCache* cache);
 
 static string
 makeDBFileName(const string& dbDir, uint groupId, const string& profileFile);
@@ -304,7 +307,8 @@ realmain(int argc, char* const* argv)
   int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
   uint rFlags = (Prof::CallPath::Profile::RFlg_VirtualMetrics
 		 | Prof::CallPath::Profile::RFlg_NoMetricSfx
-		 | Prof::CallPath::Profile::RFlg_MakeInclExcl);
+		 | Prof::CallPath::Profile::RFlg_MakeInclExcl
+		 | Prof::CallPath::Profile::RFlg_SparseMetrics);
   Analysis::Util::UIntVec* groupMap =
     (nArgs.groupMax > 1) ? nArgs.groupMap : NULL;
 
@@ -365,9 +369,24 @@ realmain(int argc, char* const* argv)
   // 2a. Create summary metrics for canonical CCT
   //
   // Post-INVARIANT: rank 0's 'profGbl' contains summary metrics
+  //
+  // Each local profile is read only here: its trace is normalized and
+  // the values it merges into the canonical CCT are cached for 2c.
+  // (Cilk normalization merges CCT nodes, which the cached values
+  // cannot follow.)
   // -------------------------------------------------------
+  ParallelAnalysis::ProfileCache* cache = NULL;
+  if (args.agent != "agent-cilk") {
+    cache = new ParallelAnalysis::ProfileCache;
+    if (!cache->isValid()) {
+      DIAG_WMsgIf(myRank == 0, "cannot create a profile cache; profiles will be read twice");
+      delete cache;
+      cache = NULL;
+    }
+  }
+
   makeSummaryMetrics(*profGbl, args, nArgs, groupIdToGroupSizeMap,
-		     myRank, numRanks);
+		     myRank, numRanks, cache);
 
   // -------------------------------------------------------
   // 2b. Prune and normalize canonical CCT
@@ -400,6 +419,11 @@ realmain(int argc, char* const* argv)
     Analysis::CallPath::applySummaryMetricAgents(*profGbl, args.agent);
   }
 
+  // N.B.: cached values refer to the node ids of 2a
+  if (cache && args.db_makeMetricDB) {
+    cache->mapNodeIds(*profGbl);
+  }
+
   // N.B.: Dense ids are assigned w.r.t. Prof::CCT::...::cmpByStructureInfo()
   profGbl->cct()->makeDensePreorderIds();
 
@@ -407,7 +431,9 @@ realmain(int argc, char* const* argv)
   // 2c. Create thread-level metric DB // Normalize trace files
   // -------------------------------------------------------
   makeThreadMetrics(*profGbl, args, nArgs, groupIdToGroupSizeMap,
-		    myRank, numRanks);
+		    myRank, numRanks, cache);
+
+  delete cache;
   
   // ------------------------------------------------------------
   // 3. Generate Experiment database
@@ -571,7 +597,8 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 		   const Analysis::Args& args,
 		   const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		   const vector<uint>& groupIdToGroupSizeMap,
-		   int myRank, int numRanks)
+		   int myRank, int numRanks,
+		   ParallelAnalysis::ProfileCache* cache)
 {
   uint mDrvdBeg = 0, mDrvdEnd = 0;   // [ )
   uint mXDrvdBeg = 0, mXDrvdEnd = 0; // [ )
@@ -596,7 +623,7 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
     const string& fnm = (*nArgs.paths)[i];
     uint groupId = (*nArgs.groupMap)[i];
     makeSummaryMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax,
-			   groupIdToGroupMetricsMap, myRank);
+			   groupIdToGroupMetricsMap, myRank, cache);
   }
 
   // -------------------------------------------------------
@@ -661,13 +688,40 @@ makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const Analysis::Args& args,
 		  const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		  const vector<uint>& groupIdToGroupSizeMap,
-		  int myRank, int numRanks)
+		  int myRank, int numRanks,
+		  ParallelAnalysis::ProfileCache* cache)
 {
-  for (uint i = 0; i < nArgs.paths->size(); ++i) {
+  uint numFiles = nArgs.paths->size();
+
+  // traces were normalized with the summary metrics; only the
+  // metric-db remains
+  if (cache && !args.db_makeMetricDB) {
+    return;
+  }
+
+  if (!(args.db_makeMetricDB && args.db_sharedMetricDB)) {
+    for (uint i = 0; i < numFiles; ++i) {
+      string& fnm = (*nArgs.paths)[i];
+      uint groupId = (*nArgs.groupMap)[i];
+      makeThreadMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax,
+			    myRank, NULL, cache);
+    }
+    return;
+  }
+
+  // All ranks write into one shared metric-db.  Each rank buffers its
+  // profiles independently; only construction and close() synchronize.
+  string sharedFnm = args.db_dir + "/" + HPCPROF_ThreadDBFnm;
+  ParallelAnalysis::SharedMetricDB sharedDB(sharedFnm, profGbl, numFiles);
+
+  for (uint i = 0; i < numFiles; ++i) {
     string& fnm = (*nArgs.paths)[i];
     uint groupId = (*nArgs.groupMap)[i];
-    makeThreadMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax, myRank);
+    makeThreadMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax,
+			  myRank, &sharedDB, cache);
   }
+
+  sharedDB.close();
 }
 
 
@@ -777,7 +831,7 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		       const string& profileFile,
 		       const Analysis::Args& args, uint groupId, uint groupMax,
 		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
-		       int myRank)
+		       int myRank, ParallelAnalysis::ProfileCache* cache)
 {
   Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
   Prof::CCT::Tree* cctGbl = profGbl.cct();
@@ -798,6 +852,13 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   // -------------------------------------------------------
   int mergeTy  = Prof::CallPath::Profile::Merge_MergeMetricByName;
   int mergeFlg = (Prof::CCT::MrgFlg_AssertCCTMergeOnly);
+  if (cache) {
+    // makeThreadMetrics_Lcl() will not see this profile again
+    mergeFlg |= Prof::CCT::MrgFlg_NormalizeTraceFileY;
+    if (args.db_remapTraces) {
+      mergeFlg |= Prof::CCT::MrgFlg_RemapTraceFileY;
+    }
+  }
 
   // Add *some* structure information to the leaves of 'prof' so that
   // it will be merged successfully with the structured canonical CCT
@@ -813,8 +874,16 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   Analysis::CallPath::noteStaticStructureOnLeaves(*prof);
   prof->structure(NULL);
 
-  uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
-  uint mEnd = mBeg + prof->metricMgr()->size();        //  open end)
+  // N.B.: Only the merged nodes (and their ancestors) receive values
+  // from 'prof'; the passes below visit only them.
+  Prof::CCT::MergedNodeSet mrgNodes;
+
+  uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg, &mrgNodes); // [closed begin
+  uint mEnd = mBeg + prof->metricMgr()->size();                   //  open end)
+
+  if (cache && args.db_makeMetricDB) {
+    cache->put(mrgNodes, mBeg, mEnd);
+  }
 
   // -------------------------------------------------------
   // compute local incl/excl sampled metrics and update local derived metrics
@@ -834,11 +903,12 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
     }
   }
 
-  cctRootGbl->aggregateMetricsIncl(ivalsetIncl);
-  cctRootGbl->aggregateMetricsExcl(ivalsetExcl);
+  cctRootGbl->aggregateMetricsIncl(ivalsetIncl, mrgNodes);
+  cctRootGbl->aggregateMetricsExcl(ivalsetExcl, mrgNodes);
 
 
-  // 2. Batch compute local derived metrics
+  // 2. Batch compute local derived metrics (N.B.: visits all nodes;
+  //    e.g., a minimum must accumulate the zeros of untouched nodes)
   const VMAIntervalSet* ivalsetDrvd = groupIdToGroupMetricsMap[groupId];
   if (ivalsetDrvd) {
     DIAG_Assert(ivalsetDrvd->size() == 1, DIAG_UnexpectedInput);
@@ -861,7 +931,7 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   // two; and (b) use a CCT init (which whould initialize using
   // assignment) instead of CCT::merge() (which initializes based on
   // addition against 0).
-  cctRootGbl->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
+  cctRootGbl->zeroMetricsDeep(mBeg, mEnd, mrgNodes); // cf. FnInitSrc
   
   delete prof;
 }
@@ -873,52 +943,66 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 // exception: Each thread-level CCT does not have to be a subset of
 // 'profGbl' (the canonical CCT); in other words, 'profGbl' may be
 // pruned.
+//
+// With a 'cache', the profile is not read again: its values are
+// replayed from the cache (cf. makeSummaryMetrics_Lcl()).
 static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		      const string& profileFile,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
-		      int myRank)
+		      int myRank, ParallelAnalysis::SharedMetricDB* sharedDB,
+		      ParallelAnalysis::ProfileCache* cache)
 {
   Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
   Prof::CCT::Tree* cctGbl = profGbl.cct();
   Prof::CCT::ANode* cctRootGbl = cctGbl->root();
 
-  // -------------------------------------------------------
-  // read profile file
-  // -------------------------------------------------------
-  uint rFlags = (Prof::CallPath::Profile::RFlg_NoMetricSfx
-		 | Prof::CallPath::Profile::RFlg_MakeInclExcl);
-  uint rGroupId = (groupMax > 1) ? groupId : 0;
+  Prof::CallPath::Profile* prof = NULL;
+  uint mBeg = 0, mEnd = 0; // [ )
+  Prof::CCT::MergedNodeSet mrgNodes;
 
-  Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
+  if (cache) {
+    cache->get(mBeg, mEnd, mrgNodes);
+  }
+  else {
+    // -------------------------------------------------------
+    // read profile file
+    // -------------------------------------------------------
+    uint rFlags = (Prof::CallPath::Profile::RFlg_NoMetricSfx
+		   | Prof::CallPath::Profile::RFlg_MakeInclExcl);
+    uint rGroupId = (groupMax > 1) ? groupId : 0;
 
-  // -------------------------------------------------------
-  // merge into canonical CCT
-  // -------------------------------------------------------
-  int mergeTy  = Prof::CallPath::Profile::Merge_MergeMetricByName;
-  int mergeFlg = (Prof::CCT::MrgFlg_NormalizeTraceFileY
-		  | Prof::CCT::MrgFlg_CCTMergeOnly);
+    prof = Analysis::CallPath::read(profileFile, rGroupId, rFlags);
 
-  // Add *some* structure information to the leaves of 'prof' so that
-  // it will be merged successfully with the structured canonical CCT
-  // 'profGbl'.
-  //
-  // Background: When CCT::Stmts are merged in
-  // Analysis::CallPath::coalesceStmts(CallPath::Profile), IP/LIP
-  // information is not retained.  This means that when merging 'prof'
-  // into 'profGbl' (using CallPath::Profile::merge()), many leaves in
-  // 'prof' will not find their corresponding node in 'profGbl' unless
-  // corrective measures are taken.
-  prof->structure(profGbl.structure());
-  Analysis::CallPath::noteStaticStructureOnLeaves(*prof);
-  prof->structure(NULL);
+    // -------------------------------------------------------
+    // merge into canonical CCT
+    // -------------------------------------------------------
+    int mergeTy  = Prof::CallPath::Profile::Merge_MergeMetricByName;
+    int mergeFlg = (Prof::CCT::MrgFlg_NormalizeTraceFileY
+		    | Prof::CCT::MrgFlg_CCTMergeOnly);
+    if (args.db_remapTraces) {
+      mergeFlg |= Prof::CCT::MrgFlg_RemapTraceFileY;
+    }
 
-  uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
+    // Add *some* structure information to the leaves of 'prof' so that
+    // it will be merged successfully with the structured canonical CCT
+    // 'profGbl'.
+    //
+    // Background: When CCT::Stmts are merged in
+    // Analysis::CallPath::coalesceStmts(CallPath::Profile), IP/LIP
+    // information is not retained.  This means that when merging 'prof'
+    // into 'profGbl' (using CallPath::Profile::merge()), many leaves in
+    // 'prof' will not find their corresponding node in 'profGbl' unless
+    // corrective measures are taken.
+    prof->structure(profGbl.structure());
+    Analysis::CallPath::noteStaticStructureOnLeaves(*prof);
+    prof->structure(NULL);
+
+    mBeg = profGbl.merge(*prof, mergeTy, mergeFlg, &mrgNodes); // [closed begin
+    mEnd = mBeg + prof->metricMgr()->size();                   //  open end)
+  }
 
   if (args.db_makeMetricDB) {
-    uint mEnd = mBeg + prof->metricMgr()->size(); // open end)
-
     // -------------------------------------------------------
     // compute local incl/excl sampled metrics
     // -------------------------------------------------------
@@ -936,22 +1020,29 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
       }
     }
     
-    cctRootGbl->aggregateMetricsIncl(ivalsetIncl);
-    cctRootGbl->aggregateMetricsExcl(ivalsetExcl);
+    cctRootGbl->aggregateMetricsIncl(ivalsetIncl, mrgNodes);
+    cctRootGbl->aggregateMetricsExcl(ivalsetExcl, mrgNodes);
 
     // -------------------------------------------------------
     // write local sampled metric values into database
     // -------------------------------------------------------
 
-    string dbFnm = makeDBFileName(args.db_dir, groupId, profileFile);
-    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    if (sharedDB) {
+      string nm =
+	FileUtil::rmSuffix(FileUtil::basename(profileFile.c_str()));
+      sharedDB->add(mrgNodes, mBeg, mEnd, nm, groupId);
+    }
+    else {
+      string dbFnm = makeDBFileName(args.db_dir, groupId, profileFile);
+      writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    }
 
     // -------------------------------------------------------
     // reinitialize metric values for next time
     // -------------------------------------------------------
     
     // TODO: see corresponding comments in makeSummaryMetrics_Lcl()
-    cctRootGbl->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
+    cctRootGbl->zeroMetricsDeep(mBeg, mEnd, mrgNodes); // cf. FnInitSrc
   }
 
   delete prof;
@@ -68,8 +68,12 @@ using std::string;
 
 //*************************** User Include Files ****************************
 
+#include <include/hpctoolkit-config.h>
+
 #include "Args.hpp"
 
+#include <lib/support/diagnostics.h>
+
 //*************************** Forward Declarations **************************
 
 // Cf. DIAG_Die.
@@ -90,6 +94,7 @@ Args::Args()
 {
   hpcprof_isMetricArg = false;
   hpcprof_forceMetrics = false;
+  hpcprof_jobs = 1;
 }
 
 
@@ -111,6 +116,24 @@ Args::parse(int argc, const char* const argv[])
     hpcprof_forceMetrics = true;
   }
 
+  if (parser.isOpt("jobs")) {
+    const string& arg = parser.getOptArg("jobs");
+    try {
+      hpcprof_jobs = (int) CmdLineParser::toLong(arg);
+    }
+    catch (const CmdLineParser::Exception& x) {
+      ARG_ERROR("--jobs/-j option: " << x.message());
+    }
+    if (hpcprof_jobs < 1) {
+      ARG_ERROR("--jobs/-j option requires a positive number of threads");
+    }
+#ifndef ENABLE_OPENMP
+    DIAG_WMsgIf(hpcprof_jobs > 1, "--jobs/-j option ignored: "
+		"hpcprof was built without OpenMP, reading profiles serially");
+    hpcprof_jobs = 1;
+#endif
+  }
+
   // Currently, hpcprof does not generate thread-level metric db
   db_makeMetricDB = false;
 }
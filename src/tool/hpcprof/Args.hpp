@@ -95,6 +95,7 @@ public:
   // Parsed Data
   bool hpcprof_isMetricArg;
   bool hpcprof_forceMetrics;
+  int  hpcprof_jobs;
 
 }; 
 
@@ -176,9 +176,13 @@ realmain(int argc, char* const* argv)
     rFlags |= Prof::CallPath::Profile::RFlg_MakeInclExcl;
   }
   uint mrgFlags = (Prof::CCT::MrgFlg_NormalizeTraceFileY);
+  if (args.db_remapTraces) {
+    mrgFlags |= Prof::CCT::MrgFlg_RemapTraceFileY;
+  }
 
   Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags);
+    Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags,
+			     args.hpcprof_jobs);
 
   prof->disable_redundancy(args.remove_redundancy);
 
@@ -100,7 +100,8 @@ static const char* usage_summary =
 static const char* usage_details =
 		 "hpcproftt generates textual dumps of call path profiles\n"
 		 "recorded by hpcrun.  The profile list may contain one or\n"
-		 "more call path profiles.\n"
+		 "more call path profiles, metric databases, trace files or\n"
+		 "binary CCT databases (experiment.cctdb).\n"
 		 "\n"
 		 "Options:\n"
 		 "  -V, --version        Print version information.\n"
@@ -83,6 +83,8 @@ static bool retain_recursion = false;
 
 static hpcrun_kernel_callpath_t hpcrun_kernel_callpath;
 
+static hpcrun_user_callchain_t hpcrun_user_callchain;
+
 
 void
 hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp) 
@@ -90,6 +92,13 @@ hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp)
 	hpcrun_kernel_callpath = kcp;
 }
 
+
+void
+hpcrun_user_callchain_register(hpcrun_user_callchain_t ucc)
+{
+	hpcrun_user_callchain = ucc;
+}
+
 static cct_node_t*
 cct_insert_raw_backtrace(cct_node_t* cct,
                             frame_t* path_beg, frame_t* path_end)
@@ -376,7 +385,17 @@ help_hpcrun_backtrace2cct(cct_bundle_t* bundle, ucontext_t* context,
   thread_data_t* td = hpcrun_get_thread_data();
   backtrace_info_t bt;
 
-  bool success = hpcrun_generate_backtrace(&bt, context, skipInner);
+  // take the call path from the sample's call chain, if it has one;
+  // trampolines need the return address locations of a real unwind
+  void **ips = NULL;
+  int nips = 0;
+  if (hpcrun_user_callchain && data && ! ENABLED(USE_TRAMP)) {
+    nips = hpcrun_user_callchain(data, &ips);
+  }
+
+  bool success = (nips > 0
+		  && hpcrun_generate_backtrace_from_callchain(&bt, ips, nips, skipInner))
+    || hpcrun_generate_backtrace(&bt, context, skipInner);
 
   assert(!success == bt.partial_unwind);
 
@@ -54,6 +54,10 @@
 
 typedef  cct_node_t *(*hpcrun_kernel_callpath_t)(cct_node_t *path, void *data_aux);
 
+// returns the number of user frames in the call chain recorded with a
+// sample (innermost first, in *ips), or 0 to unwind the context instead
+typedef  int (*hpcrun_user_callchain_t)(void *data_aux, void ***ips);
+
 //
 // interface routines
 //
@@ -103,6 +107,8 @@ extern cct_node_t* hpcrun_backtrace2cct(cct_bundle_t* cct, ucontext_t* context,
 
 extern void hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp);
 
+extern void hpcrun_user_callchain_register(hpcrun_user_callchain_t ucc);
+
 //
 // debug version of hpcrun_backtrace2cct:
 //   simulates errors to test partial unwind capability
@@ -29,6 +29,11 @@ typedef struct core_profile_trace_data_t {
   uint64_t trace_min_time_us;
   uint64_t trace_max_time_us;
 
+  // block-encoded traces (HPCRUN_TRACE_COMPRESS)
+  struct hpctrace_fmt_blk_t* trace_blk;
+  struct trace_blkidx_chunk_t* trace_blkidx; // newest chunk first
+  uint64_t trace_offset; // file offset of 'trace_blk'
+
   // ----------------------------------------
   // IO support
   // ----------------------------------------
@@ -49,6 +49,11 @@ const char* HPCRUN_OPT_LUSH_AGENTS = "HPCRUN_OPT_LUSH_AGENTS";
 
 const char* HPCRUN_OUT_PATH        = "HPCRUN_OUT_PATH";
 const char* HPCRUN_TRACE           = "HPCRUN_TRACE";
+const char* HPCRUN_TRACE_COMPRESS  = "HPCRUN_TRACE_COMPRESS";
+const char* HPCRUN_TRACE_ASYNC     = "HPCRUN_TRACE_ASYNC";
+
+const char* HPCRUN_FNBOUNDS_CACHE  = "HPCRUN_FNBOUNDS_CACHE";
+const char* HPCRUN_UNWIND_CACHE    = "HPCRUN_UNWIND_CACHE";
 
 const char* PAPI_EVENT_LIST        = "PAPI_EVENT_LIST";
 
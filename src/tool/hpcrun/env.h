@@ -84,6 +84,11 @@ extern const char* HPCRUN_OPT_LUSH_AGENTS;
 extern const char* HPCRUN_OUT_PATH;
 
 extern const char* HPCRUN_TRACE;
+extern const char* HPCRUN_TRACE_COMPRESS;
+extern const char* HPCRUN_TRACE_ASYNC;
+
+extern const char* HPCRUN_FNBOUNDS_CACHE;
+extern const char* HPCRUN_UNWIND_CACHE;
 
 extern const char* HPCRUN_EVENT_LIST;
 extern const char* HPCRUN_MEMSIZE;
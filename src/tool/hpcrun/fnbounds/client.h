@@ -3,10 +3,15 @@
 
 #include "fnbounds_file_header.h"
 
+#define SYSERV_CACHE_KEY_LEN  (2 * 64 + 1)  // == FNBOUNDS_CACHE_KEY_LEN
+
 int  hpcrun_syserv_init(void);
 
 void hpcrun_syserv_fini(void);
 
 void *hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh);
 
+// Returns: 0 on success, -1 on failure.
+int  hpcrun_syserv_cache_key(const char *fname, char *key);
+
 #endif  // _FNBOUNDS_CLIENT_H_
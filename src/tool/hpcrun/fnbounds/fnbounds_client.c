@@ -75,6 +75,17 @@
 // 6. The bottom of this file has code for an interactive, stand-alone
 // client for testing hpcfnbounds in server mode.
 //
+// 7. If HPCRUN_FNBOUNDS_CACHE names a directory, answers are also
+// kept there, keyed by the file's ELF build-id (else by its path,
+// mtime and size), and later queries for the same file -- from any
+// process -- mmap the cached table instead of asking the server.  A
+// per-key lock file makes one process compute a missing entry while
+// the others wait for it, and entries are published with rename(),
+// so readers never see a partial file.  The lock file is removed once
+// the entry is published.  The cache is in native byte
+// order and only meant to be shared by processes on the same kind of
+// host.
+//
 // Todo:
 //
 
@@ -102,9 +113,12 @@ int zero_fcn(void) { return 0; }
 //***************************************************************************
 
 #include <sys/types.h>
+#include <sys/file.h>
 #include <sys/mman.h>
+#include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <elf.h>
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -120,6 +134,7 @@ int zero_fcn(void) { return 0; }
 #include <hpcfnbounds/syserv-mesg.h>
 #include "client.h"
 #include "disabled.h"
+#include "env.h"
 #include "fnbounds_file_header.h"
 #include "messages.h"
 #include "sample_sources_all.h"
@@ -499,24 +514,367 @@ hpcrun_syserv_fini(void)
 }
 
 
+//*****************************************************************
+// Persistent fnbounds cache (HPCRUN_FNBOUNDS_CACHE)
+//*****************************************************************
+
+#if !defined(STAND_ALONE_CLIENT)
+
+#define CACHE_MAGIC    0x485043464e424332UL  // "HPCFNBC2"
+
+// The table of addresses starts at offset 'table_offset', the
+// writer's page size, so that it can be mapped on its own.
+struct cache_hdr {
+  uint64_t magic;
+  uint64_t table_offset;
+  uint64_t num_entries;
+  uint64_t reference_offset;
+  int64_t  is_relocatable;
+};
+
+
+// Read program header 'i' of ELF file 'fd' (either class) and return
+// its type, file offset and file size.
+// Returns: SUCCESS or FAILURE.
+//
+static int
+cache_read_phdr(int fd, int elf64, uint64_t phoff, int i,
+		uint64_t *type, uint64_t *offset, uint64_t *size)
+{
+  if (elf64) {
+    Elf64_Phdr phdr;
+    if (pread(fd, &phdr, sizeof(phdr), phoff + i * sizeof(phdr)) != sizeof(phdr)) {
+      return FAILURE;
+    }
+    *type = phdr.p_type;
+    *offset = phdr.p_offset;
+    *size = phdr.p_filesz;
+  }
+  else {
+    Elf32_Phdr phdr;
+    if (pread(fd, &phdr, sizeof(phdr), phoff + i * sizeof(phdr)) != sizeof(phdr)) {
+      return FAILURE;
+    }
+    *type = phdr.p_type;
+    *offset = phdr.p_offset;
+    *size = phdr.p_filesz;
+  }
+  return SUCCESS;
+}
+
+
+// Copy the hex GNU build-id of ELF file 'fd' (32 or 64-bit) into 'key'.
+// Returns: SUCCESS or FAILURE (no build-id or not a native-endian ELF
+// file).  Files with PN_XNUM program headers (the real count is in
+// section 0) also fail, and are keyed by path instead.
+//
+static int
+cache_build_id(int fd, char *key)
+{
+  union {
+    Elf32_Ehdr e32;
+    Elf64_Ehdr e64;
+  } ehdr;
+
+  if (pread(fd, &ehdr, sizeof(ehdr.e32), 0) != sizeof(ehdr.e32)
+      || memcmp(ehdr.e32.e_ident, ELFMAG, SELFMAG) != 0) {
+    return FAILURE;
+  }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  if (ehdr.e32.e_ident[EI_DATA] != ELFDATA2LSB) {
+    return FAILURE;
+  }
+#else
+  if (ehdr.e32.e_ident[EI_DATA] != ELFDATA2MSB) {
+    return FAILURE;
+  }
+#endif
+
+  int elf64 = (ehdr.e32.e_ident[EI_CLASS] == ELFCLASS64);
+  uint64_t phoff;
+  int phnum;
+
+  if (elf64) {
+    if (pread(fd, &ehdr, sizeof(ehdr.e64), 0) != sizeof(ehdr.e64)
+	|| ehdr.e64.e_phentsize != sizeof(Elf64_Phdr)) {
+      return FAILURE;
+    }
+    phoff = ehdr.e64.e_phoff;
+    phnum = ehdr.e64.e_phnum;
+  }
+  else if (ehdr.e32.e_ident[EI_CLASS] == ELFCLASS32) {
+    if (ehdr.e32.e_phentsize != sizeof(Elf32_Phdr)) {
+      return FAILURE;
+    }
+    phoff = ehdr.e32.e_phoff;
+    phnum = ehdr.e32.e_phnum;
+  }
+  else {
+    return FAILURE;
+  }
+  if (phnum == 0 || phnum == PN_XNUM) {
+    return FAILURE;
+  }
+
+  for (int i = 0; i < phnum; i++) {
+    uint64_t type, offset, size;
+    if (cache_read_phdr(fd, elf64, phoff, i, &type, &offset, &size) != SUCCESS) {
+      return FAILURE;
+    }
+    if (type != PT_NOTE) {
+      continue;
+    }
+    unsigned char notes[1024];
+    if (size > sizeof(notes)) {
+      size = sizeof(notes);
+    }
+    if (pread(fd, notes, size, offset) != size) {
+      continue;
+    }
+
+    size_t pos = 0;
+    while (pos + sizeof(Elf64_Nhdr) <= size) {
+      Elf64_Nhdr *nhdr = (Elf64_Nhdr *) (notes + pos);
+      size_t name_off = pos + sizeof(Elf64_Nhdr);
+      size_t desc_off = name_off + ((nhdr->n_namesz + 3) & ~3);
+      size_t next = desc_off + ((nhdr->n_descsz + 3) & ~3);
+      if (next > size) {
+	break;
+      }
+      if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4
+	  && memcmp(notes + name_off, "GNU", 4) == 0
+	  && nhdr->n_descsz > 0 && nhdr->n_descsz <= 64) {
+	for (int k = 0; k < nhdr->n_descsz; k++) {
+	  sprintf(key + 2 * k, "%02x", notes[desc_off + k]);
+	}
+	return SUCCESS;
+      }
+      pos = next;
+    }
+  }
+
+  return FAILURE;
+}
+
+
+// Compute the cache key for 'fname': its build-id if it has one,
+// else a hash of its path, mtime and size.  'key' must have room for
+// SYSERV_CACHE_KEY_LEN chars.  Also used by the unwind recipe cache.
+// Returns: SUCCESS or FAILURE.
+//
+int
+hpcrun_syserv_cache_key(const char *fname, char *key)
+{
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    return FAILURE;
+  }
+
+  struct stat st;
+  int ret = fstat(fd, &st);
+  if (ret == 0 && cache_build_id(fd, key) != SUCCESS) {
+    uint64_t hash = 14695981039346656037UL;  // FNV-1a
+    for (const char *c = fname; *c != 0; c++) {
+      hash = (hash ^ (unsigned char) *c) * 1099511628211UL;
+    }
+    snprintf(key, SYSERV_CACHE_KEY_LEN, "p%016lx-%lx-%lx", (unsigned long) hash,
+	     (unsigned long) st.st_mtime, (unsigned long) st.st_size);
+  }
+  close(fd);
+
+  return (ret == 0) ? SUCCESS : FAILURE;
+}
+
+
+static void
+cache_path(char *path, const char *dir, const char *key, const char *sfx)
+{
+  snprintf(path, PATH_MAX, "%s/%s.%s", dir, key, sfx);
+}
+
+
+// Returns: the cached table for 'key' (mmapped read-only) and fills
+// in 'fh', or else NULL if there is no valid entry.  As with the
+// server's answer, the table is the start of its own mapping of
+// fh->mmap_size bytes.
+//
+static void *
+cache_map(const char *dir, const char *key, struct fnbounds_file_header *fh)
+{
+  char path[PATH_MAX];
+  cache_path(path, dir, key, "fnb");
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  struct cache_hdr hdr;
+  if (fstat(fd, &st) != 0
+      || read_all(fd, &hdr, sizeof(hdr)) != SUCCESS
+      || hdr.magic != CACHE_MAGIC
+      || hdr.table_offset < sizeof(hdr)
+      || page_align(hdr.table_offset) != hdr.table_offset
+      || st.st_size != hdr.table_offset + hdr.num_entries * sizeof(void *)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t mmap_size = page_align(hdr.num_entries * sizeof(void *));
+  void *addr = mmap(NULL, mmap_size, PROT_READ, MAP_PRIVATE, fd,
+		    hdr.table_offset);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return NULL;
+  }
+
+  fh->num_entries = hdr.num_entries;
+  fh->reference_offset = hdr.reference_offset;
+  fh->is_relocatable = hdr.is_relocatable;
+  fh->mmap_size = mmap_size;
+
+  return addr;
+}
+
+
+// Publish the server's answer for 'key'.  Errors only mean that the
+// entry is not cached.
+//
+static void
+cache_store(const char *dir, const char *key, void *table,
+	    struct fnbounds_file_header *fh)
+{
+  char path[PATH_MAX], tmp_path[PATH_MAX];
+  char sfx[64];
+
+  cache_path(path, dir, key, "fnb");
+  snprintf(sfx, sizeof(sfx), "fnb.%d", (int) getpid());
+  cache_path(tmp_path, dir, key, sfx);
+
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    TMSG(SYSTEM_SERVER, "cache: unable to create %s", tmp_path);
+    return;
+  }
+
+  struct cache_hdr hdr;
+  hdr.magic = CACHE_MAGIC;
+  hdr.table_offset = page_align(sizeof(hdr));
+  hdr.num_entries = fh->num_entries;
+  hdr.reference_offset = fh->reference_offset;
+  hdr.is_relocatable = fh->is_relocatable;
+
+  int ok = (write_all(fd, &hdr, sizeof(hdr)) == SUCCESS
+	    && lseek(fd, hdr.table_offset, SEEK_SET) == (off_t) hdr.table_offset
+	    && write_all(fd, table, fh->num_entries * sizeof(void *)) == SUCCESS);
+  ok = (close(fd) == 0) && ok;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    TMSG(SYSTEM_SERVER, "cache: unable to write %s", path);
+    unlink(tmp_path);
+  }
+}
+
+
+// Returns: a locked fd on the lock file for 'key', or -1.
+//
+static int
+cache_lock(const char *dir, const char *key)
+{
+  char path[PATH_MAX];
+  cache_path(path, dir, key, "lock");
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+  while (flock(fd, LOCK_EX) != 0) {
+    if (errno != EINTR) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+
+// Release and remove the lock file for 'key'.  Removing it while
+// still locked is safe: a process that opened the old file gets the
+// lock after us and rechecks the cache; one that creates a new file
+// does the same.
+//
+static void
+cache_unlock(int fd, const char *dir, const char *key)
+{
+  if (fd >= 0) {
+    char path[PATH_MAX];
+    cache_path(path, dir, key, "lock");
+    unlink(path);
+    flock(fd, LOCK_UN);
+    close(fd);
+  }
+}
+
+#endif  // !STAND_ALONE_CLIENT
+
+
 //*****************************************************************
 // Query the System Server
 //*****************************************************************
 
+static void *
+syserv_query(const char *fname, struct fnbounds_file_header *fh);
+
+
 // Returns: pointer to array of void * and fills in the file header,
 // or else NULL on error.
 //
 void *
 hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
 {
-  struct syserv_mesg mesg;
-  void *addr;
-
   if (fname == NULL || fh == NULL) {
     EMSG("SYSTEM_SERVER ERROR: passed NULL pointer to %s", __func__);
     return NULL;
   }
 
+#if !defined(STAND_ALONE_CLIENT)
+  const char *dir = getenv(HPCRUN_FNBOUNDS_CACHE);
+  char key[SYSERV_CACHE_KEY_LEN];
+
+  if (dir != NULL && *dir != 0
+      && hpcrun_syserv_cache_key(fname, key) == SUCCESS) {
+    void *addr = cache_map(dir, key, fh);
+    if (addr != NULL) {
+      TMSG(SYSTEM_SERVER, "cache hit: %s (%s)", fname, key);
+      return addr;
+    }
+
+    // recheck under the lock: another process may have just added it
+    int lock_fd = cache_lock(dir, key);
+    addr = cache_map(dir, key, fh);
+    if (addr == NULL) {
+      addr = syserv_query(fname, fh);
+      if (addr != NULL && lock_fd >= 0) {
+	cache_store(dir, key, addr, fh);
+      }
+    }
+    cache_unlock(lock_fd, dir, key);
+
+    return addr;
+  }
+#endif
+
+  return syserv_query(fname, fh);
+}
+
+
+static void *
+syserv_query(const char *fname, struct fnbounds_file_header *fh)
+{
+  struct syserv_mesg mesg;
+  void *addr;
+
   if (client_status != SYSERV_ACTIVE || my_pid != getpid()) {
     launch_server();
   }
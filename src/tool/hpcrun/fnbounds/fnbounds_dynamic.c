@@ -402,6 +402,13 @@ fnbounds_release_lock(void)
 }
 
 
+bool
+fnbounds_cache_key(const char *module_name, char *key)
+{
+  return hpcrun_syserv_cache_key(module_name, key) == 0;
+}
+
+
 fnbounds_table_t
 fnbounds_fetch_executable_table(void)
 {
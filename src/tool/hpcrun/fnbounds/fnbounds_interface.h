@@ -75,6 +75,15 @@ fnbounds_ensure_mapped_dso(const char *module_name, void *start, void *end);
 void
 fnbounds_fini();
 
+// fnbounds_cache_key(): Compute the key that the persistent caches use
+// for load module 'module_name' (its ELF build-id, if it has one).
+// 'key' must have room for FNBOUNDS_CACHE_KEY_LEN chars.
+// Returns: true on success.
+#define FNBOUNDS_CACHE_KEY_LEN  (2 * 64 + 1)
+
+bool
+fnbounds_cache_key(const char *module_name, char *key);
+
 void
 fnbounds_release_lock(void);
 
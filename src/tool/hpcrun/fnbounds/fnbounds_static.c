@@ -150,6 +150,14 @@ fnbounds_fini()
 }
 
 
+// static executables are not cached
+bool
+fnbounds_cache_key(const char *module_name, char *key)
+{
+  return false;
+}
+
+
 void
 fnbounds_release_lock(void)
 {
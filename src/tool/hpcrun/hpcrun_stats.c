@@ -45,11 +45,20 @@
 // ******************************************************* EndRiceCopyright *
 
 
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <string.h>
+
+
 //***************************************************************************
 // local include files
 //***************************************************************************
 #include "sample_event.h"
 #include "disabled.h"
+#include "thread_data.h"
+#include "hpcrun_stats.h"
 
 #include <memory/hpcrun-malloc.h>
 #include <messages/messages.h>
@@ -63,40 +72,120 @@
 // local variables
 //***************************************************************************
 
-static atomic_long num_samples_total = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_attempted = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_blocked_async = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_blocked_dlopen = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_dropped = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_segv = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_partial = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_yielded = ATOMIC_VAR_INIT(0);
+// The counters live in each thread's thread_data_t, so that the
+// signal handlers never share a cache line across threads.  Every
+// thread's counters are kept on a list and summed when reporting.
+// Increments that happen when a thread has no thread data go into
+// the shared counters below.
+
+static _Atomic(hpcrun_thread_stats_t *) thread_stats_list = ATOMIC_VAR_INIT(NULL);
+
+static atomic_long shared_stats[HPCRUN_NUM_STATS];
+
+
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+static inline void
+stats_add(int stat, long amt)
+{
+  thread_data_t *td = hpcrun_safe_get_td();
+
+  if (td != NULL) {
+    // relaxed atomic: other threads read the counter while we add
+    __atomic_fetch_add(&td->stats.count[stat], amt, __ATOMIC_RELAXED);
+  } else {
+    atomic_fetch_add_explicit(&shared_stats[stat], amt, memory_order_relaxed);
+  }
+}
+
+
+static void
+stats_sum(long total[])
+{
+  hpcrun_thread_stats_t *ts;
+  int k;
+
+  for (k = 0; k < HPCRUN_NUM_STATS; k++) {
+    total[k] = atomic_load_explicit(&shared_stats[k], memory_order_relaxed);
+  }
+
+  for (ts = atomic_load_explicit(&thread_stats_list, memory_order_acquire);
+       ts != NULL; ts = ts->next) {
+    for (k = 0; k < HPCRUN_NUM_STATS; k++) {
+      total[k] += __atomic_load_n(&ts->count[k], __ATOMIC_RELAXED);
+    }
+  }
+}
+
+
+static long
+stats_total(int stat)
+{
+  hpcrun_thread_stats_t *ts;
+  long total = atomic_load_explicit(&shared_stats[stat], memory_order_relaxed);
+
+  for (ts = atomic_load_explicit(&thread_stats_list, memory_order_acquire);
+       ts != NULL; ts = ts->next) {
+    total += __atomic_load_n(&ts->count[stat], __ATOMIC_RELAXED);
+  }
 
-static atomic_long num_unwind_intervals_total = ATOMIC_VAR_INIT(0);
-static atomic_long num_unwind_intervals_suspicious = ATOMIC_VAR_INIT(0);
+  return total;
+}
 
-static atomic_long trolled = ATOMIC_VAR_INIT(0);
-static atomic_long frames_total = ATOMIC_VAR_INIT(0);
-static atomic_long trolled_frames = ATOMIC_VAR_INIT(0);
 
 //***************************************************************************
 // interface operations
 //***************************************************************************
 
+// Clear the totals and restart the thread list with only the
+// calling thread, whose thread data is already initialized.
 void
 hpcrun_stats_reinit(void)
 {
-  atomic_store_explicit(&num_samples_total, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_attempted, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_blocked_async, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_blocked_dlopen, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_dropped, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_segv, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_unwind_intervals_total, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_unwind_intervals_suspicious, 0, memory_order_relaxed);
-  atomic_store_explicit(&trolled, 0, memory_order_relaxed);
-  atomic_store_explicit(&frames_total, 0, memory_order_relaxed);
-  atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
+  int k;
+
+  for (k = 0; k < HPCRUN_NUM_STATS; k++) {
+    atomic_store_explicit(&shared_stats[k], 0, memory_order_relaxed);
+  }
+  atomic_store_explicit(&thread_stats_list, NULL, memory_order_relaxed);
+
+  thread_data_t *td = hpcrun_safe_get_td();
+  if (td != NULL) {
+    hpcrun_stats_thread_init(&td->stats);
+    hpcrun_stats_thread_register(&td->stats, td->core_profile_trace_data.id);
+  }
+}
+
+
+//-----------------------------
+// per-thread counters
+//-----------------------------
+
+void
+hpcrun_stats_thread_init(hpcrun_thread_stats_t *ts)
+{
+  memset(ts->count, 0, sizeof(ts->count));
+  ts->id = -1;
+  ts->next = NULL;
+}
+
+
+// Add a newly allocated thread's counters to the list.  Each
+// hpcrun_thread_stats_t must be registered only once.
+void
+hpcrun_stats_thread_register(hpcrun_thread_stats_t *ts, int id)
+{
+  hpcrun_thread_stats_t *head;
+
+  ts->id = id;
+  head = atomic_load_explicit(&thread_stats_list, memory_order_relaxed);
+  do {
+    ts->next = head;
+  } while (! atomic_compare_exchange_weak_explicit(&thread_stats_list, &head, ts,
+						   memory_order_release,
+						   memory_order_relaxed));
 }
 
 
@@ -107,18 +196,17 @@ hpcrun_stats_reinit(void)
 void
 hpcrun_stats_num_samples_total_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_total, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_TOTAL, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_total(void)
 {
-  return atomic_load_explicit(&num_samples_total, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_SAMPLES_TOTAL);
 }
 
 
-
 //-----------------------------
 // samples attempted 
 //-----------------------------
@@ -126,18 +214,17 @@ hpcrun_stats_num_samples_total(void)
 void
 hpcrun_stats_num_samples_attempted_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_attempted, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_ATTEMPTED, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_attempted(void)
 {
-  return atomic_load_explicit(&num_samples_attempted, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_SAMPLES_ATTEMPTED);
 }
 
 
-
 //-----------------------------
 // samples blocked async 
 //-----------------------------
@@ -147,19 +234,18 @@ hpcrun_stats_num_samples_attempted(void)
 void
 hpcrun_stats_num_samples_blocked_async_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_blocked_async, 1L, memory_order_relaxed);
-  atomic_fetch_add_explicit(&num_samples_total, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC, 1L);
+  stats_add(HPCRUN_STAT_SAMPLES_TOTAL, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_blocked_async(void)
 {
-  return atomic_load_explicit(&num_samples_blocked_async, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC);
 }
 
 
-
 //-----------------------------
 // samples blocked dlopen 
 //-----------------------------
@@ -167,18 +253,17 @@ hpcrun_stats_num_samples_blocked_async(void)
 void
 hpcrun_stats_num_samples_blocked_dlopen_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_blocked_dlopen, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_blocked_dlopen(void)
 {
-  return atomic_load_explicit(&num_samples_blocked_dlopen, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN);
 }
 
 
-
 //-----------------------------
 // samples dropped
 //-----------------------------
@@ -186,31 +271,35 @@ hpcrun_stats_num_samples_blocked_dlopen(void)
 void
 hpcrun_stats_num_samples_dropped_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_dropped, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_DROPPED, 1L);
 }
 
+
 long
 hpcrun_stats_num_samples_dropped(void)
 {
-  return atomic_load_explicit(&num_samples_dropped, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_SAMPLES_DROPPED);
 }
 
-//----------------------------
+
+//-----------------------------
 // partial unwinds
-//----------------------------
+//-----------------------------
 
 void
 hpcrun_stats_num_samples_partial_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_partial, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_PARTIAL, 1L);
 }
 
+
 long
 hpcrun_stats_num_samples_partial(void)
 {
-  return atomic_load_explicit(&num_samples_partial, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_SAMPLES_PARTIAL);
 }
 
+
 //-----------------------------
 // samples segv
 //-----------------------------
@@ -218,19 +307,17 @@ hpcrun_stats_num_samples_partial(void)
 void
 hpcrun_stats_num_samples_segv_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_segv, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_SEGV, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_segv(void)
 {
-  return atomic_load_explicit(&num_samples_segv, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_SAMPLES_SEGV);
 }
 
 
-
-
 //-----------------------------
 // unwind intervals total
 //-----------------------------
@@ -238,18 +325,17 @@ hpcrun_stats_num_samples_segv(void)
 void
 hpcrun_stats_num_unwind_intervals_total_inc(void)
 {
-  atomic_fetch_add_explicit(&num_unwind_intervals_total, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_UNWIND_INTERVALS_TOTAL, 1L);
 }
 
 
 long
 hpcrun_stats_num_unwind_intervals_total(void)
 {
-  return atomic_load_explicit(&num_unwind_intervals_total, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_UNWIND_INTERVALS_TOTAL);
 }
 
 
-
 //-----------------------------
 // unwind intervals suspicious
 //-----------------------------
@@ -257,110 +343,201 @@ hpcrun_stats_num_unwind_intervals_total(void)
 void
 hpcrun_stats_num_unwind_intervals_suspicious_inc(void)
 {
-  atomic_fetch_add_explicit(&num_unwind_intervals_suspicious, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS, 1L);
 }
 
 
 long
 hpcrun_stats_num_unwind_intervals_suspicious(void)
 {
-  return atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS);
 }
 
-//------------------------------------------------------
+
+//-------------------------------------------------------
 // samples that include 1 or more successful troll steps
-//------------------------------------------------------
+//-------------------------------------------------------
 
 void
 hpcrun_stats_trolled_inc(void)
 {
-  atomic_fetch_add_explicit(&trolled, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_TROLLED, 1L);
 }
 
+
 long
 hpcrun_stats_trolled(void)
 {
-  return atomic_load_explicit(&trolled, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_TROLLED);
 }
 
-//------------------------------------------------------
+
+//-----------------------------------------------
 // total number of (unwind) frames in sample set
-//------------------------------------------------------
+//-----------------------------------------------
 
 void
 hpcrun_stats_frames_total_inc(long amt)
 {
-  atomic_fetch_add_explicit(&frames_total, amt, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_FRAMES_TOTAL, amt);
 }
 
+
 long
 hpcrun_stats_frames_total(void)
 {
-  return atomic_load_explicit(&frames_total, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_FRAMES_TOTAL);
 }
 
-//---------------------------------------------------------------------
+
+//----------------------------------------------------------------------
 // total number of (unwind) frames in sample set that employed trolling
-//---------------------------------------------------------------------
+//----------------------------------------------------------------------
 
 void
 hpcrun_stats_trolled_frames_inc(long amt)
 {
-  atomic_fetch_add_explicit(&trolled_frames, amt, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_TROLLED_FRAMES, amt);
 }
 
+
 long
 hpcrun_stats_trolled_frames(void)
 {
-  return atomic_load_explicit(&trolled_frames, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_TROLLED_FRAMES);
 }
 
-//----------------------------
+
+//--------------------------------------------
 // samples yielded due to deadlock prevention
-//----------------------------
+//--------------------------------------------
 
 void
 hpcrun_stats_num_samples_yielded_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_yielded, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_YIELDED, 1L);
 }
 
+
 long
 hpcrun_stats_num_samples_yielded(void)
 {
-  return atomic_load_explicit(&num_samples_yielded, memory_order_relaxed);
+  return stats_total(HPCRUN_STAT_SAMPLES_YIELDED);
+}
+
+
+//---------------------------------------------------------------------
+// async trace buffers that were still being written when needed again
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_num_buffers_waited_inc(void)
+{
+  stats_add(HPCRUN_STAT_BUFFERS_WAITED, 1L);
+}
+
+
+long
+hpcrun_stats_num_buffers_waited(void)
+{
+  return stats_total(HPCRUN_STAT_BUFFERS_WAITED);
+}
+
+
+//----------------------------------
+// samples unwound from call chains
+//----------------------------------
+
+void
+hpcrun_stats_num_samples_callchain_inc(void)
+{
+  stats_add(HPCRUN_STAT_SAMPLES_CALLCHAIN, 1L);
 }
 
+
+long
+hpcrun_stats_num_samples_callchain(void)
+{
+  return stats_total(HPCRUN_STAT_SAMPLES_CALLCHAIN);
+}
+
+
 //-----------------------------
 // print summary
 //-----------------------------
 
+// One line per thread that took samples, so that threads that block,
+// drop or troll more than the others stand out.
+static void
+stats_print_threads(void)
+{
+  hpcrun_thread_stats_t *ts;
+
+  for (ts = atomic_load_explicit(&thread_stats_list, memory_order_acquire);
+       ts != NULL; ts = ts->next) {
+    long c[HPCRUN_NUM_STATS];
+    int k;
+    for (k = 0; k < HPCRUN_NUM_STATS; k++) {
+      c[k] = __atomic_load_n(&ts->count[k], __ATOMIC_RELAXED);
+    }
+    if (c[HPCRUN_STAT_SAMPLES_TOTAL] == 0) {
+      continue;
+    }
+    AMSG("THREAD %d: samples: %ld (recorded: %ld, blocked: %ld, errant: %ld, "
+	 "trolled: %ld, yielded: %ld), frames: %ld (trolled: %ld)",
+	 ts->id, c[HPCRUN_STAT_SAMPLES_TOTAL], c[HPCRUN_STAT_SAMPLES_ATTEMPTED],
+	 c[HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC] + c[HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN],
+	 c[HPCRUN_STAT_SAMPLES_DROPPED], c[HPCRUN_STAT_TROLLED],
+	 c[HPCRUN_STAT_SAMPLES_YIELDED], c[HPCRUN_STAT_FRAMES_TOTAL],
+	 c[HPCRUN_STAT_TROLLED_FRAMES]);
+  }
+}
+
+
 void
 hpcrun_stats_print_summary(void)
 {
-  long blocked = atomic_load_explicit(&num_samples_blocked_async, memory_order_relaxed) +
-    atomic_load_explicit(&num_samples_blocked_dlopen, memory_order_relaxed);
-  long errant = atomic_load_explicit(&num_samples_dropped, memory_order_relaxed);
-  long soft = atomic_load_explicit(&num_samples_dropped, memory_order_relaxed) -
-    atomic_load_explicit(&num_samples_segv, memory_order_relaxed);
-  long valid = atomic_load_explicit(&num_samples_attempted, memory_order_relaxed);
+  long c[HPCRUN_NUM_STATS];
+
+  stats_sum(c);
+
+  long blocked = c[HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC] +
+    c[HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN];
+  long errant = c[HPCRUN_STAT_SAMPLES_DROPPED];
+  long soft = c[HPCRUN_STAT_SAMPLES_DROPPED] - c[HPCRUN_STAT_SAMPLES_SEGV];
+  long valid = c[HPCRUN_STAT_SAMPLES_ATTEMPTED];
   if (ENABLED(NO_PARTIAL_UNW)) {
-    valid = atomic_load_explicit(&num_samples_attempted, memory_order_relaxed) - errant;
+    valid = c[HPCRUN_STAT_SAMPLES_ATTEMPTED] - errant;
   }
 
   hpcrun_memory_summary();
 
   AMSG("SAMPLE ANOMALIES: blocks: %ld (async: %ld, dlopen: %ld), "
        "errors: %ld (segv: %ld, soft: %ld)",
-       blocked, num_samples_blocked_async, num_samples_blocked_dlopen,
-       errant, num_samples_segv, soft);
+       blocked, c[HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC],
+       c[HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN],
+       errant, c[HPCRUN_STAT_SAMPLES_SEGV], soft);
 
   AMSG("SUMMARY: samples: %ld (recorded: %ld, blocked: %ld, errant: %ld, trolled: %ld, yielded: %ld),\n"
        "         frames: %ld (trolled: %ld)\n"
        "         intervals: %ld (suspicious: %ld)",
-       num_samples_total, valid, blocked, errant, trolled, num_samples_yielded,
-       frames_total, trolled_frames,
-       num_unwind_intervals_total,  num_unwind_intervals_suspicious);
+       c[HPCRUN_STAT_SAMPLES_TOTAL], valid, blocked, errant,
+       c[HPCRUN_STAT_TROLLED], c[HPCRUN_STAT_SAMPLES_YIELDED],
+       c[HPCRUN_STAT_FRAMES_TOTAL], c[HPCRUN_STAT_TROLLED_FRAMES],
+       c[HPCRUN_STAT_UNWIND_INTERVALS_TOTAL],
+       c[HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS]);
+
+  stats_print_threads();
+
+  long waited = c[HPCRUN_STAT_BUFFERS_WAITED];
+  if (waited > 0) {
+    AMSG("TRACE BUFFERS: waited for async write: %ld", waited);
+  }
+
+  long callchain = c[HPCRUN_STAT_SAMPLES_CALLCHAIN];
+  if (callchain > 0) {
+    AMSG("CALL CHAINS: samples unwound from call chains: %ld", callchain);
+  }
 
   if (hpcrun_get_disabled()) {
     AMSG("SAMPLING HAS BEEN DISABLED");
@@ -372,4 +549,3 @@ hpcrun_stats_print_summary(void)
     hpcrun_validation_summary();
   }
 }
-
@@ -44,6 +44,40 @@
 //
 // ******************************************************* EndRiceCopyright *
 
+#ifndef HPCRUN_STATS_H
+#define HPCRUN_STATS_H
+
+//***************************************************************************
+// types
+//***************************************************************************
+
+typedef enum {
+  HPCRUN_STAT_SAMPLES_TOTAL,
+  HPCRUN_STAT_SAMPLES_ATTEMPTED,
+  HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC,
+  HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN,
+  HPCRUN_STAT_SAMPLES_DROPPED,
+  HPCRUN_STAT_SAMPLES_PARTIAL,
+  HPCRUN_STAT_SAMPLES_SEGV,
+  HPCRUN_STAT_UNWIND_INTERVALS_TOTAL,
+  HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS,
+  HPCRUN_STAT_TROLLED,
+  HPCRUN_STAT_FRAMES_TOTAL,
+  HPCRUN_STAT_TROLLED_FRAMES,
+  HPCRUN_STAT_SAMPLES_YIELDED,
+  HPCRUN_STAT_BUFFERS_WAITED,
+  HPCRUN_STAT_SAMPLES_CALLCHAIN,
+  HPCRUN_NUM_STATS
+} hpcrun_stat_t;
+
+// per-thread counters, kept in thread_data_t and only written by
+// their own thread, with relaxed __atomic builtins
+typedef struct hpcrun_thread_stats_t {
+  long count[HPCRUN_NUM_STATS];
+  int id;
+  struct hpcrun_thread_stats_t *next;
+} hpcrun_thread_stats_t;
+
 
 //***************************************************************************
 // interface operations
@@ -51,6 +85,13 @@
 
 void hpcrun_stats_reinit(void);
 
+//-----------------------------
+// per-thread counters
+//-----------------------------
+
+void hpcrun_stats_thread_init(hpcrun_thread_stats_t *ts);
+void hpcrun_stats_thread_register(hpcrun_thread_stats_t *ts, int id);
+
 //-----------------------------
 // samples total 
 //-----------------------------
@@ -158,8 +199,24 @@ long hpcrun_stats_frames_total(void);
 void hpcrun_stats_trolled_frames_inc(long amt);
 long hpcrun_stats_trolled_frames(void);
 
+//---------------------------------------------------------------------
+// async trace buffers that were still being written when needed again
+//---------------------------------------------------------------------
+
+void hpcrun_stats_num_buffers_waited_inc(void);
+long hpcrun_stats_num_buffers_waited(void);
+
+//-----------------------------
+// samples whose call path came from a sample source's call chain
+//-----------------------------
+
+void hpcrun_stats_num_samples_callchain_inc(void);
+long hpcrun_stats_num_samples_callchain(void);
+
 //-----------------------------
 // print summary
 //-----------------------------
 
 void hpcrun_stats_print_summary(void);
+
+#endif // HPCRUN_STATS_H
@@ -126,6 +126,7 @@
 
 #include <unwind/common/backtrace.h>
 #include <unwind/common/unwind.h>
+#include <unwind/common/uw_recipe_map.h>
 
 #include <utilities/arch/context-pc.h>
 
@@ -634,7 +635,9 @@ hpcrun_fini_internal()
 
     // write all threads' profile data and close trace file
     hpcrun_threadMgr_data_fini(hpcrun_get_thread_data());
+    hpcrun_trace_fini();
 
+    uw_recipe_map_fini();
     fnbounds_fini();
     hpcrun_stats_print_summary();
     messages_fini();
@@ -749,6 +749,8 @@ static inline core_profile_trace_data_t *hpcrun_stream_data_alloc_init(int id) {
     
     st->trace_min_time_us = 0;
     st->trace_max_time_us = 0;
+    st->trace_blk = NULL;
+    st->trace_blkidx = NULL;
     st->hpcrun_file  = NULL;
     
     return st;
@@ -93,8 +93,8 @@
 #include <safe-sampling.h>
 #include <sample_event.h>
 #include <monitor-exts/monitor_ext.h>
-#include <lib/prof-lean/spinlock.h>
-#include <lib/prof-lean/splay-macros.h>
+#include <memory/hpcrun-malloc.h>
+#include <lib/prof-lean/stdatomic.h>
 
 // FIXME: the inline getcontext macro is broken on 32-bit x86, so
 // revert to the getcontext syscall for now.
@@ -117,10 +117,30 @@ typedef struct leakinfo_s {
   cct_node_t *context;
   size_t bytes;
   void *memblock;
-  struct leakinfo_s *left;
-  struct leakinfo_s *right;
 } leakinfo_t;
 
+// an entry in the allocation table for footer leakinfo structs.
+// memblock is 0 when the entry is free, MEMLEAK_ENTRY_BUSY while it
+// is being claimed, and the application pointer otherwise.
+typedef struct leakentry_s {
+  atomic_uintptr_t memblock;
+  struct leakinfo_s *info;
+  struct leakentry_s *next;
+} leakentry_t;
+
+// a thread's buffer of frees not yet given to the system.  Buffers
+// are linked on a global list and never freed, so that any thread can
+// drain them when sampling stops, including buffers of threads that
+// exited without stopping.  busy is held by whoever uses the buffer.
+typedef struct memleak_pending_s {
+  atomic_int busy;
+  int num;
+  void **frees;
+  struct memleak_pending_s *next;
+} memleak_pending_t;
+
+typedef _Atomic(leakentry_t *) leakbucket_t;
+
 leakinfo_t leakinfo_NULL = { .magic = 0, .context = NULL, .bytes = 0 };
 
 typedef void *memalign_fcn(size_t, size_t);
@@ -143,6 +163,17 @@ typedef void *realloc_fcn(void *, size_t);
 #define HPCRUN_MEMLEAK_PROB  "HPCRUN_MEMLEAK_PROB"
 #define DEFAULT_PROB  0.1
 
+#define HPCRUN_MEMLEAK_FREE_BUFFER  "HPCRUN_MEMLEAK_FREE_BUFFER"
+#define MEMLEAK_MAX_PENDING_FREES  4096
+
+// allocation table: 2^6 shards of 2^12 buckets each
+#define MEMLEAK_SHARD_BITS     6
+#define MEMLEAK_BUCKET_BITS    12
+#define MEMLEAK_NUM_SHARDS     (1 << MEMLEAK_SHARD_BITS)
+#define MEMLEAK_SHARD_BUCKETS  (1 << MEMLEAK_BUCKET_BITS)
+#define MEMLEAK_ENTRY_CHUNK    128
+#define MEMLEAK_ENTRY_BUSY     ((uintptr_t) 1)
+
 #ifdef HPCRUN_STATIC_LINK
 #define real_memalign   __real_memalign
 #define real_valloc   __real_valloc
@@ -174,8 +205,20 @@ static int leak_detection_init = 0;    // default is uninitialized
 static int use_memleak_prob = 0;
 static float memleak_prob = 0.0;
 
-static struct leakinfo_s *memleak_tree_root = NULL;
-static spinlock_t memtree_lock = SPINLOCK_UNLOCKED;
+static _Atomic(leakbucket_t *) memleak_table[MEMLEAK_NUM_SHARDS];
+
+static __thread leakentry_t *memleak_free_entries = NULL;
+static __thread int memleak_num_free_entries = 0;
+
+// shard array that lost the race to install it, reused for the next
+// shard or entry chunk (hpcrun_malloc memory cannot be freed)
+static __thread leakbucket_t *memleak_spare_shard = NULL;
+
+// per-thread buffer of frees not yet given to the system, enabled
+// with HPCRUN_MEMLEAK_FREE_BUFFER
+static int memleak_free_buffer_size = 0;
+static __thread memleak_pending_t *memleak_pending = NULL;
+static _Atomic(memleak_pending_t *) memleak_pending_list = ATOMIC_VAR_INIT(NULL);
 
 static int leakinfo_size = sizeof(struct leakinfo_s);
 static long memleak_pagesize = MEMLEAK_DEFAULT_PAGESIZE;
@@ -193,81 +236,166 @@ static char *loc_name[4] = {
 
 
 /******************************************************************************
- * splay operations
+ * allocation table operations
  *****************************************************************************/
 
+// Footer leakinfo structs are found at free() through a table keyed
+// by the application pointer.  The table is split into shards of
+// hash buckets, each bucket a singly-linked list of entries.  Entries
+// are allocated with hpcrun_malloc() and never unlinked: free()
+// releases an entry by clearing its key with a CAS, and malloc()
+// reclaims cleared entries in its bucket before pushing a new one.
+// Thus, lookups and inserts are lock-free and never touch memory
+// that has been returned to the application's allocator.
+
+static uint64_t
+leaktable_hash(uintptr_t key)
+{
+  return ((uint64_t) (key >> 4)) * 0x9e3779b97f4a7c15ULL;
+}
 
-static struct leakinfo_s *
-splay(struct leakinfo_s *root, void *key)
+
+// Returns: the bucket for key, allocating the shard's bucket array
+// if create is set, or NULL if the shard does not exist.
+//
+static leakbucket_t *
+leaktable_bucket(uintptr_t key, int create)
 {
-  REGULAR_SPLAY_TREE(leakinfo_s, root, key, memblock, left, right);
-  return root;
+  uint64_t hash = leaktable_hash(key);
+  int shard = (int) (hash >> (64 - MEMLEAK_SHARD_BITS));
+  int index = (int) (hash >> (64 - MEMLEAK_SHARD_BITS - MEMLEAK_BUCKET_BITS))
+    & (MEMLEAK_SHARD_BUCKETS - 1);
+  leakbucket_t *buckets;
+  int k;
+
+  buckets = atomic_load_explicit(&memleak_table[shard], memory_order_acquire);
+  if (buckets == NULL) {
+    if (! create) {
+      return NULL;
+    }
+    leakbucket_t *fresh = memleak_spare_shard;
+    memleak_spare_shard = NULL;
+    if (fresh == NULL) {
+      fresh = hpcrun_malloc(MEMLEAK_SHARD_BUCKETS * sizeof(leakbucket_t));
+    }
+    if (fresh == NULL) {
+      return NULL;
+    }
+    for (k = 0; k < MEMLEAK_SHARD_BUCKETS; k++) {
+      atomic_init(&fresh[k], NULL);
+    }
+    // if another thread installed the shard first, use its array and
+    // keep ours for later
+    if (atomic_compare_exchange_strong_explicit(&memleak_table[shard], &buckets,
+						fresh, memory_order_acq_rel,
+						memory_order_acquire)) {
+      buckets = fresh;
+    }
+    else {
+      memleak_spare_shard = fresh;
+    }
+  }
+
+  return &buckets[index];
 }
 
 
-static void
-splay_insert(struct leakinfo_s *node)
+static leakentry_t *
+leaktable_new_entry(void)
 {
-  void *memblock = node->memblock;
-
-  node->left = node->right = NULL;
-
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root != NULL) {
-    memleak_tree_root = splay(memleak_tree_root, memblock);
-
-    if (memblock < memleak_tree_root->memblock) {
-      node->left = memleak_tree_root->left;
-      node->right = memleak_tree_root;
-      memleak_tree_root->left = NULL;
-    } else if (memblock > memleak_tree_root->memblock) {
-      node->left = memleak_tree_root;
-      node->right = memleak_tree_root->right;
-      memleak_tree_root->right = NULL;
-    } else {
-      TMSG(MEMLEAK, "memleak splay tree: unable to insert %p (already present)", 
-	   node->memblock);
-      assert(0);
+  if (memleak_num_free_entries == 0 && memleak_spare_shard != NULL) {
+    memleak_free_entries = (leakentry_t *) memleak_spare_shard;
+    memleak_num_free_entries =
+      MEMLEAK_SHARD_BUCKETS * sizeof(leakbucket_t) / sizeof(leakentry_t);
+    memleak_spare_shard = NULL;
+  }
+  if (memleak_num_free_entries == 0) {
+    memleak_free_entries =
+      hpcrun_malloc(MEMLEAK_ENTRY_CHUNK * sizeof(leakentry_t));
+    if (memleak_free_entries == NULL) {
+      return NULL;
     }
+    memleak_num_free_entries = MEMLEAK_ENTRY_CHUNK;
   }
-  memleak_tree_root = node;
-  spinlock_unlock(&memtree_lock);  
+  memleak_num_free_entries--;
+  return &memleak_free_entries[memleak_num_free_entries];
 }
 
 
-static struct leakinfo_s *
-splay_delete(void *memblock)
+// Returns: 1 if node was added to the table, else 0 (out of memory).
+//
+static int
+leaktable_insert(struct leakinfo_s *node)
 {
-  struct leakinfo_s *result = NULL;
+  uintptr_t key = (uintptr_t) node->memblock;
+  leakbucket_t *bucket = leaktable_bucket(key, 1);
+  leakentry_t *entry;
 
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root == NULL) {
-    spinlock_unlock(&memtree_lock);  
-    TMSG(MEMLEAK, "memleak splay tree empty: unable to delete %p", memblock);
-    return NULL;
+  if (bucket == NULL) {
+    return 0;
   }
 
-  memleak_tree_root = splay(memleak_tree_root, memblock);
+  // first, try to reclaim a released entry in this bucket
+  for (entry = atomic_load_explicit(bucket, memory_order_acquire);
+       entry != NULL;
+       entry = entry->next) {
+    uintptr_t empty = 0;
+    if (atomic_load_explicit(&entry->memblock, memory_order_relaxed) == 0
+	&& atomic_compare_exchange_strong_explicit(&entry->memblock, &empty,
+						   MEMLEAK_ENTRY_BUSY,
+						   memory_order_acquire,
+						   memory_order_relaxed)) {
+      entry->info = node;
+      atomic_store_explicit(&entry->memblock, key, memory_order_release);
+      return 1;
+    }
+  }
 
-  if (memblock != memleak_tree_root->memblock) {
-    spinlock_unlock(&memtree_lock);  
-    TMSG(MEMLEAK, "memleak splay tree: %p not in tree", memblock);
-    return NULL;
+  // else push a new entry onto the front of the bucket
+  entry = leaktable_new_entry();
+  if (entry == NULL) {
+    return 0;
+  }
+  entry->info = node;
+  atomic_init(&entry->memblock, key);
+  entry->next = atomic_load_explicit(bucket, memory_order_relaxed);
+  while (! atomic_compare_exchange_weak_explicit(bucket, &entry->next, entry,
+						 memory_order_release,
+						 memory_order_relaxed)) {
+    // entry->next was reloaded by the failed CAS, try again
   }
+  return 1;
+}
+
+
+static struct leakinfo_s *
+leaktable_delete(void *memblock)
+{
+  uintptr_t key = (uintptr_t) memblock;
+  leakbucket_t *bucket = leaktable_bucket(key, 0);
+  leakentry_t *entry;
 
-  result = memleak_tree_root;
+  if (bucket == NULL) {
+    TMSG(MEMLEAK, "memleak table: %p not in table (no shard)", memblock);
+    return NULL;
+  }
 
-  if (memleak_tree_root->left == NULL) {
-    memleak_tree_root = memleak_tree_root->right;
-    spinlock_unlock(&memtree_lock);  
-    return result;
+  for (entry = atomic_load_explicit(bucket, memory_order_acquire);
+       entry != NULL;
+       entry = entry->next) {
+    if (atomic_load_explicit(&entry->memblock, memory_order_acquire) == key) {
+      struct leakinfo_s *result = entry->info;
+      uintptr_t expected = key;
+      if (atomic_compare_exchange_strong_explicit(&entry->memblock, &expected, 0,
+						  memory_order_acq_rel,
+						  memory_order_relaxed)) {
+	return result;
+      }
+    }
   }
 
-  memleak_tree_root->left = splay(memleak_tree_root->left, memblock);
-  memleak_tree_root->left->right = memleak_tree_root->right;
-  memleak_tree_root =  memleak_tree_root->left;
-  spinlock_unlock(&memtree_lock);  
-  return result;
+  TMSG(MEMLEAK, "memleak table: %p not in table", memblock);
+  return NULL;
 }
 
 
@@ -276,6 +404,9 @@ splay_delete(void *memblock)
  * private operations
  *****************************************************************************/
 
+static void memleak_flush_pending_frees(void);
+
+
 // Accept 0.ddd as floating point or x/y as fraction.
 static float
 string_to_prob(char *str)
@@ -303,7 +434,7 @@ static void
 memleak_initialize(void)
 {
   struct timeval tv;
-  char *prob_str;
+  char *prob_str, *buf_str;
   unsigned int seed;
   int fd;
 
@@ -335,6 +466,24 @@ memleak_initialize(void)
     srandom(seed);
   }
 
+  // Optionally batch the frees of each thread.  The blocks stay
+  // allocated until the buffer fills or some thread stops sampling,
+  // at the latest when the process stops sampling at exit.
+  buf_str = getenv(HPCRUN_MEMLEAK_FREE_BUFFER);
+  if (buf_str != NULL) {
+    memleak_free_buffer_size = atoi(buf_str);
+    if (memleak_free_buffer_size < 0) {
+      memleak_free_buffer_size = 0;
+    }
+    if (memleak_free_buffer_size > MEMLEAK_MAX_PENDING_FREES) {
+      memleak_free_buffer_size = MEMLEAK_MAX_PENDING_FREES;
+    }
+    if (memleak_free_buffer_size > 0) {
+      hpcrun_memleak_register_flush(memleak_flush_pending_frees);
+    }
+    TMSG(MEMLEAK, "free buffer size = %d", memleak_free_buffer_size);
+  }
+
   // unconditionally enable leak detection for now
   leak_detection_enabled = 1;
   leak_detection_init = 1;
@@ -412,7 +561,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 
   // always try footer
   *sys_ptr = appl_ptr;
-  *info_ptr = splay_delete(appl_ptr);
+  *info_ptr = leaktable_delete(appl_ptr);
   if (*info_ptr == NULL) {
     return MEMLEAK_LOC_NONE;
   }
@@ -435,8 +584,8 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 }
 
 
-// Fill in the leakinfo struct, add metric to CCT, add to splay tree
-// (if footer) and print TMSG.
+// Fill in the leakinfo struct, add metric to CCT, add to allocation
+// table (if footer) and print TMSG.
 //
 static void
 memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
@@ -455,8 +604,6 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
   info_ptr->magic = MEMLEAK_MAGIC;
   info_ptr->bytes = bytes;
   info_ptr->memblock = appl_ptr;
-  info_ptr->left = NULL;
-  info_ptr->right = NULL;
   if (hpcrun_memleak_active()) {
     sample_val_t smpl =
       hpcrun_sample_callpath(uc, hpcrun_memleak_alloc_id(), 
@@ -468,8 +615,12 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
     info_ptr->context = NULL;
     loc_str = "inactive";
   }
-  if (loc == MEMLEAK_LOC_FOOT) {
-    splay_insert(info_ptr);
+  if (loc == MEMLEAK_LOC_FOOT && ! leaktable_insert(info_ptr)) {
+    // the block is still freed correctly (a footer's system and
+    // application pointers are the same), we only lose the metric
+    info_ptr->magic = 0;
+    info_ptr->context = NULL;
+    loc_str = "table full";
   }
 
   TMSG(MEMLEAK, "%s: bytes: %ld sys: %p appl: %p info: %p cct: %p (%s)",
@@ -576,6 +727,97 @@ memleak_free_helper(const char *name, void *sys_ptr, void *appl_ptr,
 }
 
 
+// Do the work of free() for every block in a pending free buffer.
+// The caller must hold the buffer.
+//
+static void
+memleak_flush_buffer(memleak_pending_t *pend)
+{
+  leakinfo_t *info_ptr;
+  void *appl_ptr, *sys_ptr;
+  int k, num, loc;
+
+  num = pend->num;
+  pend->num = 0;
+
+  TMSG(MEMLEAK, "flush pending frees: %d", num);
+
+  for (k = 0; k < num; k++) {
+    appl_ptr = pend->frees[k];
+    loc = memleak_get_free_loc(appl_ptr, &sys_ptr, &info_ptr);
+    memleak_free_helper("free", sys_ptr, appl_ptr, info_ptr, loc);
+    real_free(sys_ptr);
+  }
+}
+
+
+// Flush the pending free buffers of all threads, so that blocks from
+// threads that exited without stopping the sample source are freed.
+// Called when a thread stops sampling.
+//
+static void
+memleak_flush_pending_frees(void)
+{
+  memleak_pending_t *pend;
+
+  for (pend = atomic_load_explicit(&memleak_pending_list, memory_order_acquire);
+       pend != NULL;
+       pend = pend->next) {
+    while (atomic_exchange_explicit(&pend->busy, 1, memory_order_acquire)) {
+      // the owner is adding to the buffer
+    }
+    memleak_flush_buffer(pend);
+    atomic_store_explicit(&pend->busy, 0, memory_order_release);
+  }
+}
+
+
+// Add ptr to this thread's pending free buffer and flush the buffer
+// if full.  The owner never waits for the buffer: if another thread
+// is draining it (or we interrupted ourselves in a signal handler),
+// the caller frees ptr directly.
+//
+// Returns: 1 if ptr was buffered, else 0 and the caller must free it.
+//
+static int
+memleak_defer_free(void *ptr)
+{
+  memleak_pending_t *pend = memleak_pending;
+
+  if (pend == NULL) {
+    pend = hpcrun_malloc(sizeof(memleak_pending_t));
+    if (pend == NULL) {
+      return 0;
+    }
+    pend->frees = hpcrun_malloc(memleak_free_buffer_size * sizeof(void *));
+    if (pend->frees == NULL) {
+      return 0;
+    }
+    atomic_init(&pend->busy, 0);
+    pend->num = 0;
+    pend->next = atomic_load_explicit(&memleak_pending_list, memory_order_relaxed);
+    while (! atomic_compare_exchange_weak_explicit(&memleak_pending_list,
+						   &pend->next, pend,
+						   memory_order_release,
+						   memory_order_relaxed)) {
+    }
+    memleak_pending = pend;
+  }
+
+  if (atomic_exchange_explicit(&pend->busy, 1, memory_order_acquire)) {
+    return 0;
+  }
+
+  pend->frees[pend->num++] = ptr;
+  if (pend->num >= memleak_free_buffer_size) {
+    memleak_flush_buffer(pend);
+  }
+  atomic_store_explicit(&pend->busy, 0, memory_order_release);
+
+  return 1;
+}
+
+
 /******************************************************************************
  * interface operations
  *****************************************************************************/
@@ -755,6 +997,14 @@ MONITOR_EXT_WRAP_NAME(free)(void *ptr)
     goto finish;
   }
 
+  // only buffer frees from the application while the thread is
+  // sampling, so that stopping the sample source flushes the buffer
+  if (memleak_free_buffer_size > 0 && safe && hpcrun_memleak_active()
+      && memleak_defer_free(ptr)) {
+    TMSG(MEMLEAK, "free: ptr: %p (pending)", ptr);
+    goto finish;
+  }
+
   loc = memleak_get_free_loc(ptr, &sys_ptr, &info_ptr);
   memleak_free_helper("free", sys_ptr, ptr, info_ptr, loc);
   real_free(sys_ptr);
@@ -79,6 +79,7 @@
 #include <hpcrun/sample_sources_registered.h>
 #include "simple_oo.h"
 #include <hpcrun/thread_data.h>
+#include <sample-sources/memleak.h>
 
 #include <messages/messages.h>
 #include <utilities/tokenize.h>
@@ -89,6 +90,8 @@ static int alloc_metric_id = -1;
 static int free_metric_id = -1;
 static int leak_metric_id = -1;
 
+static hpcrun_memleak_flush_fn_t *memleak_flush_fn = NULL;
+
 
 /******************************************************************************
  * method definitions
@@ -136,6 +139,11 @@ static void
 METHOD_FN(stop)
 {
   TMSG(MEMLEAK,"stopping MEMLEAK");
+
+  // free any blocks still buffered while the metrics are active
+  if (memleak_flush_fn != NULL) {
+    memleak_flush_fn();
+  }
   TD_GET(ss_state)[self->sel_idx] = STOP;
 }
 
@@ -251,6 +259,13 @@ hpcrun_memleak_active()
 }
 
 
+void
+hpcrun_memleak_register_flush(hpcrun_memleak_flush_fn_t *fn)
+{
+  memleak_flush_fn = fn;
+}
+
+
 void
 hpcrun_alloc_inc(cct_node_t* node, int incr)
 {
@@ -74,4 +74,9 @@ int hpcrun_memleak_active();
 void hpcrun_alloc_inc(cct_node_t* node, int incr);
 void hpcrun_free_inc(cct_node_t* node, int incr);
 
+// the overrides register a function to flush the pending frees of
+// all threads when a thread stops sampling
+typedef void hpcrun_memleak_flush_fn_t(void);
+void hpcrun_memleak_register_flush(hpcrun_memleak_flush_fn_t *fn);
+
 #endif // sample_source_memleak_h
@@ -568,6 +568,41 @@ record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
   return sv;
 }
 
+/***
+ * read the records pending in the ring buffer of an event and
+ * attribute the samples.  the interrupted context only belongs to the
+ * last record of the event that signaled ('signaled'); in batched mode
+ * every other record is attributed from its own call chain, and
+ * dropped if it has no complete one.
+ */
+static void
+perf_drain_buffer(event_thread_t *current, void *context,
+                  bool batched, bool signaled)
+{
+  int more_data = 0;
+  do {
+    perf_mmap_data_t mmap_data;
+    memset(&mmap_data, 0, sizeof(perf_mmap_data_t));
+
+    // reading info from mmapped buffer
+    more_data = read_perf_buffer(current, &mmap_data);
+
+    sample_val_t sv;
+    memset(&sv, 0, sizeof(sample_val_t));
+
+    if (mmap_data.header_type == PERF_RECORD_SAMPLE) {
+      if (! batched || (signaled && ! more_data)
+          || perf_util_has_user_callchain(&mmap_data))
+        record_sample(current, &mmap_data, context, &sv);
+      else
+        hpcrun_stats_num_samples_dropped_inc();
+    }
+
+    kernel_block_handler(current, sv, &mmap_data);
+
+  } while (more_data);
+}
+
 /***
  * (1) ensure that the default rate for frequency-based sampling is below the maximum.
  * (2) if the environment variable HPCRUN_PERF_COUNT is set, use it to set the threshold
@@ -1038,13 +1073,15 @@ perf_event_handler(
   }
 
   // ----------------------------------------------------------------------------
-  // disable all counters
+  // disable all counters, unless sampling is batched: then the counters
+  // keep running and we only drain the ring buffers
   // ----------------------------------------------------------------------------
 
   sample_source_t *self = &obj_name();
   event_thread_t *event_thread = TD_GET(ss_info)[self->sel_idx].ptr;
 
   int nevents = self->evl.nevents;
+  bool batched = perf_util_is_batched();
 
   // if finalized already, refuse to handle any more samples
   if (perf_was_finalized(nevents, event_thread)) {
@@ -1053,7 +1090,8 @@ perf_event_handler(
     return 0; // tell monitor that the signal has been handled
   }
 
-  perf_stop_all(nevents, event_thread);
+  if (!batched)
+    perf_stop_all(nevents, event_thread);
 
   // ----------------------------------------------------------------------------
   // check #1: check if signal generated by kernel for profiling
@@ -1062,7 +1100,8 @@ perf_event_handler(
   if (siginfo->si_code < 0) {
     TMSG(LINUX_PERF, "signal si_code %d < 0 indicates not from kernel", 
          siginfo->si_code);
-    perf_start_all(nevents, event_thread);
+    if (!batched)
+      perf_start_all(nevents, event_thread);
 
     HPCTOOLKIT_APPLICATION_ERRNO_RESTORE();
 
@@ -1115,7 +1154,8 @@ perf_event_handler(
        siginfo->si_code, fd);
     hpcrun_safe_exit();
 
-    perf_start_all(nevents, event_thread);
+    if (!batched)
+      perf_start_all(nevents, event_thread);
 
     HPCTOOLKIT_APPLICATION_ERRNO_RESTORE();
 
@@ -1124,27 +1164,21 @@ perf_event_handler(
 
   // ----------------------------------------------------------------------------
   // parse the buffer until it finishes reading all buffers
+  // in batched mode, the other events may have pending records that did
+  // not reach their wakeup count yet; drain them too
   // ----------------------------------------------------------------------------
 
-  int more_data = 0;
-  do {
-    perf_mmap_data_t mmap_data;
-    memset(&mmap_data, 0, sizeof(perf_mmap_data_t));
-
-    // reading info from mmapped buffer
-    more_data = read_perf_buffer(current, &mmap_data);
-
-    sample_val_t sv;
-    memset(&sv, 0, sizeof(sample_val_t));
-
-    if (mmap_data.header_type == PERF_RECORD_SAMPLE)
-      record_sample(current, &mmap_data, context, &sv);
-
-    kernel_block_handler(current, sv, &mmap_data);
-
-  } while (more_data);
+  if (batched) {
+    for (int i = 0; i < nevents; i++) {
+      if (event_thread[i].fd >= 0 && perf_mmap_has_data(event_thread[i].mmap))
+        perf_drain_buffer(&event_thread[i], context, true,
+                          &event_thread[i] == current);
+    }
+  } else {
+    perf_drain_buffer(current, context, false, true);
 
-  perf_start_all(nevents, event_thread);
+    perf_start_all(nevents, event_thread);
+  }
 
   hpcrun_safe_exit();
 
@@ -48,6 +48,7 @@
 
 #include <linux/version.h>
 #include <ctype.h>
+#include <stdlib.h>
 
 
 /******************************************************************************
@@ -55,6 +56,7 @@
  *****************************************************************************/
 
 #include <hpcrun/cct_insert_backtrace.h>
+#include <unwind/common/backtrace.h>
 #include <lib/support-lean/OSUtil.h>     // hostid
 
 #include <include/linux_info.h>
@@ -85,6 +87,13 @@ static uint16_t perf_kernel_lm_id = 0;
 
 static enum perf_ksym_e ksym_status = PERF_UNDEFINED;
 
+// batched sampling (HPCRUN_PERF_BATCH, HPCRUN_PERF_WATERMARK)
+static int perf_batch_events    = 0;
+static int perf_batch_watermark = 0;
+
+// user call chains from the kernel (HPCRUN_PERF_USER_CALLCHAIN)
+static bool perf_user_callchain = false;
+
 
 //******************************************************************************
 // forward declaration
@@ -207,6 +216,49 @@ perf_get_kernel_lm_id()
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
 
+//----------------------------------------------------------
+// the number of entries of the call chain before the user
+// frames, if any
+//----------------------------------------------------------
+static int
+perf_kernel_callchain_length(perf_mmap_data_t *data)
+{
+  int i;
+  for (i = 0; i < data->nr; i++) {
+    if (data->ips[i] == PERF_CONTEXT_USER) break;
+  }
+  return i;
+}
+
+
+//----------------------------------------------------------
+// return the user frames of the call chain recorded by the
+// kernel, innermost first (see hpcrun_user_callchain_t)
+//----------------------------------------------------------
+static int
+perf_get_user_callchain(
+  void *data_aux,
+  void ***ips
+)
+{
+  perf_mmap_data_t *data = (perf_mmap_data_t*) data_aux;
+
+  int first = perf_kernel_callchain_length(data) + 1;
+  if (first >= data->nr) {
+    return 0;
+  }
+
+  // the chain may be truncated at another context marker
+  int last;
+  for (last = first; last < data->nr; last++) {
+    if (data->ips[last] >= PERF_CONTEXT_MAX) break;
+  }
+
+  *ips = (void **) &data->ips[first];
+  return last - first;
+}
+
+
 //----------------------------------------------------------
 // extend a user-mode callchain with kernel frames (if any)
 //----------------------------------------------------------
@@ -223,7 +275,11 @@ perf_add_kernel_callchain(
   }
 
   perf_mmap_data_t *data = (perf_mmap_data_t*) data_aux;
-  if (data->nr > 0) {
+
+  // with user call chains, the kernel frames end at the user marker
+  int nr = perf_kernel_callchain_length(data);
+
+  if (nr > 0) {
     uint16_t kernel_lm_id = perf_get_kernel_lm_id();
 
     // bug #44 https://github.com/HPCToolkit/hpctoolkit/issues/44 
@@ -235,7 +291,7 @@ perf_add_kernel_callchain(
 
     // add kernel IPs to the call chain top down, which is the 
     // reverse of the order in which they appear in ips[]
-    for (int i = data->nr - 1; i > 0; i--) {
+    for (int i = nr - 1; i > 0; i--) {
       parent = perf_insert_cct(kernel_lm_id, parent, data->ips[i]);
     }
 
@@ -349,6 +405,81 @@ perf_util_init()
     ksym_status = PERF_AVAILABLE;
   }
 #endif
+
+  // take user frames from the kernel's call chains instead of unwinding
+  // (for code built with frame pointers)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
+  const char *callchain_str = getenv("HPCRUN_PERF_USER_CALLCHAIN");
+  perf_user_callchain = (callchain_str != NULL && atoi(callchain_str) > 0);
+  if (perf_user_callchain) {
+    hpcrun_user_callchain_register(perf_get_user_callchain);
+  }
+#endif
+
+  // batched sampling: the kernel signals only every N samples or when
+  // the ring buffer holds a number of bytes, and the handler drains all
+  // pending records without stopping the counters.  the signal context
+  // only belongs to the last record, so the others must be attributed
+  // from their own call chains: this needs user call chains.
+  const char *batch_str = getenv("HPCRUN_PERF_BATCH");
+  const char *watermark_str = getenv("HPCRUN_PERF_WATERMARK");
+  perf_batch_events    = (batch_str) ? atoi(batch_str) : 0;
+  perf_batch_watermark = (watermark_str) ? atoi(watermark_str) : 0;
+  if (perf_batch_events < 0)    perf_batch_events = 0;
+  if (perf_batch_watermark < 0) perf_batch_watermark = 0;
+  if ((perf_batch_events > 1 || perf_batch_watermark > 0)
+      && ! perf_user_callchain) {
+    EMSG("WARNING: HPCRUN_PERF_BATCH and HPCRUN_PERF_WATERMARK need "
+         "HPCRUN_PERF_USER_CALLCHAIN, sampling is not batched.");
+    perf_batch_events    = 0;
+    perf_batch_watermark = 0;
+  }
+  TMSG(LINUX_PERF, "batch: %d samples, watermark: %d bytes",
+       perf_batch_events, perf_batch_watermark);
+}
+
+
+//----------------------------------------------------------
+// Interface to see if samples are batched, i.e. the signal
+//  handler should drain the buffers without stopping the
+//  counters
+//----------------------------------------------------------
+bool
+perf_util_is_batched()
+{
+  return (perf_batch_events > 1 || perf_batch_watermark > 0);
+}
+
+
+//----------------------------------------------------------
+// Interface to see if a sample can be attributed from its
+//  own call chain, without the signal context
+//----------------------------------------------------------
+bool
+perf_util_has_user_callchain(perf_mmap_data_t *data)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
+  // with trampolines, the call path is always unwound from the context
+  if (ENABLED(USE_TRAMP)) {
+    return false;
+  }
+  void **ips = NULL;
+  int nips = perf_get_user_callchain(data, &ips);
+  return (nips > 0 && hpcrun_callchain_is_complete(ips, nips));
+#else
+  return false;
+#endif
+}
+
+
+//----------------------------------------------------------
+// Interface to see if user frames come from the kernel's
+//  call chains
+//----------------------------------------------------------
+bool
+perf_util_is_user_callchain()
+{
+  return perf_user_callchain;
 }
 
 
@@ -399,6 +530,13 @@ perf_util_attr_init(
 
   attr->disabled       = 1;                 /* the counter will be enabled later  */
   attr->sample_type    = sample_type;
+
+  if (perf_batch_watermark > 0) {
+    attr->watermark        = 1;
+    attr->wakeup_watermark = perf_batch_watermark;
+  } else if (perf_batch_events > 1) {
+    attr->wakeup_events    = perf_batch_events;
+  }
   attr->exclude_kernel = EXCLUDE;
   attr->exclude_hv     = EXCLUDE;
 
@@ -415,6 +553,13 @@ perf_util_attr_init(
 #endif
     attr->exclude_kernel           = INCLUDE;
   }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
+  if (perf_user_callchain) {
+    attr->sample_type           |= PERF_SAMPLE_CALLCHAIN;
+    attr->exclude_callchain_user = INCLUDE_CALLCHAIN;
+  }
+#endif
   
   char *name;
   int precise_ip_type = perf_skid_parse_event(event_name, &name);
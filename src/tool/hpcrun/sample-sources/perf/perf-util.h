@@ -58,8 +58,9 @@
 
 // the number of maximum frames (call chains) 
 // For kernel only call chain, I think 32 is a good number.
-// If we include user call chains, it should be bigger than that.
-#define MAX_CALLCHAIN_FRAMES 32
+// User call chains (HPCRUN_PERF_USER_CALLCHAIN) need more: this is the
+// default of the kernel's perf_event_max_stack plus its context markers.
+#define MAX_CALLCHAIN_FRAMES 130
 
 
 /******************************************************************************
@@ -162,6 +163,15 @@ perf_util_attr_init(
 bool
 perf_util_is_ksym_available();
 
+bool
+perf_util_is_batched();
+
+bool
+perf_util_has_user_callchain(perf_mmap_data_t *data);
+
+bool
+perf_util_is_user_callchain();
+
 int
 perf_util_get_paranoid_level();
 
@@ -52,6 +52,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <sys/mman.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -86,8 +87,12 @@
 #define PERF_DATA_PAGE_EXP        1      // use 2^PERF_DATA_PAGE_EXP pages
 #define PERF_DATA_PAGES           (1 << PERF_DATA_PAGE_EXP)
 
-#define PERF_MMAP_SIZE(pagesz)    ((pagesz) * (PERF_DATA_PAGES + 1))
-#define PERF_TAIL_MASK(pagesz)    (((pagesz) * PERF_DATA_PAGES) - 1)
+// default ring buffer in batched mode: it has to hold a whole batch
+#define PERF_BATCH_DATA_PAGES     16
+#define PERF_MAX_DATA_PAGES       1024
+
+#define PERF_MMAP_SIZE(pagesz)    ((pagesz) * (data_pages + 1))
+#define PERF_TAIL_MASK(pagesz)    (((pagesz) * data_pages) - 1)
 
 
 
@@ -107,6 +112,7 @@ __attribute__ ((unused));
 
 static int pagesize      = 0;
 static size_t tail_mask  = 0;
+static size_t data_pages = PERF_DATA_PAGES;
 
 
 /******************************************************************************
@@ -291,11 +297,13 @@ perf_sample_callchain(pe_mmap_t *current_perf_mmap, perf_mmap_data_t* mmap_data)
       // simplest solution I can come up.
       mmap_data->nr = (num_records < MAX_CALLCHAIN_FRAMES ? num_records : MAX_CALLCHAIN_FRAMES);
 
-      // read the IPs for the frames
-      if (perf_read( current_perf_mmap, mmap_data->ips, num_records * sizeof(u64)) != 0) {
+      // read the IPs for the frames, and skip the ones we have no room for
+      if (perf_read( current_perf_mmap, mmap_data->ips, mmap_data->nr * sizeof(u64)) != 0) {
         // the data seems invalid
-        mmap_data->nr = 0;
         TMSG(LINUX_PERF, "unable to read all %d frames", mmap_data->nr);
+        mmap_data->nr = 0;
+      } else if (num_records > mmap_data->nr) {
+        skip_perf_data(current_perf_mmap, (num_records - mmap_data->nr) * sizeof(u64));
       }
     }
   } else {
@@ -502,6 +510,15 @@ read_perf_buffer(event_thread_t *current, perf_mmap_data_t *mmap_info)
   return (has_more_perf_data(current_perf_mmap));
 }
 
+//----------------------------------------------------------
+// return true if the buffer has records that were not read
+//----------------------------------------------------------
+int
+perf_mmap_has_data(pe_mmap_t *mmap)
+{
+  return (mmap != NULL && has_more_perf_data(mmap));
+}
+
 //----------------------------------------------------------
 // allocate mmap for a given file descriptor
 //----------------------------------------------------------
@@ -548,6 +565,20 @@ void
 perf_mmap_init()
 {
   pagesize = sysconf(_SC_PAGESIZE);
+
+  // the kernel requires a power of 2 number of data pages
+  // (HPCRUN_PERF_BUFFER_PAGES is rounded up)
+  size_t pages = perf_util_is_batched() ? PERF_BATCH_DATA_PAGES : PERF_DATA_PAGES;
+  const char *pages_str = getenv("HPCRUN_PERF_BUFFER_PAGES");
+  if (pages_str != NULL && atoi(pages_str) > 0) {
+    pages = atoi(pages_str);
+  }
+  if (pages > PERF_MAX_DATA_PAGES) {
+    pages = PERF_MAX_DATA_PAGES;
+  }
+  for (data_pages = 1; data_pages < pages; data_pages <<= 1);
+
   tail_mask = PERF_TAIL_MASK(pagesize);
+  TMSG(LINUX_PERF, "ring buffer: %d data pages", (int) data_pages);
 }
 
@@ -84,5 +84,7 @@ void perf_unmmap(pe_mmap_t *mmap);
 
 int read_perf_buffer(event_thread_t *current, perf_mmap_data_t *mmap_info);
 
+int perf_mmap_has_data(pe_mmap_t *mmap);
+
 
 #endif
@@ -237,6 +237,9 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   // ----------------------------------------
   cptd->trace_min_time_us = 0;
   cptd->trace_max_time_us = 0;
+  cptd->trace_blk = NULL;
+  cptd->trace_blkidx = NULL;
+  cptd->trace_offset = 0;
 
   // ----------------------------------------
   // IO support
@@ -282,6 +285,8 @@ hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sou
   hpcrun_make_memstore(&td->memstore, is_child);
   td->mem_low = 0;
 
+  hpcrun_stats_thread_init(&td->stats);
+
   // ----------------------------------------
   // normalized thread id (monitor-generated)
   // ----------------------------------------
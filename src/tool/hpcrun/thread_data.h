@@ -63,6 +63,7 @@
 #include "epoch.h"
 #include "cct2metrics.h"
 #include "core_profile_trace_data.h"
+#include "hpcrun_stats.h"
 
 #include <lush/lush-pthread.i>
 #include <unwind/common/backtrace.h>
@@ -156,6 +157,11 @@ typedef struct thread_data_t {
   bool           timer_init;
 
   uint64_t       last_time_us; // microseconds
+
+  // ----------------------------------------
+  // statistics counters (see hpcrun_stats.c)
+  // ----------------------------------------
+  hpcrun_thread_stats_t stats;
    
   // ----------------------------------------
   // core_profile_trace_data contains the following
@@ -153,6 +153,7 @@ allocate_and_init_thread_data(int id, cct_ctxt_t* thr_ctxt)
   // make sure we already call hpcrun_set_thread_data to set the variable.
   // ----------------------------------------
   hpcrun_thread_data_init(id, thr_ctxt, 0, hpcrun_get_num_sample_sources());
+  hpcrun_stats_thread_register(&data->stats, id);
 
   // ----------------------------------------
   // set up initial 'epoch'
@@ -49,9 +49,13 @@
 //*********************************************************************
 
 #include <stdio.h>
+#include <stddef.h>
 #include <sys/time.h>
 #include <assert.h>
 #include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
 
 
 //*********************************************************************
@@ -63,6 +67,7 @@
 #include "disabled.h"
 #include "env.h"
 #include "files.h"
+#include "hpcrun_stats.h"
 #include "monitor.h"
 #include "rank.h"
 #include "string.h"
@@ -77,12 +82,32 @@
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcio.h>
 #include <lib/prof-lean/hpcio-buffer.h>
+#include <lib/prof-lean/spinlock.h>
 
 
 //*********************************************************************
 // type declarations
 //*********************************************************************
 
+// block index of a block-encoded trace, kept in hpcrun_malloc'd chunks
+// until it is written as the trace footer at close
+#define TRACE_BLKIDX_CHUNK_SZ 256
+
+typedef struct trace_blkidx_chunk_t {
+  struct trace_blkidx_chunk_t* next;
+  uint32_t n;
+  hpctrace_fmt_blkidx_t idx[TRACE_BLKIDX_CHUNK_SZ];
+} trace_blkidx_chunk_t;
+
+// a thread's block encoder (cptd->trace_blk points to 'blk')
+typedef struct trace_blkbuf_t {
+  struct trace_blkbuf_t* next;
+  hpctrace_fmt_blk_t blk;
+} trace_blkbuf_t;
+
+#define trace_blkbuf_of(b) \
+  ((trace_blkbuf_t*)((char*)(b) - offsetof(trace_blkbuf_t, blk)))
+
 
 
 //*********************************************************************
@@ -91,6 +116,12 @@
 
 static void hpcrun_trace_file_validate(int valid, char *op);
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t microtime);
+static int hpcrun_trace_blk_flush(core_profile_trace_data_t *cptd);
+static int hpcrun_trace_blk_close(core_profile_trace_data_t *cptd);
+static hpctrace_fmt_blk_t* hpcrun_trace_blk_new(void);
+static trace_blkidx_chunk_t* hpcrun_trace_blkidx_chunk_new(void);
+static void hpcrun_trace_blk_free(core_profile_trace_data_t *cptd);
+static void hpcrun_trace_writer_start(void);
 
 
 //*********************************************************************
@@ -98,6 +129,19 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
 //*********************************************************************
 
 static int tracing = 0;
+static int tracing_blocked = 0;
+static int tracing_async = 0;
+
+// async trace writer (HPCRUN_TRACE_ASYNC): one thread per process
+static pthread_t trace_writer;
+static pid_t trace_writer_pid = 0;
+static volatile int trace_writer_stop = 0;
+
+// block encoders and index chunks of closed traces, reused by the
+// traces of later threads since hpcrun_malloc'd memory cannot be freed
+static trace_blkbuf_t* s_blkbuf_free_list = NULL;
+static trace_blkidx_chunk_t* s_blkidx_free_list = NULL;
+static spinlock_t trace_free_list_lock = SPINLOCK_UNLOCKED;
 
 //*********************************************************************
 // interface operations
@@ -113,9 +157,21 @@ hpcrun_trace_isactive()
 void
 hpcrun_trace_init()
 {
+  // N.B.: after a fork, the memory of the free lists is not ours
+  s_blkbuf_free_list = NULL;
+  s_blkidx_free_list = NULL;
+  spinlock_init(&trace_free_list_lock);
+
   if (getenv(HPCRUN_TRACE)) {
       tracing = 1;
       TMSG(TRACE, "Tracing is ON");
+      if (getenv(HPCRUN_TRACE_COMPRESS)) {
+        tracing_blocked = 1;
+        TMSG(TRACE, "Trace block encoding is ON");
+      }
+      if (getenv(HPCRUN_TRACE_ASYNC)) {
+        hpcrun_trace_writer_start();
+      }
   }
 }
 
@@ -142,8 +198,12 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
     fd = hpcrun_open_trace_file(cptd->id);
     hpcrun_trace_file_validate(fd >= 0, "open");
     cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
+    int flags_outbuf = HPCIO_OUTBUF_UNLOCKED;
+    if (tracing_async) {
+      flags_outbuf |= HPCIO_OUTBUF_ASYNC;
+    }
     ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
-			      HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED);
+			      HPCRUN_TraceBufferSz, flags_outbuf);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "open");
 
     hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
@@ -152,9 +212,17 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
 #else
     flags.fields.isDataCentric = false;
 #endif
+    flags.fields.isBlocked = tracing_blocked;
 
     ret = hpctrace_fmt_hdr_outbuf(flags, &cptd->trace_outbuf);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "write header to");
+
+    if (tracing_blocked) {
+      cptd->trace_blk = hpcrun_trace_blk_new();
+      hpctrace_fmt_blk_init(cptd->trace_blk);
+      cptd->trace_blkidx = NULL;
+      cptd->trace_offset = HPCTRACE_FMT_HeaderLen;
+    }
   }
   TMSG(TRACE, "Trace open done");
 }
@@ -198,6 +266,12 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
   if (tracing && hpcrun_sample_prob_active()) {
 
     TMSG(TRACE, "Trace active close code");
+    if (cptd->trace_blk) {
+      int ret = hpcrun_trace_blk_close(cptd);
+      hpcrun_trace_blk_free(cptd);
+      hpcrun_trace_file_validate(ret == HPCFMT_OK, "write block index to");
+    }
+
     int ret = hpcio_outbuf_close(&cptd->trace_outbuf);
     if (ret != HPCFMT_OK) {
       EMSG("unable to flush and close trace file");
@@ -211,10 +285,76 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
   TMSG(TRACE, "trace close done");
 }
 
+// Stop the async trace writer, after all trace files are closed.
+void
+hpcrun_trace_fini()
+{
+  if (tracing_async && trace_writer_pid == getpid()) {
+    trace_writer_stop = 1;
+    hpcio_outbuf_async_wake();
+    pthread_join(trace_writer, NULL);
+    tracing_async = 0;
+    trace_writer_pid = 0;
+    TMSG(TRACE, "Trace writer stopped");
+  }
+}
+
 //*********************************************************************
 // private operations
 //*********************************************************************
 
+// The async writer writes the full halves of all trace outbufs, so
+// that sampled threads only copy trace records into memory.  Trace
+// outbufs that find their other half still pending help drain the
+// queue (and count a wait), so the writer is never required for
+// progress.  Between handoffs, the writer sleeps on the outbuf
+// futex.
+static void*
+hpcrun_trace_writer(void* arg)
+{
+  // never handle the application's or hpcrun's signals here
+  sigset_t mask;
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  while (!trace_writer_stop) {
+    int seq = hpcio_outbuf_async_seq();
+    if (hpcio_outbuf_async_drain() == 0 && !trace_writer_stop) {
+      hpcio_outbuf_async_sleep(seq);
+    }
+  }
+  hpcio_outbuf_async_drain();
+  return NULL;
+}
+
+
+static void
+hpcrun_trace_writer_start(void)
+{
+  // after fork(), the child has no writer thread
+  if (tracing_async && trace_writer_pid == getpid()) {
+    return;
+  }
+
+  hpcio_outbuf_async_init(hpcrun_stats_num_buffers_waited_inc);
+  trace_writer_stop = 0;
+
+  // the writer is hpcrun's own thread: do not monitor or sample it
+  monitor_disable_new_threads();
+  int ret = pthread_create(&trace_writer, NULL, hpcrun_trace_writer, NULL);
+  monitor_enable_new_threads();
+
+  if (ret != 0) {
+    EMSG("unable to create trace writer thread (%d), writing traces synchronously", ret);
+    tracing_async = 0;
+    return;
+  }
+  tracing_async = 1;
+  trace_writer_pid = getpid();
+  TMSG(TRACE, "Trace writer started");
+}
+
+
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t microtime)
 {
     if (cptd->trace_min_time_us == 0) {
@@ -239,11 +379,149 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
     flags.fields.isDataCentric = false;
 #endif
     
-    int ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, &cptd->trace_outbuf);
+    int ret = HPCFMT_OK;
+    hpctrace_fmt_blk_t* blk = cptd->trace_blk;
+    if (blk) {
+      // encode into the block; the outbuf only sees whole blocks
+      if (hpctrace_fmt_blk_isFull(blk)) {
+        ret = hpcrun_trace_blk_flush(cptd);
+      }
+      hpctrace_fmt_blk_append(blk, &trace_datum, flags);
+    }
+    else {
+      ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, &cptd->trace_outbuf);
+    }
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "append");
 }
 
 
+// Write the current block and record it in the block index.
+static int
+hpcrun_trace_blk_flush(core_profile_trace_data_t *cptd)
+{
+  hpctrace_fmt_blk_t* blk = cptd->trace_blk;
+  if (blk->numRecs == 0) {
+    return HPCFMT_OK;
+  }
+
+  trace_blkidx_chunk_t* chunk = cptd->trace_blkidx;
+  if (!chunk || chunk->n == TRACE_BLKIDX_CHUNK_SZ) {
+    chunk = hpcrun_trace_blkidx_chunk_new();
+    chunk->next = cptd->trace_blkidx;
+    chunk->n = 0;
+    cptd->trace_blkidx = chunk;
+  }
+
+  hpctrace_fmt_blkidx_t* x = &chunk->idx[chunk->n++];
+  x->time = blk->time0;
+  x->off = cptd->trace_offset;
+  x->numRecs = blk->numRecs;
+
+  int ret = hpctrace_fmt_blk_outbuf(blk, &cptd->trace_outbuf);
+  cptd->trace_offset += HPCTRACE_FMT_BlkHdrLen + blk->len;
+  hpctrace_fmt_blk_init(blk);
+  return ret;
+}
+
+
+// Write the last block, the terminating empty block, the block index
+// and the footer.
+static int
+hpcrun_trace_blk_close(core_profile_trace_data_t *cptd)
+{
+  HPCFMT_ThrowIfError(hpcrun_trace_blk_flush(cptd));
+  HPCFMT_ThrowIfError(hpctrace_fmt_blk_outbuf(cptd->trace_blk,
+					      &cptd->trace_outbuf));
+
+  hpctrace_fmt_footer_t footer;
+  footer.idxOff = cptd->trace_offset + HPCTRACE_FMT_BlkHdrLen;
+  footer.numBlocks = 0;
+
+  // chunks are kept newest first: reverse them to write in time order
+  trace_blkidx_chunk_t* prev = NULL;
+  trace_blkidx_chunk_t* chunk = cptd->trace_blkidx;
+  while (chunk) {
+    trace_blkidx_chunk_t* next = chunk->next;
+    chunk->next = prev;
+    prev = chunk;
+    chunk = next;
+  }
+  cptd->trace_blkidx = prev;
+
+  for (chunk = cptd->trace_blkidx; chunk; chunk = chunk->next) {
+    for (uint32_t i = 0; i < chunk->n; i++) {
+      HPCFMT_ThrowIfError(hpctrace_fmt_blkidx_outbuf(&chunk->idx[i],
+						     &cptd->trace_outbuf));
+      footer.numBlocks++;
+    }
+  }
+
+  HPCFMT_ThrowIfError(hpctrace_fmt_footer_outbuf(&footer, &cptd->trace_outbuf));
+  return HPCFMT_OK;
+}
+
+
+static hpctrace_fmt_blk_t*
+hpcrun_trace_blk_new(void)
+{
+  spinlock_lock(&trace_free_list_lock);
+  trace_blkbuf_t* x = s_blkbuf_free_list;
+  if (x) {
+    s_blkbuf_free_list = x->next;
+  }
+  spinlock_unlock(&trace_free_list_lock);
+
+  if (!x) {
+    x = hpcrun_malloc(sizeof(trace_blkbuf_t));
+  }
+  x->next = NULL;
+  return &x->blk;
+}
+
+
+static trace_blkidx_chunk_t*
+hpcrun_trace_blkidx_chunk_new(void)
+{
+  spinlock_lock(&trace_free_list_lock);
+  trace_blkidx_chunk_t* x = s_blkidx_free_list;
+  if (x) {
+    s_blkidx_free_list = x->next;
+  }
+  spinlock_unlock(&trace_free_list_lock);
+
+  if (!x) {
+    x = hpcrun_malloc(sizeof(trace_blkidx_chunk_t));
+  }
+  return x;
+}
+
+
+// Return the block encoder and the block index of a closed trace to
+// the free lists.
+static void
+hpcrun_trace_blk_free(core_profile_trace_data_t *cptd)
+{
+  trace_blkbuf_t* buf = trace_blkbuf_of(cptd->trace_blk);
+
+  trace_blkidx_chunk_t* last = cptd->trace_blkidx;
+  while (last && last->next) {
+    last = last->next;
+  }
+
+  spinlock_lock(&trace_free_list_lock);
+  buf->next = s_blkbuf_free_list;
+  s_blkbuf_free_list = buf;
+  if (last) {
+    last->next = s_blkidx_free_list;
+    s_blkidx_free_list = cptd->trace_blkidx;
+  }
+  spinlock_unlock(&trace_free_list_lock);
+
+  cptd->trace_blk = NULL;
+  cptd->trace_blkidx = NULL;
+}
+
+
 static void
 hpcrun_trace_file_validate(int valid, char *op)
 {
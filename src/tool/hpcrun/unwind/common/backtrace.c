@@ -69,6 +69,7 @@
 #include <monitor.h>
 
 #include <trampoline/common/trampoline.h>
+#include <fnbounds/fnbounds_interface.h>
 #include <dbg_backtrace.h>
 
 //***************************************************************************
@@ -375,6 +376,101 @@ hpcrun_generate_backtrace(backtrace_info_t* bt,
 }
 
 
+//
+// Fill the backtrace buffer from the call chain ips[0..nips), innermost
+// first, e.g. a user call chain recorded by the kernel for a perf
+// sample.  This needs only the function bounds of each IP: no unwind
+// recipes are looked up or built.  The call chain is trusted to be
+// right (frame pointers); it is rejected only if it does not reach a
+// libmonitor fence, in which case the caller should unwind instead.
+//
+bool
+hpcrun_generate_backtrace_from_callchain(backtrace_info_t* bt,
+					 void** ips, int nips, int skipInner)
+{
+  TMSG(BT, "Generate backtrace from call chain of %d frames", nips);
+  bt->has_tramp = false;
+  bt->n_trolls = 0;
+  bt->fence = FENCE_BAD;
+  bt->bottom_frame_elided = false;
+  bt->partial_unwind = true;
+
+  thread_data_t* td = hpcrun_get_thread_data();
+  td->btbuf_cur   = td->btbuf_beg; // innermost
+  td->btbuf_sav   = td->btbuf_end;
+
+  for (int i = 0; i < nips; i++) {
+    void* ip = ips[i];
+    void *func_start, *func_end;
+    load_module_t* lm;
+    if (! fnbounds_enclosing_addr(ip, &func_start, &func_end, &lm)) {
+      TMSG(BT, "call chain frame %d: no function bounds for %p", i, ip);
+      return false;
+    }
+
+    hpcrun_ensure_btbuf_avail();
+
+    frame_t* frame = td->btbuf_cur++;
+    memset(frame, 0, sizeof(*frame));
+    frame->cursor.pc_unnorm = ip;
+    frame->cursor.pc_norm = hpcrun_normalize_ip(ip, lm);
+    frame->cursor.the_function = hpcrun_normalize_ip(func_start, lm);
+    frame->ip_norm = frame->cursor.pc_norm;
+    frame->the_function = frame->cursor.the_function;
+
+    if (monitor_unwind_process_bottom_frame(ip)) {
+      bt->fence = FENCE_MAIN;
+      break;
+    }
+    if (monitor_unwind_thread_bottom_frame(ip)) {
+      bt->fence = FENCE_THREAD;
+      break;
+    }
+  }
+
+  TMSG(FENCE, "call chain detects fence = %s", fence_enum_name(bt->fence));
+  if (bt->fence == FENCE_BAD) {
+    return false;
+  }
+
+  frame_t* bt_beg  = td->btbuf_beg;      // innermost, inclusive
+  frame_t* bt_last = td->btbuf_cur - 1; // outermost, inclusive
+
+  if (skipInner) {
+    bt_beg = hpcrun_skip_chords(bt_last, bt_beg, skipInner);
+  }
+
+  bt->begin = bt_beg;
+  bt->last  = bt_last;
+  bt->partial_unwind = false;
+
+  hpcrun_stats_num_samples_callchain_inc();
+  return true;
+}
+
+
+//
+// Check a call chain the way hpcrun_generate_backtrace_from_callchain
+// does, without filling the backtrace buffer.
+//
+bool
+hpcrun_callchain_is_complete(void** ips, int nips)
+{
+  for (int i = 0; i < nips; i++) {
+    void *func_start, *func_end;
+    load_module_t* lm;
+    if (! fnbounds_enclosing_addr(ips[i], &func_start, &func_end, &lm)) {
+      return false;
+    }
+    if (monitor_unwind_process_bottom_frame(ips[i])
+	|| monitor_unwind_thread_bottom_frame(ips[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
 //***************************************************************************
 // private operations 
 //***************************************************************************
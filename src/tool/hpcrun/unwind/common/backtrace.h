@@ -117,4 +117,14 @@ bool hpcrun_generate_backtrace(backtrace_info_t* bt,
 bool hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
 					     ucontext_t* context, int skipInner);
 
+// build the backtrace from a call chain of return addresses recorded
+// by a sample source (innermost first) instead of unwinding the context.
+// returns false if the call chain does not reach a fence.
+bool hpcrun_generate_backtrace_from_callchain(backtrace_info_t* bt,
+					      void** ips, int nips, int skipInner);
+
+// true if hpcrun_generate_backtrace_from_callchain would accept the
+// call chain, ie, a sample can be attributed without its context.
+bool hpcrun_callchain_is_complete(void** ips, int nips);
+
 #endif // hpcrun_backtrace_h
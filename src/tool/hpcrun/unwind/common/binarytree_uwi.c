@@ -21,6 +21,7 @@ static struct {
   bitree_uwi_t *tree;		// global free unwind interval tree
   mcs_lock_t lock;		// lock for tree
   mem_alloc alloc;
+  size_t recipe_size;		// size of recipes, 0 until first malloc
 } GF[NUM_UNWINDERS];
 
 static __thread  bitree_uwi_t *_lf_uwi_tree[NUM_UNWINDERS]; // thread local free unwind interval tree
@@ -36,6 +37,7 @@ bitree_uwi_init(mem_alloc m_alloc)
     mcs_init(&GF[i].lock);
     GF[i].tree = NULL;
     GF[i].alloc = m_alloc;
+    GF[i].recipe_size = 0;
   }
 }
 
@@ -44,6 +46,7 @@ bitree_uwi_t*
 bitree_uwi_malloc(unwinder_t uw,
 		  size_t recipe_size)
 {
+  GF[uw].recipe_size = recipe_size;
   if (!_lf_uwi_tree[uw]) {
     mcs_node_t me;
     if (mcs_trylock(&GF[uw].lock, &me)) {
@@ -69,6 +72,12 @@ bitree_uwi_malloc(unwinder_t uw,
   return top;
 }
 
+size_t
+bitree_uwi_recipe_size(unwinder_t uw)
+{
+  return GF[uw].recipe_size;
+}
+
 /*
  * link only non null tree to GF.tree
  */
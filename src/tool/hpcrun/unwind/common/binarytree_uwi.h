@@ -86,6 +86,14 @@ bitree_uwi_init(mem_alloc m_alloc);
 bitree_uwi_t*
 bitree_uwi_malloc(unwinder_t uw, size_t recipe_size);
 
+/*
+ * Returns the recipe size of the nodes for unwinder uw, or 0 if
+ * bitree_uwi_malloc has not been called for uw yet.  Node recycling
+ * requires all recipes of one unwinder to have the same size.
+ */
+size_t
+bitree_uwi_recipe_size(unwinder_t uw);
+
 /*
  * If tree != NULL return tree to global free tree,
  * otherwise do nothing.
@@ -80,6 +80,7 @@
 //---------------------------------------------------------------------
 #include <memory/hpcrun-malloc.h>
 #include <main.h>
+#include <env.h>
 #include "thread_data.h"
 #include "uw_recipe_map.h"
 #include "unwind-interval.h"
@@ -98,9 +99,17 @@
 // global include files
 //******************************************************************************
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/stat.h>
 
 //---------------------------------------------------------------------
 // macros
@@ -553,9 +562,14 @@ uw_recipe_map_repoison(uintptr_t start, uintptr_t end, unwinder_t uw)
   uw_recipe_map_poison(start, end, uw);
 }
 
+static void
+uw_recipe_cache_register(void *start, void *end);
+
 static void
 uw_recipe_map_notify_map(void *start, void *end)
 {
+  uw_recipe_cache_register(start, end);
+
   uw_recipe_map_report_and_dump("*** map: before unpoisoning", start, end);
 
   unwinder_t uw;
@@ -596,6 +610,481 @@ uw_recipe_map_notify_init()
 
 
 
+//---------------------------------------------------------------------
+// persistent recipe cache (HPCRUN_UNWIND_CACHE)
+//---------------------------------------------------------------------
+
+/*
+ * Interval trees that one process builds are saved at exit in a file
+ * per (load module, unwinder), keyed by the module's build-id.  A later
+ * process that finds the function in the file copies its intervals
+ * instead of calling build_intervals, so DEFERRED -> READY becomes a
+ * table lookup.
+ *
+ * File layout: a uwc_hdr, then num_fcns uwc_fcn entries sorted by start,
+ * then num_ivals intervals.  An interval is a uwc_ival followed by its
+ * recipe, padded to 8 bytes.  Addresses are offsets from the start of
+ * the load module.  Recipes are copied verbatim: once a tree is built,
+ * no unwinder's recipe refers to another address (the x86 prev_canonical
+ * link is only used while building).
+ *
+ * The key is computed and the file mapped when the load module is
+ * registered (loadmap notify), not in the signal handler.  Entries are
+ * published with a CAS push, so the handler only walks lists.
+ */
+
+#define UWC_MAGIC  0x4850435557524331UL  // "HPCUWRC1"
+
+struct uwc_hdr {
+  uint64_t magic;
+  uint32_t unwinder;
+  uint32_t recipe_size;
+  uint64_t num_fcns;
+  uint64_t num_ivals;
+};
+
+struct uwc_fcn {
+  uint64_t start;
+  uint64_t end;
+  uint64_t first;  // index of the first interval
+  uint64_t count;
+};
+
+struct uwc_ival {
+  uint64_t start;
+  uint64_t end;
+};
+
+// the intervals of one function built by this process
+typedef struct uwc_added_s {
+  struct uwc_added_s *next;  // immutable once published
+  struct uwc_fcn fcn;
+  char ivals[];
+} uwc_added_t;
+
+typedef struct uwc_lm_s {
+  struct uwc_lm_s *next;  // immutable once published
+  load_module_t *lm;
+  unwinder_t uw;
+  char key[FNBOUNDS_CACHE_KEY_LEN];
+  struct uwc_hdr *file;  // mapped cache file or NULL
+  size_t file_size;
+  _Atomic(uwc_added_t *) added;
+  atomic_long num_added;
+} uwc_lm_t;
+
+static const char *uwc_dir = NULL;
+static _Atomic(uwc_lm_t *) uwc_lms = ATOMIC_VAR_INIT(NULL);
+
+
+static size_t
+uwc_ival_size(size_t recipe_size)
+{
+  return sizeof(struct uwc_ival) + ((recipe_size + 7) & ~((size_t) 7));
+}
+
+
+static const struct uwc_fcn *
+uwc_fcns(struct uwc_hdr *hdr)
+{
+  return (const struct uwc_fcn *) (hdr + 1);
+}
+
+
+static const char *
+uwc_ivals(struct uwc_hdr *hdr)
+{
+  return (const char *) (uwc_fcns(hdr) + hdr->num_fcns);
+}
+
+
+// Returns: true if [first, first + count) is an interval range of 'hdr'
+static bool
+uwc_fcn_inrange(const struct uwc_hdr *hdr, const struct uwc_fcn *fcn)
+{
+  return fcn->first <= hdr->num_ivals
+    && fcn->count <= hdr->num_ivals - fcn->first;
+}
+
+
+// Returns: true if a file of 'size' bytes holds exactly the tables
+// 'hdr' describes.  Counts are checked by division, so that a corrupt
+// header cannot overflow the computed size.
+static bool
+uwc_size_ok(const struct uwc_hdr *hdr, uint64_t size)
+{
+  if (size < sizeof(*hdr)) {
+    return false;
+  }
+  uint64_t rest = size - sizeof(*hdr);
+  if (hdr->num_fcns > rest / sizeof(struct uwc_fcn)) {
+    return false;
+  }
+  rest -= hdr->num_fcns * sizeof(struct uwc_fcn);
+  uint64_t stride = uwc_ival_size(hdr->recipe_size);
+  return hdr->num_ivals <= rest / stride && hdr->num_ivals * stride == rest;
+}
+
+
+// Returns: true if every function's intervals lie within the file and
+// the functions are sorted by start (cf. uwc_fcn_find)
+static bool
+uwc_fcns_ok(struct uwc_hdr *hdr)
+{
+  const struct uwc_fcn *fcns = uwc_fcns(hdr);
+  for (uint64_t i = 0; i < hdr->num_fcns; i++) {
+    if (!uwc_fcn_inrange(hdr, &fcns[i])
+	|| fcns[i].start >= fcns[i].end
+	|| (i > 0 && fcns[i - 1].start >= fcns[i].start)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+static void
+uwc_path(char *path, uwc_lm_t *c, const char *sfx)
+{
+  snprintf(path, PATH_MAX, "%s/%s.uw%d%s", uwc_dir, c->key, (int) c->uw, sfx);
+}
+
+
+// map the cache file of 'c', if there is a valid one
+static void
+uwc_map(uwc_lm_t *c)
+{
+  char path[PATH_MAX];
+  uwc_path(path, c, "");
+
+  c->file = NULL;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  struct uwc_hdr hdr;
+  if (fstat(fd, &st) != 0
+      || read(fd, &hdr, sizeof(hdr)) != sizeof(hdr)
+      || hdr.magic != UWC_MAGIC
+      || hdr.unwinder != c->uw
+      || st.st_size < 0
+      || !uwc_size_ok(&hdr, (uint64_t) st.st_size)) {
+    close(fd);
+    return;
+  }
+
+  void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr != MAP_FAILED && !uwc_fcns_ok(addr)) {
+    // one bad entry means the file cannot be trusted at all
+    TMSG(UW_RECIPE_MAP, "unwind cache: ignoring corrupt %s", path);
+    munmap(addr, st.st_size);
+    addr = MAP_FAILED;
+  }
+  if (addr != MAP_FAILED) {
+    c->file = addr;
+    c->file_size = st.st_size;
+    TMSG(UW_RECIPE_MAP, "unwind cache: mapped %s (%ld functions)",
+	 path, (long) hdr.num_fcns);
+  }
+}
+
+
+// Returns: the cache entry for (lm, uw), or NULL if lm is not cached.
+// Safe in the signal handler: only reads published entries.
+static uwc_lm_t *
+uwc_get(load_module_t *lm, unwinder_t uw)
+{
+  if (lm == NULL || lm->dso_info == NULL) {
+    return NULL;
+  }
+
+  uwc_lm_t *c = atomic_load_explicit(&uwc_lms, memory_order_acquire);
+  for (; c != NULL; c = c->next) {
+    if (c->lm == lm && c->uw == uw) break;
+  }
+  return c;
+}
+
+
+// Create and publish the cache entries of the load module that was
+// just mapped at [start, end).  Called at load module registration,
+// so the open/mmap of the cache file stays out of the handler.
+static void
+uw_recipe_cache_register(void *start, void *end)
+{
+  if (uwc_dir == NULL) {
+    return;
+  }
+  load_module_t *lm = hpcrun_loadmap_findByAddr(start, end);
+  if (lm == NULL || lm->dso_info == NULL || uwc_get(lm, 0) != NULL) {
+    // not found, or a remap of a load module we already have
+    return;
+  }
+
+  char key[FNBOUNDS_CACHE_KEY_LEN];
+  if (!fnbounds_cache_key(lm->name, key)) {
+    return;
+  }
+
+  unwinder_t uw;
+  for (uw = 0; uw < NUM_UNWINDERS; uw++) {
+    uwc_lm_t *c = my_alloc(sizeof(*c));
+    if (c == NULL) {
+      return;
+    }
+    memset(c, 0, sizeof(*c));
+    c->lm = lm;
+    c->uw = uw;
+    memcpy(c->key, key, sizeof(key));
+    atomic_init(&c->added, NULL);
+    atomic_init(&c->num_added, 0);
+    uwc_map(c);
+
+    uwc_lm_t *head = atomic_load_explicit(&uwc_lms, memory_order_relaxed);
+    do {
+      c->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&uwc_lms, &head, c,
+						    memory_order_release,
+						    memory_order_relaxed));
+  }
+}
+
+
+static const struct uwc_fcn *
+uwc_fcn_find(struct uwc_hdr *hdr, uint64_t start)
+{
+  const struct uwc_fcn *fcns = uwc_fcns(hdr);
+  uint64_t lo = 0, hi = hdr->num_fcns;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (fcns[mid].start < start) lo = mid + 1;
+    else hi = mid;
+  }
+  return (lo < hdr->num_fcns && fcns[lo].start == start) ? &fcns[lo] : NULL;
+}
+
+
+/*
+ * Returns: the intervals of [start, end) from the cache file as a list
+ * linked by right subtrees (like build_intervals), or NULL on a miss.
+ */
+static bitree_uwi_t *
+uw_recipe_cache_find(load_module_t *lm, uintptr_t start, uintptr_t end,
+		     unwinder_t uw, int *count)
+{
+  // the first tree of each unwinder is always built, which fixes the
+  // recipe size for the node free lists
+  size_t recipe_size = bitree_uwi_recipe_size(uw);
+  if (uwc_dir == NULL || recipe_size == 0) {
+    return NULL;
+  }
+  uwc_lm_t *c = uwc_get(lm, uw);
+  if (c == NULL || c->file == NULL || c->file->recipe_size != recipe_size) {
+    return NULL;
+  }
+
+  uintptr_t base = (uintptr_t) lm->dso_info->start_addr;
+  const struct uwc_fcn *fcn = uwc_fcn_find(c->file, start - base);
+  if (fcn == NULL || fcn->end != end - base || fcn->count == 0
+      || fcn->count > INT_MAX || !uwc_fcn_inrange(c->file, fcn)) {
+    return NULL;
+  }
+
+  size_t stride = uwc_ival_size(recipe_size);
+  const char *ival = uwc_ivals(c->file) + fcn->first * stride;
+  bitree_uwi_t *first = NULL, *last = NULL;
+  for (uint64_t i = 0; i < fcn->count; i++, ival += stride) {
+    bitree_uwi_t *u = bitree_uwi_malloc(uw, recipe_size);
+    if (u == NULL) {
+      bitree_uwi_free(uw, first);
+      return NULL;
+    }
+    const struct uwc_ival *iv = (const struct uwc_ival *) ival;
+    uwi_t *uwi = bitree_uwi_rootval(u);
+    uwi->interval.start = base + iv->start;
+    uwi->interval.end = base + iv->end;
+    memcpy(uwi->recipe, iv + 1, recipe_size);
+    if (last) bitree_uwi_set_rightsubtree(last, u);
+    else first = u;
+    last = u;
+  }
+
+  *count = fcn->count;
+  return first;
+}
+
+
+// remember the intervals just built for [start, end) for the cache file
+static void
+uw_recipe_cache_add(load_module_t *lm, uintptr_t start, uintptr_t end,
+		    unwinder_t uw, bitree_uwi_t *first, int count)
+{
+  if (uwc_dir == NULL || count <= 0) {
+    return;
+  }
+  uwc_lm_t *c = uwc_get(lm, uw);
+  if (c == NULL) {
+    return;
+  }
+
+  uintptr_t base = (uintptr_t) lm->dso_info->start_addr;
+  size_t recipe_size = bitree_uwi_recipe_size(uw);
+  size_t stride = uwc_ival_size(recipe_size);
+  uwc_added_t *a = my_alloc(sizeof(*a) + count * stride);
+  if (a == NULL) {
+    return;
+  }
+  a->fcn.start = start - base;
+  a->fcn.end = end - base;
+  a->fcn.count = count;
+
+  char *ival = a->ivals;
+  bitree_uwi_t *u = first;
+  for (int i = 0; i < count && u != NULL; i++, ival += stride) {
+    uwi_t *uwi = bitree_uwi_rootval(u);
+    struct uwc_ival *iv = (struct uwc_ival *) ival;
+    iv->start = uwi->interval.start - base;
+    iv->end = uwi->interval.end - base;
+    memset(iv + 1, 0, stride - sizeof(*iv));
+    memcpy(iv + 1, uwi->recipe, recipe_size);
+    u = bitree_uwi_rightsubtree(u);
+  }
+
+  uwc_added_t *head = atomic_load_explicit(&c->added, memory_order_relaxed);
+  do {
+    a->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&c->added, &head, a,
+						  memory_order_release,
+						  memory_order_relaxed));
+  atomic_fetch_add_explicit(&c->num_added, 1, memory_order_relaxed);
+}
+
+
+typedef struct uwc_src_s {
+  struct uwc_fcn fcn;
+  const char *ivals;
+} uwc_src_t;
+
+
+static int
+uwc_src_cmp(const void *lhs, const void *rhs)
+{
+  const uwc_src_t *l = lhs;
+  const uwc_src_t *r = rhs;
+  if (l->fcn.start != r->fcn.start) {
+    return (l->fcn.start < r->fcn.start) ? -1 : 1;
+  }
+  // for equal starts, entries from the file come first
+  return (l->fcn.first < r->fcn.first) ? -1 : (l->fcn.first > r->fcn.first);
+}
+
+
+static bool
+uwc_write(int fd, const void *buf, size_t len)
+{
+  const char *p = buf;
+  while (len > 0) {
+    ssize_t ret = write(fd, p, len);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) return false;
+    p += ret;
+    len -= ret;
+  }
+  return true;
+}
+
+
+// merge the functions built by this process into the cache file of 'c'
+static void
+uwc_store(uwc_lm_t *c)
+{
+  char path[PATH_MAX], tmp_path[PATH_MAX], sfx[64];
+  size_t recipe_size = bitree_uwi_recipe_size(c->uw);
+  size_t stride = uwc_ival_size(recipe_size);
+
+  snprintf(sfx, sizeof(sfx), ".lock");
+  uwc_path(path, c, sfx);
+  int lock_fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0) {
+    if (lock_fd >= 0) close(lock_fd);
+    return;
+  }
+
+  // another process may have updated the file since we mapped it
+  if (c->file) {
+    munmap(c->file, c->file_size);
+  }
+  uwc_map(c);
+  uint64_t num_old = 0;
+  if (c->file && c->file->recipe_size == recipe_size) {
+    num_old = c->file->num_fcns;
+  }
+
+  uwc_added_t *added = atomic_load_explicit(&c->added, memory_order_acquire);
+  uint64_t num_added = 0;
+  for (uwc_added_t *a = added; a != NULL; a = a->next) {
+    num_added++;
+  }
+
+  uwc_src_t *srcs = my_alloc((num_old + num_added) * sizeof(*srcs));
+  if (srcs == NULL) {
+    goto unlock;
+  }
+  uint64_t n = 0;
+  for (uint64_t i = 0; i < num_old; i++, n++) {
+    srcs[n].fcn = uwc_fcns(c->file)[i];
+    srcs[n].ivals = uwc_ivals(c->file) + srcs[n].fcn.first * stride;
+    srcs[n].fcn.first = 0;
+  }
+  for (uwc_added_t *a = added; a != NULL; a = a->next, n++) {
+    srcs[n].fcn = a->fcn;
+    srcs[n].fcn.first = 1;
+    srcs[n].ivals = a->ivals;
+  }
+  qsort(srcs, n, sizeof(*srcs), uwc_src_cmp);
+
+  // drop duplicates and assign interval indices
+  struct uwc_hdr hdr = { UWC_MAGIC, c->uw, recipe_size, 0, 0 };
+  for (uint64_t i = 0; i < n; i++) {
+    if (hdr.num_fcns > 0 && srcs[hdr.num_fcns - 1].fcn.start == srcs[i].fcn.start) {
+      continue;
+    }
+    srcs[hdr.num_fcns] = srcs[i];
+    srcs[hdr.num_fcns].fcn.first = hdr.num_ivals;
+    hdr.num_ivals += srcs[i].fcn.count;
+    hdr.num_fcns++;
+  }
+
+  snprintf(sfx, sizeof(sfx), ".%d", (int) getpid());
+  uwc_path(tmp_path, c, sfx);
+  uwc_path(path, c, "");
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    TMSG(UW_RECIPE_MAP, "unwind cache: unable to create %s", tmp_path);
+    goto unlock;
+  }
+  bool ok = uwc_write(fd, &hdr, sizeof(hdr));
+  for (uint64_t i = 0; ok && i < hdr.num_fcns; i++) {
+    ok = uwc_write(fd, &srcs[i].fcn, sizeof(srcs[i].fcn));
+  }
+  for (uint64_t i = 0; ok && i < hdr.num_fcns; i++) {
+    ok = uwc_write(fd, srcs[i].ivals, srcs[i].fcn.count * stride);
+  }
+  ok = (close(fd) == 0) && ok;
+  if (!ok || rename(tmp_path, path) != 0) {
+    TMSG(UW_RECIPE_MAP, "unwind cache: unable to write %s", path);
+    unlink(tmp_path);
+  }
+
+ unlock:
+  flock(lock_fd, LOCK_UN);
+  close(lock_fd);
+}
+
+
 //---------------------------------------------------------------------
 // interface operations
 //---------------------------------------------------------------------
@@ -626,6 +1115,11 @@ uw_recipe_map_init(void)
       cskl_new(lsentinel, rsentinel, SKIPLIST_HEIGHT,
 	       ilmstat_btuwi_pair_cmp, ilmstat_btuwi_pair_inrange, my_alloc);
 
+  uwc_dir = getenv(HPCRUN_UNWIND_CACHE);
+  if (uwc_dir != NULL && *uwc_dir == 0) {
+    uwc_dir = NULL;
+  }
+
   uw_recipe_map_notify_init();
 
   // initialize the map with a POISONED node ({([0, UINTPTR_MAX), NULL), NEVER}, NULL)
@@ -710,10 +1204,20 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
 
     int ljmp = sigsetjmp(td->bad_interval.jb, 1);
     if (ljmp == 0) {
-      btuwi_status_t btuwi_stat = build_intervals(fcn_start, fcn_end - fcn_start, uw);
-      if (btuwi_stat.error != 0) {
-        TMSG(UW_RECIPE_MAP, "build_intervals: fcn range %p to %p: error %d",
-       fcn_start, fcn_end, btuwi_stat.error);
+      btuwi_status_t btuwi_stat;
+      btuwi_stat.first =
+	uw_recipe_cache_find(ilm_btui->lm, (uintptr_t)fcn_start, (uintptr_t)fcn_end,
+			     uw, &btuwi_stat.count);
+      if (btuwi_stat.first == NULL) {
+	btuwi_stat = build_intervals(fcn_start, fcn_end - fcn_start, uw);
+	if (btuwi_stat.error != 0) {
+	  TMSG(UW_RECIPE_MAP, "build_intervals: fcn range %p to %p: error %d",
+	       fcn_start, fcn_end, btuwi_stat.error);
+	}
+	else {
+	  uw_recipe_cache_add(ilm_btui->lm, (uintptr_t)fcn_start, (uintptr_t)fcn_end,
+			      uw, btuwi_stat.first, btuwi_stat.count);
+	}
       }
       ilm_btui->btuwi = bitree_uwi_rebalance(btuwi_stat.first, btuwi_stat.count);
       atomic_store_explicit(&ilm_btui->stat, READY, memory_order_release);
@@ -746,3 +1250,21 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
 
   return (unwr_info->btuwi != NULL);
 }
+
+
+/*
+ * save the trees built by this process in the unwind recipe cache
+ */
+void
+uw_recipe_map_fini(void)
+{
+  if (uwc_dir == NULL) {
+    return;
+  }
+  uwc_lm_t *c = atomic_load_explicit(&uwc_lms, memory_order_acquire);
+  for (; c != NULL; c = c->next) {
+    if (atomic_load_explicit(&c->num_added, memory_order_relaxed) > 0) {
+      uwc_store(c);
+    }
+  }
+}
@@ -68,4 +68,11 @@ uw_recipe_map_init(void);
 bool
 uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info);
 
+/*
+ * if HPCRUN_UNWIND_CACHE is set, add the interval trees built by this
+ * process to the cache files there
+ */
+void
+uw_recipe_map_fini(void);
+
 #endif  /* !_UW_RECIPE_MAP_H_ */
@@ -120,6 +120,11 @@ Options: General\n\
                            indicates that the port will be auto-negotiated with\n\
                            the client. Specifying 1 indicates that the xml will\n\
                            be transferred on the main data port.\n\
+  -y, --pyramid        Enables or disables the trace pyramid (off by default)\n\
+                       Allowed values: on off \n\
+                           When on, zoomed-out timelines are sampled from\n\
+                           experiment.mt.pyramid, a multi-resolution index\n\
+                           that is built once when the database is opened.\n\
 \n\
 ";
 
@@ -149,6 +154,8 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
      CLP::isOptArg_long },
   {  'x' , "xmlport",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
      CLP::isOptArg_long },
+  {  'y' , "pyramid",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   CmdLineParser_OptArgDesc_NULL_MACRO // SGI's compiler requires this version
 };
 
@@ -178,6 +185,7 @@ Args::Ctor()
   compression = true;
   mainPort = DEFAULT_PORT;//21590
   xmlPort = 0;
+  pyramid = false;
 }
 
 
@@ -258,6 +266,10 @@ Args::parse(int argc, const char* const argv[])
       const string& arg = parser.getOptArg("compression");
       compression = CmdLineParser::parseArg_bool(arg, "--compression option");
     }
+    if (parser.isOpt("pyramid")) {
+      const string& arg = parser.getOptArg("pyramid");
+      pyramid = CmdLineParser::parseArg_bool(arg, "--pyramid option");
+    }
     if (parser.isOpt("port")) {
       const string& arg = parser.getOptArg("port");
       mainPort = (int) CmdLineParser::toLong(arg);
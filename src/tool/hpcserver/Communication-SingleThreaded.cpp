@@ -57,7 +57,10 @@
 //
 //***************************************************************************
 
+#include <include/hpctoolkit-config.h>
+
 #include <stdint.h>                     // for uint64_t
+#include <exception>                    // for exception_ptr
 #include <iostream>                     // for operator<<, basic_ostream, etc
 #include <string>                       // for string
 #include <vector>                       // for vector, vector<>::iterator
@@ -103,44 +106,82 @@ void Communication::sendStartGetData(SpaceTimeDataController* contr, int process
 }
 void Communication::sendEndGetData(DataSocketStream* stream, ProgressBar* prog, SpaceTimeDataController* controller)
 {
-	// TODO: Make this so that the Lines get sent as soon as they are
-	// filled.
-
-	controller->fillTraces();
-	for (int i = 0; i < controller->tracesLength; i++)
+	// Lines are read in and compressed by a team of threads. Each line is
+	// sent as soon as it and all the lines before it are done, so the client
+	// receives them in order while later lines are still being computed.
+	controller->resetTraces();
+	int numTraces = controller->tracesLength;
+
+	std::exception_ptr error;
+
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for ordered schedule(dynamic, 1)
+#endif
+	for (int i = 0; i < numTraces; i++)
 	{
-
-		ProcessTimeline* timeline = controller->traces[i];
-		stream->writeInt( timeline->line());
-		vector<TimeCPID> data = *timeline->data->listCPID;
-		stream->writeInt( data.size());
-		// Begin time
-		stream->writeLong( data[0].timestamp);
-		//End time
-		stream->writeLong( data[data.size() - 1].timestamp);
-
-		DataCompressionLayer comprStr;
-
-		vector<TimeCPID>::iterator it;
-		DEBUGCOUT(2) << "Sending process timeline with " << data.size() << " entries" << endl;
-
-
-		Time currentTime = data[0].timestamp;
-		for (it = data.begin(); it != data.end(); ++it)
+		try
 		{
-			comprStr.writeInt( (int)(it->timestamp - currentTime));
-			comprStr.writeInt( it->cpid);
-			currentTime = it->timestamp;
+			ProcessTimeline* timeline = controller->fillTrace(i);
+			vector<TimeCPID>& data = *timeline->data->listCPID;
+
+			DataCompressionLayer comprStr;
+
+			vector<TimeCPID>::iterator it;
+			DEBUGCOUT(2) << "Sending process timeline with " << data.size() << " entries" << endl;
+
+
+			Time currentTime = data[0].timestamp;
+			for (it = data.begin(); it != data.end(); ++it)
+			{
+				comprStr.writeInt( (int)(it->timestamp - currentTime));
+				comprStr.writeInt( it->cpid);
+				currentTime = it->timestamp;
+			}
+			comprStr.flush();
+			int outputBufferLen = comprStr.getOutputLength();
+			char* outputBuffer = (char*)comprStr.getOutputBuffer();
+
+#ifdef ENABLE_OPENMP
+#pragma omp ordered
+#endif
+			{
+				bool failed;
+#ifdef ENABLE_OPENMP
+#pragma omp critical (sendEndGetData_error)
+#endif
+				failed = (bool) error;
+
+				// once a line is lost, the ones after it can't be sent
+				if (!failed)
+				{
+					stream->writeInt( timeline->line());
+					stream->writeInt( data.size());
+					// Begin time
+					stream->writeLong( data[0].timestamp);
+					//End time
+					stream->writeLong( data[data.size() - 1].timestamp);
+
+					stream->writeInt(outputBufferLen);
+
+					stream->writeRawData(outputBuffer, outputBufferLen);
+					prog->incrementProgress();
+				}
+			}
+		}
+		catch (...)
+		{
+#ifdef ENABLE_OPENMP
+#pragma omp critical (sendEndGetData_error)
+#endif
+			{
+				if (!error)
+					error = std::current_exception();
+			}
 		}
-		comprStr.flush();
-		int outputBufferLen = comprStr.getOutputLength();
-		char* outputBuffer = (char*)comprStr.getOutputBuffer();
-
-		stream->writeInt(outputBufferLen);
-
-		stream->writeRawData(outputBuffer, outputBufferLen);
-		prog->incrementProgress();
 	}
+
+	if (error)
+		std::rethrow_exception(error);
 	stream->flush();
 }
 
@@ -62,6 +62,7 @@
 
 #include "sys/stat.h"
 #include "dirent.h"
+#include <unistd.h>
 #include <iostream>
 #include <vector>
 #include <errno.h>
@@ -148,6 +149,43 @@ namespace TraceviewerServer
 			return validFiles;
 		}
 
+		//Writes all 'len' bytes of 'buffer' at offset 'off' of 'fd'
+		static bool pwriteFully(FileDescriptor fd, const char* buffer, size_t len, FileOffset off)
+		{
+			while (len > 0)
+			{
+				ssize_t n = pwrite(fd, buffer, len, off);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+				{
+					cerr << "Write failed: " << strerror(errno) << endl;
+					return false;
+				}
+				buffer += n;
+				len -= n;
+				off += n;
+			}
+			return true;
+		}
+
+		//Reads 'len' bytes at offset 'off' of 'fd' into 'buffer'. Fails at end of file.
+		static bool preadFully(FileDescriptor fd, char* buffer, size_t len, FileOffset off)
+		{
+			while (len > 0)
+			{
+				ssize_t n = pread(fd, buffer, len, off);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					return false;
+				buffer += n;
+				len -= n;
+				off += n;
+			}
+			return true;
+		}
+
 		//Because atoi returns 0 when the string is invalid, there's no easy way
 		//to distinguish between "0" and an invalid string. This method helps with
 		//that by testing the string to ensure it is only whitespace and '0's.
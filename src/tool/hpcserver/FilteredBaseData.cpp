@@ -67,12 +67,14 @@
 
 #include "DebugUtils.hpp"
 #include "FilteredBaseData.hpp"
+#include "Server.hpp"
 
 namespace TraceviewerServer {
 FilteredBaseData::FilteredBaseData(string filename, int _headerSize) {
 	baseDataFile = new BaseDataFile(filename, _headerSize);
 	headerSize = _headerSize;
 	baseOffsets = baseDataFile->getOffsets();
+	pyramid = useTracePyramid ? TracePyramid::open(filename) : NULL;
 	//Filters are default, which is allow everything, so this will initialize the vector
 	filter();
 
@@ -80,6 +82,7 @@ FilteredBaseData::FilteredBaseData(string filename, int _headerSize) {
 
 FilteredBaseData::~FilteredBaseData() {
 	delete baseDataFile;
+	delete pyramid;
 }
 
 void FilteredBaseData::setFilters(FilterSet _filter)
@@ -121,6 +124,19 @@ int FilteredBaseData::getInt(FileOffset position)
 	return baseDataFile->getMasterBuffer()->getInt(position);
 }
 
+bool FilteredBaseData::findPyramidLevel(int pseudoRank, Long maxStride,
+		FileOffset& minLoc, FileOffset& maxLoc, Long& stride)
+{
+	assert((unsigned int)pseudoRank < rankMapping.size());
+	return pyramid != NULL
+			&& pyramid->findLevel(rankMapping[pseudoRank], maxStride, minLoc, maxLoc, stride);
+}
+
+TracePyramid* FilteredBaseData::getPyramid()
+{
+	return pyramid;
+}
+
 int FilteredBaseData::getNumberOfRanks()
 {
 	return rankMapping.size();
@@ -64,6 +64,7 @@
 #include "BaseDataFile.hpp"
 #include "FilterSet.hpp"
 #include "FileUtils.hpp"//For FileOffset
+#include "TracePyramid.hpp"
 
 #include <vector>
 #include <stdint.h>
@@ -82,6 +83,9 @@ namespace TraceviewerServer
 		FileOffset getMaxLoc(int pseudoRank);
 		int64_t getLong(FileOffset position);
 		int getInt(FileOffset position);
+		bool findPyramidLevel(int pseudoRank, Long maxStride,
+				FileOffset& minLoc, FileOffset& maxLoc, Long& stride);
+		TracePyramid* getPyramid();
 		int getNumberOfRanks();
 		int* getProcessIDs();
 		short* getThreadIDs();
@@ -90,6 +94,7 @@ namespace TraceviewerServer
 		void filter();
 
 		BaseDataFile* baseDataFile;
+		TracePyramid* pyramid;
 		OffsetPair* baseOffsets;
 		FilterSet currentlyAppliedFilter;
 		//Maps the pseudoranks the program asks for from the unfiltered
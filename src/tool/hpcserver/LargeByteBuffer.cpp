@@ -127,25 +127,95 @@ namespace TraceviewerServer
 
 		}
 
+		//If the whole file fits in the page budget, no page is ever evicted,
+		//so map everything now and read without touching the LRU list. This
+		//keeps reads lock-free when several threads sample timelines at once.
+		if (numPages <= MaxPages)
+		{
+			for (int i = 0; i < numPages; i++)
+				residentPages.push_back(masterBuffer[i].get());
+		}
+
+		pthread_rwlock_init(&pagesLock, NULL);
+		mappedPages.assign(numPages, (char*) NULL);
+		lastUse.assign(numPages, 0);
+		epoch = 0;
 	}
 
 	int LargeByteBuffer::getInt(FileOffset pos)
 	{
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
-		char* p2D = masterBuffer[Page].get() + loc;
-		int val = ByteUtilities::readInt(p2D);
+		if (!residentPages.empty())
+			return ByteUtilities::readInt(residentPages[Page] + loc);
+
+		int val = ByteUtilities::readInt(lockPage(Page) + loc);
+		pthread_rwlock_unlock(&pagesLock);
 		return val;
 	}
 	Long LargeByteBuffer::getLong(FileOffset pos)
 	{
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
-		char* p2D = masterBuffer[Page].get() + loc;
-		Long val = ByteUtilities::readLong(p2D);
+		if (!residentPages.empty())
+			return ByteUtilities::readLong(residentPages[Page] + loc);
+
+		Long val = ByteUtilities::readLong(lockPage(Page) + loc);
+		pthread_rwlock_unlock(&pagesLock);
 		return val;
 
 	}
+
+	/**
+	 * Returns the address of page 'page' with pagesLock held, so that it
+	 * cannot be unmapped until the caller unlocks. A mapped page only
+	 * needs the read lock; otherwise, the page is mapped under the write
+	 * lock, which the caller then holds.
+	 */
+	char* LargeByteBuffer::lockPage(int page)
+	{
+		pthread_rwlock_rdlock(&pagesLock);
+		char* p = mappedPages[page];
+		if (p != NULL)
+		{
+			Long now = __atomic_load_n(&epoch, __ATOMIC_RELAXED);
+			if (__atomic_load_n(&lastUse[page], __ATOMIC_RELAXED) != now)
+				__atomic_store_n(&lastUse[page], now, __ATOMIC_RELAXED);
+			return p;
+		}
+		pthread_rwlock_unlock(&pagesLock);
+
+		pthread_rwlock_wrlock(&pagesLock);
+		if (mappedPages[page] == NULL)
+			mapPage(page);
+		return mappedPages[page];
+	}
+
+	/**
+	 * Maps 'page', evicting the least recently used page if the budget
+	 * is full. Call with pagesLock held exclusively.
+	 */
+	void LargeByteBuffer::mapPage(int page)
+	{
+		//Reads do not touch the LRU list, so first bring it up to date
+		//with their epochs, oldest first
+		vector<pair<Long, int> > used;
+		for (int i = 0; i < numPages; i++)
+			if (mappedPages[i] != NULL)
+				used.push_back(make_pair(lastUse[i], i));
+		sort(used.begin(), used.end());
+		for (size_t k = 0; k < used.size(); k++)
+			masterBuffer[used[k].second].get();
+
+		masterBuffer[page].get();
+		epoch++;
+		lastUse[page] = epoch;
+
+		for (size_t k = 0; k < used.size(); k++)
+			if (!masterBuffer[used[k].second].mapped())
+				mappedPages[used[k].second] = NULL;
+		mappedPages[page] = masterBuffer[page].get();
+	}
 	//Could very well be a template, but we only use it for uint64_t
 	uint64_t LargeByteBuffer::lcm(uint64_t _a, uint64_t _b)
 	{
@@ -196,6 +266,7 @@ namespace TraceviewerServer
 	{
 		masterBuffer.clear();
 		delete pageManagementList;
+		pthread_rwlock_destroy(&pagesLock);
 
 	}
 }
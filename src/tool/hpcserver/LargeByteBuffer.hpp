@@ -68,6 +68,7 @@
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include <pthread.h>
 
 namespace TraceviewerServer
 {
@@ -83,10 +84,23 @@ namespace TraceviewerServer
 	private:
 		static uint64_t lcm(uint64_t, uint64_t);
 		static uint64_t getRamSize();
+		char* lockPage(int);
+		void mapPage(int);
 		vector<VersatileMemoryPage> masterBuffer;
+		//Pages mapped for the lifetime of the buffer; empty if the file is too large
+		vector<char*> residentPages;
 		int numPages;
 		LRUList<VersatileMemoryPage>* pageManagementList;
 
+		//Otherwise, reads of mapped pages share pagesLock, and only mapping
+		//(and evicting) a page takes it exclusively. mappedPages[i] is the
+		//address of page i or NULL, and lastUse[i] the epoch (number of
+		//mappings so far) of its last read, which orders the LRU list
+		pthread_rwlock_t pagesLock;
+		vector<char*> mappedPages;
+		vector<Long> lastUse;
+		Long epoch;
+
 	};
 
 } /* namespace TraceviewerServer */
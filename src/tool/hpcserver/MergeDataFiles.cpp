@@ -58,6 +58,8 @@
 //
 //***************************************************************************
 
+#include <include/hpctoolkit-config.h>
+
 #include "MergeDataFiles.hpp"
 #include "ByteUtilities.hpp"
 #include "Constants.hpp"
@@ -69,8 +71,18 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
 #include <sstream>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcfmt.h>
+
 using namespace std;
 typedef int64_t Long;
 namespace TraceviewerServer
@@ -83,38 +95,123 @@ namespace TraceviewerServer
 
 		DEBUGCOUT(2) << "Checking to see if " << outputFile << " exists" << endl;
 
-
+		bool incremental = false;
 		if (FileUtils::exists(outputFile))
 		{
 
 			DEBUGCOUT(2) << "Exists" << endl;
 
-			if (isMergedFileCorrect(&outputFile))
+			if (!isMergedFileCorrect(&outputFile))
+			{
+				// the file exists but corrupted.
+				cout << "Database file may be corrupted. Continuing" << endl;
+				return STATUS_UNKNOWN;
+				//remove(OutputFile.string().c_str());
+			}
+			// traces added to the database since it was merged are
+			// merged into the existing file
+			if (!atLeastOneValidFile(directory))
 				return SUCCESS_ALREADY_CREATED;
-			// the file exists but corrupted.
-			cout << "Database file may be corrupted. Continuing" << endl;
-			return STATUS_UNKNOWN;
-			//remove(OutputFile.string().c_str());
+			incremental = true;
 		}
+		else
+		{
+			DEBUGCOUT(2) << "Doesn't exist" << endl;
+			// check if the files in glob patterns is correct
 
-		DEBUGCOUT(2) << "Doesn't exist" << endl;
-		// check if the files in glob patterns is correct
+			if (!atLeastOneValidFile(directory))
+			{
+				return FAIL_NO_DATA;
+			}
+			remove(manifestFileName(outputFile).c_str());
+		}
 
-		if (!atLeastOneValidFile(directory))
+		//-----------------------------------------------------
+		// 1. Record the process ID and thread ID of each trace
+		//   It will also detect if the application is mp, mt, or hybrid
+		//	 no accelator is supported
+		//-----------------------------------------------------
+		vector<string> traceFileNames = getTraceFiles(directory, outputFile);
+		vector<MergedTrace> traces;
+		int type = parseTraceNames(directory, suffix, traceFileNames, traces);
+		if (incremental && traces.empty())
+			return SUCCESS_ALREADY_CREATED;
+
+		// the size of a trace in the merged file fixes the offsets of
+		// all the traces after it
+		int numNew = traces.size();
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+		for (int i = 0; i < numNew; i++)
 		{
-			return FAIL_NO_DATA;
+			traces[i].size = getMergedTraceSize(traces[i].filename);
+		}
+
+		vector<string> mergedFileNames;
+		for (int i = 0; i < numNew; i++)
+			mergedFileNames.push_back(traces[i].filename);
+
+		string oldFile;
+		if (incremental)
+		{
+			vector<MergedTrace> oldTraces;
+			int oldType;
+			if (!readMergedFile(outputFile, &oldType, oldTraces))
+			{
+				cout << "Database file may be corrupted. Continuing" << endl;
+				return STATUS_UNKNOWN;
+			}
+			DEBUGCOUT(2) << "Adding " << numNew << " traces to " << oldTraces.size()
+					<< " merged traces" << endl;
+			type |= oldType;
+
+			// keep the merged file ordered by process and thread
+			vector<MergedTrace> allTraces(oldTraces.size() + traces.size());
+			std::merge(oldTraces.begin(), oldTraces.end(), traces.begin(), traces.end(),
+					allTraces.begin(), compareRank);
+			traces.swap(allTraces);
+			oldFile = outputFile;
 		}
 
-		DataOutputFileStream dos(outputFile.c_str());
+		//-----------------------------------------------------
+		// 2. Write the header, the index and the traces
+		//-----------------------------------------------------
+		if (!writeMergedFile(outputFile, type, traces, oldFile))
+		{
+			if (incremental)
+			{
+				cerr << "Could not add new traces to " << outputFile << endl;
+				return SUCCESS_ALREADY_CREATED;
+			}
+			return FAIL_NO_DATA;
+		}
 
 		//-----------------------------------------------------
-		// 1. write the header:
-		//  int type (0: unknown, 1: mpi, 2: openmp, 3: hybrid, ...
-		//	int num_files
+		// 3. remove old files (and their cpId remap tables)
 		//-----------------------------------------------------
+		appendManifest(outputFile, mergedFileNames);
+		vector<string> remapFileNames;
+		vector<string>::iterator it2;
+		for (it2 = mergedFileNames.begin(); it2 < mergedFileNames.end(); it2++)
+		{
+			string remapName = remapFileName(*it2);
+			if (FileUtils::exists(remapName))
+				remapFileNames.push_back(remapName);
+		}
+		removeFiles(mergedFileNames);
+		removeFiles(remapFileNames);
+		return SUCCESS_MERGED;
+	}
 
-		int type = 0;
-		dos.writeInt(type);
+	/**
+	 * Returns the sorted trace files of 'directory' that are not already
+	 * part of the merged file 'outputFile'.
+	 */
+	vector<string> MergeDataFiles::getTraceFiles(string directory, string outputFile)
+	{
+		vector<string> merged = readManifest(outputFile);
+		sort(merged.begin(), merged.end());
 
 		vector<string> allPaths = FileUtils::getAllFilesInDir(directory);
 		vector<string> filteredFileNames;
@@ -123,28 +220,29 @@ namespace TraceviewerServer
 		{
 			string val = *it;
 			if (val.find(".hpctrace") < string::npos)//This is hardcoded, which isn't great but will have to do because GlobInputFile is regex-style ("*.hpctrace")
-				filteredFileNames.push_back(val);
+			{
+				string baseName = val.substr(val.find_last_of('/') + 1);
+				if (!binary_search(merged.begin(), merged.end(), baseName))
+					filteredFileNames.push_back(val);
+			}
 		}
 		// on linux, we have to sort the files
 		//To sort them, we need a random access iterator, which means we need to load all of them into a vector
 		sort(filteredFileNames.begin(), filteredFileNames.end());
+		return filteredFileNames;
+	}
 
-		dos.writeInt(filteredFileNames.size());
-		const Long num_metric_header = 2 * SIZEOF_INT; // type of app (4 bytes) + num procs (4 bytes)
-		 Long num_metric_index = filteredFileNames.size()
-				* (SIZEOF_LONG + 2 * SIZEOF_INT);
-		FileOffset currentOffset = num_metric_header + num_metric_index;
-
+	/**
+	 * Appends a trace to 'traces' for each of 'fileNames' that follows
+	 * the hpcrun naming scheme. Returns the application type.
+	 */
+	int MergeDataFiles::parseTraceNames(string directory, string suffix,
+			vector<string>& fileNames, vector<MergedTrace>& traces)
+	{
+		int type = 0;
 		int name_format = 0; // FIXME hack:some hpcprof revisions have different format name !!
-		//-----------------------------------------------------
-		// 2. Record the process ID, thread ID and the currentOffset
-		//   It will also detect if the application is mp, mt, or hybrid
-		//	 no accelator is supported
-		//  for all files:
-		//		int proc-id, int thread-id, long currentOffset
-		//-----------------------------------------------------
 		vector<string>::iterator it2;
-		for (it2 = filteredFileNames.begin(); it2 < filteredFileNames.end(); it2++)
+		for (it2 = fileNames.begin(); it2 < fileNames.end(); it2++)
 		{
 
 			 string Filename = *it2;
@@ -169,62 +267,453 @@ namespace TraceviewerServer
 				string Token_To_Parse = tokens[name_format + num_tokens - PROC_POS];
 				proc = atoi(Token_To_Parse.c_str());
 			}
-			dos.writeInt(proc);
 			if (proc != 0)
 				type |= MULTI_PROCESSES;
 			 int Thread = atoi(tokens[name_format + num_tokens - THREAD_POS].c_str());
-			dos.writeInt(Thread);
 			if (Thread != 0)
 				type |= MULTI_THREADING;
-			dos.writeLong(currentOffset);
-			currentOffset += FileUtils::getFileSize(Filename);
+
+			MergedTrace trace;
+			trace.proc = proc;
+			trace.thread = Thread;
+			trace.filename = Filename;
+			trace.srcOffset = 0;
+			trace.size = 0;
+			trace.offset = 0;
+			traces.push_back(trace);
 		}
-		//-----------------------------------------------------
-		// 3. Copy all data from the multiple files into one file
-		//-----------------------------------------------------
-		ProgressBar prog("Merging database", filteredFileNames.size());
-		for (it2 = filteredFileNames.begin(); it2 < filteredFileNames.end(); it2++)
+		return type;
+	}
+
+	bool MergeDataFiles::compareRank(const MergedTrace& a, const MergedTrace& b)
+	{
+		return (a.proc < b.proc) || (a.proc == b.proc && a.thread < b.thread);
+	}
+
+	/**
+	 * Reads the type and the index of a merged file. The traces refer to
+	 * their extent in that file.
+	 */
+	bool MergeDataFiles::readMergedFile(string filename, int* type,
+			vector<MergedTrace>& traces)
+	{
+		Long fileSize = FileUtils::getFileSize(filename);
+		ifstream f(filename.c_str(), ios_base::binary | ios_base::in);
+
+		char buffer[SIZEOF_LONG + 2 * SIZEOF_INT];
+		f.read(buffer, 2 * SIZEOF_INT);
+		if (!f)
+			return false;
+		*type = ByteUtilities::readInt(buffer);
+		int numFiles = ByteUtilities::readInt(buffer + SIZEOF_INT);
+
+		Long dataStart = 2 * SIZEOF_INT + (Long) numFiles * (SIZEOF_LONG + 2 * SIZEOF_INT);
+		Long dataEnd = fileSize - SIZEOF_LONG; // end marker
+		if (numFiles <= 0 || dataStart > dataEnd)
+			return false;
+
+		traces.resize(numFiles);
+		for (int i = 0; i < numFiles; i++)
+		{
+			f.read(buffer, SIZEOF_LONG + 2 * SIZEOF_INT);
+			if (!f)
+				return false;
+			traces[i].proc = ByteUtilities::readInt(buffer);
+			traces[i].thread = ByteUtilities::readInt(buffer + SIZEOF_INT);
+			traces[i].srcOffset = ByteUtilities::readLong(buffer + 2 * SIZEOF_INT);
+			traces[i].offset = 0;
+		}
+		f.close();
+
+		for (int i = 0; i < numFiles; i++)
+		{
+			Long end = (i + 1 < numFiles) ? (Long) traces[i + 1].srcOffset : dataEnd;
+			if ((Long) traces[i].srcOffset < dataStart || (Long) traces[i].srcOffset > end)
+				return false;
+			traces[i].size = end - traces[i].srcOffset;
+		}
+		return true;
+	}
+
+	/**
+	 * Names of the trace files already in the merged file. Traces are
+	 * removed once merged, but may stay behind if that fails.
+	 */
+	string MergeDataFiles::manifestFileName(string outputFile)
+	{
+		return outputFile + ".traces";
+	}
+
+	vector<string> MergeDataFiles::readManifest(string outputFile)
+	{
+		vector<string> names;
+		ifstream f(manifestFileName(outputFile).c_str());
+		string name;
+		while (getline(f, name))
+		{
+			if (!name.empty())
+				names.push_back(name);
+		}
+		return names;
+	}
+
+	void MergeDataFiles::appendManifest(string outputFile, const vector<string>& fileNames)
+	{
+		ofstream f(manifestFileName(outputFile).c_str(), ios_base::out | ios_base::app);
+		vector<string>::const_iterator it;
+		for (it = fileNames.begin(); it != fileNames.end(); ++it)
+			f << it->substr(it->find_last_of('/') + 1) << '\n';
+		f.close();
+	}
+
+	/**
+	 * Writes the merged file:
+	 *  int type (0: unknown, 1: mpi, 2: openmp, 3: hybrid, ...
+	 *  int num_files
+	 *  for all files: int proc-id, int thread-id, long offset
+	 *  the traces
+	 *  the end marker
+	 * The offsets follow from the trace sizes, so the traces are copied
+	 * concurrently, each to its own offset. Traces without a file name
+	 * come from 'oldFile'. The file is written next to 'outputFile' and
+	 * renamed once complete.
+	 */
+	bool MergeDataFiles::writeMergedFile(string outputFile, int type,
+			vector<MergedTrace>& traces, string oldFile)
+	{
+		int numFiles = traces.size();
+		const Long num_metric_header = 2 * SIZEOF_INT; // type of app (4 bytes) + num procs (4 bytes)
+		 Long num_metric_index = numFiles * (SIZEOF_LONG + 2 * SIZEOF_INT);
+		FileOffset currentOffset = num_metric_header + num_metric_index;
+
+		vector<char> index(num_metric_header + num_metric_index);
+		char* pos = &index[0];
+		ByteUtilities::writeInt(pos, type);
+		ByteUtilities::writeInt(pos + SIZEOF_INT, numFiles);
+		pos += num_metric_header;
+		for (int i = 0; i < numFiles; i++)
 		{
-			string i = *it2;
+			traces[i].offset = currentOffset;
+			currentOffset += traces[i].size;
+			ByteUtilities::writeInt(pos, traces[i].proc);
+			ByteUtilities::writeInt(pos + SIZEOF_INT, traces[i].thread);
+			ByteUtilities::writeLong(pos + 2 * SIZEOF_INT, traces[i].offset);
+			pos += SIZEOF_LONG + 2 * SIZEOF_INT;
+		}
+		char marker[SIZEOF_LONG];
+		ByteUtilities::writeLong(marker, MARKER_END_MERGED_FILE);
 
-			ifstream dis(i.c_str(), ios_base::binary | ios_base::in);
-			char data[PAGE_SIZE_GUESS];
-			dis.read(data, PAGE_SIZE_GUESS);
-			int bytesRead = dis.gcount();
-			while (bytesRead > 0)
+		string tmpFile = outputFile + ".tmp";
+		int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+		{
+			cerr << "Could not create " << tmpFile << ": " << strerror(errno) << endl;
+			return false;
+		}
+		int oldFd = -1;
+		if (!oldFile.empty() && (oldFd = open(oldFile.c_str(), O_RDONLY)) < 0)
+		{
+			cerr << "Could not open " << oldFile << ": " << strerror(errno) << endl;
+			close(fd);
+			remove(tmpFile.c_str());
+			return false;
+		}
+
+		bool ok = FileUtils::pwriteFully(fd, &index[0], index.size(), 0)
+				&& FileUtils::pwriteFully(fd, marker, SIZEOF_LONG, currentOffset);
+
+		int numFailed = 0;
+		ProgressBar prog("Merging database", numFiles);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:numFailed)
+#endif
+		for (int i = 0; i < numFiles; i++)
+		{
+			bool copied = traces[i].filename.empty()
+					? copyRange(oldFd, traces[i].srcOffset, fd, traces[i].offset, traces[i].size)
+					: copyTrace(fd, traces[i]);
+			if (!copied)
 			{
-				dos.write(data, bytesRead);
-				dis.read(data, PAGE_SIZE_GUESS);
-				bytesRead = dis.gcount();
+				numFailed++;
 			}
-			dis.close();
+#ifdef ENABLE_OPENMP
+#pragma omp critical (MergeDataFiles_progress)
+#endif
 			prog.incrementProgress();
 		}
-		insertMarker(&dos);
-		dos.close();
-		//-----------------------------------------------------
-		// 4. FIXME: write the type of the application
-		//  	the type of the application is computed in step 2
-		//		Ideally, this step has to be in the beginning !
-		//-----------------------------------------------------
-		//While we don't actually want to do any input operations, adding the input flag prevents the file from being truncated to 0 bytes
-		DataOutputFileStream f(outputFile.c_str(), ios_base::in | ios_base::out | ios_base::binary);
-		f.writeInt(type);
-		f.close();
 
-		//-----------------------------------------------------
-		// 5. remove old files
-		//-----------------------------------------------------
-		removeFiles(filteredFileNames);
-		return SUCCESS_MERGED;
+		if (oldFd >= 0)
+			close(oldFd);
+		ok = (close(fd) == 0) && ok && (numFailed == 0);
+		if (!ok)
+		{
+			cerr << "Failed to write " << tmpFile << endl;
+			remove(tmpFile.c_str());
+			return false;
+		}
+		return (rename(tmpFile.c_str(), outputFile.c_str()) == 0);
 	}
 
 
 
-	void MergeDataFiles::insertMarker(DataOutputFileStream* dos)
+	/**
+	 * Returns the trace file positioned after its header, or NULL if it
+	 * cannot be read.
+	 */
+	FILE* MergeDataFiles::openTrace(string filename, hpctrace_hdr_flags_t* flags)
 	{
-		dos->writeLong(MARKER_END_MERGED_FILE);
+		FILE* fs = hpcio_fopen_r(filename.c_str());
+		if (!fs)
+			return NULL;
+
+		hpctrace_fmt_hdr_t hdr;
+		if (hpctrace_fmt_hdr_fread(&hdr, fs) != HPCFMT_OK)
+		{
+			hpcio_fclose(fs);
+			return NULL;
+		}
+		*flags = hdr.flags;
+		return fs;
 	}
+
+	/**
+	 * Returns the trace file positioned after its header if it is a
+	 * block-encoded (hpctrace 1.02) trace, or NULL otherwise.
+	 */
+	FILE* MergeDataFiles::openBlockedTrace(string filename, hpctrace_hdr_flags_t* flags)
+	{
+		FILE* fs = openTrace(filename, flags);
+		if (fs && !flags->fields.isBlocked)
+		{
+			hpcio_fclose(fs);
+			return NULL;
+		}
+		return fs;
+	}
+
+	/**
+	 * hpcprof --trace-remap leaves the traces unchanged and writes the
+	 * new call path ids of 'name.hpctrace' to 'name.cpmap'.
+	 */
+	string MergeDataFiles::remapFileName(string filename)
+	{
+		string traceSuffix = string(".") + HPCRUN_TraceFnmSfx;
+		string stem = filename;
+		if (stem.length() > traceSuffix.length()
+				&& stem.compare(stem.length() - traceSuffix.length(),
+						traceSuffix.length(), traceSuffix) == 0)
+			stem.erase(stem.length() - traceSuffix.length());
+		return stem + "." + HPCTRACE_RemapFnmSfx;
+	}
+
+	bool MergeDataFiles::readRemap(string filename, vector<uint32_t>& newId)
+	{
+		string remapName = remapFileName(filename);
+		if (!FileUtils::exists(remapName))
+			return false;
+
+		FILE* fs = hpcio_fopen_r(remapName.c_str());
+		if (!fs)
+			return false;
+
+		uint32_t* map = NULL;
+		uint32_t numIds = 0;
+		bool ok = (hpctrace_fmt_remap_fread(&map, &numIds, fs, malloc, free) == HPCFMT_OK);
+		hpcio_fclose(fs);
+		if (ok)
+			newId.assign(map, map + numIds);
+		else
+			cerr << "Ignoring unreadable call path remap table " << remapName << endl;
+		free(map);
+		return ok;
+	}
+
+	/**
+	 * The rest of the server indexes trace records by their fixed size,
+	 * so block-encoded traces are expanded into (time, cpid) records, or
+	 * (time, cpid, metricId) records for data-centric traces, when they
+	 * are merged. Their size in the merged file comes from the block
+	 * index in the trace footer.
+	 */
+	Long MergeDataFiles::getMergedTraceSize(string filename)
+	{
+		hpctrace_hdr_flags_t flags;
+		FILE* fs = openBlockedTrace(filename, &flags);
+		if (!fs)
+			return FileUtils::getFileSize(filename);
+
+		Long numRecords = 0;
+		hpctrace_fmt_footer_t footer;
+		bool indexOK = (hpctrace_fmt_footer_fread(&footer, fs) == HPCFMT_OK
+				&& fseek(fs, footer.idxOff, SEEK_SET) == 0);
+		for (uint64_t i = 0; indexOK && i < footer.numBlocks; i++)
+		{
+			hpctrace_fmt_blkidx_t blkIdx;
+			indexOK = (hpctrace_fmt_blkidx_fread(&blkIdx, fs) == HPCFMT_OK);
+			numRecords += blkIdx.numRecs;
+		}
+
+		if (!indexOK)
+		{
+			// no usable index (e.g., a truncated trace): count the records
+			cerr << "Missing block index in " << filename << endl;
+			numRecords = 0;
+			fseek(fs, HPCTRACE_FMT_HeaderLen, SEEK_SET);
+			hpctrace_fmt_blk_t blk;
+			hpctrace_fmt_blk_init(&blk);
+			hpctrace_fmt_datum_t datum;
+			while (hpctrace_fmt_datum_blk_fread(&datum, flags, &blk, fs) == HPCFMT_OK)
+				numRecords++;
+		}
+		hpcio_fclose(fs);
+
+		Long recordSize = SIZE_OF_TRACE_RECORD
+				+ (flags.fields.isDataCentric ? SIZEOF_INT : 0);
+		return HPCTRACE_FMT_HeaderLen + numRecords * recordSize;
+	}
+
+	/**
+	 * Copies 'size' bytes between files, in the kernel where possible.
+	 */
+	bool MergeDataFiles::copyRange(int inFd, FileOffset inOff, int outFd,
+			FileOffset outOff, Long size)
+	{
+#ifdef SYS_copy_file_range
+		loff_t in = inOff, out = outOff;
+		while (size > 0)
+		{
+			ssize_t n = syscall(SYS_copy_file_range, inFd, &in, outFd, &out,
+					(size_t) min(size, (Long) 1 << 30), 0);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break; // e.g., unsupported across file systems
+			size -= n;
+		}
+		inOff = in;
+		outOff = out;
+#endif
+		vector<char> buffer;
+		if (size > 0)
+			buffer.resize(min(size, (Long) COPY_CHUNK_SIZE));
+		while (size > 0)
+		{
+			ssize_t n = pread(inFd, &buffer[0], min(size, (Long) buffer.size()), inOff);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			if (!FileUtils::pwriteFully(outFd, &buffer[0], n, outOff))
+				return false;
+			inOff += n;
+			outOff += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	/**
+	 * Writes trace 'trace.filename' to 'trace.offset' of 'outFd', using
+	 * exactly 'trace.size' bytes.
+	 */
+	bool MergeDataFiles::copyTrace(int outFd, const MergedTrace& trace)
+	{
+		string filename = trace.filename;
+
+		// traces with a remap table are decoded to renumber their
+		// call path ids as they are copied
+		vector<uint32_t> newId;
+		bool remap = readRemap(filename, newId);
+
+		hpctrace_hdr_flags_t flags;
+		FILE* fs = remap ? openTrace(filename, &flags)
+				: openBlockedTrace(filename, &flags);
+		if (!fs)
+		{
+			int inFd = open(filename.c_str(), O_RDONLY);
+			if (inFd < 0)
+			{
+				cerr << "Could not open " << filename << ": " << strerror(errno) << endl;
+				return false;
+			}
+			bool ok = copyRange(inFd, 0, outFd, trace.offset, trace.size);
+			close(inFd);
+			return ok;
+		}
+
+		// expand into a version 1.01 trace of (time, cpid[, metricId])
+		// records with the same flags, except for 'isBlocked'
+		hpctrace_hdr_flags_t outFlags = flags;
+		outFlags.fields.isBlocked = false;
+		size_t recordSize = SIZE_OF_TRACE_RECORD
+				+ (outFlags.fields.isDataCentric ? SIZEOF_INT : 0);
+
+		vector<char> buffer(COPY_CHUNK_SIZE);
+		char* pos = &buffer[0];
+		memcpy(pos, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen);
+		pos += HPCTRACE_FMT_MagicLen;
+		memcpy(pos, HPCTRACE_FMT_Version, HPCTRACE_FMT_VersionLen);
+		pos += HPCTRACE_FMT_VersionLen;
+		memcpy(pos, HPCTRACE_FMT_Endian, HPCTRACE_FMT_EndianLen);
+		pos += HPCTRACE_FMT_EndianLen;
+		ByteUtilities::writeLong(pos, outFlags.bits);
+		pos += SIZEOF_LONG;
+
+		const uint32_t* map = newId.empty() ? NULL : &newId[0];
+		uint32_t numIds = newId.size();
+
+		FileOffset outOff = trace.offset;
+		Long left = trace.size;
+		bool ok = true;
+		bool haveRecord = false;
+
+		hpctrace_fmt_blk_t blk;
+		hpctrace_fmt_blk_init(&blk);
+		hpctrace_fmt_datum_t datum;
+		while (ok && hpctrace_fmt_datum_blk_fread(&datum, flags, &blk, fs) == HPCFMT_OK)
+		{
+			if (pos + recordSize > &buffer[0] + buffer.size())
+			{
+				Long len = min(left, (Long) (pos - &buffer[0]));
+				ok = FileUtils::pwriteFully(outFd, &buffer[0], len, outOff);
+				outOff += len;
+				left -= len;
+				pos = &buffer[0];
+			}
+			ByteUtilities::writeLong(pos, datum.time);
+			ByteUtilities::writeInt(pos + SIZEOF_LONG,
+					hpctrace_fmt_remap_cpId(map, numIds, datum.cpId));
+			if (outFlags.fields.isDataCentric)
+				ByteUtilities::writeInt(pos + SIZE_OF_TRACE_RECORD, datum.metricId);
+			pos += recordSize;
+			haveRecord = true;
+		}
+		hpcio_fclose(fs);
+
+		Long len = min(left, (Long) (pos - &buffer[0]));
+		ok = ok && FileUtils::pwriteFully(outFd, &buffer[0], len, outOff);
+		outOff += len;
+		left -= len;
+
+		// a damaged trace decodes to fewer records than its size
+		// promised; repeat the last record to fill its extent
+		if (ok && left > 0)
+		{
+			char last[SIZE_OF_TRACE_RECORD + SIZEOF_INT];
+			memset(last, 0, sizeof(last));
+			if (haveRecord)
+				memcpy(last, pos - recordSize, recordSize);
+			while (ok && left > 0)
+			{
+				Long n = min(left, (Long) recordSize);
+				ok = FileUtils::pwriteFully(outFd, last, n, outOff);
+				outOff += n;
+				left -= n;
+			}
+		}
+		return ok;
+	}
+
 	bool MergeDataFiles::isMergedFileCorrect(string* filename)
 	{
 		ifstream f(filename->c_str(), ios_base::binary | ios_base::in);
@@ -59,11 +59,15 @@
 #ifndef MERGEDATAFILES_H_
 #define MERGEDATAFILES_H_
 
-#include "DataOutputFileStream.hpp"
+#include "FileUtils.hpp"
+#include "ByteUtilities.hpp"
 #include <vector>
 #include <string>
+#include <cstdio>
 #include <stdint.h>
 
+#include <lib/prof-lean/hpcrun-fmt.h>
+
 using namespace std;
 namespace TraceviewerServer
 {
@@ -80,15 +84,42 @@ namespace TraceviewerServer
 
 		static vector<string> splitString(string, char);
 	private:
+		// One trace of the merged file: either a trace file of the
+		// database or (filename empty) a trace of an existing merged file
+		struct MergedTrace
+		{
+			int proc;
+			int thread;
+			string filename;
+			FileOffset srcOffset;
+			Long size;
+			FileOffset offset;
+		};
+
 		static const uint64_t MARKER_END_MERGED_FILE = 0xFFFFFFFFDEADF00D;
 		static const int PAGE_SIZE_GUESS = 4096;
+		static const int COPY_CHUNK_SIZE = 4 * 1024 * 1024;
 		static const int PROC_POS = 5;
 		static const int THREAD_POS = 4;
-		static void insertMarker(DataOutputFileStream*);
 		static bool isMergedFileCorrect(string*);
 		static bool removeFiles(vector<string>);
 		//This was in Util.java in a modified form but is more useful here
 		static bool atLeastOneValidFile(string);
+		static vector<string> getTraceFiles(string, string);
+		static int parseTraceNames(string, string, vector<string>&, vector<MergedTrace>&);
+		static bool compareRank(const MergedTrace&, const MergedTrace&);
+		static bool readMergedFile(string, int*, vector<MergedTrace>&);
+		static string manifestFileName(string);
+		static vector<string> readManifest(string);
+		static void appendManifest(string, const vector<string>&);
+		static bool writeMergedFile(string, int, vector<MergedTrace>&, string);
+		static FILE* openTrace(string, hpctrace_hdr_flags_t*);
+		static FILE* openBlockedTrace(string, hpctrace_hdr_flags_t*);
+		static string remapFileName(string);
+		static bool readRemap(string, vector<uint32_t>&);
+		static Long getMergedTraceSize(string);
+		static bool copyRange(int, FileOffset, int, FileOffset, Long);
+		static bool copyTrace(int, const MergedTrace&);
 
 
 
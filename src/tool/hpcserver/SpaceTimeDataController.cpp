@@ -131,15 +131,20 @@ namespace TraceviewerServer
 		resetTraces();
 
 
-		//Taken straight from TimelineThread
-		ProcessTimeline* nextTrace = getNextTrace();
-		while (nextTrace != NULL)
-		{
-			nextTrace->readInData();
-			addNextTrace(nextTrace);
+		for (int i = 0; i < tracesLength; i++)
+			fillTrace(i);
+	}
 
-			nextTrace = getNextTrace();
-		}
+	//Reads in the timeline for one line of the current request. Lines are
+	//independent, so different lines may be filled concurrently once
+	//resetTraces has been called.
+	ProcessTimeline* SpaceTimeDataController::fillTrace(int line)
+	{
+		ProcessTimeline* trace = new ProcessTimeline(*attributes, line, dataTrace,
+				minBegTime + attributes->begTime, headerSize);
+		trace->readInData();
+		addNextTrace(trace);
+		return trace;
 	}
 
 	 int* SpaceTimeDataController::getValuesXProcessID()
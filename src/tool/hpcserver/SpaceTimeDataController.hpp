@@ -80,7 +80,8 @@ namespace TraceviewerServer
 		ProcessTimeline* getNextTrace();
 		void addNextTrace(ProcessTimeline*);
 		void fillTraces();
-		ProcessTimeline* fillTrace(bool);
+		ProcessTimeline* fillTrace(int);
+		void resetTraces();
 		void applyFilters(FilterSet filters);
 		//The number of processes in the database, independent of the current display size
 		int getNumRanks();
@@ -93,7 +94,6 @@ namespace TraceviewerServer
 		ProcessTimeline** traces;
 		int tracesLength;
 	private:
-		void resetTraces();
 		void deleteTraces();
 
 		FilteredBaseData* dataTrace;
@@ -75,6 +75,8 @@ namespace TraceviewerServer
 		minloc = data->getMinLoc(rank);
 		maxloc = data->getMaxLoc(rank);
 		numPixelsH = _numPixelH;
+		pyramid = data->getPyramid();
+		usePyramid = false;
 
 		
 		listCPID = new vector<TimeCPID>();
@@ -83,6 +85,9 @@ namespace TraceviewerServer
 	void TraceDataByRank::getData(Time timeStart, Time timeRange,
 			double pixelLength)
 	{
+		if (pyramid != NULL)
+			selectPyramidLevel(timeStart, timeStart + timeRange);
+
 		// get the start location
 		FileOffset startLoc = findTimeInInterval(timeStart, minloc, maxloc);
 
@@ -94,8 +99,20 @@ namespace TraceviewerServer
 		// get the number of records data to display
 		 Long numRec = 1 + getNumberOfRecords(startLoc, endLoc);
 
+		// one sample per pixel, plus the records just outside the view
+		listCPID->reserve(min(numRec, (Long) numPixelsH) + 2);
+
+		// --------------------------------------------------------------------------------------------------
+		// get the first data if necessary: the leftmost time is still bigger than the lower limit
+		//	we add it in front of the samples
 		// --------------------------------------------------------------------------------------------------
-		// if the data-to-display is fit in the display zone, we don't need to use recursive binary search
+		if (startLoc > minloc)
+		{
+			listCPID->push_back(getData(startLoc - SIZE_OF_TRACE_RECORD));
+		}
+
+		// --------------------------------------------------------------------------------------------------
+		// if the data-to-display is fit in the display zone, we don't need to sample
 		//	we just simply display everything from the file
 		// --------------------------------------------------------------------------------------------------
 		if (numRec <= numPixelsH)
@@ -113,7 +130,7 @@ namespace TraceviewerServer
 			// the data is too big: try to fit the "big" data into the display
 
 			//fills in the rest of the data for this process timeline
-			sampleTimeLine(startLoc, endLoc, 0, numPixelsH, 0, pixelLength, timeStart);
+			sampleTimeLine(startLoc, endLoc, numPixelsH, pixelLength, timeStart);
 		}
 		// --------------------------------------------------------------------------------------------------
 		// get the last data if necessary: the rightmost time is still less then the upper limit
@@ -121,54 +138,32 @@ namespace TraceviewerServer
 		// --------------------------------------------------------------------------------------------------
 		if (endLoc < maxloc)
 		{
-			 TimeCPID dataLast = getData(endLoc);
-			addSample(listCPID->size(), dataLast);
+			listCPID->push_back(getData(endLoc));
 		}
 
-		// --------------------------------------------------------------------------------------------------
-		// get the first data if necessary: the leftmost time is still bigger than the lower limit
-		//	similarly, we add to the list
-		// --------------------------------------------------------------------------------------------------
-		if (startLoc > minloc)
-		{
-			 TimeCPID dataFirst = getData(startLoc - SIZE_OF_TRACE_RECORD);
-			addSample(0, dataFirst);
-		}
 		postProcess();
 	}
 	/*******************************************************************************************
-	 * Recursive method that fills in times and timeLine with the correct data from the file.
-	 * Takes in two pixel locations as endpoints and finds the timestamp that owns the pixel
-	 * in between these two. It then recursively calls itself twice - once with the beginning
-	 * location and the newfound location as endpoints and once with the newfound location
-	 * and the end location as endpoints. Effectively updates times and timeLine by calculating
-	 * the index in which to insert the next data. This way, it keeps times and timeLine sorted.
-	 * @author Reed Landrum and Michael Franco
+	 * Appends the samples for pixels 1 to numPixels-1 to listCPID, from left to right. Each
+	 * pixel gets the record closest to its start time. The records are sorted by time, so
+	 * the search for a pixel starts just before the record found for the previous pixel
+	 * instead of at minLoc.
 	 * @param minLoc The beginning location in the file to bound the search.
 	 * @param maxLoc The end location in the file to bound the search.
-	 * @param startPixel The beginning pixel in the image that corresponds to minLoc.
-	 * @param endPixel The end pixel in the image that corresponds to maxLoc.
-	 * @param minIndex An index used for calculating the index in which the data is to be inserted.
-	 * @return Returns the index that shows the size of the recursive subtree that has been read.
-	 * Used for calculating the index in which the data is to be inserted.
+	 * @param numPixels The number of pixels in the image.
 	 ******************************************************************************************/
-	int TraceDataByRank::sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel,
-			int endPixel, int minIndex, double pixelLength, Time startingTime)
+	void TraceDataByRank::sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int numPixels,
+			double pixelLength, Time startingTime)
 	{
-		int midPixel = (startPixel + endPixel) / 2;
-		if (midPixel == startPixel)
-			return 0;
-
-		Long loc = findTimeInInterval((long)(midPixel * pixelLength + startingTime), minLoc,
-				maxLoc);
-		 TimeCPID nextData = getData(loc);
-		addSample(minIndex, nextData);
-		int addedLeft = sampleTimeLine(minLoc, loc, startPixel, midPixel, minIndex,
-				pixelLength, startingTime);
-		int addedRight = sampleTimeLine(loc, maxLoc, midPixel, endPixel,
-				minIndex + addedLeft + 1, pixelLength, startingTime);
-
-		return (addedLeft + addedRight + 1);
+		FileOffset loc = minLoc;
+		for (int pixel = 1; pixel < numPixels; pixel++)
+		{
+			// the record before the previous sample is no later than the previous
+			// pixel, so the record closest to this pixel can't be left of it
+			FileOffset left = loc > minLoc ? loc - SIZE_OF_TRACE_RECORD : minLoc;
+			loc = findTimeInInterval((long)(pixel * pixelLength + startingTime), left, maxLoc);
+			listCPID->push_back(getData(loc));
+		}
 	}
 
 
@@ -190,8 +185,15 @@ namespace TraceviewerServer
 		FileOffset l_index = getRelativeLocation(l_boundOffset);
 		FileOffset r_index = getRelativeLocation(r_boundOffset);
 
-		Time l_time = data->getLong(l_boundOffset);
-		Time r_time = data->getLong(r_boundOffset);
+		Time l_time = getTime(l_boundOffset);
+		Time r_time = getTime(r_boundOffset);
+
+		// Time is unsigned, so a target outside the interval would wrap around
+		// in the interpolation below and make it step one record at a time
+		if (time <= l_time)
+			return l_boundOffset;
+		if (time >= r_time)
+			return min(r_boundOffset, maxloc);
 	
 		// apply "Newton's method" to find target time
 		while (r_index - l_index > 1)
@@ -202,8 +204,11 @@ namespace TraceviewerServer
 			//rate instead. This line of code and the one in the else block account for
 			//about 40% of the computation once the data is in memory
 			//double rate = (r_time - l_time) / (r_index - l_index);
-			double invrate = (r_index - l_index) / (r_time - l_time);
-			Time mtime = (r_time - l_time) / 2;
+			//The division has to be done in floating point: with integers, invrate
+			//is 0 whenever the times are further apart than the indices, and the
+			//search degrades to stepping one record at a time from the far end.
+			double invrate = r_time > l_time ? (r_index - l_index) / (double) (r_time - l_time) : 0;
+			Time mtime = l_time + (r_time - l_time) / 2;
 			if (time <= mtime)
 			{
 				predicted_index = max((Long) ((time - l_time) * invrate) + l_index, l_index);
@@ -220,7 +225,7 @@ namespace TraceviewerServer
 			if (predicted_index >= r_index)
 				predicted_index = r_index - 1;
 
-			Time temp = data->getLong(getAbsoluteLocation(predicted_index));
+			Time temp = getTime(getAbsoluteLocation(predicted_index));
 			if (time >= temp)
 			{
 				l_index = predicted_index;
@@ -235,8 +240,8 @@ namespace TraceviewerServer
 		FileOffset l_offset = getAbsoluteLocation(l_index);
 		FileOffset r_offset = getAbsoluteLocation(r_index);
 
-		l_time = data->getLong(l_offset);
-		r_time = data->getLong(r_offset);
+		l_time = getTime(l_offset);
+		r_time = getTime(r_offset);
 
 		int leftDiff = time - l_time;
 		int rightDiff = r_time - time;
@@ -248,6 +253,41 @@ namespace TraceviewerServer
 		else
 			return maxloc;
 	}
+	/*********************************************************************************
+	 *	If there are many records per pixel between 'timeStart' and 'timeEnd',
+	 *	switches minloc and maxloc to the coarsest level of the trace pyramid
+	 *	that still has MIN_ENTRIES_PER_PIXEL entries per pixel. Its entries are
+	 *	laid out like trace records, so they are sampled the same way.
+	 ********************************************************************************/
+	void TraceDataByRank::selectPyramidLevel(Time timeStart, Time timeEnd)
+	{
+		FileOffset levelMin, levelMax;
+		Long stride;
+		if (!data->findPyramidLevel(rank, TracePyramid::BASE_STRIDE, levelMin, levelMax, stride))
+			return;
+
+		// estimate the number of records in view from the finest level
+		usePyramid = true;
+		minloc = levelMin;
+		maxloc = levelMax;
+		Long numRec = stride * getNumberOfRecords(findTimeInInterval(timeStart, minloc, maxloc),
+				findTimeInInterval(timeEnd, minloc, maxloc));
+
+		Long maxStride = numRec / ((Long) numPixelsH * MIN_ENTRIES_PER_PIXEL);
+		if (maxStride >= stride
+				&& data->findPyramidLevel(rank, maxStride, levelMin, levelMax, stride))
+		{
+			minloc = levelMin;
+			maxloc = levelMax;
+			return;
+		}
+
+		// close enough to sample resolution: use the trace itself
+		usePyramid = false;
+		minloc = data->getMinLoc(rank);
+		maxloc = data->getMaxLoc(rank);
+	}
+
 	FileOffset TraceDataByRank::getAbsoluteLocation(FileOffset relativePosition)
 	{
 		return minloc + (relativePosition * SIZE_OF_TRACE_RECORD);
@@ -257,53 +297,41 @@ namespace TraceviewerServer
 	{
 		return (absolutePosition - minloc) / SIZE_OF_TRACE_RECORD;
 	}
-	void TraceDataByRank::addSample(unsigned int index, TimeCPID dataCpid)
-	{
-		if (index == listCPID->size())
-		{
-			listCPID->push_back(dataCpid);
-		}
-		else
-		{
-			vector<TimeCPID>::iterator it = listCPID->begin();
-			it += index;
-			listCPID->insert(it, dataCpid);
-		}
-	}
-
 	TimeCPID TraceDataByRank::getData(FileOffset location)
 	{
 
-		 Time time = data->getLong(location);
-		 int CPID = data->getInt(location + SIZEOF_LONG);
+		 Time time = getTime(location);
+		 int CPID = usePyramid ? pyramid->getInt(location + SIZEOF_LONG)
+				 : data->getInt(location + SIZEOF_LONG);
 		TimeCPID ToReturn(time, CPID);
 		return ToReturn;
 	}
 
+	Time TraceDataByRank::getTime(FileOffset location)
+	{
+		return usePyramid ? pyramid->getLong(location) : data->getLong(location);
+	}
+
 	Long TraceDataByRank::getNumberOfRecords(FileOffset start, FileOffset end)
 	{
 		return (end - start) / SIZE_OF_TRACE_RECORD;
 	}
 
 	/*********************************************************************************************
-	 * Removes unnecessary samples:
+	 * Removes unnecessary samples: of consecutive samples with the same time, only the first
+	 * is kept.
 	 ********************************************************************************************/
 
 	void TraceDataByRank::postProcess()
 	{
-		int len = listCPID->size();
-		for (int i = 0; i < len - 2; i++)
+		vector<TimeCPID>& samples = *listCPID;
+		size_t len = 0;
+		for (size_t i = 0; i < samples.size(); i++)
 		{
-
-			while (i < len - 1 && (*listCPID)[i].timestamp == (*listCPID)[i + 1].timestamp)
-			{
-				vector<TimeCPID>::iterator it = listCPID->begin();
-				it += (i + 1);
-				listCPID->erase(it);
-				len--;
-			}
-
+			if (len == 0 || samples[len - 1].timestamp != samples[i].timestamp)
+				samples[len++] = samples[i];
 		}
+		samples.erase(samples.begin() + len, samples.end());
 	}
 
 	TraceDataByRank::~TraceDataByRank()
@@ -77,7 +77,7 @@ namespace TraceviewerServer
 		virtual ~TraceDataByRank();
 
 		void getData(Time timeStart, Time timeRange, double pixelLength);
-		int sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel, int endPixel, int minIndex, double pixelLength, Time startingTime);
+		void sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int numPixels, double pixelLength, Time startingTime);
 		FileOffset findTimeInInterval(Time time, FileOffset l_boundOffset, FileOffset r_boundOffset);
 
 
@@ -86,15 +86,22 @@ namespace TraceviewerServer
 		int rank;
 	private:
 		FilteredBaseData* data;
+		TracePyramid* pyramid;
+		//true if minloc and maxloc are locations in a level of the pyramid
+		bool usePyramid;
 
 		FileOffset minloc;
 		FileOffset maxloc;
 		int numPixelsH;
 
+		//a pyramid level is used only if it has at least this many entries per pixel
+		static const int MIN_ENTRIES_PER_PIXEL = 4;
+
+		void selectPyramidLevel(Time, Time);
+		Time getTime(FileOffset);
 		FileOffset getAbsoluteLocation(FileOffset);
 
 		FileOffset getRelativeLocation(FileOffset);
-		void addSample(unsigned int, TimeCPID);
 		TimeCPID getData(FileOffset);
 		Long getNumberOfRecords(FileOffset, FileOffset);
 		void postProcess();
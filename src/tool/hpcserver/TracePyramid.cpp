@@ -0,0 +1,423 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL: https://hpctoolkit.googlecode.com/svn/branches/hpctoolkit-hpcserver/src/tool/hpcserver/TracePyramid.cpp $
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL: https://hpctoolkit.googlecode.com/svn/branches/hpctoolkit-hpcserver/src/tool/hpcserver/TracePyramid.cpp $
+//
+// Purpose:
+//   Multi-resolution time index (pyramid) of a merged trace file
+//
+// Description:
+//   TracePyramid: builds, validates and reads experiment.mt.pyramid
+//
+//***************************************************************************
+
+#include <include/hpctoolkit-config.h>
+
+#include "TracePyramid.hpp"
+#include "DebugUtils.hpp"
+#include "ProgressBar.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+using namespace std;
+
+namespace TraceviewerServer
+{
+	TracePyramid::TracePyramid(char* _base, FileOffset _size)
+	{
+		base = _base;
+		size = _size;
+		numFiles = ByteUtilities::readInt(base + 2 * SIZEOF_LONG);
+	}
+
+	TracePyramid::~TracePyramid()
+	{
+		munmap(base, size);
+	}
+
+	TracePyramid* TracePyramid::open(string traceFile)
+	{
+		string pyramidFile = fileName(traceFile);
+
+		for (int attempt = 0; attempt < 2; attempt++)
+		{
+			FileDescriptor fd = ::open(pyramidFile.c_str(), O_RDONLY);
+			if (fd >= 0)
+			{
+				FileOffset pyramidSize = FileUtils::getFileSize(pyramidFile);
+				void* p = MAP_FAILED;
+				if (pyramidSize >= (FileOffset) HEADER_SIZE)
+					p = mmap(NULL, pyramidSize, PROT_READ, MAP_SHARED, fd, 0);
+				close(fd);
+				if (p != MAP_FAILED)
+				{
+					if (isCurrent((char*) p, pyramidSize, traceFile)
+							&& isValid((char*) p, pyramidSize))
+						return new TracePyramid((char*) p, pyramidSize);
+					munmap(p, pyramidSize);
+				}
+			}
+			if (attempt == 0 && !build(traceFile, pyramidFile))
+				break;
+		}
+		cerr << "Trace pyramid " << pyramidFile << " is not available" << endl;
+		return NULL;
+	}
+
+	bool TracePyramid::findLevel(int rank, Long maxStride,
+			FileOffset& minLoc, FileOffset& maxLoc, Long& stride)
+	{
+		if (rank < 0 || rank >= numFiles)
+			return false;
+
+		char* file = base + HEADER_SIZE + (FileOffset) rank * FILE_ENTRY_SIZE;
+		FileOffset levels = ByteUtilities::readLong(file);
+		Long numLevels = ByteUtilities::readLong(file + SIZEOF_LONG);
+
+		bool found = false;
+		Long levelStride = BASE_STRIDE;
+		for (int k = 0; k < numLevels && levelStride <= maxStride; k++)
+		{
+			char* level = base + levels + k * LEVEL_ENTRY_SIZE;
+			FileOffset entries = ByteUtilities::readLong(level);
+			Long count = ByteUtilities::readLong(level + SIZEOF_LONG);
+			minLoc = entries;
+			maxLoc = entries + (count - 1) * SIZE_OF_TRACE_RECORD;
+			stride = levelStride;
+			found = true;
+			levelStride *= FANOUT;
+		}
+		return found;
+	}
+
+	string TracePyramid::fileName(string traceFile)
+	{
+		return traceFile + ".pyramid";
+	}
+
+	/**
+	 * A pyramid is current if it was built from a merged file of the
+	 * same size; merging new traces always makes that file grow.
+	 */
+	bool TracePyramid::isCurrent(char* p, FileOffset pyramidSize, string traceFile)
+	{
+		if ((uint64_t) ByteUtilities::readLong(p) != MAGIC)
+			return false;
+		if ((FileOffset) ByteUtilities::readLong(p + SIZEOF_LONG) != FileUtils::getFileSize(traceFile))
+			return false;
+		Long files = ByteUtilities::readInt(p + 2 * SIZEOF_LONG);
+		return (files >= 0 && HEADER_SIZE + files * FILE_ENTRY_SIZE <= (Long) pyramidSize);
+	}
+
+	/**
+	 * findLevel trusts the offsets and counts of the pyramid, so check
+	 * that every level table and level lies inside the mapped file.
+	 */
+	bool TracePyramid::isValid(char* p, FileOffset pyramidSize)
+	{
+		Long files = ByteUtilities::readInt(p + 2 * SIZEOF_LONG);
+		for (Long i = 0; i < files; i++)
+		{
+			char* file = p + HEADER_SIZE + i * FILE_ENTRY_SIZE;
+			Long levels = ByteUtilities::readLong(file);
+			Long numLevels = ByteUtilities::readLong(file + SIZEOF_LONG);
+			if (numLevels < 0 || numLevels > MAX_LEVELS)
+				return false;
+			if (numLevels == 0)
+				continue;
+			if (levels < HEADER_SIZE || levels > (Long) pyramidSize
+					|| numLevels * LEVEL_ENTRY_SIZE > (Long) pyramidSize - levels)
+				return false;
+			for (Long k = 0; k < numLevels; k++)
+			{
+				char* level = p + levels + k * LEVEL_ENTRY_SIZE;
+				Long entries = ByteUtilities::readLong(level);
+				Long count = ByteUtilities::readLong(level + SIZEOF_LONG);
+				if (entries < HEADER_SIZE || entries > (Long) pyramidSize || count <= 0
+						|| count > ((Long) pyramidSize - entries) / SIZE_OF_TRACE_RECORD)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Reads the index of the merged file and the header of each trace.
+	 */
+	bool TracePyramid::readTraces(FileDescriptor fd, FileOffset traceSize, vector<Trace>& traces)
+	{
+		char header[2 * SIZEOF_INT];
+		if (!FileUtils::preadFully(fd, header, sizeof(header), 0))
+			return false;
+		int files = ByteUtilities::readInt(header + SIZEOF_INT);
+		if (files <= 0)
+			return false;
+
+		vector<char> index((size_t) files * (SIZEOF_LONG + 2 * SIZEOF_INT));
+		if (!FileUtils::preadFully(fd, &index[0], index.size(), sizeof(header)))
+			return false;
+
+		// int proc-id, int thread-id, long offset
+		vector<FileOffset> starts(files + 1);
+		for (int i = 0; i < files; i++)
+			starts[i] = ByteUtilities::readLong(&index[i * (SIZEOF_LONG + 2 * SIZEOF_INT) + 2 * SIZEOF_INT]);
+		starts[files] = traceSize - SIZEOF_LONG; // end marker
+
+		traces.resize(files);
+		for (int i = 0; i < files; i++)
+		{
+			FileOffset start = starts[i];
+			FileOffset end = starts[i + 1];
+
+			// version 1.0 traces have no flags
+			char traceHeader[HPCTRACE_FMT_MagicLen + HPCTRACE_FMT_VersionLen + 1];
+			if (end < start + sizeof(traceHeader) - 1
+					|| !FileUtils::preadFully(fd, traceHeader, sizeof(traceHeader) - 1, start))
+				return false;
+			traceHeader[sizeof(traceHeader) - 1] = '\0';
+			double version = atof(traceHeader + HPCTRACE_FMT_MagicLen);
+			FileOffset headerSize = HPCTRACE_FMT_MagicLen + HPCTRACE_FMT_VersionLen
+					+ HPCTRACE_FMT_EndianLen + (version > 1.0 ? SIZEOF_LONG : 0);
+
+			// data-centric records carry a metric id after the cpid
+			hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
+			if (version > 1.0)
+			{
+				char flagBytes[SIZEOF_LONG];
+				if (end < start + headerSize
+						|| !FileUtils::preadFully(fd, flagBytes, SIZEOF_LONG, start + headerSize - SIZEOF_LONG))
+					return false;
+				flags.bits = ByteUtilities::readLong(flagBytes);
+			}
+			if (flags.fields.isBlocked)
+				return false; // the merged file holds fixed-size records only
+			traces[i].recordSize = SIZE_OF_TRACE_RECORD
+					+ (flags.fields.isDataCentric ? SIZEOF_INT : 0);
+
+			traces[i].records = start + headerSize;
+			traces[i].numRecords = (end > traces[i].records)
+					? (end - traces[i].records) / traces[i].recordSize : 0;
+		}
+		return true;
+	}
+
+	Long TracePyramid::numEntries(Long numRecords, Long stride)
+	{
+		if (numRecords == 0)
+			return 0;
+		// every stride-th record and the last one
+		Long n = (numRecords + stride - 1) / stride;
+		if ((numRecords - 1) % stride != 0)
+			n++;
+		return n;
+	}
+
+	bool TracePyramid::build(string traceFile, string pyramidFile)
+	{
+		FileDescriptor fd = ::open(traceFile.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		FileOffset traceSize = FileUtils::getFileSize(traceFile);
+		vector<Trace> traces;
+		if (!readTraces(fd, traceSize, traces))
+		{
+			cerr << "Could not read the index of " << traceFile << endl;
+			close(fd);
+			return false;
+		}
+
+		// lay out the level tables, then the entries of each trace
+		int files = traces.size();
+		FileOffset pos = HEADER_SIZE + (FileOffset) files * FILE_ENTRY_SIZE;
+		for (int i = 0; i < files; i++)
+		{
+			traces[i].numLevels = 0;
+			for (Long stride = BASE_STRIDE;
+					numEntries(traces[i].numRecords, stride) >= MIN_ENTRIES; stride *= FANOUT)
+				traces[i].numLevels++;
+			traces[i].levels = pos;
+			pos += traces[i].numLevels * LEVEL_ENTRY_SIZE;
+		}
+		for (int i = 0; i < files; i++)
+		{
+			traces[i].entries = pos;
+			Long stride = BASE_STRIDE;
+			for (int k = 0; k < traces[i].numLevels; k++, stride *= FANOUT)
+				pos += numEntries(traces[i].numRecords, stride) * SIZE_OF_TRACE_RECORD;
+		}
+
+		vector<char> header(HEADER_SIZE + (size_t) files * FILE_ENTRY_SIZE, 0);
+		ByteUtilities::writeLong(&header[0], MAGIC);
+		ByteUtilities::writeLong(&header[SIZEOF_LONG], traceSize);
+		ByteUtilities::writeInt(&header[2 * SIZEOF_LONG], files);
+		for (int i = 0; i < files; i++)
+		{
+			char* file = &header[HEADER_SIZE + i * FILE_ENTRY_SIZE];
+			ByteUtilities::writeLong(file, traces[i].levels);
+			ByteUtilities::writeLong(file + SIZEOF_LONG, traces[i].numLevels);
+		}
+
+		// several servers may open the database at once
+		string tmpFile = pyramidFile + ".XXXXXX";
+		vector<char> tmpName(tmpFile.begin(), tmpFile.end());
+		tmpName.push_back('\0');
+		FileDescriptor outFd = mkstemp(&tmpName[0]);
+		if (outFd < 0)
+		{
+			cerr << "Could not create " << tmpFile << ": " << strerror(errno) << endl;
+			close(fd);
+			return false;
+		}
+		fchmod(outFd, 0644);
+
+		bool ok = FileUtils::pwriteFully(outFd, &header[0], header.size(), 0);
+
+		int numFailed = 0;
+		ProgressBar prog("Indexing traces", files);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:numFailed)
+#endif
+		for (int i = 0; i < files; i++)
+		{
+			if (!writeTrace(fd, outFd, traces[i]))
+			{
+				numFailed++;
+			}
+#ifdef ENABLE_OPENMP
+#pragma omp critical (TracePyramid_progress)
+#endif
+			prog.incrementProgress();
+		}
+		close(fd);
+
+		ok = (close(outFd) == 0) && ok && (numFailed == 0);
+		if (ok)
+			ok = (rename(&tmpName[0], pyramidFile.c_str()) == 0);
+		if (!ok)
+		{
+			cerr << "Failed to write " << pyramidFile << endl;
+			remove(&tmpName[0]);
+		}
+		return ok;
+	}
+
+	/**
+	 * Samples every BASE_STRIDE-th record of 'trace' in one sequential
+	 * pass; the coarser levels are subsets of that one. Entries keep the
+	 * time and cpid of a record and drop a data-centric metric id.
+	 */
+	bool TracePyramid::writeTrace(FileDescriptor inFd, FileDescriptor outFd, const Trace& trace)
+	{
+		if (trace.numLevels == 0)
+			return true;
+
+		const Long chunkRecords = BASE_STRIDE * 16384;
+		Long numRecords = trace.numRecords;
+		Long recordSize = trace.recordSize;
+
+		vector<char> chunk(chunkRecords * recordSize);
+		vector<char> finest;
+		finest.reserve(((numRecords + BASE_STRIDE - 1) / BASE_STRIDE) * SIZE_OF_TRACE_RECORD);
+		for (Long first = 0; first < numRecords; first += chunkRecords)
+		{
+			Long n = min(chunkRecords, numRecords - first);
+			if (!FileUtils::preadFully(inFd, &chunk[0], n * recordSize,
+					trace.records + first * recordSize))
+				return false;
+			for (Long r = 0; r < n; r += BASE_STRIDE)
+			{
+				char* record = &chunk[r * recordSize];
+				finest.insert(finest.end(), record, record + SIZE_OF_TRACE_RECORD);
+			}
+		}
+		char last[SIZE_OF_TRACE_RECORD];
+		if (!FileUtils::preadFully(inFd, last, SIZE_OF_TRACE_RECORD,
+				trace.records + (numRecords - 1) * recordSize))
+			return false;
+
+		vector<char> levels(trace.numLevels * LEVEL_ENTRY_SIZE);
+		vector<char> entries;
+		FileOffset pos = trace.entries;
+		Long stride = BASE_STRIDE;
+		for (int k = 0; k < trace.numLevels; k++, stride *= FANOUT)
+		{
+			// every (stride / BASE_STRIDE)-th entry of the finest level
+			Long step = stride / BASE_STRIDE;
+			entries.clear();
+			for (Long e = 0; e * SIZE_OF_TRACE_RECORD < (Long) finest.size(); e += step)
+			{
+				char* entry = &finest[e * SIZE_OF_TRACE_RECORD];
+				entries.insert(entries.end(), entry, entry + SIZE_OF_TRACE_RECORD);
+			}
+			if ((numRecords - 1) % stride != 0)
+				entries.insert(entries.end(), last, last + SIZE_OF_TRACE_RECORD);
+
+			if (!FileUtils::pwriteFully(outFd, &entries[0], entries.size(), pos))
+				return false;
+			ByteUtilities::writeLong(&levels[k * LEVEL_ENTRY_SIZE], pos);
+			ByteUtilities::writeLong(&levels[k * LEVEL_ENTRY_SIZE + SIZEOF_LONG],
+					entries.size() / SIZE_OF_TRACE_RECORD);
+			pos += entries.size();
+		}
+		return FileUtils::pwriteFully(outFd, &levels[0], levels.size(), trace.levels);
+	}
+
+} /* namespace TraceviewerServer */
@@ -0,0 +1,148 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL: https://hpctoolkit.googlecode.com/svn/branches/hpctoolkit-hpcserver/src/tool/hpcserver/TracePyramid.hpp $
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL: https://hpctoolkit.googlecode.com/svn/branches/hpctoolkit-hpcserver/src/tool/hpcserver/TracePyramid.hpp $
+//
+// Purpose:
+//   Multi-resolution time index (pyramid) of a merged trace file
+//
+// Description:
+//   TracePyramid: builds, validates and reads experiment.mt.pyramid
+//
+//***************************************************************************
+
+
+#ifndef TRACEPYRAMID_H_
+#define TRACEPYRAMID_H_
+
+#include <string>
+#include <vector>
+
+#include "ByteUtilities.hpp" //Long
+#include "Constants.hpp"
+#include "FileUtils.hpp" //FileOffset
+
+namespace TraceviewerServer
+{
+	/**
+	 * Level k of the pyramid of a trace holds every
+	 * (BASE_STRIDE * FANOUT^k)-th record of the trace, and its last one,
+	 * as (time, cpid) pairs whatever the record size of the trace. A view
+	 * with many records per pixel can then be sampled from a level of the
+	 * pyramid, which is a small contiguous part of the file, instead of
+	 * from the records spread over the whole trace.
+	 *
+	 * The file (big-endian) holds:
+	 *  long magic, long size of the merged file, int num_files, int 0
+	 *  for all files: long offset of its level table, long num_levels
+	 *  for all files and levels: long offset, long num_entries
+	 *  the entries: long time, int cpid
+	 */
+	class TracePyramid
+	{
+	public:
+		static const int BASE_STRIDE = 16;
+		static const int FANOUT = 4;
+
+		// Returns the pyramid of merged trace file 'traceFile', building it
+		// if it is missing, out of date or corrupt, or NULL if that fails
+		// (the caller then reads the raw trace).
+		static TracePyramid* open(string traceFile);
+		virtual ~TracePyramid();
+
+		// Finds the coarsest level of trace 'rank' that has at most
+		// 'maxStride' records between entries, and returns the locations
+		// of its first and last entry. Returns false if there is none.
+		bool findLevel(int rank, Long maxStride,
+				FileOffset& minLoc, FileOffset& maxLoc, Long& stride);
+
+		Long getLong(FileOffset pos)
+		{
+			return ByteUtilities::readLong(base + pos);
+		}
+		int getInt(FileOffset pos)
+		{
+			return ByteUtilities::readInt(base + pos);
+		}
+	private:
+		// "HPCTPY2": version 1 copied whole data-centric records
+		static const uint64_t MAGIC = 0x48504354505932ULL;
+		static const int HEADER_SIZE = 2 * SIZEOF_LONG + 2 * SIZEOF_INT;
+		static const int FILE_ENTRY_SIZE = 2 * SIZEOF_LONG;
+		static const int LEVEL_ENTRY_SIZE = 2 * SIZEOF_LONG;
+		static const Long MIN_ENTRIES = 64;
+		static const Long MAX_LEVELS = 32;
+
+		// One trace of the merged file
+		struct Trace
+		{
+			FileOffset records;
+			Long numRecords;
+			int recordSize;
+			FileOffset levels;
+			int numLevels;
+			FileOffset entries;
+		};
+
+		TracePyramid(char*, FileOffset);
+		static string fileName(string);
+		static bool isCurrent(char*, FileOffset, string);
+		static bool isValid(char*, FileOffset);
+		static bool build(string, string);
+		static bool readTraces(FileDescriptor, FileOffset, vector<Trace>&);
+		static Long numEntries(Long, Long);
+		static bool writeTrace(FileDescriptor, FileDescriptor, const Trace&);
+
+		char* base;
+		FileOffset size;
+		int numFiles;
+	};
+
+} /* namespace TraceviewerServer */
+#endif /* TRACEPYRAMID_H_ */
@@ -57,10 +57,16 @@
 //
 //***************************************************************************
 
+#include "UnitTests.hpp"
+
+int ut_numFailures = 0;
+
 extern void filterTest();
 extern void progBarTest();
 extern void compressionTest();
 extern void lruTest();
+extern void samplingTest();
+extern void pyramidTest();
 
 int main(int argc, char** argv)
 {
@@ -68,5 +74,14 @@ int main(int argc, char** argv)
 	compressionTest();
 	progBarTest();
 	filterTest();
+	samplingTest();
+	pyramidTest();
+
+	if (ut_numFailures > 0)
+	{
+		std::cerr << ut_numFailures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	return 0;
 }
 
@@ -0,0 +1,132 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Microbenchmark for timeline extraction (TraceDataByRank::getData)
+//
+// Description:
+//   Writes a synthetic merged trace file and reports the time to sample
+//   one rank's timeline at several display widths. A standalone program,
+//   kept out of LaunchUnitTests because its file is large.
+//
+//***************************************************************************
+
+#include "../DataOutputFileStream.hpp"
+#include "../FilteredBaseData.hpp"
+#include "../TraceDataByRank.hpp"
+
+#include <sys/time.h>
+#include <cstdio>
+#include <iostream>
+using namespace std;
+
+using namespace TraceviewerServer;
+
+static const int BENCH_RANKS = 16;
+static const Long BENCH_RECORDS = 1 << 20; //per rank
+static const int BENCH_HEADER_SIZE = 24;
+static const Time BENCH_INTERVAL = 10;
+
+static void writeBenchFile(const char* filename)
+{
+	DataOutputFileStream out(filename);
+	out.writeInt(MULTI_PROCESSES);
+	out.writeInt(BENCH_RANKS);
+	FileOffset start = 2 * SIZEOF_INT + BENCH_RANKS * (2 * SIZEOF_INT + SIZEOF_LONG);
+	for (int rank = 0; rank < BENCH_RANKS; rank++)
+	{
+		out.writeInt(rank);
+		out.writeInt(0);
+		out.writeLong(start);
+		start += BENCH_HEADER_SIZE + BENCH_RECORDS * SIZE_OF_TRACE_RECORD;
+	}
+	for (int rank = 0; rank < BENCH_RANKS; rank++)
+	{
+		for (int i = 0; i < BENCH_HEADER_SIZE; i++)
+			out.put(0);
+		for (Long i = 0; i < BENCH_RECORDS; i++)
+		{
+			out.writeLong(i * BENCH_INTERVAL + rank);
+			out.writeInt(i % 7);
+		}
+	}
+	out.writeInt(0); //end of file marker
+}
+
+int main(int argc, char** argv)
+{
+	const char* filename = "hpcserver_sampling_bench.mt";
+	writeBenchFile(filename);
+	{
+		FilteredBaseData data(filename, BENCH_HEADER_SIZE);
+		Time range = BENCH_RECORDS * BENCH_INTERVAL;
+
+		int widths[] = {1024, 4096, 8192};
+		for (int w = 0; w < 3; w++)
+		{
+			int width = widths[w];
+			timeval begin, end;
+			gettimeofday(&begin, NULL);
+			for (int rank = 0; rank < BENCH_RANKS; rank++)
+			{
+				TraceDataByRank timeline(&data, rank, width, BENCH_HEADER_SIZE);
+				timeline.getData(0, range, range / (double) width);
+			}
+			gettimeofday(&end, NULL);
+
+			Long elapsed = (end.tv_sec - begin.tv_sec) * 1000000 + (end.tv_usec - begin.tv_usec);
+			cout << "Sampling " << width << " pixels: " << elapsed / BENCH_RANKS
+					<< " us per rank" << endl;
+		}
+	}
+	remove(filename);
+	return 0;
+}
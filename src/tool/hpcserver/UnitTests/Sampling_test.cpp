@@ -0,0 +1,200 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Tests timeline extraction (TraceDataByRank::getData)
+//
+// Description:
+//   Writes a small synthetic merged trace file and checks the samples of
+//   each rank's timeline against a search of every record.
+//
+//***************************************************************************
+
+#include "../DataOutputFileStream.hpp"
+#include "../FilteredBaseData.hpp"
+#include "../TraceDataByRank.hpp"
+#include "UnitTests.hpp"
+
+#include <cstdio>
+#include <vector>
+using namespace std;
+
+using namespace TraceviewerServer;
+
+static const int SAMPLE_RANKS = 4;
+static const Long SAMPLE_RECORDS = 4096; //per rank
+static const int SAMPLE_HEADER_SIZE = 24;
+
+// uneven, strictly increasing times
+static Time recordTime(int rank, Long i)
+{
+	return 100 + i * 10 + (i % 3) * 3 + rank;
+}
+
+static int recordCpid(int rank, Long i)
+{
+	return (int) (i % 7) + 10 * rank;
+}
+
+static void writeSampleFile(const char* filename)
+{
+	DataOutputFileStream out(filename);
+	out.writeInt(MULTI_PROCESSES);
+	out.writeInt(SAMPLE_RANKS);
+	FileOffset start = 2 * SIZEOF_INT + SAMPLE_RANKS * (2 * SIZEOF_INT + SIZEOF_LONG);
+	for (int rank = 0; rank < SAMPLE_RANKS; rank++)
+	{
+		out.writeInt(rank);
+		out.writeInt(0);
+		out.writeLong(start);
+		start += SAMPLE_HEADER_SIZE + SAMPLE_RECORDS * SIZE_OF_TRACE_RECORD;
+	}
+	for (int rank = 0; rank < SAMPLE_RANKS; rank++)
+	{
+		for (int i = 0; i < SAMPLE_HEADER_SIZE; i++)
+			out.put(0);
+		for (Long i = 0; i < SAMPLE_RECORDS; i++)
+		{
+			out.writeLong(recordTime(rank, i));
+			out.writeInt(recordCpid(rank, i));
+		}
+	}
+	out.writeInt(0); //end of file marker
+}
+
+// the record of 'rank' closest to 'time' in [lo, hi], the later one on a tie
+static Long nearestRecord(int rank, Time time, Long lo, Long hi)
+{
+	if (time <= recordTime(rank, lo))
+		return lo;
+	if (time >= recordTime(rank, hi))
+		return hi;
+	Long l = lo;
+	while (recordTime(rank, l + 1) <= time)
+		l++;
+	return (time - recordTime(rank, l) < recordTime(rank, l + 1) - time) ? l : l + 1;
+}
+
+// the samples getData should return, found by scanning the records
+static void expectedSamples(int rank, Time timeStart, Time timeRange, int width,
+		vector<TimeCPID>& samples)
+{
+	double pixelLength = timeRange / (double) width;
+	Long last = SAMPLE_RECORDS - 1;
+	Long startRec = nearestRecord(rank, timeStart, 0, last);
+	Long endRec = min(nearestRecord(rank, timeStart + timeRange, 0, last) + 1, last);
+
+	vector<Long> recs;
+	if (startRec > 0)
+		recs.push_back(startRec - 1);
+	if (endRec - startRec + 1 <= width)
+	{
+		for (Long i = startRec; i <= endRec; i++)
+			recs.push_back(i);
+	}
+	else
+	{
+		for (int pixel = 1; pixel < width; pixel++)
+			recs.push_back(nearestRecord(rank, (long)(pixel * pixelLength + timeStart),
+					startRec, endRec));
+	}
+	if (endRec < last)
+		recs.push_back(endRec);
+
+	// of consecutive samples with the same time, only the first is kept
+	samples.clear();
+	for (size_t i = 0; i < recs.size(); i++)
+	{
+		Time t = recordTime(rank, recs[i]);
+		if (samples.empty() || samples.back().timestamp != t)
+			samples.push_back(TimeCPID(t, recordCpid(rank, recs[i])));
+	}
+}
+
+static void checkTimeline(FilteredBaseData* data, int rank, Time timeStart,
+		Time timeRange, int width)
+{
+	TraceDataByRank timeline(data, rank, width, SAMPLE_HEADER_SIZE);
+	timeline.getData(timeStart, timeRange, timeRange / (double) width);
+	vector<TimeCPID>& samples = *timeline.listCPID;
+
+	vector<TimeCPID> expected;
+	expectedSamples(rank, timeStart, timeRange, width, expected);
+
+	UT_CHECK(samples.size() == expected.size());
+	for (size_t i = 0; i < samples.size() && i < expected.size(); i++)
+	{
+		UT_CHECK(samples[i].timestamp == expected[i].timestamp);
+		UT_CHECK(samples[i].cpid == expected[i].cpid);
+	}
+}
+
+void samplingTest()
+{
+	const char* filename = "hpcserver_sampling_test.mt";
+	writeSampleFile(filename);
+	{
+		FilteredBaseData data(filename, SAMPLE_HEADER_SIZE);
+		Time end = recordTime(SAMPLE_RANKS, SAMPLE_RECORDS);
+
+		int widths[] = {64, 1000, 8192};
+		for (int w = 0; w < 3; w++)
+		{
+			for (int rank = 0; rank < SAMPLE_RANKS; rank++)
+			{
+				// the whole trace, and a window with records on both sides
+				checkTimeline(&data, rank, 0, end, widths[w]);
+				checkTimeline(&data, rank, end / 3, end / 4, widths[w]);
+			}
+		}
+	}
+	remove(filename);
+}
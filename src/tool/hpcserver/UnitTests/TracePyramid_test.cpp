@@ -0,0 +1,168 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Tests the trace pyramid
+//
+// Description:
+//   Builds the pyramid of a merged trace file with a data-centric trace
+//   and a plain one and checks the entries of their levels.
+//
+//***************************************************************************
+
+
+#include "../DataOutputFileStream.hpp"
+#include "../TracePyramid.hpp"
+#include "UnitTests.hpp"
+
+#include <cstdio>
+#include <string>
+
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+using namespace std;
+using namespace TraceviewerServer;
+
+static const int PYR_RANKS = 2;
+static const Long PYR_RECORDS = TracePyramid::BASE_STRIDE * 64 * TracePyramid::FANOUT + 5;
+
+static Long recordTime(int rank, Long i)
+{
+	return 1000 + i * 10 + rank;
+}
+
+static int recordCpid(int rank, Long i)
+{
+	return (int) (i % 13) + 100 * rank;
+}
+
+// rank 0 is data-centric: its records carry a metric id
+static bool isDataCentric(int rank)
+{
+	return rank == 0;
+}
+
+static void writeMergedFile(const char* filename)
+{
+	DataOutputFileStream out(filename);
+	out.writeInt(MULTI_PROCESSES);
+	out.writeInt(PYR_RANKS);
+	FileOffset start = 2 * SIZEOF_INT + PYR_RANKS * (2 * SIZEOF_INT + SIZEOF_LONG);
+	for (int rank = 0; rank < PYR_RANKS; rank++)
+	{
+		out.writeInt(rank);
+		out.writeInt(0);
+		out.writeLong(start);
+		start += HPCTRACE_FMT_HeaderLen + PYR_RECORDS
+				* (SIZE_OF_TRACE_RECORD + (isDataCentric(rank) ? SIZEOF_INT : 0));
+	}
+	for (int rank = 0; rank < PYR_RANKS; rank++)
+	{
+		hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
+		flags.fields.isDataCentric = isDataCentric(rank);
+		out.write(HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen);
+		out.write(HPCTRACE_FMT_Version, HPCTRACE_FMT_VersionLen);
+		out.write(HPCTRACE_FMT_Endian, HPCTRACE_FMT_EndianLen);
+		out.writeLong(flags.bits);
+		for (Long i = 0; i < PYR_RECORDS; i++)
+		{
+			out.writeLong(recordTime(rank, i));
+			out.writeInt(recordCpid(rank, i));
+			if (isDataCentric(rank))
+				out.writeInt(0x7fff0000 + (int) i); // metric id
+		}
+	}
+	out.writeLong(0); // end of file marker
+}
+
+// every entry of each level is the (time, cpid) of the record it samples
+static void checkLevels(TracePyramid* pyramid, int rank)
+{
+	Long lastStride = 0;
+	for (Long maxStride = TracePyramid::BASE_STRIDE; maxStride <= PYR_RECORDS;
+			maxStride *= TracePyramid::FANOUT)
+	{
+		FileOffset minLoc, maxLoc;
+		Long stride;
+		UT_CHECK(pyramid->findLevel(rank, maxStride, minLoc, maxLoc, stride));
+		if (stride == lastStride)
+			break; // coarsest level
+		lastStride = stride;
+
+		Long numEntries = (maxLoc - minLoc) / SIZE_OF_TRACE_RECORD + 1;
+		for (Long e = 0; e < numEntries; e++)
+		{
+			Long i = (e == numEntries - 1) ? PYR_RECORDS - 1 : e * stride;
+			FileOffset loc = minLoc + e * SIZE_OF_TRACE_RECORD;
+			UT_CHECK(pyramid->getLong(loc) == recordTime(rank, i));
+			UT_CHECK(pyramid->getInt(loc + SIZEOF_LONG) == recordCpid(rank, i));
+		}
+	}
+	UT_CHECK(lastStride > TracePyramid::BASE_STRIDE);
+}
+
+void pyramidTest()
+{
+	const char* filename = "hpcserver_pyramid_test.mt";
+	string pyramidFile = string(filename) + ".pyramid";
+	writeMergedFile(filename);
+
+	TracePyramid* pyramid = TracePyramid::open(filename);
+	UT_CHECK(pyramid != NULL);
+	if (pyramid != NULL)
+	{
+		for (int rank = 0; rank < PYR_RANKS; rank++)
+			checkLevels(pyramid, rank);
+		delete pyramid;
+	}
+	remove(pyramidFile.c_str());
+	remove(filename);
+}
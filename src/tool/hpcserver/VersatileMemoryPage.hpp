@@ -77,6 +77,10 @@ namespace TraceviewerServer
 		virtual ~VersatileMemoryPage();
 		static void setMaxPages(int);
 		char* get();
+		bool mapped() const
+		{
+			return isMapped;
+		}
 	private:
 		void mapPage();
 		void unmapPage();
@@ -85,12 +85,6 @@ main(int argc, char **argv)
 
   if (!infs) {
     fprintf(stderr, "%s: error opening trace file %s\n", argv[0], fileName);
-  }
-
-  ret = setvbuf(infs, infsBuf, _IOFBF, HPCIO_RWBufferSz);
-
-  if (ret != 0) {
-    fprintf(stderr, "%s: setvbuf failed\n", argv[0]);
     exit(-1);
   }
 
@@ -103,11 +97,31 @@ main(int argc, char **argv)
     exit(-1);
   }
 
-  // read and dump trace records until EOF 
-  while ( !feof(infs) ) {
-    hpctrace_fmt_datum_t datum;
+  // decode the records straight from the file (mapped, or else read
+  // into 'infsBuf') rather than through 'infs'
+  hpcio_inbuf_t inbuf;
+  ret = hpcio_inbuf_attach(&inbuf, fileno(infs), ftello(infs),
+			   infsBuf, HPCIO_RWBufferSz, HPCIO_INBUF_MMAP);
 
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+  if (ret != HPCFMT_OK) {
+    fprintf(stderr, "%s: unable to read records of %s\n", argv[0], fileName);
+    exit(-1);
+  }
+
+  // read and dump trace records until EOF 
+  const size_t maxRecs = 1024;
+  hpctrace_fmt_datum_t datum[maxRecs];
+  hpctrace_fmt_blk_t blk;
+  hpctrace_fmt_blk_init(&blk);
+  while (true) {
+    size_t numRecs = maxRecs;
+
+    ret = hpctrace_fmt_datums_inbuf_read(datum, &numRecs, hdr.flags, &blk,
+					 &inbuf);
+
+    for (size_t i = 0; i < numRecs; ++i) {
+      printf("%d\n", datum[i].cpId);
+    }
 
     if (ret == HPCFMT_EOF) {
       break;
@@ -116,10 +130,9 @@ main(int argc, char **argv)
       fprintf(stderr, "%s: error reading trace file %s\n", argv[0], fileName);
       exit(-1);
     }
-
-    printf("%d\n", datum.cpId);
   }
 
+  hpcio_inbuf_detach(&inbuf);
   hpcio_fclose(infs);
 
   delete[] infsBuf;